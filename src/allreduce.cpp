@@ -0,0 +1,110 @@
+#include "allreduce.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+struct ShmAllReduce::Header {
+    std::atomic<uint64_t> floats;
+    std::atomic<uint64_t> world;
+};
+
+struct alignas(64) ShmAllReduce::RankSlot {
+    std::atomic<uint64_t> posted;  // last step whose input is in the slot
+    std::atomic<uint64_t> reduced; // last step whose chunk is in the output
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared counters must be address-free");
+
+static constexpr size_t kChunkAlign = 16; // floats: chunks start on cache lines
+
+ShmAllReduce::~ShmAllReduce() { close(); }
+
+// Publishes `value` in an atomic field the first time; later ranks must agree.
+static bool agree(std::atomic<uint64_t>& field, uint64_t value) {
+    uint64_t expected = 0;
+    return field.compare_exchange_strong(expected, value) || expected == value;
+}
+
+bool ShmAllReduce::open(const std::string& name, uint32_t world, uint32_t rank, size_t floats) {
+    close();
+    if (world == 0 || rank >= world) return false;
+    world_ = world;
+    rank_ = rank;
+    floats_ = floats;
+    stride_ = (floats + kChunkAlign - 1) / kChunkAlign * kChunkAlign;
+    const size_t header_bytes = 64 + world * sizeof(RankSlot);
+    bytes_ = header_bytes + (world + 1) * stride_ * sizeof(float);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "shm_open " << name << " failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+    // Every rank sizes the segment to the same length; growing a new segment
+    // zero-fills it and a same-size ftruncate leaves the contents alone.
+    bool ok = ftruncate(fd, static_cast<off_t>(bytes_)) == 0;
+    void* p = ok ? mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "Failed to map shared segment " << name << "\n";
+        return false;
+    }
+    base_ = p;
+    auto* bytes = static_cast<uint8_t*>(base_);
+    header_ = reinterpret_cast<Header*>(bytes);
+    slots_ = reinterpret_cast<RankSlot*>(bytes + 64);
+    inputs_ = reinterpret_cast<float*>(bytes + header_bytes);
+    output_ = inputs_ + world * stride_;
+    if (!agree(header_->floats, floats + 1) || !agree(header_->world, world)) {
+        std::cerr << "Shared segment " << name << " was created for a different model or world size\n";
+        close();
+        return false;
+    }
+    step_ = slots_[rank].posted.load(std::memory_order_acquire);
+    return true;
+}
+
+void ShmAllReduce::close() {
+    if (base_) munmap(base_, bytes_);
+    base_ = nullptr;
+    header_ = nullptr;
+    slots_ = nullptr;
+}
+
+void ShmAllReduce::wait_all(std::atomic<uint64_t> RankSlot::*counter, uint64_t step) const {
+    for (uint32_t r = 0; r < world_; ++r) {
+        size_t spins = 0;
+        while ((slots_[r].*counter).load(std::memory_order_acquire) < step) {
+            if (++spins > 64) std::this_thread::yield();
+        }
+    }
+}
+
+void ShmAllReduce::sum(float* data) {
+    if (!base_) return;
+    const uint64_t step = ++step_;
+    std::memcpy(inputs_ + rank_ * stride_, data, floats_ * sizeof(float));
+    slots_[rank_].posted.store(step, std::memory_order_release);
+    wait_all(&RankSlot::posted, step);
+
+    const size_t chunk = (stride_ / kChunkAlign + world_ - 1) / world_ * kChunkAlign;
+    const size_t lo = std::min(floats_, rank_ * chunk);
+    const size_t hi = std::min(floats_, lo + chunk);
+    float* out = output_;
+    std::memcpy(out + lo, inputs_ + lo, (hi - lo) * sizeof(float));
+    for (uint32_t r = 1; r < world_; ++r) {
+        const float* in = inputs_ + r * stride_;
+        for (size_t i = lo; i < hi; ++i) out[i] += in[i];
+    }
+    slots_[rank_].reduced.store(step, std::memory_order_release);
+    wait_all(&RankSlot::reduced, step);
+
+    std::memcpy(data, out, floats_ * sizeof(float));
+}
+
+void remove_shm(const std::string& name) { shm_unlink(name.c_str()); }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Sums a float vector across `world` cooperating local processes through a
+// POSIX shared-memory segment. Every rank opens the same name with the same
+// length; the segment is created on first open and starts zeroed, so there
+// is no setup handshake. Each sum() is one step:
+//   1. copy the input into this rank's slot and publish the step number;
+//   2. once every rank has published, reduce one chunk of the vector (chunk
+//      = rank) over the slots in rank order into the shared output;
+//   3. once every rank has reduced, copy the whole output back.
+// Only per-rank step counters are shared (release/acquire, no locks), and
+// summing in rank order gives every rank bit-identical results.
+class ShmAllReduce {
+public:
+    ShmAllReduce() = default;
+    ShmAllReduce(const ShmAllReduce&) = delete;
+    ShmAllReduce& operator=(const ShmAllReduce&) = delete;
+    ~ShmAllReduce();
+
+    bool open(const std::string& name, uint32_t world, uint32_t rank, size_t floats);
+    // In-place sum of data[0, floats) over all ranks. Blocks until every rank
+    // has called it for the same step.
+    void sum(float* data);
+    void close();
+
+    uint32_t world() const { return world_; }
+    uint32_t rank() const { return rank_; }
+    size_t size() const { return floats_; }
+
+private:
+    struct Header;
+    struct RankSlot;
+
+    void wait_all(std::atomic<uint64_t> RankSlot::*counter, uint64_t step) const;
+
+    void* base_ = nullptr;
+    size_t bytes_ = 0;
+    Header* header_ = nullptr;
+    RankSlot* slots_ = nullptr;
+    float* inputs_ = nullptr; // world x stride
+    float* output_ = nullptr; // stride
+    size_t stride_ = 0;
+    size_t floats_ = 0;
+    uint32_t world_ = 1;
+    uint32_t rank_ = 0;
+    uint64_t step_ = 0;
+};
+
+// Removes a segment left behind by an earlier run; missing names are fine.
+void remove_shm(const std::string& name);
@@ -0,0 +1,102 @@
+#include "async_checkpoint.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+AsyncCheckpointer::AsyncCheckpointer(const std::string& base_path, size_t keep)
+    : base_(base_path), keep_(keep == 0 ? 1 : keep) {
+    worker_ = std::thread([this]() { run(); });
+}
+
+AsyncCheckpointer::~AsyncCheckpointer() {
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+}
+
+CheckpointSnapshot& AsyncCheckpointer::acquire() {
+    std::lock_guard<std::mutex> lock(mu_);
+    // Prefer a free slot; otherwise take back the queued one, which the writer
+    // has not started on. At most one slot is ever being written.
+    int pick = -1;
+    for (int i = 0; i < 2 && pick < 0; ++i) {
+        if (state_[i] == SlotState::Free) pick = i;
+    }
+    for (int i = 0; i < 2 && pick < 0; ++i) {
+        if (state_[i] == SlotState::Queued) pick = i;
+    }
+    state_[pick] = SlotState::Filling;
+    filling_ = pick;
+    return slots_[pick];
+}
+
+void AsyncCheckpointer::submit(size_t step) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (filling_ < 0) return;
+        step_[filling_] = step;
+        state_[filling_] = SlotState::Queued;
+        filling_ = -1;
+    }
+    cv_.notify_all();
+}
+
+void AsyncCheckpointer::drain() {
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this]() {
+        for (SlotState s : state_) {
+            if (s == SlotState::Queued || s == SlotState::Writing) return false;
+        }
+        return true;
+    });
+}
+
+size_t AsyncCheckpointer::written() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return written_;
+}
+
+size_t AsyncCheckpointer::failed() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return failed_;
+}
+
+void AsyncCheckpointer::run() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (true) {
+        // Write the older queued snapshot first if both are queued.
+        int slot = -1;
+        for (int i = 0; i < 2; ++i) {
+            if (state_[i] == SlotState::Queued && (slot < 0 || step_[i] < step_[slot])) slot = i;
+        }
+        if (slot < 0) {
+            if (stop_) return;
+            cv_.wait(lock);
+            continue;
+        }
+        state_[slot] = SlotState::Writing;
+        std::string path = base_ + ".step" + std::to_string(step_[slot]);
+        lock.unlock();
+
+        bool ok = write_snapshot(path, slots_[slot]);
+        if (!ok) std::cerr << "Background checkpoint failed: " << path << "\n";
+
+        lock.lock();
+        if (ok) {
+            ++written_;
+            on_disk_.push_back(path);
+            while (on_disk_.size() > keep_) {
+                std::remove(on_disk_.front().c_str());
+                on_disk_.pop_front();
+            }
+        } else {
+            ++failed_;
+        }
+        state_[slot] = SlotState::Free;
+        cv_.notify_all();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "checkpoint.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Writes checkpoint snapshots on a background thread. Two snapshot buffers
+// alternate: the trainer fills one while the other is being written. If a
+// snapshot is still queued when the next one is due, the queued one is
+// replaced rather than stalling training. Each snapshot lands in
+// "<base>.step<N>"; only the newest `keep` files written by this instance are
+// kept on disk.
+class AsyncCheckpointer {
+public:
+    AsyncCheckpointer(const std::string& base_path, size_t keep);
+    AsyncCheckpointer(const AsyncCheckpointer&) = delete;
+    AsyncCheckpointer& operator=(const AsyncCheckpointer&) = delete;
+    ~AsyncCheckpointer();
+
+    // Buffer to fill for the next snapshot; never the one being written.
+    CheckpointSnapshot& acquire();
+    // Queues the buffer returned by acquire() for writing.
+    void submit(size_t step);
+    // Blocks until nothing is queued or in flight.
+    void drain();
+    size_t written() const;
+    size_t failed() const;
+
+private:
+    enum class SlotState { Free, Filling, Queued, Writing };
+
+    void run();
+
+    std::string base_;
+    size_t keep_;
+    CheckpointSnapshot slots_[2];
+    SlotState state_[2] = {SlotState::Free, SlotState::Free};
+    size_t step_[2] = {0, 0};
+    int filling_ = -1;
+    std::deque<std::string> on_disk_;
+    size_t written_ = 0;
+    size_t failed_ = 0;
+    bool stop_ = false;
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::thread worker_;
+};
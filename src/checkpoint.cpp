@@ -1,15 +1,70 @@
 #include "checkpoint.hpp"
 
+#include "precision.hpp"
+
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <bit>
 #include <fstream>
 #include <iostream>
 
-static void write_vec(std::ofstream& f, const std::vector<float>& v) {
-    uint64_t n = v.size();
-    f.write(reinterpret_cast<const char*>(&n), sizeof(n));
-    if (n) f.write(reinterpret_cast<const char*>(v.data()), sizeof(float) * n);
+static constexpr uint32_t kMagicV1 = 0x4b474331; // "KGC1"
+static constexpr uint32_t kMagicV2 = 0x4b474332; // "KGC2"
+static constexpr size_t kAlign = 64;
+static constexpr size_t kNameLen = 40;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t section_count;
+    uint64_t table_offset;
+    uint64_t file_bytes;
+    uint64_t checksum;
+    uint8_t reserved[24];
+};
+static_assert(sizeof(FileHeader) == kAlign, "FileHeader must be 64 bytes");
+
+struct SectionEntry {
+    char name[kNameLen];
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t count;
+};
+static_assert(sizeof(SectionEntry) == kAlign, "SectionEntry must be 64 bytes");
+
+// Order of the values in the "meta" section. New fields go at the end.
+enum MetaField : size_t {
+    kMetaHidden,
+    kMetaLayers,
+    kMetaUseRelu,
+    kMetaUseInDegree,
+    kMetaAddNoise,
+    kMetaNumRel,
+    kMetaFeatureDim,
+    kMetaUseAdam,
+    kMetaStep,
+    kMetaCount,
+};
+
+static size_t type_size(uint32_t type) {
+    switch (static_cast<TensorType>(type)) {
+    case TensorType::F32: return sizeof(float);
+    case TensorType::U64: return sizeof(uint64_t);
+    case TensorType::F16: return sizeof(uint16_t);
+    case TensorType::BF16: return sizeof(uint16_t);
+    case TensorType::I8: return sizeof(int8_t);
+    case TensorType::U8: return sizeof(uint8_t);
+    }
+    return 0;
 }
 
+static size_t align_up(size_t x) { return (x + kAlign - 1) / kAlign * kAlign; }
+
 static bool read_vec(std::ifstream& f, std::vector<float>& v) {
     uint64_t n = 0;
     if (!f.read(reinterpret_cast<char*>(&n), sizeof(n))) return false;
@@ -20,75 +75,283 @@ static bool read_vec(std::ifstream& f, std::vector<float>& v) {
     return true;
 }
 
-bool save_checkpoint(const std::string& path, const Encoder& enc, const Decoder& dec,
-                     const FeatureConfig& feat_cfg, const Optimizer* opt) {
-    std::ofstream f(path, std::ios::binary | std::ios::trunc);
-    if (!f) {
-        std::cerr << "Failed to open checkpoint for write: " << path << "\n";
-        return false;
+
+bool write_checkpoint(const std::string& path, const std::vector<CheckpointTensor>& tensors) {
+    std::vector<SectionEntry> table(tensors.size());
+    size_t offset = align_up(sizeof(FileHeader) + table.size() * sizeof(SectionEntry));
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        const CheckpointTensor& t = tensors[i];
+        if (t.name.size() >= kNameLen) {
+            std::cerr << "Checkpoint tensor name too long: " << t.name << "\n";
+            return false;
+        }
+        SectionEntry& e = table[i];
+        std::memset(&e, 0, sizeof(e));
+        std::memcpy(e.name, t.name.data(), t.name.size());
+        e.type = static_cast<uint32_t>(t.type);
+        e.offset = offset;
+        e.count = t.count;
+        offset = align_up(offset + t.count * type_size(e.type));
     }
-    uint32_t magic = 0x4b474331; // "KGC1"
-    uint32_t version = 1;
-    f.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
-    f.write(reinterpret_cast<const char*>(&version), sizeof(version));
-
-    const EncoderConfig& ec = enc.config();
-    // Serialize encoder config
-    uint64_t hidden = enc.output_dim();
-    uint32_t layers = static_cast<uint32_t>(ec.layers);
-    f.write(reinterpret_cast<const char*>(&hidden), sizeof(hidden));
-    f.write(reinterpret_cast<const char*>(&layers), sizeof(layers));
-    uint64_t fanout_len = ec.fanouts.size();
-    f.write(reinterpret_cast<const char*>(&fanout_len), sizeof(fanout_len));
-    for (size_t i = 0; i < ec.fanouts.size(); ++i) {
-        uint64_t v = static_cast<uint64_t>(ec.fanouts[i]);
-        f.write(reinterpret_cast<const char*>(&v), sizeof(v));
-    }
-    uint8_t use_relu = ec.use_relu ? 1 : 0;
-    f.write(reinterpret_cast<const char*>(&use_relu), sizeof(use_relu));
-
-    uint8_t use_in = feat_cfg.use_in_degree ? 1 : 0;
-    uint8_t add_noise = feat_cfg.add_noise ? 1 : 0;
-    f.write(reinterpret_cast<const char*>(&use_in), sizeof(use_in));
-    f.write(reinterpret_cast<const char*>(&add_noise), sizeof(add_noise));
-
-    uint64_t num_rel = enc.num_relations();
-    f.write(reinterpret_cast<const char*>(&num_rel), sizeof(num_rel));
-    uint64_t feature_dim = enc.feature_dim_raw();
-    f.write(reinterpret_cast<const char*>(&feature_dim), sizeof(feature_dim));
-
-    // Parameters
-    auto params_enc = enc.parameters_const();
-    auto params_dec = dec.parameters_const();
-    std::vector<const Parameter*> params;
-    params.insert(params.end(), params_enc.begin(), params_enc.end());
-    params.insert(params.end(), params_dec.begin(), params_dec.end());
-
-    uint32_t param_count = static_cast<uint32_t>(params.size());
-    f.write(reinterpret_cast<const char*>(&param_count), sizeof(param_count));
-    for (const auto* p : params) {
-        write_vec(f, p->data);
-    }
-
-    bool use_adam = opt && !opt->m().empty();
-    uint8_t use_adam_u8 = use_adam ? 1 : 0;
-    f.write(reinterpret_cast<const char*>(&use_adam_u8), sizeof(use_adam_u8));
-    uint64_t step = opt ? static_cast<uint64_t>(opt->step_count()) : 0;
-    f.write(reinterpret_cast<const char*>(&step), sizeof(step));
-    if (use_adam) {
-        const auto& m = opt->m();
-        const auto& v = opt->v();
-        for (const auto& vec : m) write_vec(f, vec);
-        for (const auto& vec : v) write_vec(f, vec);
+
+    // Written to a temp file, synced and renamed so readers never see a partial checkpoint.
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open checkpoint for write: " << tmp << ": " << strerror(errno) << "\n";
+        return false;
     }
+    FileHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = kMagicV2;
+    hdr.version = 2;
+    hdr.section_count = table.size();
+    hdr.table_offset = sizeof(FileHeader);
+    hdr.file_bytes = offset;
 
+    // Header goes last, once the checksum is known.
+    static const char zeros[kAlign] = {};
+    Checksum64 sum;
+    bool ok = lseek(fd, sizeof(FileHeader), SEEK_SET) >= 0;
+    size_t pos = sizeof(FileHeader);
+    auto emit = [&](const void* data, size_t bytes) {
+        if (!ok || bytes == 0) return;
+        sum.update(data, bytes);
+        ok = write_all(fd, data, bytes);
+        pos += bytes;
+    };
+    emit(table.data(), table.size() * sizeof(SectionEntry));
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        emit(zeros, table[i].offset - pos);
+        emit(tensors[i].data, tensors[i].count * type_size(table[i].type));
+    }
+    emit(zeros, offset - pos);
+    hdr.checksum = sum.finish();
+    if (ok) ok = pwrite(fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr));
+    if (ok) ok = fsync(fd) == 0;
+    if (close(fd) != 0) ok = false;
+    if (ok) ok = rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        std::cerr << "Failed to write checkpoint " << path << ": " << strerror(errno) << "\n";
+        unlink(tmp.c_str());
+        return false;
+    }
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
     return true;
 }
 
-bool load_checkpoint(const std::string& path, CheckpointMeta& meta,
-                     std::vector<std::vector<float>>& params_out,
-                     std::vector<std::vector<float>>& m_out,
-                     std::vector<std::vector<float>>& v_out) {
+static std::vector<uint64_t> encode_meta(const CheckpointMeta& m) {
+    std::vector<uint64_t> words(kMetaCount, 0);
+    words[kMetaHidden] = m.enc_cfg.hidden_dim;
+    words[kMetaLayers] = static_cast<uint64_t>(m.enc_cfg.layers);
+    words[kMetaUseRelu] = m.enc_cfg.use_relu ? 1 : 0;
+    words[kMetaUseInDegree] = m.feat_cfg.use_in_degree ? 1 : 0;
+    words[kMetaAddNoise] = m.feat_cfg.add_noise ? 1 : 0;
+    words[kMetaNumRel] = m.num_rel;
+    words[kMetaFeatureDim] = m.feature_dim;
+    words[kMetaUseAdam] = m.use_adam ? 1 : 0;
+    words[kMetaStep] = m.step;
+    return words;
+}
+
+enum ProgressField : size_t {
+    kProgressEpoch,
+    kProgressNext,
+    kProgressRng0,
+    kProgressRng1,
+    kProgressShuffleSeed,
+    kProgressBatchEstimate, // absent from files written before it was added
+    kProgressCount,
+};
+
+static std::vector<uint64_t> encode_progress(const TrainProgress& p) {
+    if (!p.valid) return {};
+    std::vector<uint64_t> words(kProgressCount, 0);
+    words[kProgressEpoch] = p.epoch;
+    words[kProgressNext] = p.next;
+    words[kProgressRng0] = p.rng_s0;
+    words[kProgressRng1] = p.rng_s1;
+    words[kProgressShuffleSeed] = p.shuffle_seed;
+    words[kProgressBatchEstimate] = std::bit_cast<uint64_t>(p.batch_estimate);
+    return words;
+}
+
+static std::string encode_columns(const FeatureConfig& feat_cfg) {
+    std::string out;
+    for (const std::string& c : feat_cfg.columns) out += c + "\n";
+    return out;
+}
+
+static CheckpointMeta model_meta(const Encoder& enc, const FeatureConfig& feat_cfg, const Optimizer* opt) {
+    CheckpointMeta cm;
+    cm.enc_cfg = enc.config();
+    cm.enc_cfg.hidden_dim = enc.output_dim();
+    cm.feat_cfg = feat_cfg;
+    cm.num_rel = enc.num_relations();
+    cm.feature_dim = enc.feature_dim_raw();
+    cm.use_adam = opt && !opt->m().empty();
+    cm.step = opt ? opt->step_count() : 0;
+    return cm;
+}
+
+static std::vector<ParamSpec> model_specs(const Encoder& enc, const Decoder& dec) {
+    auto specs = enc.parameter_specs();
+    auto dspecs = dec.parameter_specs();
+    specs.insert(specs.end(), dspecs.begin(), dspecs.end());
+    return specs;
+}
+
+static void append_tensors(std::vector<CheckpointTensor>& out, const std::string& prefix,
+                           const std::vector<ParamSpec>& specs, const std::vector<const float*>& data) {
+    for (size_t i = 0; i < specs.size(); ++i) {
+        out.push_back({prefix + specs[i].name, TensorType::F32, data[i], specs[i].size});
+    }
+}
+
+// meta words, fanouts, columns and progress must outlive the returned tensors.
+static std::vector<CheckpointTensor> model_tensors(const std::vector<uint64_t>& meta,
+                                                   const std::vector<uint64_t>& fanouts,
+                                                   const std::string& columns,
+                                                   const std::vector<uint64_t>& progress,
+                                                   const std::vector<ParamSpec>& specs,
+                                                   const std::vector<const float*>& params,
+                                                   const std::vector<const float*>& m,
+                                                   const std::vector<const float*>& v) {
+    std::vector<CheckpointTensor> tensors;
+    tensors.push_back({"meta", TensorType::U64, meta.data(), meta.size()});
+    tensors.push_back({"meta.fanouts", TensorType::U64, fanouts.data(), fanouts.size()});
+    if (!columns.empty()) tensors.push_back({"meta.features", TensorType::U8, columns.data(), columns.size()});
+    if (!progress.empty()) {
+        tensors.push_back({"train.progress", TensorType::U64, progress.data(), progress.size()});
+    }
+    append_tensors(tensors, "param.", specs, params);
+    if (!m.empty()) append_tensors(tensors, "adam.m.", specs, m);
+    if (!v.empty()) append_tensors(tensors, "adam.v.", specs, v);
+    return tensors;
+}
+
+template <typename Vec>
+static std::vector<const float*> data_ptrs(const std::vector<Vec>& vecs) {
+    std::vector<const float*> out;
+    for (const auto& v : vecs) out.push_back(v.data());
+    return out;
+}
+
+bool save_checkpoint(const std::string& path, const Encoder& enc, const Decoder& dec,
+                     const FeatureConfig& feat_cfg, const Optimizer* opt,
+                     const TrainProgress* progress) {
+    CheckpointMeta cm = model_meta(enc, feat_cfg, opt);
+    if (progress) cm.progress = *progress;
+    std::vector<uint64_t> meta = encode_meta(cm);
+    std::vector<uint64_t> prog = encode_progress(cm.progress);
+    std::vector<uint64_t> fanouts(cm.enc_cfg.fanouts.begin(), cm.enc_cfg.fanouts.end());
+    std::string columns = encode_columns(cm.feat_cfg);
+
+    auto params = enc.parameters_const();
+    auto dparams = dec.parameters_const();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    std::vector<const float*> pdata;
+    for (const Parameter* p : params) pdata.push_back(p->data.data());
+    std::vector<const float*> m, v;
+    if (cm.use_adam) {
+        m = data_ptrs(opt->m());
+        v = data_ptrs(opt->v());
+    }
+    return write_checkpoint(path, model_tensors(meta, fanouts, columns, prog, model_specs(enc, dec), pdata, m, v));
+}
+
+void take_snapshot(const Encoder& enc, const Decoder& dec, const FeatureConfig& feat_cfg,
+                   const Optimizer* opt, CheckpointSnapshot& snap,
+                   const TrainProgress* progress) {
+    snap.meta = model_meta(enc, feat_cfg, opt);
+    if (progress) snap.meta.progress = *progress;
+    snap.specs = model_specs(enc, dec);
+    auto params = enc.parameters_const();
+    auto dparams = dec.parameters_const();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    snap.params.resize(params.size());
+    for (size_t i = 0; i < params.size(); ++i) {
+        snap.params[i].assign(params[i]->data.begin(), params[i]->data.end());
+    }
+    snap.m.resize(snap.meta.use_adam ? params.size() : 0);
+    snap.v.resize(snap.meta.use_adam ? params.size() : 0);
+    for (size_t i = 0; i < snap.m.size(); ++i) {
+        snap.m[i].assign(opt->m()[i].begin(), opt->m()[i].end());
+        snap.v[i].assign(opt->v()[i].begin(), opt->v()[i].end());
+    }
+}
+
+bool write_snapshot(const std::string& path, const CheckpointSnapshot& snap) {
+    std::vector<uint64_t> meta = encode_meta(snap.meta);
+    std::vector<uint64_t> fanouts(snap.meta.enc_cfg.fanouts.begin(), snap.meta.enc_cfg.fanouts.end());
+    std::vector<uint64_t> prog = encode_progress(snap.meta.progress);
+    std::string columns = encode_columns(snap.meta.feat_cfg);
+    return write_checkpoint(path, model_tensors(meta, fanouts, columns, prog, snap.specs, data_ptrs(snap.params),
+                                                data_ptrs(snap.m), data_ptrs(snap.v)));
+}
+
+bool export_checkpoint(const CheckpointView& view, const std::string& path, ExportPrecision precision) {
+    CheckpointMeta cm = view.meta();
+    cm.use_adam = false;
+    std::vector<uint64_t> meta = encode_meta(cm);
+    std::vector<uint64_t> fanouts(cm.enc_cfg.fanouts.begin(), cm.enc_cfg.fanouts.end());
+    std::string columns = encode_columns(cm.feat_cfg);
+    std::vector<CheckpointTensor> tensors;
+    tensors.push_back({"meta", TensorType::U64, meta.data(), meta.size()});
+    tensors.push_back({"meta.fanouts", TensorType::U64, fanouts.data(), fanouts.size()});
+    if (!columns.empty()) tensors.push_back({"meta.features", TensorType::U8, columns.data(), columns.size()});
+
+    // Converted payloads must stay alive until the file is written.
+    std::vector<std::vector<uint16_t>> halves;
+    std::vector<std::vector<int8_t>> bytes;
+    std::vector<std::vector<float>> scales;
+    const size_t rows = cm.num_rel + 1;
+    Encoder enc(cm.feature_dim, cm.num_rel, cm.enc_cfg, cm.feat_cfg);
+    Decoder dec(cm.num_rel, cm.enc_cfg.hidden_dim, enc.relation_embeddings());
+    auto specs = enc.parameter_specs();
+    auto dspecs = dec.parameter_specs();
+    specs.insert(specs.end(), dspecs.begin(), dspecs.end());
+    for (size_t i = 0; i < specs.size(); ++i) {
+        const std::string& name = specs[i].name;
+        std::string key = view.version() == 1 ? std::to_string(i) : name;
+        const CheckpointTensor* found = view.find("param." + key);
+        if (!found || found->count != specs[i].size) {
+            std::cerr << "Checkpoint tensor missing or mis-sized: " << name << "\n";
+            return false;
+        }
+        CheckpointTensor t = *found;
+        t.name = "param." + name;
+        const float* src = static_cast<const float*>(t.data);
+        bool quantisable = name == "enc.rel_emb" || name == "dec.rel_cls_w";
+        if (!quantisable || precision == ExportPrecision::F32) {
+            tensors.push_back(t);
+        } else if (precision == ExportPrecision::I8) {
+            bytes.emplace_back(t.count);
+            scales.emplace_back(rows);
+            quantize_rows_i8(src, rows, t.count / rows, bytes.back().data(), scales.back().data());
+            tensors.push_back({t.name, TensorType::I8, bytes.back().data(), t.count});
+            tensors.push_back({"scale." + name, TensorType::F32, scales.back().data(), rows});
+        } else {
+            halves.emplace_back(t.count);
+            bool bf16 = precision == ExportPrecision::BF16;
+            if (bf16) pack_bf16(src, halves.back().data(), t.count);
+            else pack_fp16(src, halves.back().data(), t.count);
+            tensors.push_back({t.name, bf16 ? TensorType::BF16 : TensorType::F16, halves.back().data(), t.count});
+        }
+    }
+    return write_checkpoint(path, tensors);
+}
+
+static bool load_checkpoint_v1(const std::string& path, CheckpointMeta& meta,
+                              std::vector<std::vector<float>>& params_out,
+                              std::vector<std::vector<float>>& m_out,
+                              std::vector<std::vector<float>>& v_out) {
     std::ifstream f(path, std::ios::binary);
     if (!f) {
         std::cerr << "Failed to open checkpoint for read: " << path << "\n";
@@ -154,12 +417,219 @@ bool load_checkpoint(const std::string& path, CheckpointMeta& meta,
     return true;
 }
 
+CheckpointView::~CheckpointView() {
+    unmap(map_);
+}
+
+bool CheckpointView::open(const std::string& path) {
+    unmap(map_);
+    tensors_.clear();
+    owned_.clear();
+    meta_ = CheckpointMeta();
+    version_ = 0;
+    checksum_ = 0;
+
+    if (!map_readonly(path, map_)) return false;
+    uint32_t magic = 0;
+    if (map_.bytes >= sizeof(magic)) std::memcpy(&magic, map_.data, sizeof(magic));
+    if (magic == kMagicV1) {
+        unmap(map_);
+        return open_v1(path);
+    }
+    if (magic != kMagicV2 || map_.bytes < sizeof(FileHeader)) {
+        std::cerr << "Bad checkpoint magic\n";
+        unmap(map_);
+        return false;
+    }
+
+    const uint8_t* base = static_cast<const uint8_t*>(map_.data);
+    FileHeader hdr;
+    std::memcpy(&hdr, base, sizeof(hdr));
+    if (hdr.version != 2) {
+        std::cerr << "Unsupported checkpoint version " << hdr.version << ": " << path << "\n";
+        unmap(map_);
+        return false;
+    }
+    bool ok = hdr.file_bytes == map_.bytes && hdr.table_offset >= sizeof(FileHeader) &&
+              hdr.table_offset % kAlign == 0 && hdr.table_offset <= map_.bytes &&
+              hdr.section_count <= (map_.bytes - hdr.table_offset) / sizeof(SectionEntry);
+    if (ok) {
+        const SectionEntry* table = reinterpret_cast<const SectionEntry*>(base + hdr.table_offset);
+        tensors_.reserve(hdr.section_count);
+        for (uint64_t i = 0; i < hdr.section_count && ok; ++i) {
+            const SectionEntry& e = table[i];
+            size_t elem = type_size(e.type);
+            ok = elem != 0 && e.name[kNameLen - 1] == '\0' && e.offset % kAlign == 0 &&
+                 e.offset <= map_.bytes && e.count <= (map_.bytes - e.offset) / elem;
+            if (ok) {
+                tensors_.push_back({std::string(e.name), static_cast<TensorType>(e.type),
+                                    base + e.offset, e.count});
+            }
+        }
+    }
+    if (!ok) {
+        std::cerr << "Corrupt checkpoint section table: " << path << "\n";
+        unmap(map_);
+        tensors_.clear();
+        return false;
+    }
+    version_ = hdr.version;
+    checksum_ = hdr.checksum;
+    return parse_meta() && expand_params();
+}
+
+bool CheckpointView::open_v1(const std::string& path) {
+    std::vector<std::vector<float>> params, m, v;
+    if (!load_checkpoint_v1(path, meta_, params, m, v)) return false;
+    size_t n = params.size();
+    owned_.reserve(n + m.size() + v.size());
+    for (auto& p : params) owned_.push_back(std::move(p));
+    for (auto& x : m) owned_.push_back(std::move(x));
+    for (auto& x : v) owned_.push_back(std::move(x));
+    for (size_t i = 0; i < owned_.size(); ++i) {
+        std::string prefix = i < n ? "param." : (i < n + m.size() ? "adam.m." : "adam.v.");
+        tensors_.push_back({prefix + std::to_string(i % n), TensorType::F32, owned_[i].data(), owned_[i].size()});
+    }
+    version_ = 1;
+    return true;
+}
+
+bool CheckpointView::parse_meta() {
+    const CheckpointTensor* meta = find("meta");
+    const CheckpointTensor* fanouts = find("meta.fanouts");
+    if (!meta || meta->type != TensorType::U64 || meta->count < kMetaCount ||
+        !fanouts || fanouts->type != TensorType::U64) {
+        std::cerr << "Checkpoint is missing its meta section\n";
+        return false;
+    }
+    const uint64_t* mv = static_cast<const uint64_t*>(meta->data);
+    const uint64_t* fv = static_cast<const uint64_t*>(fanouts->data);
+    meta_.enc_cfg.hidden_dim = static_cast<size_t>(mv[kMetaHidden]);
+    meta_.enc_cfg.layers = static_cast<int>(mv[kMetaLayers]);
+    meta_.enc_cfg.use_relu = mv[kMetaUseRelu] != 0;
+    meta_.enc_cfg.fanouts.assign(fv, fv + fanouts->count);
+    meta_.feat_cfg.use_in_degree = mv[kMetaUseInDegree] != 0;
+    meta_.feat_cfg.add_noise = mv[kMetaAddNoise] != 0;
+    meta_.num_rel = static_cast<size_t>(mv[kMetaNumRel]);
+    meta_.feature_dim = static_cast<size_t>(mv[kMetaFeatureDim]);
+    meta_.use_adam = mv[kMetaUseAdam] != 0;
+    meta_.step = static_cast<size_t>(mv[kMetaStep]);
+    const CheckpointTensor* columns = find("meta.features");
+    if (columns && columns->type == TensorType::U8) {
+        meta_.feat_cfg.columns = split_paths(
+            std::string(static_cast<const char*>(columns->data), columns->count), '\n');
+    }
+    const CheckpointTensor* progress = find("train.progress");
+    if (progress && progress->type == TensorType::U64 && progress->count >= kProgressBatchEstimate) {
+        const uint64_t* pv = static_cast<const uint64_t*>(progress->data);
+        meta_.progress.valid = true;
+        meta_.progress.epoch = pv[kProgressEpoch];
+        meta_.progress.next = pv[kProgressNext];
+        meta_.progress.rng_s0 = pv[kProgressRng0];
+        meta_.progress.rng_s1 = pv[kProgressRng1];
+        meta_.progress.shuffle_seed = pv[kProgressShuffleSeed];
+        if (progress->count > kProgressBatchEstimate) {
+            meta_.progress.batch_estimate = std::bit_cast<double>(pv[kProgressBatchEstimate]);
+        }
+    }
+    return true;
+}
+
+bool CheckpointView::expand_params() {
+    for (auto& t : tensors_) {
+        if (t.name.rfind("param.", 0) != 0 || t.type == TensorType::F32) continue;
+        std::vector<float> out(t.count);
+        if (t.type == TensorType::F16) {
+            unpack_fp16(static_cast<const uint16_t*>(t.data), out.data(), t.count);
+        } else if (t.type == TensorType::BF16) {
+            unpack_bf16(static_cast<const uint16_t*>(t.data), out.data(), t.count);
+        } else if (t.type == TensorType::I8) {
+            const CheckpointTensor* sc = find("scale." + t.name.substr(6));
+            if (!sc || sc->type != TensorType::F32 || sc->count == 0 || t.count % sc->count != 0) {
+                std::cerr << "Missing row scales for " << t.name << "\n";
+                return false;
+            }
+            dequantize_rows_i8(static_cast<const int8_t*>(t.data), static_cast<const float*>(sc->data),
+                               sc->count, t.count / sc->count, out.data());
+        } else {
+            std::cerr << "Unsupported tensor type for " << t.name << "\n";
+            return false;
+        }
+        owned_.push_back(std::move(out));
+        t.type = TensorType::F32;
+        t.data = owned_.back().data();
+    }
+    return true;
+}
+
+bool CheckpointView::verify() const {
+    if (version_ == 1) return true;
+    if (!map_.data) return false;
+    Checksum64 sum;
+    sum.update(static_cast<const uint8_t*>(map_.data) + sizeof(FileHeader), map_.bytes - sizeof(FileHeader));
+    return sum.finish() == checksum_;
+}
+
+const CheckpointTensor* CheckpointView::find(const std::string& name) const {
+    for (const auto& t : tensors_) {
+        if (t.name == name) return &t;
+    }
+    return nullptr;
+}
+
+bool bind_parameters(const CheckpointView& view, const std::vector<ParamSpec>& specs,
+                     const std::vector<Parameter*>& params) {
+    if (specs.size() != params.size()) return false;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        std::string key = view.version() == 1 ? std::to_string(i) : specs[i].name;
+        const CheckpointTensor* t = view.find("param." + key);
+        if (!t || t->type != TensorType::F32 || t->count != specs[i].size) {
+            std::cerr << "Checkpoint tensor missing or mis-sized: " << specs[i].name << "\n";
+            return false;
+        }
+        params[i]->data.borrow(static_cast<const float*>(t->data), t->count);
+        params[i]->grad.clear();
+    }
+    return true;
+}
+
+bool bind_checkpoint(const CheckpointView& view, Encoder& enc, Decoder& dec) {
+    auto params = enc.parameters();
+    auto dparams = dec.parameters();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    auto specs = enc.parameter_specs();
+    auto dspecs = dec.parameter_specs();
+    specs.insert(specs.end(), dspecs.begin(), dspecs.end());
+    return bind_parameters(view, specs, params);
+}
+
+bool load_checkpoint(const std::string& path, CheckpointMeta& meta,
+                     std::vector<std::vector<float>>& params_out,
+                     std::vector<std::vector<float>>& m_out,
+                     std::vector<std::vector<float>>& v_out) {
+    CheckpointView view;
+    if (!view.open(path)) return false;
+    meta = view.meta();
+    params_out.clear();
+    m_out.clear();
+    v_out.clear();
+    for (const auto& t : view.tensors()) {
+        if (t.type != TensorType::F32) continue;
+        const float* p = static_cast<const float*>(t.data);
+        std::vector<float> copy(p, p + t.count);
+        if (t.name.rfind("param.", 0) == 0) params_out.push_back(std::move(copy));
+        else if (t.name.rfind("adam.m.", 0) == 0) m_out.push_back(std::move(copy));
+        else if (t.name.rfind("adam.v.", 0) == 0) v_out.push_back(std::move(copy));
+    }
+    return true;
+}
+
 void assign_parameters(const std::vector<std::vector<float>>& data,
                        const std::vector<Parameter*>& params) {
     if (data.size() != params.size()) return;
     for (size_t i = 0; i < data.size(); ++i) {
         if (data[i].size() != params[i]->size()) continue;
-        params[i]->data = data[i];
+        params[i]->data.assign(data[i].data(), data[i].size());
         params[i]->grad.assign(params[i]->size(), 0.0f);
     }
 }
@@ -2,11 +2,26 @@
 
 #include "decoder.hpp"
 #include "encoder.hpp"
+#include "io.hpp"
 #include "optim.hpp"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+// Where a training run stopped: the next batch starts at position `next` of
+// epoch `epoch`'s order (see epoch_order), with the sampling RNG in state
+// (rng_s0, rng_s1). Stored in the optional "train.progress" section.
+struct TrainProgress {
+    bool valid = false;
+    uint64_t epoch = 0;
+    uint64_t next = 0;
+    uint64_t rng_s0 = 0;
+    uint64_t rng_s1 = 0;
+    uint64_t shuffle_seed = 0;
+    double batch_estimate = 0.0; // AdaptiveBatch bytes per triple under a memory budget
+};
+
 struct CheckpointMeta {
     EncoderConfig enc_cfg;
     FeatureConfig feat_cfg;
@@ -14,10 +29,105 @@ struct CheckpointMeta {
     size_t feature_dim = 0;
     bool use_adam = true;
     size_t step = 0;
+    TrainProgress progress;
+};
+
+enum class TensorType : uint32_t {
+    F32 = 0,
+    U64 = 1,
+    F16 = 2,
+    BF16 = 3,
+    I8 = 4, // per-row symmetric; row scales live in "scale.<name>"
+    U8 = 5, // raw bytes, e.g. the newline-separated feature columns
+};
+
+// Storage precision of the quantisable tensors (enc.rel_emb, dec.rel_cls_w)
+// in a serving artifact.
+enum class ExportPrecision {
+    F32,
+    F16,
+    BF16,
+    I8,
+};
+
+// A named tensor of a checkpoint. When writing, data points at the caller's
+// elements; in a CheckpointView it points into the mapped file.
+struct CheckpointTensor {
+    std::string name;
+    TensorType type = TensorType::F32;
+    const void* data = nullptr;
+    uint64_t count = 0;
 };
 
+class CheckpointView;
+
+// Writes the current format (KGC2): a 64-byte header, a table of 64-byte
+// section entries, then every tensor payload on a 64-byte boundary. The header
+// carries a checksum over everything that follows it. Files are written to
+// "<path>.tmp", fsynced and renamed into place.
 bool save_checkpoint(const std::string& path, const Encoder& enc, const Decoder& dec,
-                     const FeatureConfig& feat_cfg, const Optimizer* opt);
+                     const FeatureConfig& feat_cfg, const Optimizer* opt,
+                     const TrainProgress* progress = nullptr);
+
+bool write_checkpoint(const std::string& path, const std::vector<CheckpointTensor>& tensors);
+
+// Copy of everything save_checkpoint writes, taken between optimizer steps so
+// the file can be written off the training thread. Buffers are reused across
+// snapshots.
+struct CheckpointSnapshot {
+    CheckpointMeta meta;
+    std::vector<ParamSpec> specs;
+    std::vector<std::vector<float>> params;
+    std::vector<std::vector<float>> m;
+    std::vector<std::vector<float>> v;
+};
+
+void take_snapshot(const Encoder& enc, const Decoder& dec, const FeatureConfig& feat_cfg,
+                   const Optimizer* opt, CheckpointSnapshot& snap,
+                   const TrainProgress* progress = nullptr);
+bool write_snapshot(const std::string& path, const CheckpointSnapshot& snap);
+
+// Writes a serving artifact: weights only, no optimizer moments, with the
+// large relation tensors optionally stored in reduced precision.
+bool export_checkpoint(const CheckpointView& view, const std::string& path, ExportPrecision precision);
+
+// Read-only access to a checkpoint. KGC2 files are mapped and tensors point
+// straight into the mapping; legacy KGC1 files are read into owned buffers and
+// exposed under the same interface ("param.<i>", "adam.m.<i>", "adam.v.<i>").
+// Reduced-precision weights of a serving artifact are expanded to fp32 owned
+// buffers on open, so every "param." tensor is F32.
+class CheckpointView {
+public:
+    CheckpointView() = default;
+    CheckpointView(const CheckpointView&) = delete;
+    CheckpointView& operator=(const CheckpointView&) = delete;
+    ~CheckpointView();
+
+    bool open(const std::string& path);
+    bool verify() const;
+    uint32_t version() const { return version_; }
+    uint64_t checksum() const { return checksum_; } // from the header; 0 for KGC1
+    const CheckpointMeta& meta() const { return meta_; }
+    const CheckpointTensor* find(const std::string& name) const;
+    const std::vector<CheckpointTensor>& tensors() const { return tensors_; }
+
+private:
+    bool open_v1(const std::string& path);
+    bool parse_meta();
+    bool expand_params();
+
+    MMapArrayBase map_;
+    uint32_t version_ = 0;
+    uint64_t checksum_ = 0;
+    CheckpointMeta meta_;
+    std::vector<CheckpointTensor> tensors_;
+    std::vector<std::vector<float>> owned_;
+};
+
+// Points params at the view's weights without copying. The view must outlive them.
+bool bind_parameters(const CheckpointView& view, const std::vector<ParamSpec>& specs,
+                     const std::vector<Parameter*>& params);
+bool bind_checkpoint(const CheckpointView& view, Encoder& enc, Decoder& dec);
 
 bool load_checkpoint(const std::string& path, CheckpointMeta& meta,
                      std::vector<std::vector<float>>& params_out,
@@ -0,0 +1,95 @@
+#include "config_file.hpp"
+
+#include <fstream>
+#include <iostream>
+
+static std::string trim(const std::string& s) {
+    const size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return std::string();
+    const size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+bool read_config_section(const std::string& path, const std::string& section, ConfigEntries& out) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open config " << path << "\n";
+        return false;
+    }
+    std::string line, current;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+        ++line_no;
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        line = trim(line);
+        if (line.empty()) continue;
+        if (line.front() == '[') {
+            if (line.back() != ']') {
+                std::cerr << path << ":" << line_no << ": unterminated section header\n";
+                return false;
+            }
+            current = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+        const size_t eq = line.find('=');
+        if (eq == std::string::npos || trim(line.substr(0, eq)).empty()) {
+            std::cerr << path << ":" << line_no << ": expected key = value\n";
+            return false;
+        }
+        if (current == section) out.emplace_back(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+    }
+    return true;
+}
+
+bool write_config_file(const std::string& path, const std::string& header,
+                       const std::vector<std::pair<std::string, ConfigEntries>>& sections) {
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for write\n";
+        return false;
+    }
+    size_t start = 0;
+    while (start < header.size()) {
+        size_t nl = header.find('\n', start);
+        if (nl == std::string::npos) nl = header.size();
+        out << "# " << header.substr(start, nl - start) << "\n";
+        start = nl + 1;
+    }
+    for (const auto& [name, entries] : sections) {
+        out << "\n[" << name << "]\n";
+        for (const auto& [key, value] : entries) out << key << " = " << value << "\n";
+    }
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed to write " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool expand_config_args(int argc, char** argv, const std::string& section, std::vector<std::string>& args) {
+    args.clear();
+    for (int i = 0; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i > 0 && a == "--config" && i + 1 < argc) {
+            ConfigEntries entries;
+            if (!read_config_section(argv[++i], section, entries)) return false;
+            for (const auto& [key, value] : entries) {
+                args.push_back("--" + key);
+                if (!value.empty()) args.push_back(value);
+            }
+        } else {
+            args.push_back(a);
+        }
+    }
+    return true;
+}
+
+std::vector<char*> arg_pointers(std::vector<std::string>& args) {
+    std::vector<char*> out;
+    out.reserve(args.size() + 1);
+    for (std::string& a : args) out.push_back(a.data());
+    out.push_back(nullptr);
+    return out;
+}
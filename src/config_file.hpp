@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Tool configuration files, as written by kg_tune: "[section]" headers
+// followed by "key = value" lines, with '#' comments. Each key is the name of
+// a command-line flag without its leading "--".
+using ConfigEntries = std::vector<std::pair<std::string, std::string>>;
+
+// Reads the entries of `section` from `path`; false (with a message) if the
+// file cannot be read or has a malformed line.
+bool read_config_section(const std::string& path, const std::string& section, ConfigEntries& out);
+
+// Writes `sections` (name, entries) to `path` under a comment header.
+bool write_config_file(const std::string& path, const std::string& header,
+                       const std::vector<std::pair<std::string, ConfigEntries>>& sections);
+
+// Expands "--config FILE" in a command line into the flags of FILE's
+// `section`, placed where --config stood, so that flags given after it
+// override the file. `args` receives the full command line (argv[0] first).
+bool expand_config_args(int argc, char** argv, const std::string& section, std::vector<std::string>& args);
+
+// argv-style pointers into `args`, for the tools' parse_args.
+std::vector<char*> arg_pointers(std::vector<std::string>& args);
@@ -1,14 +1,26 @@
 #include "csr.hpp"
 
+#include "delta.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <sstream>
+#include <unistd.h>
+#include <utility>
 
 CsrGraph::~CsrGraph() {
     unmap(offsets_.base);
     unmap(csr_.base);
     unmap(rels_.base);
+    unmap(cbin_.base);
+    unmap(cidx_.base);
     unmap(entities_.base);
     unmap(props_.base);
+    unmap(delta_entities_.base);
+    unmap(delta_props_.base);
 }
 
 bool CsrGraph::load(const std::string& dir) {
@@ -20,59 +32,295 @@ bool CsrGraph::load_custom(const std::string& dir,
                            const std::string& csr_file,
                            const std::string& rels_file,
                            const std::string& entities_file,
-                           const std::string& props_file) {
+                           const std::string& props_file,
+                           const std::string& delta_file) {
     std::string offsets_path  = dir + "/" + offsets_file;
     std::string csr_path      = dir + "/" + csr_file;
     std::string rels_path     = dir + "/" + rels_file;
     std::string entities_path = dir + "/" + entities_file;
     std::string props_path    = dir + "/" + props_file;
 
-    if (!map_array(offsets_path, offsets_)) return false;
+    if (!map_array(offsets_path, offsets_, map_policy_.offsets)) return false;
     if (offsets_.size < 2) return false;
     n_ = static_cast<uint32_t>(offsets_.size - 2);
     m_ = offsets_[n_ + 1];
 
-    if (!map_array(csr_path, csr_)) return false;
-    if (!map_array(rels_path, rels_)) return false;
-    if (csr_.size != m_ || rels_.size != m_) {
-        std::cerr << "CSR size mismatch\n";
-        return false;
+    // Compressed adjacency replaces both csr and rels: "<csr stem>.cbin/.cidx".
+    std::string stem = csr_path.size() > 4 && csr_path.compare(csr_path.size() - 4, 4, ".bin") == 0
+                           ? csr_path.substr(0, csr_path.size() - 4)
+                           : csr_path;
+    bool use_packed = format_ == AdjFormat::Compressed ||
+                      (format_ == AdjFormat::Auto && file_exists(stem + ".cbin"));
+    if (use_packed && !map_packed(stem, offsets_path, csr_path, rels_path)) {
+        unmap(cbin_.base);
+        unmap(cidx_.base);
+        cbin_ = MMapArray<uint8_t>();
+        cidx_ = MMapArray<uint64_t>();
+        if (format_ == AdjFormat::Compressed) return false;
+        std::cerr << "Using the raw adjacency instead\n";
+        use_packed = false;
+    }
+    if (!use_packed) {
+        if (!map_array(csr_path, csr_, map_policy_.adjacency)) return false;
+        if (!map_array(rels_path, rels_, map_policy_.adjacency)) return false;
+        if (csr_.size != m_ || rels_.size != m_) {
+            std::cerr << "CSR size mismatch\n";
+            return false;
+        }
     }
+    // Lets caches recognise these base files without reading them (see GraphIdentity).
+    Checksum64 stamps;
+    for (const std::string& path : use_packed ? std::vector<std::string>{offsets_path, stem + ".cbin", stem + ".cidx"}
+                                              : std::vector<std::string>{offsets_path, csr_path, rels_path}) {
+        const FileStamp stamp = file_stamp(path);
+        stamps.update(&stamp, sizeof(stamp));
+    }
+    base_stamp_ = stamps.finish();
 
-    if (!map_array(entities_path, entities_)) return false;
+    if (!map_array(entities_path, entities_, map_policy_.dictionaries)) return false;
     if (entities_.size != n_) {
         std::cerr << "Entity map length mismatch\n";
         return false;
     }
 
-    if (!map_array(props_path, props_)) return false;
+    if (!map_array(props_path, props_, map_policy_.dictionaries)) return false;
     r_ = static_cast<uint32_t>(props_.size);
+    base_n_ = n_;
+    base_r_ = r_;
+
+    // kg_compact marks a log it is folding with "<log>.folding" once the
+    // merged base is staged as "<file>.compact". When none of those is left,
+    // the base already contains the log; a partly installed fold has to be
+    // finished by kg_compact first.
+    if (!delta_file.empty() && file_exists(dir + "/" + delta_file + ".folding")) {
+        size_t staged = 0;
+        for (const std::string* path : {&offsets_path, &csr_path, &rels_path}) {
+            staged += file_exists(*path + ".compact");
+        }
+        if (staged == 0) return true;
+        if (staged < 3) {
+            std::cerr << "Interrupted fold in " << dir << "; run kg_compact to finish it\n";
+            return false;
+        }
+    }
+    return load_delta(dir, delta_file);
+}
+
+uint64_t raw_csr_checksum(const uint32_t* offsets, size_t offset_count, const uint32_t* csr, const uint16_t* rels,
+                          size_t edges) {
+    // Blocks of edges are hashed in parallel, then combined in order.
+    constexpr size_t kBlock = size_t(1) << 20;
+    std::vector<uint64_t> sums((edges + kBlock - 1) / kBlock);
+    parallel_for(0, sums.size(), default_threads(), [&](size_t b) {
+        const size_t lo = b * kBlock;
+        const size_t count = std::min(edges, lo + kBlock) - lo;
+        Checksum64 sum;
+        sum.update(csr + lo, count * sizeof(uint32_t));
+        sum.update(rels + lo, count * sizeof(uint16_t));
+        sums[b] = sum.finish();
+    });
+    Checksum64 sum;
+    sum.update(offsets, offset_count * sizeof(uint32_t));
+    sum.update(sums.data(), sums.size() * sizeof(uint64_t));
+    return sum.finish();
+}
 
+// Maps "<stem>.cbin/.cidx" and checks that they encode the raw files next to
+// them: the same edge count and, for each raw file still there, the stamp it
+// had when kg_compress read it.
+bool CsrGraph::map_packed(const std::string& stem, const std::string& offsets_path, const std::string& csr_path,
+                          const std::string& rels_path) {
+    if (!map_array(stem + ".cbin", cbin_, map_policy_.adjacency) || !map_array(stem + ".cidx", cidx_, map_policy_.offsets)) {
+        return false;
+    }
+    PackedIndexHeader hdr{};
+    if (cidx_.size >= kPackedIndexHeaderWords) std::memcpy(&hdr, cidx_.data, sizeof(hdr));
+    if (hdr.magic != kPackedIndexMagic) {
+        std::cerr << stem << ".cidx has no current index header; rerun kg_compress\n";
+        return false;
+    }
+    cidx_.data += kPackedIndexHeaderWords;
+    cidx_.size -= kPackedIndexHeaderWords;
+    if (hdr.edges != m_ || cidx_.size != offsets_.size || cidx_[n_ + 1] + kPackedPadding > cbin_.size) {
+        std::cerr << "Compressed adjacency size mismatch\n";
+        return false;
+    }
+    const std::pair<const std::string*, const FileStamp*> raw[] = {
+        {&offsets_path, &hdr.offsets}, {&csr_path, &hdr.csr}, {&rels_path, &hdr.rels}};
+    for (const auto& [path, stamp] : raw) {
+        if (file_exists(*path) && file_stamp(*path) != *stamp) {
+            std::cerr << stem << ".cbin was encoded from a different " << *path << "; rerun kg_compress\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+void remove_packed(const std::string& dir, const std::string& stem) {
+    for (const char* ext : {".cbin", ".cidx"}) {
+        const std::string path = dir + "/" + stem + ext;
+        if (file_exists(path) && unlink(path.c_str()) == 0) {
+            std::cout << "Removed stale " << path << "; rerun kg_compress\n";
+        }
+    }
+}
+
+bool CsrGraph::load_delta(const std::string& dir, const std::string& delta_file) {
+    const std::string delta_path = dir + "/" + delta_file;
+    if (delta_file.empty() || file_size(delta_path) == 0) return true;
+    MMapArray<DeltaRecord> log;
+    if (!map_array(delta_path, log)) return false;
+    // Entities/props may grow after the log was written; records only ever
+    // reference a prefix of them.
+    if (file_size(dir + "/delta_entities.bin") > 0 && !map_array(dir + "/delta_entities.bin", delta_entities_)) {
+        unmap(log.base);
+        return false;
+    }
+    if (file_size(dir + "/delta_props.bin") > 0 && !map_array(dir + "/delta_props.bin", delta_props_)) {
+        unmap(log.base);
+        return false;
+    }
+    n_ = base_n_ + static_cast<uint32_t>(delta_entities_.size);
+    r_ = base_r_ + static_cast<uint32_t>(delta_props_.size);
+
+    // Replay the log into per-node adjacency, seeded from the base lists.
+    std::map<uint32_t, std::vector<std::pair<uint32_t, uint16_t>>> merged;
+    for (size_t i = 0; i < log.size; ++i) {
+        const DeltaRecord& d = log[i];
+        if (d.src == 0 || d.src > n_ || d.dst == 0 || d.dst > n_ || d.rel == 0 || d.rel > r_ ||
+            d.op > static_cast<uint16_t>(DeltaOp::Remove)) {
+            std::cerr << "Invalid record " << i << " in " << delta_path << "\n";
+            unmap(log.base);
+            return false;
+        }
+        auto it = merged.find(d.src);
+        if (it == merged.end()) {
+            it = merged.emplace(d.src, std::vector<std::pair<uint32_t, uint16_t>>()).first;
+            if (d.src <= base_n_) {
+                AdjView base = base_neighbors(d.src);
+                for (uint32_t e = 0; e < base.size; ++e) it->second.emplace_back(base.dst_at(e), base.rel_at(e));
+            }
+        }
+        auto& adj = it->second;
+        if (d.op == static_cast<uint16_t>(DeltaOp::Add)) {
+            adj.emplace_back(d.dst, d.rel);
+        } else {
+            adj.erase(std::remove(adj.begin(), adj.end(), std::make_pair(d.dst, d.rel)), adj.end());
+        }
+    }
+    delta_records_ = log.size;
+    unmap(log.base);
+
+    touched_.assign((static_cast<size_t>(n_) >> 6) + 1, 0);
+    overlay_.reserve(merged.size());
+    overlay_offsets_.assign(1, 0);
+    uint64_t m = m_;
+    for (const auto& [v, adj] : merged) {
+        touched_[v >> 6] |= uint64_t(1) << (v & 63);
+        overlay_.emplace(v, static_cast<uint32_t>(overlay_offsets_.size() - 1));
+        for (const auto& [dst, rel] : adj) {
+            overlay_dst_.push_back(dst);
+            overlay_rel_.push_back(rel);
+        }
+        overlay_offsets_.push_back(static_cast<uint32_t>(overlay_dst_.size()));
+        if (v <= base_n_) m -= offsets_[v + 1] - offsets_[v];
+        m += adj.size();
+    }
+    m_ = static_cast<uint32_t>(m);
     return true;
 }
 
 AdjView CsrGraph::neighbors(uint32_t v) const {
     if (v == 0 || v > n_) return {};
+    if (touched(v)) {
+        uint32_t slot = overlay_.find(v)->second;
+        uint32_t begin = overlay_offsets_[slot];
+        AdjView a;
+        a.dst  = overlay_dst_.data() + begin;
+        a.rel  = overlay_rel_.data() + begin;
+        a.size = overlay_offsets_[slot + 1] - begin;
+        return a;
+    }
+    if (v > base_n_) return {};
+    return base_neighbors(v);
+}
+
+AdjView CsrGraph::base_neighbors(uint32_t v) const {
     uint32_t begin = offsets_[v];
     uint32_t end   = offsets_[v + 1];
     AdjView a;
+    a.size = end - begin;
+    if (!cidx_.empty()) {
+        a.packed = cbin_.data + cidx_[v];
+        return a;
+    }
     a.dst  = csr_.data + begin;
     a.rel  = rels_.data + begin;
-    a.size = end - begin;
     return a;
 }
 
 uint32_t CsrGraph::out_degree(uint32_t v) const {
     if (v == 0 || v > n_) return 0;
+    if (touched(v)) {
+        uint32_t slot = overlay_.find(v)->second;
+        return overlay_offsets_[slot + 1] - overlay_offsets_[slot];
+    }
+    if (v > base_n_) return 0;
     return offsets_[v + 1] - offsets_[v];
 }
 
 uint32_t CsrGraph::entity_of(uint32_t v) const {
     if (v == 0 || v > n_) return 0;
+    if (v > base_n_) return delta_entities_[v - base_n_ - 1];
     return entities_[v - 1];
 }
 
 uint16_t CsrGraph::prop_of(uint32_t r) const {
     if (r == 0 || r > r_) return 0;
+    if (r > base_r_) return delta_props_[r - base_r_ - 1];
     return props_[r - 1];
 }
+
+// Hashes lists(v) for nodes 1..n: node blocks in parallel, then combined in
+// order after the counts.
+template <typename Lists>
+static uint64_t hash_lists(uint32_t n, uint64_t edges, uint64_t relations, size_t threads, Lists lists) {
+    constexpr uint32_t kBlock = 1u << 16;
+    std::vector<uint64_t> sums((static_cast<size_t>(n) + kBlock - 1) / kBlock);
+    parallel_for(0, sums.size(), threads, [&](size_t b) {
+        std::vector<uint32_t> ds;
+        std::vector<uint16_t> rs;
+        const uint32_t lo = static_cast<uint32_t>(b * kBlock) + 1;
+        const uint32_t hi = std::min<uint32_t>(n, lo + kBlock - 1);
+        Checksum64 sum;
+        for (uint32_t v = lo; v <= hi; ++v) {
+            AdjView adj = lists(v).unpacked(ds, rs);
+            sum.update(&adj.size, sizeof(adj.size));
+            sum.update(adj.dst, adj.size * sizeof(uint32_t));
+            sum.update(adj.rel, adj.size * sizeof(uint16_t));
+        }
+        sums[b] = sum.finish();
+    });
+    Checksum64 sum;
+    const uint64_t counts[] = {n, edges, relations};
+    sum.update(counts, sizeof(counts));
+    sum.update(sums.data(), sums.size() * sizeof(uint64_t));
+    return sum.finish();
+}
+
+uint64_t adjacency_checksum(const CsrGraph& g, size_t threads) {
+    return hash_lists(g.num_nodes(), g.num_edges(), g.num_relations(), threads,
+                      [&](uint32_t v) { return g.neighbors(v); });
+}
+
+uint64_t CsrGraph::base_checksum(size_t threads) const {
+    return hash_lists(base_n_, offsets_[base_n_ + 1], base_r_, threads, [this](uint32_t v) { return base_neighbors(v); });
+}
+
+GraphIdentity graph_identity(const CsrGraph& g, const GraphIdentity* known, size_t threads) {
+    GraphIdentity id;
+    id.stamp = g.base_stamp();
+    id.base = known && known->stamp == id.stamp ? known->base : g.base_checksum(threads);
+    id.delta = g.delta_records();
+    return id;
+}
@@ -1,16 +1,58 @@
 #pragma once
 
 #include "io.hpp"
+#include "packed_adj.hpp"
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+// Neighbours of one node. Raw adjacency exposes dst/rel arrays; compressed
+// adjacency sets `packed` instead and is read through dst_at/rel_at or
+// unpacked() into caller-provided scratch.
 struct AdjView {
     const uint32_t* dst = nullptr;
     const uint16_t* rel = nullptr;
     uint32_t size = 0;
+    const uint8_t* packed = nullptr;
+
+    uint32_t dst_at(uint32_t i) const { return packed ? packed_dst_at(packed, size, i) : dst[i]; }
+    uint16_t rel_at(uint32_t i) const { return packed ? packed_rel_at(packed, size, i) : rel[i]; }
+    AdjView unpacked(std::vector<uint32_t>& dst_scratch, std::vector<uint16_t>& rel_scratch) const {
+        if (!packed) return *this;
+        dst_scratch.resize(size);
+        rel_scratch.resize(size);
+        packed_decode(packed, size, dst_scratch.data(), rel_scratch.data());
+        AdjView a;
+        a.dst = dst_scratch.data();
+        a.rel = rel_scratch.data();
+        a.size = size;
+        return a;
+    }
+};
+
+enum class AdjFormat {
+    Auto,       // compressed when "<csr>.cbin" exists and matches the raw files, raw otherwise
+    Raw,
+    Compressed,
+};
+
+// Mapping policy per file group of a graph directory.
+struct GraphMapPolicy {
+    MapPolicy offsets;      // offsets.bin and the compressed index
+    MapPolicy adjacency;    // csr.bin/rels.bin or the compressed blob
+    MapPolicy dictionaries; // entities.bin, props.bin
 };
 
+// Checksum of raw offsets/csr/rels contents, recorded in the .cidx header.
+uint64_t raw_csr_checksum(const uint32_t* offsets, size_t offset_count, const uint32_t* csr, const uint16_t* rels,
+                          size_t edges);
+
+// Deletes "<dir>/<stem>.cbin/.cidx". Tools that rewrite a raw CSR call it so
+// that a compressed copy of the old adjacency is never loaded.
+void remove_packed(const std::string& dir, const std::string& stem);
+
 class CsrGraph {
 public:
     CsrGraph() = default;
@@ -23,7 +65,8 @@ public:
                      const std::string& csr_file,
                      const std::string& rels_file,
                      const std::string& entities_file = "entities.bin",
-                     const std::string& props_file = "props.bin");
+                     const std::string& props_file = "props.bin",
+                     const std::string& delta_file = "delta.bin");
     uint32_t num_nodes() const { return n_; }
     uint32_t num_edges() const { return m_; }
     uint32_t num_relations() const { return r_; }
@@ -31,15 +74,76 @@ public:
     uint32_t out_degree(uint32_t v) const;
     uint32_t entity_of(uint32_t v) const;
     uint16_t prop_of(uint32_t r) const;
+    // Hints the cache to load v's offsets (and compressed index entry) ahead of neighbors(v).
+    void prefetch(uint32_t v) const {
+        if (v == 0 || v > base_n_) return;
+        __builtin_prefetch(offsets_.data + v);
+        if (!cidx_.empty()) __builtin_prefetch(cidx_.data + v);
+    }
     bool valid() const { return n_ > 0; }
 
+    // Choose before load(); Auto prefers the compressed files when present.
+    void set_adjacency_format(AdjFormat f) { format_ = f; }
+    void set_map_policy(const GraphMapPolicy& p) { map_policy_ = p; }
+    bool compressed() const { return !cidx_.empty(); }
+
+    // Delta overlay (see delta.hpp). When the directory holds a delta log,
+    // neighbors()/out_degree() return the merged adjacency of the nodes it
+    // touches and the counts above include the delta.
+    size_t delta_records() const { return delta_records_; }
+    uint32_t base_nodes() const { return base_n_; }
+    uint32_t base_relations() const { return base_r_; }
+    // The base files without the delta: adjacency_checksum of their lists, and
+    // a hash of the stamps (see file_stamp) of the adjacency files taken at load.
+    uint64_t base_checksum(size_t threads) const;
+    uint64_t base_stamp() const { return base_stamp_; }
+
 private:
+    AdjView base_neighbors(uint32_t v) const;
+    bool map_packed(const std::string& stem, const std::string& offsets_path, const std::string& csr_path,
+                    const std::string& rels_path);
+    bool load_delta(const std::string& dir, const std::string& delta_file);
+    bool touched(uint32_t v) const { return !touched_.empty() && ((touched_[v >> 6] >> (v & 63)) & 1); }
+
     MMapArray<uint32_t> offsets_;
     MMapArray<uint32_t> csr_;
     MMapArray<uint16_t> rels_;
+    MMapArray<uint8_t> cbin_;
+    MMapArray<uint64_t> cidx_;
+    AdjFormat format_ = AdjFormat::Auto;
+    GraphMapPolicy map_policy_;
     MMapArray<uint32_t> entities_;
     MMapArray<uint16_t> props_;
     uint32_t n_ = 0;
     uint32_t m_ = 0;
     uint32_t r_ = 0;
+
+    MMapArray<uint32_t> delta_entities_;
+    MMapArray<uint16_t> delta_props_;
+    uint32_t base_n_ = 0;
+    uint32_t base_r_ = 0;
+    uint64_t base_stamp_ = 0;
+    size_t delta_records_ = 0;
+    std::vector<uint64_t> touched_;                  // bit per node ID
+    std::unordered_map<uint32_t, uint32_t> overlay_; // node -> slot
+    std::vector<uint32_t> overlay_offsets_;          // slot -> range, len = slots+1
+    std::vector<uint32_t> overlay_dst_;
+    std::vector<uint16_t> overlay_rel_;
 };
+
+// Checksum of every adjacency list as neighbors() returns it, delta log
+// included. Two graphs with the same checksum produce the same embeddings.
+uint64_t adjacency_checksum(const CsrGraph& g, size_t threads);
+
+// Identifies a graph without hashing it on every use: the base_checksum, the
+// base_stamp it was taken at, and the number of delta records on top. Delta
+// logs only grow until kg_compact folds them, which rewrites the base.
+struct GraphIdentity {
+    uint64_t base = 0;
+    uint64_t stamp = 0;
+    uint64_t delta = 0;
+};
+
+// g's identity, taking the base checksum from `known` when its stamp is g's
+// base_stamp and hashing the base lists otherwise.
+GraphIdentity graph_identity(const CsrGraph& g, const GraphIdentity* known, size_t threads);
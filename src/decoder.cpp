@@ -11,8 +11,11 @@ static void init_param(Parameter& p, size_t n, XorShift128Plus& rng, float scale
     }
 }
 
+Decoder::Decoder(size_t num_relations, size_t dim, Parameter* shared_rel_emb)
+    : num_rel_(num_relations), dim_(dim), rel_emb_(shared_rel_emb) {}
+
 Decoder::Decoder(size_t num_relations, size_t dim, Parameter* shared_rel_emb, XorShift128Plus& rng)
-    : num_rel_(num_relations), dim_(dim), rel_emb_(shared_rel_emb) {
+    : Decoder(num_relations, dim, shared_rel_emb) {
     init_param(rel_cls_w_, (num_rel_ + 1) * 4 * dim_, rng, 0.1f / std::sqrt(static_cast<float>(dim_)));
     init_param(rel_cls_b_, num_rel_ + 1, rng, 0.01f);
 }
@@ -150,3 +153,7 @@ std::vector<Parameter*> Decoder::parameters() {
 std::vector<const Parameter*> Decoder::parameters_const() const {
     return {&rel_cls_w_, &rel_cls_b_};
 }
+
+std::vector<ParamSpec> Decoder::parameter_specs() const {
+    return {{"dec.rel_cls_w", (num_rel_ + 1) * 4 * dim_}, {"dec.rel_cls_b", num_rel_ + 1}};
+}
@@ -9,6 +9,8 @@
 class Decoder {
 public:
     Decoder(size_t num_relations, size_t dim, Parameter* shared_rel_emb, XorShift128Plus& rng);
+    // Parameters are left unallocated; bind them to a checkpoint before use.
+    Decoder(size_t num_relations, size_t dim, Parameter* shared_rel_emb);
 
     float distmult_loss(const std::vector<uint32_t>& heads,
                         const std::vector<uint32_t>& rels,
@@ -29,6 +31,7 @@ public:
 
     std::vector<Parameter*> parameters();
     std::vector<const Parameter*> parameters_const() const;
+    std::vector<ParamSpec> parameter_specs() const;
     const Parameter& rel_cls_w() const { return rel_cls_w_; }
     const Parameter& rel_cls_b() const { return rel_cls_b_; }
 
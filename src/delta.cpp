@@ -0,0 +1,109 @@
+#include "delta.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+
+template <typename T>
+static bool append_bytes(const std::string& path, const T* data, size_t count) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << path << " for append: " << strerror(errno) << "\n";
+        return false;
+    }
+    bool ok = write_all(fd, data, count * sizeof(T)) && fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool append_delta(const std::string& path, const std::vector<DeltaRecord>& records) {
+    return append_bytes(path, records.data(), records.size());
+}
+
+template <typename T>
+bool append_array(const std::string& path, const std::vector<T>& data) {
+    return append_bytes(path, data.data(), data.size());
+}
+
+template bool append_array<uint32_t>(const std::string&, const std::vector<uint32_t>&);
+template bool append_array<uint16_t>(const std::string&, const std::vector<uint16_t>&);
+
+// Buffered sequential writer that fsyncs on close.
+class FileWriter {
+public:
+    explicit FileWriter(const std::string& path) : path_(path) {
+        fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) std::cerr << "Failed to open " << path << " for write: " << strerror(errno) << "\n";
+        buf_.reserve(kBuf);
+    }
+    ~FileWriter() {
+        if (fd_ >= 0) close(fd_);
+    }
+
+    template <typename T>
+    void put(const T* data, size_t count) {
+        const char* p = reinterpret_cast<const char*>(data);
+        size_t bytes = count * sizeof(T);
+        if (buf_.size() + bytes > kBuf) flush();
+        if (bytes > kBuf) {
+            ok_ = ok_ && fd_ >= 0 && write_all(fd_, p, bytes);
+            return;
+        }
+        buf_.insert(buf_.end(), p, p + bytes);
+    }
+
+    bool finish() {
+        flush();
+        ok_ = ok_ && fd_ >= 0 && fsync(fd_) == 0;
+        if (!ok_) std::cerr << "Failed to write " << path_ << "\n";
+        return ok_;
+    }
+
+private:
+    static constexpr size_t kBuf = 1 << 22;
+
+    void flush() {
+        ok_ = ok_ && fd_ >= 0 && write_all(fd_, buf_.data(), buf_.size());
+        buf_.clear();
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    bool ok_ = true;
+    std::vector<char> buf_;
+};
+
+bool write_merged_csr(const CsrGraph& g, const std::string& offsets_path,
+                      const std::string& csr_path, const std::string& rels_path) {
+    FileWriter offsets(offsets_path), csr(csr_path), rels(rels_path);
+    uint32_t pos = 0;
+    std::vector<uint32_t> dst_scratch;
+    std::vector<uint16_t> rel_scratch;
+    offsets.put(&pos, 1); // node 0 is reserved
+    for (uint32_t v = 1; v <= g.num_nodes(); ++v) {
+        offsets.put(&pos, 1);
+        AdjView adj = g.neighbors(v).unpacked(dst_scratch, rel_scratch);
+        csr.put(adj.dst, adj.size);
+        rels.put(adj.rel, adj.size);
+        pos += adj.size;
+    }
+    offsets.put(&pos, 1);
+    return offsets.finish() && csr.finish() && rels.finish();
+}
+
+bool write_merged_dictionaries(const CsrGraph& g, const std::string& entities_path,
+                               const std::string& props_path) {
+    FileWriter entities(entities_path), props(props_path);
+    for (uint32_t v = 1; v <= g.num_nodes(); ++v) {
+        uint32_t q = g.entity_of(v);
+        entities.put(&q, 1);
+    }
+    for (uint32_t r = 1; r <= g.num_relations(); ++r) {
+        uint16_t p = g.prop_of(r);
+        props.put(&p, 1);
+    }
+    return entities.finish() && props.finish();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "csr.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Append-only edge log layered over a base CSR. Records use internal IDs; node
+// IDs past the base node count refer to entities listed in
+// "delta_entities.bin", relation IDs past the base count to "delta_props.bin".
+// The forward log is "delta.bin"; the reverse directory keeps the same edits
+// with src/dst swapped in "delta_rev.bin".
+enum class DeltaOp : uint16_t {
+    Add = 0,
+    Remove = 1, // drops every (dst, rel) copy present at that point of the log
+};
+
+struct DeltaRecord {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t rel;
+    uint16_t op;
+};
+static_assert(sizeof(DeltaRecord) == 12, "DeltaRecord must be 12 bytes");
+
+// Appends and fsyncs; readers that map the file later see whole records only.
+bool append_delta(const std::string& path, const std::vector<DeltaRecord>& records);
+
+template <typename T>
+bool append_array(const std::string& path, const std::vector<T>& data);
+
+// Writes the merged (base + delta) graph as plain CSR files.
+bool write_merged_csr(const CsrGraph& g, const std::string& offsets_path,
+                      const std::string& csr_path, const std::string& rels_path);
+bool write_merged_dictionaries(const CsrGraph& g, const std::string& entities_path,
+                               const std::string& props_path);
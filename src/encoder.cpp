@@ -1,6 +1,7 @@
 #include "encoder.hpp"
 
 #include "features.hpp"
+#include "precision.hpp"
 #include "sampler.hpp"
 
 #include <algorithm>
@@ -16,13 +17,18 @@ static void init_param(Parameter& p, size_t n, XorShift128Plus& rng, float scale
 }
 
 Encoder::Encoder(size_t feature_dim, size_t num_relations, const EncoderConfig& cfg,
-                 const FeatureConfig& feat_cfg, XorShift128Plus& rng)
+                 const FeatureConfig& feat_cfg)
     : cfg_(cfg), feature_dim_(feature_dim), num_rel_(num_relations), feat_cfg_(feat_cfg) {
     if (feature_dim_ <= 1) feat_cfg_.use_in_degree = false;
-    init_param(input_w_, feature_dim_ * cfg_.hidden_dim, rng, 0.1f);
-    init_param(input_b_, cfg_.hidden_dim, rng, 0.01f);
     layer_w_.resize(cfg_.layers);
     layer_b_.resize(cfg_.layers);
+}
+
+Encoder::Encoder(size_t feature_dim, size_t num_relations, const EncoderConfig& cfg,
+                 const FeatureConfig& feat_cfg, XorShift128Plus& rng)
+    : Encoder(feature_dim, num_relations, cfg, feat_cfg) {
+    init_param(input_w_, feature_dim_ * cfg_.hidden_dim, rng, 0.1f);
+    init_param(input_b_, cfg_.hidden_dim, rng, 0.01f);
     for (int l = 0; l < cfg_.layers; ++l) {
         init_param(layer_w_[l], 2 * cfg_.hidden_dim * cfg_.hidden_dim, rng, 0.1f / std::sqrt(static_cast<float>(cfg_.hidden_dim)));
         init_param(layer_b_[l], cfg_.hidden_dim, rng, 0.01f);
@@ -30,10 +36,99 @@ Encoder::Encoder(size_t feature_dim, size_t num_relations, const EncoderConfig&
     init_param(rel_emb_, (num_rel_ + 1) * cfg_.hidden_dim, rng, 0.1f);
 }
 
+static void pack_saved(std::vector<float>& src, std::vector<uint16_t>& dst) {
+    dst.resize(src.size());
+    pack_bf16(src.data(), dst.data(), src.size());
+    std::vector<float>().swap(src);
+}
+
+// fp32 view of a saved activation, unpacking the bf16 copy into scratch if the
+// layer was stored in reduced precision.
+static const float* saved_rows(const std::vector<std::vector<float>>& f32,
+                               const std::vector<std::vector<uint16_t>>& b16,
+                               size_t l, std::vector<float>& scratch) {
+    if (l >= b16.size() || b16[l].empty()) return f32[l].data();
+    scratch.resize(b16[l].size());
+    unpack_bf16(b16[l].data(), scratch.data(), scratch.size());
+    return scratch.data();
+}
+
+size_t EncoderState::activation_bytes() const {
+    size_t floats = base_features.size();
+    size_t halves = 0;
+    for (const auto& v : h_layers) floats += v.size();
+    for (const auto& v : pre_layers) floats += v.size();
+    for (const auto& v : agg_layers) floats += v.size();
+    for (const auto& v : h_layers_bf16) halves += v.size();
+    for (const auto& v : pre_layers_bf16) halves += v.size();
+    for (const auto& v : agg_layers_bf16) halves += v.size();
+    return floats * sizeof(float) + halves * sizeof(uint16_t);
+}
+
+// Both write the pre-activation; callers apply the ReLU.
+void Encoder::project_input(const float* features, float* out) const {
+    const size_t hidden = cfg_.hidden_dim;
+    for (size_t d = 0; d < hidden; ++d) {
+        float sum = input_b_.data[d];
+        for (size_t f = 0; f < feature_dim_; ++f) {
+            sum += features[f] * input_w_.data[f * hidden + d];
+        }
+        out[d] = sum;
+    }
+}
+
+void Encoder::apply_layer(size_t l, const float* self, const float* agg, float* out) const {
+    const size_t hidden = cfg_.hidden_dim;
+    for (size_t d = 0; d < hidden; ++d) {
+        float sum = layer_b_[l].data[d];
+        for (size_t k = 0; k < hidden; ++k) {
+            float self_val = self ? self[k] : 0.0f;
+            sum += self_val * layer_w_[l].data[k * hidden + d]; // self part
+            sum += agg[k] * layer_w_[l].data[(hidden + k) * hidden + d]; // agg part
+        }
+        out[d] = sum;
+    }
+}
+
+size_t Encoder::predict_bytes(const BatchSubgraph& sg, bool backward) const {
+    const size_t L = cfg_.fanouts.size();
+    const size_t hidden = cfg_.hidden_dim;
+    size_t floats = sg.nodes_per_layer[0].size() * feature_dim_;
+    size_t halves = 0;
+    for (size_t l = 0; l <= L; ++l) {
+        const size_t n = sg.nodes_per_layer[l].size() * hidden;
+        // h and pre of every layer, agg of every aggregation layer (sized by
+        // its targets); with bf16 all but the output h are kept packed.
+        const size_t saved = 2 * n + (l > 0 ? n : 0);
+        if (cfg_.bf16_activations) {
+            halves += l < L ? saved : saved - n;
+            floats += l < L ? 0 : n;
+        } else {
+            floats += saved;
+        }
+        if (backward) floats += n;
+    }
+    return floats * sizeof(float) + halves * sizeof(uint16_t);
+}
+
+BatchSubgraph Encoder::sample(const CsrGraph& g, const std::vector<uint32_t>& batch_nodes, XorShift128Plus& rng) {
+    ScopedPhase phase(phase_times_, Phase::Subgraph);
+    return build_subgraph(g, batch_nodes, cfg_.fanouts, rng, history_);
+}
+
 EncoderState Encoder::forward(const CsrGraph& g, const CsrGraph* rev,
                               const std::vector<uint32_t>& batch_nodes, XorShift128Plus& rng) {
+    return forward(g, rev, sample(g, batch_nodes, rng));
+}
+
+EncoderState Encoder::forward(const CsrGraph& g, const CsrGraph* rev, BatchSubgraph sg) {
     EncoderState st;
-    st.sg = build_subgraph(g, batch_nodes, cfg_.fanouts, rng);
+    st.sg = std::move(sg);
+    {
+        ScopedPhase phase(phase_times_, Phase::Features);
+        compute_base_features(g, rev, st.sg.nodes_per_layer[0], feat_cfg_, st.base_features, store_);
+    }
+    ScopedPhase phase(phase_times_, Phase::Forward);
     size_t L = cfg_.fanouts.size();
 
     st.index_per_layer.resize(L + 1);
@@ -47,10 +142,11 @@ EncoderState Encoder::forward(const CsrGraph& g, const CsrGraph* rev,
     st.h_layers.resize(L + 1);
     st.pre_layers.resize(L + 1);
     st.agg_layers.resize(L);
-
-    // Base features
-    st.base_features.clear();
-    compute_base_features(g, rev, st.sg.nodes_per_layer[0], feat_cfg_, st.base_features);
+    if (cfg_.bf16_activations) {
+        st.h_layers_bf16.resize(L + 1);
+        st.pre_layers_bf16.resize(L + 1);
+        st.agg_layers_bf16.resize(L);
+    }
 
     // Input projection
     const size_t hidden = cfg_.hidden_dim;
@@ -59,13 +155,10 @@ EncoderState Encoder::forward(const CsrGraph& g, const CsrGraph* rev,
     st.pre_layers[0].resize(n0 * hidden);
     for (size_t i = 0; i < n0; ++i) {
         const float* feat = &st.base_features[i * feature_dim_];
+        float* pre = &st.pre_layers[0][i * hidden];
+        project_input(feat, pre);
         for (size_t d = 0; d < hidden; ++d) {
-            float sum = input_b_.data[d];
-            for (size_t f = 0; f < feature_dim_; ++f) {
-                sum += feat[f] * input_w_.data[f * hidden + d];
-            }
-            st.pre_layers[0][i * hidden + d] = sum;
-            st.h_layers[0][i * hidden + d] = cfg_.use_relu ? std::max(0.0f, sum) : sum;
+            st.h_layers[0][i * hidden + d] = cfg_.use_relu ? std::max(0.0f, pre[d]) : pre[d];
         }
     }
 
@@ -93,8 +186,15 @@ EncoderState Encoder::forward(const CsrGraph& g, const CsrGraph* rev,
                     uint32_t nb = ls.neighbors[e];
                     uint16_t rel = ls.rels[e];
                     auto nb_it = map_l.find(nb);
-                    if (nb_it == map_l.end()) continue;
-                    const float* nb_vec = &st.h_layers[l][nb_it->second * hidden];
+                    const float* nb_vec = nullptr;
+                    if (nb_it != map_l.end()) {
+                        nb_vec = &st.h_layers[l][nb_it->second * hidden];
+                    } else if (history_ && history_->fresh(l, nb)) {
+                        nb_vec = history_->row(l, nb);
+                        ++st.history_reads;
+                    } else {
+                        continue;
+                    }
                     const float* rel_vec = &rel_emb_.data[static_cast<size_t>(rel) * hidden];
                     for (size_t d = 0; d < hidden; ++d) {
                         agg[d] += nb_vec[d] + rel_vec[d];
@@ -108,18 +208,24 @@ EncoderState Encoder::forward(const CsrGraph& g, const CsrGraph* rev,
 
             float* pre = &st.pre_layers[l + 1][ti * hidden];
             float* out = &st.h_layers[l + 1][ti * hidden];
-            for (size_t d = 0; d < hidden; ++d) {
-                float sum = layer_b_[l].data[d];
-                for (size_t k = 0; k < hidden; ++k) {
-                    float self_val = self ? self[k] : 0.0f;
-                    sum += self_val * layer_w_[l].data[k * hidden + d]; // self part
-                    sum += agg[k] * layer_w_[l].data[(hidden + k) * hidden + d]; // agg part
-                }
-                pre[d] = sum;
-                out[d] = cfg_.use_relu ? std::max(0.0f, sum) : sum;
+            apply_layer(l, self, agg, pre);
+            for (size_t d = 0; d < hidden; ++d) out[d] = cfg_.use_relu ? std::max(0.0f, pre[d]) : pre[d];
+        }
+        if (history_ && l + 1 < L) {
+            for (size_t ti = 0; ti < targets.size(); ++ti) {
+                history_->push(l + 1, targets[ti], &st.h_layers[l + 1][ti * hidden]);
             }
         }
+
+        // Layer l is only needed by backward from here on.
+        if (cfg_.bf16_activations) {
+            pack_saved(st.h_layers[l], st.h_layers_bf16[l]);
+            pack_saved(st.pre_layers[l], st.pre_layers_bf16[l]);
+            pack_saved(st.agg_layers[l], st.agg_layers_bf16[l]);
+        }
     }
+    if (cfg_.bf16_activations) pack_saved(st.pre_layers[L], st.pre_layers_bf16[L]);
+    if (history_) history_->advance();
 
     return st;
 }
@@ -133,17 +239,22 @@ void Encoder::backward(EncoderState& st, std::vector<std::vector<float>>& grad_l
         grad_layers[l].assign(st.sg.nodes_per_layer[l].size() * hidden, 0.0f);
     }
 
+    std::vector<float> h_buf, pre_buf, agg_buf;
+
     // Backprop through aggregation layers
     for (int l = static_cast<int>(L) - 1; l >= 0; --l) {
         const auto& targets = st.sg.nodes_per_layer[l + 1];
         const auto& map_l = st.index_per_layer[l];
         const LayerSamples& ls = st.sg.samples[l];
         auto& grad_out = grad_layers[l + 1];
+        const float* h_l = saved_rows(st.h_layers, st.h_layers_bf16, l, h_buf);
+        const float* pre_next = saved_rows(st.pre_layers, st.pre_layers_bf16, l + 1, pre_buf);
+        const float* agg_l = saved_rows(st.agg_layers, st.agg_layers_bf16, l, agg_buf);
         for (size_t ti = 0; ti < targets.size(); ++ti) {
             float* grad_pre = &grad_out[ti * hidden];
             // ReLU backprop
             if (cfg_.use_relu) {
-                const float* pre = &st.pre_layers[l + 1][ti * hidden];
+                const float* pre = &pre_next[ti * hidden];
                 for (size_t d = 0; d < hidden; ++d) {
                     if (pre[d] <= 0.0f) grad_pre[d] = 0.0f;
                 }
@@ -152,8 +263,8 @@ void Encoder::backward(EncoderState& st, std::vector<std::vector<float>>& grad_l
             auto it = map_l.find(v);
             if (it == map_l.end()) continue;
             size_t self_idx = it->second;
-            const float* self = &st.h_layers[l][self_idx * hidden];
-            const float* agg = &st.agg_layers[l][ti * hidden];
+            const float* self = &h_l[self_idx * hidden];
+            const float* agg = &agg_l[ti * hidden];
 
             // Gradient w.r.t weights and bias
             for (size_t d_out = 0; d_out < hidden; ++d_out) {
@@ -187,13 +298,19 @@ void Encoder::backward(EncoderState& st, std::vector<std::vector<float>>& grad_l
                 uint32_t nb = ls.neighbors[e];
                 uint16_t rel = ls.rels[e];
                 auto nb_it = map_l.find(nb);
-                if (nb_it == map_l.end()) continue;
+                float* rel_grad = &rel_emb_.grad[static_cast<size_t>(rel) * hidden];
+                if (nb_it == map_l.end()) {
+                    // Served from the history: the relation still gets its share.
+                    if (!history_) continue;
+                    for (size_t d = 0; d < hidden; ++d) rel_grad[d] += grad_concat[hidden + d] * inv;
+                    continue;
+                }
                 size_t nb_idx = nb_it->second;
                 float* grad_nb = &grad_layers[l][nb_idx * hidden];
                 for (size_t d = 0; d < hidden; ++d) {
                     float gshare = grad_concat[hidden + d] * inv;
                     grad_nb[d] += gshare;
-                    rel_emb_.grad[static_cast<size_t>(rel) * hidden + d] += gshare;
+                    rel_grad[d] += gshare;
                 }
             }
         }
@@ -203,8 +320,9 @@ void Encoder::backward(EncoderState& st, std::vector<std::vector<float>>& grad_l
     {
         const size_t n0 = st.sg.nodes_per_layer[0].size();
         auto& grad0 = grad_layers[0];
+        const float* pre0 = saved_rows(st.pre_layers, st.pre_layers_bf16, 0, pre_buf);
         for (size_t i = 0; i < n0; ++i) {
-            const float* pre = &st.pre_layers[0][i * hidden];
+            const float* pre = &pre0[i * hidden];
             for (size_t d = 0; d < hidden; ++d) {
                 if (cfg_.use_relu && pre[d] <= 0.0f) grad0[i * hidden + d] = 0.0f;
             }
@@ -242,3 +360,14 @@ std::vector<const Parameter*> Encoder::parameters_const() const {
     ps.push_back(&rel_emb_);
     return ps;
 }
+
+std::vector<ParamSpec> Encoder::parameter_specs() const {
+    const size_t hidden = cfg_.hidden_dim;
+    std::vector<ParamSpec> specs;
+    specs.push_back({"enc.input_w", feature_dim_ * hidden});
+    specs.push_back({"enc.input_b", hidden});
+    for (int l = 0; l < cfg_.layers; ++l) specs.push_back({"enc.layer_w." + std::to_string(l), 2 * hidden * hidden});
+    for (int l = 0; l < cfg_.layers; ++l) specs.push_back({"enc.layer_b." + std::to_string(l), hidden});
+    specs.push_back({"enc.rel_emb", (num_rel_ + 1) * hidden});
+    return specs;
+}
@@ -2,7 +2,9 @@
 
 #include "csr.hpp"
 #include "features.hpp"
+#include "history.hpp"
 #include "optim.hpp"
+#include "profile.hpp"
 #include "subgraph.hpp"
 
 #include <unordered_map>
@@ -13,6 +15,7 @@ struct EncoderConfig {
     int layers = 2;
     std::vector<size_t> fanouts{20, 10};
     bool use_relu = true;
+    bool bf16_activations = false; // keep saved activations in bf16 between forward and backward
 };
 
 struct EncoderState {
@@ -22,31 +25,75 @@ struct EncoderState {
     std::vector<std::vector<float>> agg_layers; // length = L
     std::vector<std::unordered_map<uint32_t, size_t>> index_per_layer;
     std::vector<float> base_features;
+    size_t history_reads = 0; // neighbour messages served from the HistoryStore
+
+    // bf16 copies of the saved activations when EncoderConfig::bf16_activations
+    // is set. The fp32 vector of a layer is released once it has been packed;
+    // the output layer h_layers[L] always stays fp32.
+    std::vector<std::vector<uint16_t>> h_layers_bf16;
+    std::vector<std::vector<uint16_t>> pre_layers_bf16;
+    std::vector<std::vector<uint16_t>> agg_layers_bf16;
+
+    size_t activation_bytes() const;
 };
 
 class Encoder {
 public:
     Encoder(size_t feature_dim, size_t num_relations, const EncoderConfig& cfg,
             const FeatureConfig& feat_cfg, XorShift128Plus& rng);
+    // Parameters are left unallocated; bind them to a checkpoint before use.
+    Encoder(size_t feature_dim, size_t num_relations, const EncoderConfig& cfg,
+            const FeatureConfig& feat_cfg);
 
     EncoderState forward(const CsrGraph& g, const CsrGraph* rev,
                          const std::vector<uint32_t>& batch_nodes, XorShift128Plus& rng);
+    // The two halves of forward: the batch subgraph around `batch_nodes`, then
+    // the pass over it. Callers that size batches by memory sample first and
+    // check predict_bytes before committing to the pass.
+    BatchSubgraph sample(const CsrGraph& g, const std::vector<uint32_t>& batch_nodes, XorShift128Plus& rng);
+    EncoderState forward(const CsrGraph& g, const CsrGraph* rev, BatchSubgraph sg);
+    // Bytes forward will save for `sg` (EncoderState::activation_bytes() after
+    // it returns), plus, with `backward`, the activation gradients that
+    // backward allocates.
+    size_t predict_bytes(const BatchSubgraph& sg, bool backward) const;
 
     void backward(EncoderState& state, std::vector<std::vector<float>>& grad_layers);
 
     std::vector<Parameter*> parameters();
     std::vector<const Parameter*> parameters_const() const;
+    std::vector<ParamSpec> parameter_specs() const;
     size_t output_dim() const { return cfg_.hidden_dim; }
     size_t num_relations() const { return num_rel_; }
     const EncoderConfig& config() const { return cfg_; }
     size_t feature_dim_raw() const { return feature_dim_; }
     Parameter* relation_embeddings() { return &rel_emb_; }
+    // Per-node pieces of forward, for layer-wise inference: the pre-activation
+    // of the input layer for one feature row, and of aggregation layer l from a
+    // node's own layer-l row (nullptr if absent) and its mean neighbour message.
+    void project_input(const float* features, float* out) const;
+    void apply_layer(size_t l, const float* self, const float* agg, float* out) const;
+    const float* relation_row(uint16_t rel) const { return &rel_emb_.data[static_cast<size_t>(rel) * cfg_.hidden_dim]; }
+    const FeatureConfig& feature_config() const { return feat_cfg_; }
+    const FeatureStore* feature_store() const { return store_; }
+    // Input rows come from this store instead of the computed degree features.
+    // Its columns must match FeatureConfig::columns.
+    void set_feature_store(const FeatureStore* store) { store_ = store; }
+    // Training only: forward reads fresh out-of-batch neighbours from this
+    // store instead of expanding them, pushes every intermediate row it
+    // computes, and advances the store's step. Historical rows carry no
+    // gradient back into the layers below.
+    void set_history(HistoryStore* history) { history_ = history; }
+    // forward adds its Subgraph, Features and Forward phase times here.
+    void set_phase_times(PhaseTimes* times) { phase_times_ = times; }
 
 private:
     EncoderConfig cfg_;
     size_t feature_dim_;
     size_t num_rel_;
     FeatureConfig feat_cfg_;
+    const FeatureStore* store_ = nullptr;
+    HistoryStore* history_ = nullptr;
+    PhaseTimes* phase_times_ = nullptr;
     Parameter input_w_;
     Parameter input_b_;
     std::vector<Parameter> layer_w_;
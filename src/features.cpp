@@ -1,9 +1,73 @@
 #include "features.hpp"
 
+#include "precision.hpp"
+
+#include <atomic>
 #include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+struct FeatureFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t columns;
+    uint64_t rows;
+    uint64_t row_stride; // bytes
+    uint64_t names_bytes;
+    uint64_t data_offset;
+    uint64_t checksum; // of everything after the header; 0 in files written before it was added
+    uint8_t reserved[8];
+};
+static_assert(sizeof(FeatureFileHeader) == 64, "FeatureFileHeader must be 64 bytes");
+
+static constexpr uint32_t kFeatureMagic = 0x4b474631; // "KGF1"
+static constexpr uint64_t kFeatureAlign = 64;
+static constexpr uint64_t kRowAlign = 16;
+
+static uint64_t round_up(uint64_t x, uint64_t a) { return (x + a - 1) / a * a; }
+
+static size_t dtype_size(FeatureDtype dtype) { return dtype == FeatureDtype::F16 ? sizeof(uint16_t) : sizeof(float); }
+
+// Edge count per relation over the whole graph.
+static std::vector<uint64_t> relation_counts(const CsrGraph& g, size_t threads) {
+    const uint32_t n = g.num_nodes();
+    threads = std::max<size_t>(1, std::min<size_t>(threads, n));
+    std::vector<std::vector<uint64_t>> local(threads, std::vector<uint64_t>(g.num_relations() + 1, 0));
+    const uint32_t per = (n + threads - 1) / threads;
+    parallel_for(0, threads, threads, [&](size_t t) {
+        std::vector<uint32_t> ds;
+        std::vector<uint16_t> rs;
+        uint32_t end = static_cast<uint32_t>(std::min<uint64_t>(n, (t + 1) * uint64_t(per)));
+        for (uint32_t v = static_cast<uint32_t>(t * per) + 1; v <= end; ++v) {
+            AdjView adj = g.neighbors(v).unpacked(ds, rs);
+            for (uint32_t i = 0; i < adj.size; ++i) ++local[t][adj.rel[i]];
+        }
+    });
+    for (size_t t = 1; t < threads; ++t) {
+        for (size_t r = 0; r < local[0].size(); ++r) local[0][r] += local[t][r];
+    }
+    return local[0];
+}
+
+// Indices of the k largest non-zero counts, largest first, ties by index.
+static std::vector<uint32_t> top_k(const std::vector<uint64_t>& counts, size_t k) {
+    std::vector<uint32_t> ids;
+    for (uint32_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] > 0) ids.push_back(i);
+    }
+    k = std::min(k, ids.size());
+    auto by_count = [&](uint32_t a, uint32_t b) { return counts[a] != counts[b] ? counts[a] > counts[b] : a < b; };
+    std::partial_sort(ids.begin(), ids.begin() + k, ids.end(), by_count);
+    ids.resize(k);
+    return ids;
+}
 
 size_t feature_dim(const FeatureConfig& cfg, bool has_reverse) {
     (void)has_reverse;
+    if (!cfg.columns.empty()) return cfg.columns.size();
     size_t dim = 1;
     if (cfg.use_in_degree) dim += 1;
     return dim;
@@ -12,18 +76,25 @@ size_t feature_dim(const FeatureConfig& cfg, bool has_reverse) {
 void compute_base_features(const CsrGraph& g, const CsrGraph* rev,
                            const std::vector<uint32_t>& nodes,
                            const FeatureConfig& cfg,
-                           std::vector<float>& out) {
+                           std::vector<float>& out,
+                           const FeatureStore* store) {
     const bool has_rev = (rev != nullptr);
-    size_t dim = feature_dim(cfg, has_rev);
-    out.assign(nodes.size() * dim, 0.0f);
+    size_t dim = store ? store->dim() : feature_dim(cfg, has_rev);
+    if (store) {
+        store->gather(nodes, out);
+    } else {
+        out.assign(nodes.size() * dim, 0.0f);
+    }
     for (size_t i = 0; i < nodes.size(); ++i) {
         uint32_t v = nodes[i];
         size_t idx = i * dim;
-        float deg_out = static_cast<float>(g.out_degree(v));
-        out[idx] = std::log1pf(deg_out);
-        if (cfg.use_in_degree) {
-            float deg_in = has_rev ? static_cast<float>(rev->out_degree(v)) : 0.0f;
-            out[idx + 1] = std::log1pf(deg_in);
+        if (!store) {
+            float deg_out = static_cast<float>(g.out_degree(v));
+            out[idx] = std::log1pf(deg_out);
+            if (cfg.use_in_degree) {
+                float deg_in = has_rev ? static_cast<float>(rev->out_degree(v)) : 0.0f;
+                out[idx + 1] = std::log1pf(deg_in);
+            }
         }
         if (cfg.add_noise) {
             uint64_t noise_seed = mix_seed(static_cast<uint64_t>(v));
@@ -32,3 +103,199 @@ void compute_base_features(const CsrGraph& g, const CsrGraph* rev,
         }
     }
 }
+
+bool plan_features(const CsrGraph& g, const CsrGraph* rev, const std::string& spec, size_t threads,
+                   FeaturePlan& plan) {
+    plan = FeaturePlan();
+    plan.rel_out_col.assign(g.num_relations() + 1, -1);
+    plan.rel_in_col.assign(g.num_relations() + 1, -1);
+    std::vector<uint64_t> rel_counts;
+    auto column = [&](const std::string& name) {
+        plan.names.push_back(name);
+        return static_cast<int>(plan.names.size() - 1);
+    };
+    for (const std::string& tok : split_paths(spec)) {
+        size_t eq = tok.find('=');
+        std::string kind = tok.substr(0, eq);
+        size_t k = eq == std::string::npos ? 0 : std::stoul(tok.substr(eq + 1));
+        if ((kind == "in_degree" || kind == "rel_in") && !rev) {
+            std::cerr << "Feature column " << kind << " needs the reverse CSR\n";
+            return false;
+        }
+        if (kind == "out_degree") {
+            plan.out_degree_col = column(kind);
+        } else if (kind == "in_degree") {
+            plan.in_degree_col = column(kind);
+        } else if ((kind == "rel_out" || kind == "rel_in") && k > 0) {
+            // rev holds the same edges swapped, so forward counts rank both directions.
+            if (rel_counts.empty()) rel_counts = relation_counts(g, threads);
+            std::vector<int>& cols = kind == "rel_out" ? plan.rel_out_col : plan.rel_in_col;
+            for (uint32_t r : top_k(rel_counts, k)) {
+                if (r == 0) continue;
+                cols[r] = column(kind + ".P" + std::to_string(g.prop_of(r)));
+            }
+        } else if (kind == "class" && k > 0) {
+            for (uint32_t r = 1; r <= g.num_relations(); ++r) {
+                if (g.prop_of(r) == 31) plan.class_rel = r;
+            }
+            if (plan.class_rel == 0) {
+                std::cerr << "Feature column class needs P31 edges; the graph has none\n";
+                return false;
+            }
+            std::vector<uint64_t> counts(static_cast<size_t>(g.num_nodes()) + 1, 0);
+            parallel_for(1, static_cast<size_t>(g.num_nodes()) + 1, threads, [&](size_t v) {
+                AdjView adj = g.neighbors(static_cast<uint32_t>(v));
+                for (uint32_t i = 0; i < adj.size; ++i) {
+                    if (adj.rel_at(i) != plan.class_rel) continue;
+                    std::atomic_ref<uint64_t>(counts[adj.dst_at(i)]).fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+            for (uint32_t c : top_k(counts, k)) {
+                plan.class_col[c] = column("class.Q" + std::to_string(g.entity_of(c)));
+            }
+        } else {
+            std::cerr << "Unknown feature column: " << tok << "\n";
+            return false;
+        }
+    }
+    if (plan.names.empty()) {
+        std::cerr << "Feature spec selects no columns: " << spec << "\n";
+        return false;
+    }
+    return true;
+}
+
+void fill_feature_row(const FeaturePlan& plan, const CsrGraph& g, const CsrGraph* rev, uint32_t v,
+                      float* row) {
+    thread_local std::vector<uint32_t> ds;
+    thread_local std::vector<uint16_t> rs;
+    if (plan.out_degree_col >= 0) row[plan.out_degree_col] = std::log1pf(static_cast<float>(g.out_degree(v)));
+    if (plan.in_degree_col >= 0) row[plan.in_degree_col] = std::log1pf(static_cast<float>(rev->out_degree(v)));
+
+    auto count_relations = [&](const CsrGraph& graph, const std::vector<int>& cols, bool classes) {
+        AdjView adj = graph.neighbors(v).unpacked(ds, rs);
+        for (uint32_t i = 0; i < adj.size; ++i) {
+            int c = adj.rel[i] < cols.size() ? cols[adj.rel[i]] : -1;
+            if (c >= 0) row[c] += 1.0f;
+            if (classes && adj.rel[i] == plan.class_rel) {
+                auto it = plan.class_col.find(adj.dst[i]);
+                if (it != plan.class_col.end()) row[it->second] = 1.0f;
+            }
+        }
+        for (int c : cols) {
+            if (c >= 0) row[c] = std::log1pf(row[c]);
+        }
+    };
+    count_relations(g, plan.rel_out_col, !plan.class_col.empty());
+    if (rev) count_relations(*rev, plan.rel_in_col, false);
+}
+
+bool create_feature_file(const std::string& path, const std::vector<std::string>& columns, uint64_t rows,
+                         FeatureDtype dtype, MMapArrayBase& out, uint8_t*& data, uint64_t& stride) {
+    std::string names;
+    for (const std::string& c : columns) names += c + "\n";
+    FeatureFileHeader hdr{};
+    hdr.magic = kFeatureMagic;
+    hdr.version = 1;
+    hdr.dtype = static_cast<uint32_t>(dtype);
+    hdr.columns = static_cast<uint32_t>(columns.size());
+    hdr.rows = rows;
+    hdr.row_stride = round_up(columns.size() * dtype_size(dtype), kRowAlign);
+    hdr.names_bytes = names.size();
+    hdr.data_offset = round_up(sizeof(hdr) + names.size(), kFeatureAlign);
+    if (!map_writable(path + ".tmp", hdr.data_offset + rows * hdr.row_stride, out)) return false;
+    uint8_t* base = static_cast<uint8_t*>(out.data);
+    std::memcpy(base, &hdr, sizeof(hdr));
+    std::memcpy(base + sizeof(hdr), names.data(), names.size());
+    data = base + hdr.data_offset;
+    stride = hdr.row_stride;
+    return true;
+}
+
+// Checksum64 of the names and rows, which identifies the contents to caches
+// built from them (see cache_tag).
+static uint64_t feature_checksum(const MMapArrayBase& map) {
+    Checksum64 sum;
+    sum.update(static_cast<const uint8_t*>(map.data) + sizeof(FeatureFileHeader), map.bytes - sizeof(FeatureFileHeader));
+    return sum.finish();
+}
+
+bool finish_feature_file(const std::string& path, MMapArrayBase& map) {
+    const uint64_t checksum = feature_checksum(map);
+    std::memcpy(static_cast<uint8_t*>(map.data) + offsetof(FeatureFileHeader, checksum), &checksum, sizeof(checksum));
+    bool ok = sync_mapping(map);
+    unmap(map);
+    if (ok) ok = std::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+    if (!ok) std::cerr << "Failed to write feature store " << path << "\n";
+    return ok;
+}
+
+void store_feature_row(FeatureDtype dtype, const float* row, size_t dim, uint8_t* dst) {
+    if (dtype == FeatureDtype::F16) {
+        pack_fp16(row, reinterpret_cast<uint16_t*>(dst), dim);
+    } else {
+        std::memcpy(dst, row, dim * sizeof(float));
+    }
+}
+
+FeatureStore::~FeatureStore() {
+    unmap(map_);
+}
+
+bool FeatureStore::open(const std::string& path, const MapPolicy& policy) {
+    unmap(map_);
+    columns_.clear();
+    if (!map_readonly(path, map_, policy)) {
+        std::cerr << "Failed to map feature store " << path << "\n";
+        return false;
+    }
+    FeatureFileHeader hdr;
+    const uint8_t* base = static_cast<const uint8_t*>(map_.data);
+    bool ok = map_.bytes >= sizeof(hdr);
+    if (ok) {
+        std::memcpy(&hdr, base, sizeof(hdr));
+        ok = hdr.magic == kFeatureMagic && hdr.version == 1 && hdr.dtype <= 1 &&
+             sizeof(hdr) + hdr.names_bytes <= hdr.data_offset &&
+             hdr.row_stride >= hdr.columns * dtype_size(static_cast<FeatureDtype>(hdr.dtype)) &&
+             hdr.data_offset + hdr.rows * hdr.row_stride <= map_.bytes;
+    }
+    if (ok) {
+        columns_ = split_paths(std::string(reinterpret_cast<const char*>(base + sizeof(hdr)), hdr.names_bytes), '\n');
+        ok = columns_.size() == hdr.columns;
+    }
+    if (!ok) {
+        std::cerr << "Not a valid feature store: " << path << "\n";
+        unmap(map_);
+        columns_.clear();
+        return false;
+    }
+    rows_ = hdr.rows;
+    stride_ = hdr.row_stride;
+    dtype_ = static_cast<FeatureDtype>(hdr.dtype);
+    data_ = base + hdr.data_offset;
+    checksum_ = hdr.checksum ? hdr.checksum : feature_checksum(map_);
+    return true;
+}
+
+void FeatureStore::gather(const std::vector<uint32_t>& nodes, std::vector<float>& out) const {
+    const size_t d = dim();
+    out.assign(nodes.size() * d, 0.0f);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i] >= rows_) continue;
+        const uint8_t* row = data_ + nodes[i] * stride_;
+        if (dtype_ == FeatureDtype::F16) {
+            unpack_fp16(reinterpret_cast<const uint16_t*>(row), &out[i * d], d);
+        } else {
+            std::memcpy(&out[i * d], row, d * sizeof(float));
+        }
+    }
+}
+
+bool open_feature_store(const std::string& path, const FeatureConfig& cfg, FeatureStore& store) {
+    if (!store.open(path)) return false;
+    if (store.columns() != cfg.columns) {
+        std::cerr << "Feature store " << path << " has columns that do not match the checkpoint\n";
+        return false;
+    }
+    return true;
+}
@@ -1,20 +1,123 @@
 #pragma once
 
 #include "csr.hpp"
+#include "io.hpp"
 #include "rng.hpp"
+#include "threadpool.hpp"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 struct FeatureConfig {
     bool use_in_degree = true;
     bool add_noise = false;
+    // Columns of a precomputed feature store (see FeatureStore). Empty means
+    // the log-degree features are computed per batch.
+    std::vector<std::string> columns;
 };
 
+class FeatureStore;
+
 size_t feature_dim(const FeatureConfig& cfg, bool has_reverse);
 
+// Fills `out` with one row per node. With a store the rows are gathered from
+// it, otherwise log1p(out-degree) and log1p(in-degree) are computed.
 void compute_base_features(const CsrGraph& g, const CsrGraph* rev,
                            const std::vector<uint32_t>& nodes,
                            const FeatureConfig& cfg,
-                           std::vector<float>& out);
+                           std::vector<float>& out,
+                           const FeatureStore* store = nullptr);
+
+enum class FeatureDtype : uint32_t {
+    F32 = 0,
+    F16 = 1,
+};
+
+// Concrete columns for a spec such as "out_degree,in_degree,rel_out=16,rel_in=16,class=16":
+//   out_degree, in_degree   log1p of the degree ("in_degree" needs the reverse CSR)
+//   rel_out=K, rel_in=K     log1p of the node's edge count for each of the K
+//                           most frequent relations ("rel_out.P31", ...)
+//   class=K                 1 if the node has a P31 (instance of) edge to one
+//                           of the K most frequent classes ("class.Q5", ...)
+struct FeaturePlan {
+    std::vector<std::string> names;
+    int out_degree_col = -1;
+    int in_degree_col = -1;
+    std::vector<int> rel_out_col; // relation -> column, -1 if not a column
+    std::vector<int> rel_in_col;
+    uint32_t class_rel = 0;       // internal ID of P31, 0 without class columns
+    std::unordered_map<uint32_t, int> class_col; // class node -> column
+};
+
+bool plan_features(const CsrGraph& g, const CsrGraph* rev, const std::string& spec, size_t threads,
+                   FeaturePlan& plan);
+void fill_feature_row(const FeaturePlan& plan, const CsrGraph& g, const CsrGraph* rev, uint32_t v,
+                      float* row);
+
+// Read-only, mapped feature matrix: a 64-byte header, the newline-separated
+// column names, then `rows` rows of `dim()` floats or halves starting on a
+// 64-byte boundary, each row padded to 16 bytes. Nodes past the last row
+// (e.g. added by a delta log) read as zeros.
+class FeatureStore {
+public:
+    FeatureStore() = default;
+    FeatureStore(const FeatureStore&) = delete;
+    FeatureStore& operator=(const FeatureStore&) = delete;
+    ~FeatureStore();
+
+    bool open(const std::string& path, const MapPolicy& policy = {});
+    size_t dim() const { return columns_.size(); }
+    uint64_t rows() const { return rows_; }
+    FeatureDtype dtype() const { return dtype_; }
+    const std::vector<std::string>& columns() const { return columns_; }
+    // Checksum of the names and rows, recorded when the file was written.
+    uint64_t checksum() const { return checksum_; }
+    void gather(const std::vector<uint32_t>& nodes, std::vector<float>& out) const;
+
+private:
+    MMapArrayBase map_;
+    std::vector<std::string> columns_;
+    uint64_t rows_ = 0;
+    uint64_t stride_ = 0;
+    FeatureDtype dtype_ = FeatureDtype::F32;
+    const uint8_t* data_ = nullptr;
+    uint64_t checksum_ = 0;
+};
+
+// Opens the store a model with `cfg` was trained on; fails unless its columns
+// are exactly cfg.columns, in order.
+bool open_feature_store(const std::string& path, const FeatureConfig& cfg, FeatureStore& store);
+
+// Building blocks of write_feature_store: create_feature_file maps
+// "<path>.tmp" with the header and names written, finish_feature_file syncs
+// it and renames it into place.
+bool create_feature_file(const std::string& path, const std::vector<std::string>& columns, uint64_t rows,
+                         FeatureDtype dtype, MMapArrayBase& out, uint8_t*& data, uint64_t& stride);
+bool finish_feature_file(const std::string& path, MMapArrayBase& map);
+void store_feature_row(FeatureDtype dtype, const float* row, size_t dim, uint8_t* dst);
+
+// Writes a feature store with rows 0..rows-1 (row 0 unused) filled by
+// `fill(v, row)` from `threads` threads; rows start zeroed.
+template <typename Fill>
+bool write_feature_store(const std::string& path, const std::vector<std::string>& columns, uint64_t rows,
+                         FeatureDtype dtype, size_t threads, Fill fill) {
+    MMapArrayBase map;
+    uint8_t* data = nullptr;
+    uint64_t stride = 0;
+    if (!create_feature_file(path, columns, rows, dtype, map, data, stride)) return false;
+    const size_t dim = columns.size();
+    const uint64_t chunk = 4096;
+    parallel_for(0, (rows + chunk - 1) / chunk, threads, [&](size_t c) {
+        std::vector<float> row(dim);
+        for (uint64_t v = std::max<uint64_t>(1, c * chunk); v < std::min(rows, (c + 1) * chunk); ++v) {
+            std::fill(row.begin(), row.end(), 0.0f);
+            fill(static_cast<uint32_t>(v), row.data());
+            store_feature_row(dtype, row.data(), dim, data + v * stride);
+        }
+    });
+    return finish_feature_file(path, map);
+}
@@ -1,3 +1,9 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -104,160 +110,340 @@ struct EdgeRec {
 #pragma pack(pop)
 static_assert(sizeof(EdgeRec) == 10, "EdgeRec must be 10 bytes");
 
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
-
-    mkdir("data", 0755);
-
-    uint32_t* idx_q = (uint32_t*)calloc((size_t)MAXQ + 2, sizeof(uint32_t));
-    uint16_t* idx_p = (uint16_t*)calloc((size_t)MAXP + 2, sizeof(uint16_t));
-    if (!idx_q || !idx_p) return 1;
-
-    FILE* f_entities = fopen("data/entities.bin", "wb");
-    FILE* f_props    = fopen("data/props.bin", "wb");
-    FILE* f_edges    = fopen("data/edges.tmp", "w+b");
-    if (!f_entities || !f_props || !f_edges) return 1;
-
-    static char ent_buf[1 << 20];
-    static char prop_buf[1 << 16];
-    static char edge_buf_io[1 << 20];
-    setvbuf(f_entities, ent_buf, _IOFBF, sizeof(ent_buf));
-    setvbuf(f_props,    prop_buf, _IOFBF, sizeof(prop_buf));
-    setvbuf(f_edges,    edge_buf_io, _IOFBF, sizeof(edge_buf_io));
-
-    vector<uint32_t> deg;
-    deg.reserve(1 << 20);
-    deg.push_back(0); 
-
-    uint32_t iq = 1;    
-    uint16_t ip = 1;    
-    uint64_t m  = 0;    
-
-    constexpr size_t BLOCK = 1 << 20;
-    vector<EdgeRec> edge_block;
-    edge_block.reserve(BLOCK);
-
-    constexpr size_t ENT_BLOCK = 1 << 20;
-    vector<uint32_t> ent_block;
-    ent_block.reserve(ENT_BLOCK);
-
-    string line;
-    while (getline(cin, line)) {
-        uint32_t s_orig, p_orig, o_orig;
-        if (!parse_qpq(line.data(), line.size(), s_orig, p_orig, o_orig)) continue;
-        if (s_orig > MAXQ || o_orig > MAXQ || p_orig > MAXP) continue;
-
-        uint32_t ds = idx_q[s_orig];
-        if (!ds) {
-            ds = iq++;
-            idx_q[s_orig] = ds;
-            deg.push_back(0);
-            ent_block.push_back(s_orig);
-            if (ent_block.size() == ENT_BLOCK) {
-                fwrite(ent_block.data(), sizeof(uint32_t), ent_block.size(), f_entities);
-                ent_block.clear();
-            }
+struct RawTriple {
+    uint32_t s;
+    uint32_t p;
+    uint32_t o;
+};
+
+struct GenOptions {
+    string input = "-";
+    string output = "data";
+    size_t threads = default_threads();
+    size_t chunk_mb = 256;
+};
+
+static void print_usage() {
+    cout << "Usage: kg_gencsr [--input dump.nt|-] [--output data_dir] [--threads T] [--chunk_mb MB]\n"
+            "Reads Wikidata truthy N-Triples (Q P Q lines) and writes entities.bin, props.bin,\n"
+            "offsets.bin, csr.bin and rels.bin. A regular input file is mapped and parsed twice;\n"
+            "stdin is parsed once and the edges are spilled to <output>/edges.tmp.\n";
+}
+
+static bool parse_args(int argc, char** argv, GenOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--input" || a == "-i") && need(1)) {
+            opt.input = argv[++i];
+        } else if ((a == "--output" || a == "-o") && need(1)) {
+            opt.output = argv[++i];
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = max<size_t>(1, stoul(argv[++i]));
+        } else if (a == "--chunk_mb" && need(1)) {
+            opt.chunk_mb = max<size_t>(1, stoul(argv[++i]));
+        } else {
+            print_usage();
+            return false;
         }
+    }
+    return true;
+}
 
-        uint16_t dp = idx_p[p_orig];
-        if (!dp) {
-            dp = ip++;
-            idx_p[p_orig] = dp;
-            uint16_t porig16 = (uint16_t)p_orig;
-            fwrite(&porig16, sizeof(uint16_t), 1, f_props);
+// Parses [begin, end), which starts at a line start, on `threads` threads.
+// Slice t begins after the first newline at or past its nominal start, so every
+// line belongs to exactly one slice and out[0..T) in order is the input order.
+static void parse_window(const char* begin, const char* end, size_t threads,
+                         vector<vector<RawTriple>>& out) {
+    out.resize(threads);
+    vector<const char*> cut(threads + 1, end);
+    const size_t len = (size_t)(end - begin);
+    cut[0] = begin;
+    for (size_t t = 1; t < threads; ++t) {
+        const char* p = begin + len / threads * t;
+        const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+        cut[t] = nl ? nl + 1 : end;
+        if (cut[t] < cut[t - 1]) cut[t] = cut[t - 1];
+    }
+    parallel_for(0, threads, threads, [&](size_t t) {
+        auto& v = out[t];
+        v.clear();
+        const char* p = cut[t];
+        const char* stop = cut[t + 1];
+        while (p < stop) {
+            const char* nl = (const char*)memchr(p, '\n', (size_t)(stop - p));
+            const char* line_end = nl ? nl : stop;
+            RawTriple tr;
+            if (parse_qpq(p, (size_t)(line_end - p), tr.s, tr.p, tr.o) &&
+                tr.s <= MAXQ && tr.o <= MAXQ && tr.p <= MAXP) {
+                v.push_back(tr);
+            }
+            p = line_end + 1;
         }
+    });
+}
 
-        uint32_t do_ = idx_q[o_orig];
-        if (!do_) {
-            do_ = iq++;
-            idx_q[o_orig] = do_;
-            deg.push_back(0);
-            ent_block.push_back(o_orig);
-            if (ent_block.size() == ENT_BLOCK) {
-                fwrite(ent_block.data(), sizeof(uint32_t), ent_block.size(), f_entities);
-                ent_block.clear();
+// Hands the input to `fn` in windows that end on a line boundary. A regular
+// file is mapped and windows point into the mapping; anything else is read
+// into a buffer, carrying the partial last line over to the next window.
+template <typename Fn>
+static bool for_each_window(const GenOptions& opt, const MMapArrayBase* mapped, Fn fn) {
+    const size_t window = opt.chunk_mb << 20;
+    if (mapped) {
+        const char* p = (const char*)mapped->data;
+        const char* end = p + mapped->bytes;
+        while (p < end) {
+            const char* stop = p + min(window, (size_t)(end - p));
+            if (stop < end) {
+                const char* nl = (const char*)memchr(stop, '\n', (size_t)(end - stop));
+                stop = nl ? nl + 1 : end;
             }
+            fn(p, stop);
+            p = stop;
+        }
+        return true;
+    }
+    FILE* in = opt.input == "-" ? stdin : fopen(opt.input.c_str(), "rb");
+    if (!in) return false;
+    vector<char> buf(window);
+    size_t carry = 0;
+    while (true) {
+        if (carry == buf.size()) buf.resize(buf.size() * 2);
+        size_t got = fread(buf.data() + carry, 1, buf.size() - carry, in);
+        size_t have = carry + got;
+        if (got == 0) {
+            if (have) fn(buf.data(), buf.data() + have);
+            break;
+        }
+        const char* last_nl = nullptr;
+        for (size_t i = have; i > carry; --i) {
+            if (buf[i - 1] == '\n') {
+                last_nl = buf.data() + i - 1;
+                break;
+            }
+        }
+        if (!last_nl) {
+            carry = have;
+            continue;
         }
+        size_t used = (size_t)(last_nl + 1 - buf.data());
+        fn(buf.data(), buf.data() + used);
+        carry = have - used;
+        memmove(buf.data(), buf.data() + used, carry);
+    }
+    bool ok = !ferror(in);
+    if (in != stdin) fclose(in);
+    return ok;
+}
 
-        deg[ds]++;
-        ++m;
+// Entity/property dictionaries. IDs are handed out in first-seen order of the
+// input (subject, property, object of each line), exactly as a serial reader
+// would, regardless of the thread count.
+struct IdMaps {
+    uint32_t* idx_q = nullptr;
+    uint16_t* idx_p = nullptr;
+    uint32_t next_q = 1;
+    uint16_t next_p = 1;
+    vector<uint32_t> entities;
+    vector<uint16_t> props;
+};
 
-        edge_block.push_back(EdgeRec{ds, dp, do_});
-        if (edge_block.size() == BLOCK) {
-            fwrite(edge_block.data(), sizeof(EdgeRec), edge_block.size(), f_edges);
-            edge_block.clear();
+static void assign_ids(const vector<vector<RawTriple>>& parsed, size_t threads, IdMaps& ids) {
+    // Only lines that mention an unseen ID can introduce one; find them in
+    // parallel, then walk just those serially in input order.
+    vector<vector<uint32_t>> fresh(parsed.size());
+    parallel_for(0, parsed.size(), threads, [&](size_t t) {
+        fresh[t].clear();
+        for (size_t i = 0; i < parsed[t].size(); ++i) {
+            const RawTriple& tr = parsed[t][i];
+            if (!ids.idx_q[tr.s] || !ids.idx_p[tr.p] || !ids.idx_q[tr.o]) fresh[t].push_back((uint32_t)i);
+        }
+    });
+    for (size_t t = 0; t < parsed.size(); ++t) {
+        for (uint32_t i : fresh[t]) {
+            const RawTriple& tr = parsed[t][i];
+            if (!ids.idx_q[tr.s]) {
+                ids.idx_q[tr.s] = ids.next_q++;
+                ids.entities.push_back(tr.s);
+            }
+            if (!ids.idx_p[tr.p]) {
+                ids.idx_p[tr.p] = ids.next_p++;
+                ids.props.push_back((uint16_t)tr.p);
+            }
+            if (!ids.idx_q[tr.o]) {
+                ids.idx_q[tr.o] = ids.next_q++;
+                ids.entities.push_back(tr.o);
+            }
         }
     }
+}
+
+static inline EdgeRec translate(const IdMaps& ids, const RawTriple& tr) {
+    return EdgeRec{ids.idx_q[tr.s], ids.idx_p[tr.p], ids.idx_q[tr.o]};
+}
+
+// Places the edges at their owners' cursors. Positions within a node depend on
+// thread timing; sort_adjacency makes the final layout deterministic.
+static void scatter(const EdgeRec* edges, size_t count, size_t threads, vector<uint32_t>& cursor,
+                    uint32_t* csr, uint16_t* rels) {
+    parallel_for(0, threads, threads, [&](size_t t) {
+        size_t b = count * t / threads, e = count * (t + 1) / threads;
+        for (size_t i = b; i < e; ++i) {
+            uint32_t pos = atomic_ref<uint32_t>(cursor[edges[i].s]).fetch_add(1, memory_order_relaxed);
+            csr[pos] = edges[i].o;
+            rels[pos] = edges[i].p;
+        }
+    });
+}
+
+// Orders every adjacency list by (dst, rel).
+static void sort_adjacency(const vector<uint32_t>& offsets, size_t threads, uint32_t* csr, uint16_t* rels) {
+    const size_t n = offsets.size() - 2;
+    parallel_for(0, threads, threads, [&](size_t t) {
+        size_t b = 1 + n * t / threads, e = 1 + n * (t + 1) / threads;
+        vector<uint64_t> keys;
+        for (size_t u = b; u < e; ++u) {
+            uint32_t lo = offsets[u], hi = offsets[u + 1];
+            if (hi - lo < 2) continue;
+            keys.resize(hi - lo);
+            for (uint32_t i = lo; i < hi; ++i) keys[i - lo] = ((uint64_t)csr[i] << 16) | rels[i];
+            sort(keys.begin(), keys.end());
+            for (uint32_t i = lo; i < hi; ++i) {
+                csr[i] = (uint32_t)(keys[i - lo] >> 16);
+                rels[i] = (uint16_t)(keys[i - lo] & 0xffff);
+            }
+        }
+    });
+}
 
-    if (!ent_block.empty()) fwrite(ent_block.data(), sizeof(uint32_t), ent_block.size(), f_entities);
-    if (!edge_block.empty()) fwrite(edge_block.data(), sizeof(EdgeRec), edge_block.size(), f_edges);
+template <typename T>
+static bool append_all(FILE* f, vector<T>& v) {
+    if (!v.empty() && fwrite(v.data(), sizeof(T), v.size(), f) != v.size()) return false;
+    v.clear();
+    return true;
+}
+
+int main(int argc, char** argv) {
+    GenOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+    const size_t T = opt.threads;
+    mkdir(opt.output.c_str(), 0755);
+    remove_packed(opt.output, "csr");
+    const string dir = opt.output + "/";
+
+    // A regular file is parsed a second time for the scatter instead of
+    // spilling ~10 bytes per edge; pipes and stdin fall back to the spill.
+    MMapArrayBase input;
+    const bool mapped = opt.input != "-" && map_readonly(opt.input, input);
+    if (mapped) madvise(input.data, input.bytes, MADV_SEQUENTIAL);
+
+    IdMaps ids;
+    ids.idx_q = (uint32_t*)calloc((size_t)MAXQ + 2, sizeof(uint32_t));
+    ids.idx_p = (uint16_t*)calloc((size_t)MAXP + 2, sizeof(uint16_t));
+    if (!ids.idx_q || !ids.idx_p) return 1;
+
+    FILE* f_entities = fopen((dir + "entities.bin").c_str(), "wb");
+    FILE* f_props    = fopen((dir + "props.bin").c_str(), "wb");
+    FILE* f_edges    = mapped ? nullptr : fopen((dir + "edges.tmp").c_str(), "w+b");
+    if (!f_entities || !f_props || (!mapped && !f_edges)) {
+        cerr << "Failed to open output files in " << opt.output << "\n";
+        return 1;
+    }
 
-    fflush(f_entities);
-    fflush(f_props);
-    fflush(f_edges);
+    // Pass 1: parse, assign IDs, count out-degrees.
+    vector<uint32_t> deg(1, 0);
+    uint64_t m = 0;
+    vector<vector<RawTriple>> parsed;
+    vector<vector<EdgeRec>> translated(T);
+    bool io_ok = true;
+    bool read_ok = for_each_window(opt, mapped ? &input : nullptr, [&](const char* b, const char* e) {
+        parse_window(b, e, T, parsed);
+        assign_ids(parsed, T, ids);
+        io_ok = io_ok && append_all(f_entities, ids.entities) && append_all(f_props, ids.props);
+        deg.resize(ids.next_q, 0);
+        parallel_for(0, T, T, [&](size_t t) {
+            if (!mapped) translated[t].clear();
+            for (const RawTriple& tr : parsed[t]) {
+                EdgeRec er = translate(ids, tr);
+                atomic_ref<uint32_t>(deg[er.s]).fetch_add(1, memory_order_relaxed);
+                if (!mapped) translated[t].push_back(er);
+            }
+        });
+        for (size_t t = 0; t < T; ++t) {
+            m += parsed[t].size();
+            if (!mapped) io_ok = io_ok && append_all(f_edges, translated[t]);
+        }
+    });
     fclose(f_entities);
     fclose(f_props);
-
+    if (!read_ok || !io_ok) {
+        cerr << "Failed while reading " << opt.input << " or writing " << opt.output << "\n";
+        return 1;
+    }
     if (m > std::numeric_limits<uint32_t>::max()) return 1;
 
+    vector<uint32_t> offsets(deg.size() + 1);
     uint64_t sum = 0;
     for (size_t u = 0; u < deg.size(); ++u) {
-        uint32_t cnt = deg[u];
-        deg[u] = (uint32_t)sum;
-        sum += cnt;
+        offsets[u] = (uint32_t)sum;
+        sum += deg[u];
     }
+    offsets[deg.size()] = (uint32_t)sum;
     if (sum != m) return 1;
+    vector<uint32_t>().swap(deg);
+    if (!write_array(dir + "offsets.bin", offsets)) return 1;
 
-    FILE* f_offsets = fopen("data/offsets.bin", "wb");
-    if (!f_offsets) return 1;
-    static char off_buf[1 << 20];
-    setvbuf(f_offsets, off_buf, _IOFBF, sizeof(off_buf));
-
-    fwrite(deg.data(), sizeof(uint32_t), deg.size(), f_offsets);
-    uint32_t final_off = (uint32_t)sum;
-    fwrite(&final_off, sizeof(uint32_t), 1, f_offsets);
-    fclose(f_offsets);
-
-    free(idx_q);
-    free(idx_p);
-
+    // Pass 2: scatter into the mapped outputs.
     const size_t csr_bytes  = (size_t)m * sizeof(uint32_t);
     const size_t rels_bytes = (size_t)m * sizeof(uint16_t);
-
     int fd_csr = -1, fd_rels = -1;
-    void* csr_map  = map_file_rw("data/csr.bin",  csr_bytes,  fd_csr);
-    void* rels_map = map_file_rw("data/rels.bin", rels_bytes, fd_rels);
+    void* csr_map  = map_file_rw((dir + "csr.bin").c_str(),  max<size_t>(csr_bytes, 1),  fd_csr);
+    void* rels_map = map_file_rw((dir + "rels.bin").c_str(), max<size_t>(rels_bytes, 1), fd_rels);
     if (csr_map == MAP_FAILED || rels_map == MAP_FAILED) return 1;
-
     auto* csr  = (uint32_t*)csr_map;
     auto* rels = (uint16_t*)rels_map;
 
-    fseek(f_edges, 0, SEEK_SET);
-    vector<EdgeRec> read_block(BLOCK);
-
-    while (true) {
-        size_t nread = fread(read_block.data(), sizeof(EdgeRec), BLOCK, f_edges);
-        if (nread == 0) break;
-        for (size_t i = 0; i < nread; ++i) {
-            const EdgeRec& e = read_block[i];
-            uint32_t pos = deg[e.s]++;
-            csr[pos]  = e.o;
-            rels[pos] = e.p;
+    vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    if (mapped) {
+        vector<EdgeRec> edges;
+        for_each_window(opt, &input, [&](const char* b, const char* e) {
+            parse_window(b, e, T, parsed);
+            size_t total = 0;
+            for (const auto& v : parsed) total += v.size();
+            edges.resize(total);
+            vector<size_t> base(T, 0);
+            for (size_t t = 1; t < T; ++t) base[t] = base[t - 1] + parsed[t - 1].size();
+            parallel_for(0, T, T, [&](size_t t) {
+                for (size_t i = 0; i < parsed[t].size(); ++i) edges[base[t] + i] = translate(ids, parsed[t][i]);
+            });
+            scatter(edges.data(), edges.size(), T, cursor, csr, rels);
+        });
+        unmap(input);
+    } else {
+        constexpr size_t BLOCK = 1 << 22;
+        vector<EdgeRec> block(BLOCK);
+        fseek(f_edges, 0, SEEK_SET);
+        while (size_t nread = fread(block.data(), sizeof(EdgeRec), BLOCK, f_edges)) {
+            scatter(block.data(), nread, T, cursor, csr, rels);
         }
+        fclose(f_edges);
+        unlink((dir + "edges.tmp").c_str());
     }
-
-    fclose(f_edges);
-    unlink("data/edges.tmp");
-
-    msync(csr_map, csr_bytes, MS_SYNC);
-    msync(rels_map, rels_bytes, MS_SYNC);
-
-    munmap(csr_map, csr_bytes);
-    munmap(rels_map, rels_bytes);
+    free(ids.idx_q);
+    free(ids.idx_p);
+
+    sort_adjacency(offsets, T, csr, rels);
+
+    msync(csr_map, max<size_t>(csr_bytes, 1), MS_SYNC);
+    msync(rels_map, max<size_t>(rels_bytes, 1), MS_SYNC);
+    munmap(csr_map, max<size_t>(csr_bytes, 1));
+    munmap(rels_map, max<size_t>(rels_bytes, 1));
+    // Empty outputs were mapped one byte long.
+    if (csr_bytes == 0 && ftruncate(fd_csr, 0) != 0) return 1;
+    if (rels_bytes == 0 && ftruncate(fd_rels, 0) != 0) return 1;
     close(fd_csr);
     close(fd_rels);
 
-    cerr << "nodes=" << (iq - 1) << " rels=" << (uint32_t)(ip - 1) << " edges=" << m << "\n";
+    cerr << "nodes=" << (ids.next_q - 1) << " rels=" << (uint32_t)(ids.next_p - 1) << " edges=" << m << "\n";
     return 0;
 }
@@ -0,0 +1,29 @@
+#include "history.hpp"
+
+#include <algorithm>
+
+void HistoryStore::init(uint32_t nodes, size_t layers, size_t dim, uint32_t max_staleness) {
+    nodes_ = nodes;
+    layers_ = layers;
+    dim_ = dim;
+    max_staleness_ = max_staleness;
+    step_ = 0;
+    rows_.assign(layers, {});
+    stamp_.assign(layers, {});
+    for (size_t l = 1; l < layers; ++l) {
+        rows_[l].assign((static_cast<size_t>(nodes) + 1) * dim, 0.0f);
+        stamp_[l].assign(static_cast<size_t>(nodes) + 1, 0);
+    }
+}
+
+void HistoryStore::push(size_t l, uint32_t v, const float* h) {
+    if (l == 0 || l >= layers_ || v > nodes_) return;
+    std::copy(h, h + dim_, &rows_[l][static_cast<size_t>(v) * dim_]);
+    stamp_[l][v] = step_ + 1;
+}
+
+size_t HistoryStore::bytes() const {
+    size_t total = 0;
+    for (size_t l = 0; l < layers_; ++l) total += rows_[l].size() * sizeof(float) + stamp_[l].size() * sizeof(uint32_t);
+    return total;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Historical embeddings (GNNAutoScale): the last in-batch value of every
+// node's intermediate layers 1..L-1, stamped with the step that computed it.
+// A sampled neighbour whose row is at most `max_staleness` steps old is read
+// from here instead of being expanded further down the subgraph; rows that
+// are missing or older are recomputed in-batch and written back. Layer 0 is
+// never stored, it is one projection of the input features.
+class HistoryStore {
+public:
+    void init(uint32_t nodes, size_t layers, size_t dim, uint32_t max_staleness);
+    bool enabled() const { return layers_ > 1; }
+
+    bool fresh(size_t l, uint32_t v) const {
+        if (l == 0 || l >= layers_ || v > nodes_) return false;
+        uint32_t s = stamp_[l][v];
+        return s != 0 && step_ + 1 - s <= max_staleness_;
+    }
+    const float* row(size_t l, uint32_t v) const { return &rows_[l][static_cast<size_t>(v) * dim_]; }
+    void push(size_t l, uint32_t v, const float* h);
+    // Ends a training step; rows pushed before it age by one.
+    void advance() { ++step_; }
+
+    size_t bytes() const;
+
+private:
+    uint32_t nodes_ = 0;
+    size_t layers_ = 0;
+    size_t dim_ = 0;
+    uint32_t max_staleness_ = 0;
+    uint32_t step_ = 0;
+    std::vector<std::vector<float>> rows_;     // [layer][(v) * dim]
+    std::vector<std::vector<uint32_t>> stamp_; // [layer][v], step + 1 of the last push; 0 = never
+};
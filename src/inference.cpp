@@ -0,0 +1,431 @@
+#include "inference.hpp"
+
+#include "features.hpp"
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <unistd.h>
+
+struct EmbeddingFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t nodes;
+    uint64_t dim;
+    uint64_t tag;
+    uint64_t base;  // GraphIdentity of the graph the rows were computed on
+    uint64_t stamp;
+    uint64_t delta;
+    uint8_t reserved[8];
+};
+static_assert(sizeof(EmbeddingFileHeader) == 64, "EmbeddingFileHeader must be 64 bytes");
+
+static constexpr uint32_t kEmbeddingMagic = 0x4b474531; // "KGE1"
+static constexpr uint32_t kEmbeddingVersion = 2;          // 1 stored a full adjacency checksum
+
+EmbeddingTable::~EmbeddingTable() {
+    unmap(map_);
+}
+
+bool EmbeddingTable::create(uint32_t nodes, size_t dim, const std::string& path) {
+    unmap(map_);
+    owned_.clear();
+    nodes_ = nodes;
+    dim_ = dim;
+    tag_ = 0;
+    graph_ = GraphIdentity();
+    path_ = path;
+    in_place_ = false;
+    const size_t count = static_cast<size_t>(nodes) * dim;
+    if (path.empty()) {
+        owned_.assign(count, 0.0f);
+        data_ = owned_.data();
+        return true;
+    }
+    if (!map_writable(path + ".tmp", sizeof(EmbeddingFileHeader) + count * sizeof(float), map_)) {
+        std::cerr << "Failed to create " << path << ".tmp\n";
+        return false;
+    }
+    EmbeddingFileHeader hdr{};
+    hdr.magic = kEmbeddingMagic;
+    hdr.version = kEmbeddingVersion;
+    hdr.nodes = nodes;
+    hdr.dim = dim;
+    std::memcpy(map_.data, &hdr, sizeof(hdr));
+    data_ = reinterpret_cast<float*>(static_cast<uint8_t*>(map_.data) + sizeof(hdr));
+    return true;
+}
+
+bool EmbeddingTable::commit(uint64_t tag, const GraphIdentity& graph) {
+    if (path_.empty() || !map_.data) return false;
+    tag_ = tag;
+    graph_ = graph;
+    uint8_t* base = static_cast<uint8_t*>(map_.data);
+    std::memcpy(base + offsetof(EmbeddingFileHeader, tag), &tag, sizeof(tag));
+    std::memcpy(base + offsetof(EmbeddingFileHeader, base), &graph.base, sizeof(graph.base));
+    std::memcpy(base + offsetof(EmbeddingFileHeader, stamp), &graph.stamp, sizeof(graph.stamp));
+    std::memcpy(base + offsetof(EmbeddingFileHeader, delta), &graph.delta, sizeof(graph.delta));
+    bool ok = sync_mapping(map_);
+    if (ok && !in_place_) ok = std::rename((path_ + ".tmp").c_str(), path_.c_str()) == 0;
+    if (!ok) std::cerr << "Failed to write embedding cache " << path_ << "\n";
+    return ok;
+}
+
+void EmbeddingTable::discard() {
+    if (path_.empty() || !map_.data || in_place_) return;
+    unmap(map_);
+    ::unlink((path_ + ".tmp").c_str());
+    data_ = nullptr;
+}
+
+bool EmbeddingTable::open_writable(const std::string& path, uint32_t nodes) {
+    if (!open(path)) return false;
+    const size_t dim = dim_;
+    nodes = std::max(nodes, nodes_);
+    unmap(map_);
+    data_ = nullptr;
+    if (!map_writable(path, sizeof(EmbeddingFileHeader) + static_cast<size_t>(nodes) * dim * sizeof(float), map_,
+                      false)) {
+        return false;
+    }
+    uint64_t count = nodes;
+    std::memcpy(static_cast<uint8_t*>(map_.data) + offsetof(EmbeddingFileHeader, nodes), &count, sizeof(count));
+    nodes_ = nodes;
+    path_ = path;
+    in_place_ = true;
+    data_ = reinterpret_cast<float*>(static_cast<uint8_t*>(map_.data) + sizeof(EmbeddingFileHeader));
+    return true;
+}
+
+bool EmbeddingTable::open(const std::string& path) {
+    unmap(map_);
+    owned_.clear();
+    path_.clear();
+    in_place_ = false;
+    data_ = nullptr;
+    if (!map_readonly(path, map_)) return false;
+    EmbeddingFileHeader hdr;
+    bool ok = map_.bytes >= sizeof(hdr);
+    if (ok) {
+        std::memcpy(&hdr, map_.data, sizeof(hdr));
+        ok = hdr.magic == kEmbeddingMagic && hdr.version == kEmbeddingVersion &&
+             map_.bytes == sizeof(hdr) + hdr.nodes * hdr.dim * sizeof(float);
+    }
+    if (!ok) {
+        std::cerr << "Not a valid embedding cache: " << path << "\n";
+        unmap(map_);
+        return false;
+    }
+    nodes_ = static_cast<uint32_t>(hdr.nodes);
+    dim_ = static_cast<size_t>(hdr.dim);
+    tag_ = hdr.tag;
+    graph_ = {hdr.base, hdr.stamp, hdr.delta};
+    data_ = reinterpret_cast<float*>(static_cast<uint8_t*>(map_.data) + sizeof(hdr));
+    return true;
+}
+
+bool parse_inference_mode(const std::string& s, InferenceMode& out) {
+    if (s == "full") {
+        out = InferenceMode::Full;
+    } else if (s == "fanout") {
+        out = InferenceMode::Fanout;
+    } else if (s == "batched") {
+        out = InferenceMode::Batched;
+    } else {
+        std::cerr << "Unknown inference mode: " << s << " (expected full, fanout or batched)\n";
+        return false;
+    }
+    return true;
+}
+
+XorShift128Plus node_rng(uint64_t seed, size_t layer, uint32_t v) {
+    return XorShift128Plus(mix_seed(seed + 0x9e3779b97f4a7c15ULL * (layer + 1)), v);
+}
+
+struct LayerScratch {
+    std::vector<uint32_t> ds, sampled;
+    std::vector<uint16_t> rs, sampled_rels;
+    std::vector<float> feats, agg;
+};
+
+// Neighbours that aggregation layer l averages over for v.
+static AdjView layer_neighbors(const Encoder& enc, const CsrGraph& g, const InferenceConfig& cfg, size_t l,
+                               uint32_t v, LayerScratch& s) {
+    if (cfg.mode != InferenceMode::Fanout) return g.neighbors(v).unpacked(s.ds, s.rs);
+    s.sampled.clear();
+    s.sampled_rels.clear();
+    XorShift128Plus rng = node_rng(cfg.seed, l, v);
+    sample_neighbors(g, v, enc.config().fanouts[l], s.sampled, s.sampled_rels, rng);
+    AdjView adj;
+    adj.dst = s.sampled.data();
+    adj.rel = s.sampled_rels.data();
+    adj.size = static_cast<uint32_t>(s.sampled.size());
+    return adj;
+}
+
+static void activate(const Encoder& enc, float* row) {
+    if (!enc.config().use_relu) return;
+    for (size_t d = 0; d < enc.output_dim(); ++d) row[d] = std::max(0.0f, row[d]);
+}
+
+// Input-layer rows of `nodes`; row i goes to out(i).
+template <typename Out>
+static void input_rows(const Encoder& enc, const CsrGraph& g, const CsrGraph* rev,
+                       const std::vector<uint32_t>& nodes, LayerScratch& s, Out out) {
+    compute_base_features(g, rev, nodes, enc.feature_config(), s.feats, enc.feature_store());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        float* row = out(i);
+        enc.project_input(&s.feats[i * enc.feature_dim_raw()], row);
+        activate(enc, row);
+    }
+}
+
+// Layer l+1 row of v from the layer-l rows returned by prev(u).
+template <typename Prev>
+static void layer_row(const Encoder& enc, const CsrGraph& g, const InferenceConfig& cfg, size_t l, uint32_t v,
+                      Prev prev, float* out, LayerScratch& s) {
+    const size_t hidden = enc.output_dim();
+    AdjView adj = layer_neighbors(enc, g, cfg, l, v, s);
+    s.agg.assign(hidden, 0.0f);
+    for (uint32_t e = 0; e < adj.size; ++e) {
+        const float* nb = prev(adj.dst[e]);
+        const float* rel = enc.relation_row(adj.rel[e]);
+        for (size_t d = 0; d < hidden; ++d) s.agg[d] += nb[d] + rel[d];
+    }
+    if (adj.size > 0) {
+        float inv = 1.0f / static_cast<float>(adj.size);
+        for (size_t d = 0; d < hidden; ++d) s.agg[d] *= inv;
+    }
+    enc.apply_layer(l, prev(v), s.agg.data(), out);
+    activate(enc, out);
+}
+
+bool layerwise_embeddings(const Encoder& enc, const CsrGraph& g, const CsrGraph* rev,
+                          const InferenceConfig& cfg, EmbeddingTable& out) {
+    const uint32_t n = g.num_nodes();
+    const size_t hidden = enc.output_dim();
+    const size_t L = enc.config().fanouts.size();
+    const uint32_t chunk = static_cast<uint32_t>(std::max<size_t>(1, cfg.chunk_nodes));
+    const size_t chunks = (static_cast<size_t>(n) + chunk - 1) / chunk;
+    if (out.nodes() != n || out.dim() != hidden) return false;
+
+    // Two layers are in flight; the last one is written straight into `out`.
+    const size_t layer_bytes = static_cast<size_t>(n) * hidden * sizeof(float);
+    const bool spill = !cfg.spill_dir.empty() && cfg.mem_budget > 0 && 2 * layer_bytes > cfg.mem_budget;
+    EmbeddingTable tables[2];
+    auto table_for = [&](size_t layer) -> EmbeddingTable* {
+        if (layer == L) return &out;
+        EmbeddingTable& t = tables[layer % 2];
+        std::string path = spill ? cfg.spill_dir + "/layer" + std::to_string(layer) + ".emb" : "";
+        return t.create(n, hidden, path) ? &t : nullptr;
+    };
+
+    // Intermediate layers held in RAM, for the memory account.
+    auto account = [&](size_t tables) {
+        if (cfg.memory) cfg.memory->set(MemKind::Activations, spill ? 0 : tables * layer_bytes);
+    };
+
+    EmbeddingTable* cur = table_for(0);
+    if (!cur) return false;
+    account(cur != &out ? 1 : 0);
+    parallel_for(0, chunks, cfg.threads, [&](size_t c) {
+        uint32_t lo = static_cast<uint32_t>(c * chunk) + 1;
+        uint32_t hi = std::min<uint32_t>(n, lo + chunk - 1);
+        std::vector<uint32_t> nodes;
+        for (uint32_t v = lo; v <= hi; ++v) nodes.push_back(v);
+        LayerScratch s;
+        input_rows(enc, g, rev, nodes, s, [&](size_t i) { return cur->row(nodes[i]); });
+    });
+
+    for (size_t l = 0; l < L; ++l) {
+        EmbeddingTable* next = table_for(l + 1);
+        if (!next) return false;
+        account((cur != &out ? 1 : 0) + (next != &out ? 1 : 0));
+        const EmbeddingTable* prev = cur;
+        parallel_for(0, chunks, cfg.threads, [&](size_t c) {
+            uint32_t lo = static_cast<uint32_t>(c * chunk) + 1;
+            uint32_t hi = std::min<uint32_t>(n, lo + chunk - 1);
+            LayerScratch s;
+            auto rows = [&](uint32_t u) { return prev->row(u); };
+            for (uint32_t v = lo; v <= hi; ++v) layer_row(enc, g, cfg, l, v, rows, next->row(v), s);
+        });
+        if (cur != &out) cur->discard();
+        cur = next;
+    }
+    account(0);
+    return true;
+}
+
+std::vector<uint32_t> affected_nodes(const CsrGraph& rev, std::vector<uint32_t> changed, size_t layers) {
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    std::vector<uint32_t> frontier = changed;
+    std::vector<uint32_t> ds;
+    std::vector<uint16_t> rs;
+    for (size_t hop = 0; hop < layers && !frontier.empty(); ++hop) {
+        std::vector<uint32_t> found;
+        for (uint32_t v : frontier) {
+            AdjView in = rev.neighbors(v).unpacked(ds, rs);
+            found.insert(found.end(), in.dst, in.dst + in.size);
+        }
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        frontier.clear();
+        std::set_difference(found.begin(), found.end(), changed.begin(), changed.end(), std::back_inserter(frontier));
+        std::vector<uint32_t> merged;
+        std::merge(changed.begin(), changed.end(), frontier.begin(), frontier.end(), std::back_inserter(merged));
+        changed.swap(merged);
+    }
+    return changed;
+}
+
+bool refresh_embeddings(const Encoder& enc, const CsrGraph& g, const CsrGraph* rev, const InferenceConfig& cfg,
+                        std::vector<uint32_t> targets, EmbeddingTable& out) {
+    if (cfg.mode == InferenceMode::Batched) {
+        std::cerr << "Batched inference samples per batch and cannot be refreshed row by row\n";
+        return false;
+    }
+    const size_t hidden = enc.output_dim();
+    const size_t L = enc.config().fanouts.size();
+    if (out.dim() != hidden || out.nodes() < g.num_nodes()) return false;
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    while (!targets.empty() && (targets.back() > g.num_nodes())) targets.pop_back();
+    while (!targets.empty() && targets.front() == 0) targets.erase(targets.begin());
+
+    // nodes[l]: every node whose layer-l row is needed, sorted.
+    std::vector<std::vector<uint32_t>> nodes(L + 1);
+    nodes[L] = targets;
+    LayerScratch scratch;
+    for (size_t l = L; l-- > 0;) {
+        std::vector<uint32_t> need = nodes[l + 1];
+        for (uint32_t v : nodes[l + 1]) {
+            AdjView adj = layer_neighbors(enc, g, cfg, l, v, scratch);
+            need.insert(need.end(), adj.dst, adj.dst + adj.size);
+        }
+        std::sort(need.begin(), need.end());
+        need.erase(std::unique(need.begin(), need.end()), need.end());
+        nodes[l] = std::move(need);
+    }
+
+    const size_t chunk = std::max<size_t>(1, cfg.chunk_nodes);
+    auto chunks = [&](size_t count) { return (count + chunk - 1) / chunk; };
+    std::vector<float> cur(nodes[0].size() * hidden);
+    parallel_for(0, chunks(nodes[0].size()), cfg.threads, [&](size_t c) {
+        size_t lo = c * chunk;
+        std::vector<uint32_t> part(nodes[0].begin() + lo,
+                                   nodes[0].begin() + std::min(nodes[0].size(), lo + chunk));
+        LayerScratch s;
+        input_rows(enc, g, rev, part, s, [&](size_t i) { return &cur[(lo + i) * hidden]; });
+    });
+    for (size_t l = 0; l < L; ++l) {
+        const std::vector<uint32_t>& have = nodes[l];
+        const std::vector<uint32_t>& want = nodes[l + 1];
+        std::vector<float> next(want.size() * hidden);
+        parallel_for(0, chunks(want.size()), cfg.threads, [&](size_t c) {
+            LayerScratch s;
+            auto rows = [&](uint32_t u) {
+                size_t i = std::lower_bound(have.begin(), have.end(), u) - have.begin();
+                return &cur[i * hidden];
+            };
+            for (size_t i = c * chunk; i < std::min(want.size(), (c + 1) * chunk); ++i) {
+                layer_row(enc, g, cfg, l, want[i], rows, &next[i * hidden], s);
+            }
+        });
+        cur.swap(next);
+    }
+    for (size_t i = 0; i < targets.size(); ++i) {
+        std::memcpy(out.row(targets[i]), &cur[i * hidden], hidden * sizeof(float));
+    }
+    return true;
+}
+
+// Per-batch path: two-hop sampled subgraphs around up to batch_nodes seeds at
+// a time, fewer where a batch would exceed mem_budget.
+static void batched_embeddings(Encoder& enc, const CsrGraph& g, const CsrGraph* rev, const InferenceConfig& cfg,
+                               EmbeddingTable& out) {
+    XorShift128Plus rng(cfg.seed);
+    const size_t dim = enc.output_dim();
+    AdaptiveBatch sizer(cfg.mem_budget, cfg.batch_nodes);
+    uint32_t start = 1;
+    while (start <= g.num_nodes()) {
+        const size_t take = sizer.next(static_cast<size_t>(g.num_nodes()) - start + 1);
+        std::vector<uint32_t> seeds(take);
+        for (size_t i = 0; i < take; ++i) seeds[i] = start + static_cast<uint32_t>(i);
+        BatchSubgraph sg = enc.sample(g, seeds, rng);
+        if (!sizer.accept(take, enc.predict_bytes(sg, false))) continue;
+        EncoderState st = enc.forward(g, rev, std::move(sg));
+        if (cfg.memory) cfg.memory->set(MemKind::Activations, st.activation_bytes());
+        const auto& map = st.index_per_layer.back();
+        const auto& emb = st.h_layers.back();
+        for (uint32_t v : seeds) {
+            auto it = map.find(v);
+            if (it == map.end()) continue;
+            std::memcpy(out.row(v), &emb[it->second * dim], sizeof(float) * dim);
+        }
+        start += static_cast<uint32_t>(take);
+    }
+    if (cfg.memory) cfg.memory->set(MemKind::Activations, 0);
+    if (sizer.retries() > 0 || sizer.over_budget() > 0) {
+        std::cout << "Memory budget: " << sizer.retries() << " batches resampled smaller, " << sizer.over_budget()
+                  << " single seeds over budget\n";
+    }
+}
+
+uint64_t input_tag(const Encoder& enc, const CsrGraph* rev) {
+    if (enc.feature_store()) return mix_seed(enc.feature_store()->checksum());
+    return enc.feature_config().use_in_degree && rev ? 1 : 0;
+}
+
+uint64_t cache_tag(uint64_t model_tag, const CsrGraph& g, uint64_t inputs, const InferenceConfig& cfg) {
+    return cache_tag(model_tag, graph_identity(g, nullptr, cfg.threads), inputs, cfg);
+}
+
+uint64_t cache_tag(uint64_t model_tag, const GraphIdentity& graph, uint64_t inputs, const InferenceConfig& cfg) {
+    uint64_t tag = mix_seed(model_tag ^ mix_seed((graph.base ^ mix_seed(graph.delta)) +
+                                                 static_cast<uint64_t>(cfg.mode) * 0x9e3779b97f4a7c15ULL +
+                                                 (cfg.mode == InferenceMode::Full ? 0 : cfg.seed)));
+    tag = mix_seed(tag ^ inputs);
+    if (cfg.mode == InferenceMode::Batched) tag ^= cfg.batch_nodes ^ (cfg.mem_budget ? mix_seed(cfg.mem_budget) : 0);
+    return tag;
+}
+
+bool node_embeddings(Encoder& enc, const CsrGraph& g, const CsrGraph* rev, const InferenceConfig& cfg,
+                     uint64_t model_tag, EmbeddingTable& out) {
+    // An existing cache lends its base checksum when the base files still
+    // carry its stamp, so only a changed or unknown base is hashed.
+    GraphIdentity graph;
+    uint64_t tag = 0;
+    if (!cfg.cache.empty()) {
+        const bool exists = file_exists(cfg.cache);
+        const bool opened = exists && out.open(cfg.cache);
+        graph = graph_identity(g, opened ? &out.graph() : nullptr, cfg.threads);
+        tag = cache_tag(model_tag, graph, input_tag(enc, rev), cfg);
+        if (opened && out.tag() == tag && out.nodes() == g.num_nodes() && out.dim() == enc.output_dim()) {
+            std::cout << "Using embedding cache " << cfg.cache << "\n";
+            if (cfg.memory) cfg.memory->set(MemKind::Cache, static_cast<size_t>(out.nodes()) * out.dim() * sizeof(float));
+            return true;
+        }
+        if (exists) std::cout << "Embedding cache " << cfg.cache << " is stale; rebuilding\n";
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    if (!out.create(g.num_nodes(), enc.output_dim(), cfg.cache)) return false;
+    if (cfg.memory) cfg.memory->set(MemKind::Cache, static_cast<size_t>(out.nodes()) * out.dim() * sizeof(float));
+    if (cfg.mode == InferenceMode::Batched) {
+        batched_embeddings(enc, g, rev, cfg, out);
+    } else if (!layerwise_embeddings(enc, g, rev, cfg, out)) {
+        std::cerr << "Layer-wise inference failed\n";
+        return false;
+    }
+    if (!cfg.cache.empty() && !out.commit(tag, graph)) return false;
+    auto t1 = std::chrono::steady_clock::now();
+    std::cout << "Embeddings for " << g.num_nodes() << " nodes in "
+              << std::chrono::duration<double>(t1 - t0).count() << "s\n";
+    return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "csr.hpp"
+#include "encoder.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "rng.hpp"
+#include "threadpool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Node embeddings of a whole graph, row v-1 for node v, in RAM or in a mapped
+// file. The file form is the embedding cache: a 64-byte header (magic, node
+// count, dim, cache tag, GraphIdentity) followed by the rows.
+class EmbeddingTable {
+public:
+    EmbeddingTable() = default;
+    EmbeddingTable(const EmbeddingTable&) = delete;
+    EmbeddingTable& operator=(const EmbeddingTable&) = delete;
+    ~EmbeddingTable();
+
+    // Zero-filled table in RAM, or mapped from "<path>.tmp" when path is set.
+    bool create(uint32_t nodes, size_t dim, const std::string& path = "");
+    // File-backed tables: stamps `tag` and the identity of the graph the rows
+    // were computed on, syncs and renames "<path>.tmp" to path.
+    bool commit(uint64_t tag, const GraphIdentity& graph);
+    // File-backed tables: unmaps and deletes the file.
+    void discard();
+    // Maps a committed file read-only.
+    bool open(const std::string& path);
+    // Maps a committed file for in-place updates, growing it to `nodes` rows
+    // (new rows are zero); commit() then stamps the tags without renaming.
+    bool open_writable(const std::string& path, uint32_t nodes);
+
+    uint32_t nodes() const { return nodes_; }
+    size_t dim() const { return dim_; }
+    uint64_t tag() const { return tag_; }
+    const GraphIdentity& graph() const { return graph_; }
+    float* row(uint32_t v) { return data_ + static_cast<size_t>(v - 1) * dim_; }
+    const float* row(uint32_t v) const { return data_ + static_cast<size_t>(v - 1) * dim_; }
+
+private:
+    std::vector<float> owned_;
+    MMapArrayBase map_;
+    std::string path_;
+    bool in_place_ = false;
+    float* data_ = nullptr;
+    uint32_t nodes_ = 0;
+    size_t dim_ = 0;
+    uint64_t tag_ = 0;
+    GraphIdentity graph_;
+};
+
+enum class InferenceMode {
+    Full,    // layer-wise, every neighbour
+    Fanout,  // layer-wise, the checkpoint's fanouts sampled per node (see node_rng)
+    Batched, // Encoder::forward on sampled subgraphs of batch_nodes seeds
+};
+
+struct InferenceConfig {
+    InferenceMode mode = InferenceMode::Full;
+    size_t batch_nodes = 1024;   // Batched only; the most seeds per batch under mem_budget
+    uint64_t seed = 1;
+    size_t threads = default_threads();
+    size_t chunk_nodes = 1024;   // layer-wise: nodes per parallel work item; does not change the output
+    std::string cache;           // embedding cache file, reused when its tag matches
+    std::string spill_dir;       // where intermediate layers go when they exceed mem_budget
+    // Layer-wise: bytes for the two in-flight layers, spilled to spill_dir
+    // above it. Batched: bytes of one batch's activations; seeds per batch
+    // adapt to stay under it (see AdaptiveBatch). 0: no limit.
+    size_t mem_budget = 0;
+    MemoryAccount* memory = nullptr; // activation and table bytes are reported here
+};
+
+bool parse_inference_mode(const std::string& s, InferenceMode& out);
+
+// RNG for node v's neighbour sample in aggregation layer l. It depends only on
+// (seed, l, v), so any subset of nodes can be recomputed with the same samples.
+XorShift128Plus node_rng(uint64_t seed, size_t layer, uint32_t v);
+
+// Computes every node's output embedding one layer at a time: the input layer
+// for all nodes, then each aggregation layer as one pass over the CSR in node
+// order, reading the previous layer's table. O(L * (N + E)) work with full
+// neighbourhoods, O(L * N * fanout) sampled, instead of O(N * fanout product)
+// for per-batch subgraphs. `out` must have g.num_nodes() rows of
+// enc.output_dim().
+bool layerwise_embeddings(const Encoder& enc, const CsrGraph& g, const CsrGraph* rev,
+                          const InferenceConfig& cfg, EmbeddingTable& out);
+
+// Nodes whose output embedding depends on the adjacency or features of
+// `changed`: `changed` plus everything within `layers` reverse hops, sorted.
+std::vector<uint32_t> affected_nodes(const CsrGraph& rev, std::vector<uint32_t> changed, size_t layers);
+
+// Recomputes only the rows of `targets` in `out`, bit-identical to what
+// layerwise_embeddings produces for them. Builds the targets' L-hop
+// neighbourhood cone, so the cost scales with the targets, not the graph.
+// Full and Fanout modes only.
+bool refresh_embeddings(const Encoder& enc, const CsrGraph& g, const CsrGraph* rev, const InferenceConfig& cfg,
+                        std::vector<uint32_t> targets, EmbeddingTable& out);
+
+// What the encoder's input rows depend on besides the adjacency: the feature
+// store's checksum when it reads one, otherwise whether a reverse CSR supplies
+// the in-degree column (without one it reads as zero).
+uint64_t input_tag(const Encoder& enc, const CsrGraph* rev);
+
+// Tag of an embedding cache: the model tag (checkpoint checksum) combined with
+// the graph's base checksum and delta record count (not its stamp), the
+// input_tag, inference mode and seed. The first form hashes the whole base
+// adjacency, which costs one pass over the CSR.
+uint64_t cache_tag(uint64_t model_tag, const CsrGraph& g, uint64_t inputs, const InferenceConfig& cfg);
+uint64_t cache_tag(uint64_t model_tag, const GraphIdentity& graph, uint64_t inputs, const InferenceConfig& cfg);
+
+// Fills `out` (created here) with every node's embedding, loading cfg.cache
+// instead when it exists and carries the cache_tag of `model_tag`, the graph
+// and the inputs, and writing it otherwise. The base adjacency is only hashed
+// when cfg.cache is set and the cache's base stamp differs from g's.
+bool node_embeddings(Encoder& enc, const CsrGraph& g, const CsrGraph* rev, const InferenceConfig& cfg,
+                     uint64_t model_tag, EmbeddingTable& out);
@@ -1,17 +1,82 @@
 #include "io.hpp"
 
+#include "threadpool.hpp"
+
 #include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
-bool map_readonly(const std::string& path, MMapArrayBase& out) {
+static constexpr size_t kHugePage = size_t(2) << 20;
+
+static int advice_flag(MapAdvice a) {
+    switch (a) {
+    case MapAdvice::Random: return MADV_RANDOM;
+    case MapAdvice::Sequential: return MADV_SEQUENTIAL;
+    case MapAdvice::WillNeed: return MADV_WILLNEED;
+    case MapAdvice::Normal: break;
+    }
+    return MADV_NORMAL;
+}
+
+// Reads the whole file into anonymous memory, preferring explicit huge pages.
+static void* copy_to_anonymous(int fd, size_t bytes, size_t threads, size_t& anon_bytes) {
+    anon_bytes = (bytes + kHugePage - 1) / kHugePage * kHugePage;
+    void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    ptr = mmap(nullptr, anon_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(nullptr, anon_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return ptr;
+        madvise(ptr, anon_bytes, MADV_HUGEPAGE);
+    }
+    // Each thread preads its own huge-page-aligned slice.
+    const size_t n = std::max<size_t>(1, threads);
+    const size_t slice = (bytes / n + kHugePage - 1) / kHugePage * kHugePage;
+    bool ok = true;
+    std::vector<char> slice_ok(n, 1);
+    parallel_for(0, n, n, [&](size_t t) {
+        size_t begin = std::min(bytes, t * slice);
+        size_t end = t + 1 == n ? bytes : std::min(bytes, begin + slice);
+        char* dst = static_cast<char*>(ptr);
+        while (begin < end) {
+            ssize_t got = pread(fd, dst + begin, end - begin, static_cast<off_t>(begin));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                slice_ok[t] = 0;
+                return;
+            }
+            begin += static_cast<size_t>(got);
+        }
+    });
+    for (char c : slice_ok) ok = ok && c;
+    if (!ok) {
+        munmap(ptr, anon_bytes);
+        return MAP_FAILED;
+    }
+    mprotect(ptr, anon_bytes, PROT_READ);
+    return ptr;
+}
+
+static void prefault(const void* data, size_t bytes, size_t threads) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t pages = (bytes + page - 1) / page;
+    const volatile char* p = static_cast<const volatile char*>(data);
+    parallel_for(0, threads, threads, [&](size_t t) {
+        for (size_t i = pages * t / threads; i < pages * (t + 1) / threads; ++i) (void)p[i * page];
+    });
+}
+
+bool map_readonly(const std::string& path, MMapArrayBase& out, const MapPolicy& policy) {
     int fd = open(path.c_str(), O_RDONLY);
     if (fd < 0) {
         std::cerr << "Failed to open " << path << ": " << strerror(errno) << "\n";
@@ -24,26 +89,117 @@ bool map_readonly(const std::string& path, MMapArrayBase& out) {
         return false;
     }
     size_t bytes = static_cast<size_t>(st.st_size);
-    void* ptr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (policy.anonymous_copy && bytes > 0) {
+        size_t anon_bytes = 0;
+        void* ptr = copy_to_anonymous(fd, bytes, std::max<size_t>(1, policy.prefault_threads), anon_bytes);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            std::cerr << "Failed to copy " << path << " into anonymous memory: " << strerror(errno) << "\n";
+            return false;
+        }
+        out.data = ptr;
+        out.bytes = bytes;
+        out.fd = -1;
+        out.anon_bytes = anon_bytes;
+        return true;
+    }
+    int flags = MAP_SHARED | (policy.populate ? MAP_POPULATE : 0);
+    void* ptr = mmap(nullptr, bytes, PROT_READ, flags, fd, 0);
     if (ptr == MAP_FAILED) {
         std::cerr << "mmap failed for " << path << ": " << strerror(errno) << "\n";
         close(fd);
         return false;
     }
+    if (policy.advice != MapAdvice::Normal) madvise(ptr, bytes, advice_flag(policy.advice));
+    if (policy.huge_pages) madvise(ptr, bytes, MADV_HUGEPAGE);
+    if (policy.prefault_threads > 0) prefault(ptr, bytes, policy.prefault_threads);
     out.data = ptr;
     out.bytes = bytes;
     out.fd = fd;
+    out.anon_bytes = 0;
+    return true;
+}
+
+bool parse_map_policy(const std::string& spec, MapPolicy& out) {
+    MapPolicy p;
+    for (const std::string& tok : split_paths(spec)) {
+        if (tok == "default") {
+            continue;
+        } else if (tok == "populate") {
+            p.populate = true;
+        } else if (tok == "prefault") {
+            p.prefault_threads = default_threads();
+        } else if (tok.rfind("prefault=", 0) == 0) {
+            p.prefault_threads = std::stoul(tok.substr(9));
+        } else if (tok == "random") {
+            p.advice = MapAdvice::Random;
+        } else if (tok == "sequential") {
+            p.advice = MapAdvice::Sequential;
+        } else if (tok == "willneed") {
+            p.advice = MapAdvice::WillNeed;
+        } else if (tok == "hugepages") {
+            p.huge_pages = true;
+        } else if (tok == "anon") {
+            p.anonymous_copy = true;
+        } else {
+            std::cerr << "Unknown map policy option: " << tok << "\n";
+            return false;
+        }
+    }
+    out = p;
     return true;
 }
 
+PageFaults page_faults() {
+    struct rusage ru;
+    PageFaults f;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        f.minor = ru.ru_minflt;
+        f.major = ru.ru_majflt;
+    }
+    return f;
+}
+
+bool map_writable(const std::string& path, size_t bytes, MMapArrayBase& out, bool truncate) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << path << " for write: " << strerror(errno) << "\n";
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        std::cerr << "Failed to size " << path << ": " << strerror(errno) << "\n";
+        close(fd);
+        return false;
+    }
+    void* ptr = nullptr;
+    if (bytes > 0) {
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            std::cerr << "mmap failed for " << path << ": " << strerror(errno) << "\n";
+            close(fd);
+            return false;
+        }
+    }
+    out.data = ptr;
+    out.bytes = bytes;
+    out.fd = fd;
+    return true;
+}
+
+bool sync_mapping(const MMapArrayBase& arr) {
+    if (arr.data && arr.bytes > 0 && msync(arr.data, arr.bytes, MS_SYNC) != 0) return false;
+    return arr.fd < 0 || fsync(arr.fd) == 0;
+}
+
 void unmap(MMapArrayBase& arr) {
     if (arr.data && arr.data != MAP_FAILED) {
-        munmap(arr.data, arr.bytes);
+        munmap(arr.data, arr.anon_bytes ? arr.anon_bytes : arr.bytes);
     }
     if (arr.fd >= 0) close(arr.fd);
     arr.data = nullptr;
     arr.bytes = 0;
     arr.fd = -1;
+    arr.anon_bytes = 0;
 }
 
 size_t file_size(const std::string& path) {
@@ -57,6 +213,30 @@ bool file_exists(const std::string& path) {
     return stat(path.c_str(), &st) == 0;
 }
 
+FileStamp file_stamp(const std::string& path) {
+    struct stat st;
+    FileStamp out{};
+    if (stat(path.c_str(), &st) != 0) return out;
+    out.size = static_cast<uint64_t>(st.st_size);
+    out.mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    out.inode = static_cast<uint64_t>(st.st_ino);
+    return out;
+}
+
+bool write_all(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t wrote = write(fd, p, bytes);
+        if (wrote < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += wrote;
+        bytes -= static_cast<size_t>(wrote);
+    }
+    return true;
+}
+
 template <typename T>
 bool write_array(const std::string& path, const std::vector<T>& data) {
     int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
@@ -64,14 +244,14 @@ bool write_array(const std::string& path, const std::vector<T>& data) {
         std::cerr << "Failed to open " << path << " for write: " << strerror(errno) << "\n";
         return false;
     }
-    size_t bytes = data.size() * sizeof(T);
-    ssize_t wrote = write(fd, reinterpret_cast<const char*>(data.data()), bytes);
+    bool ok = write_all(fd, data.data(), data.size() * sizeof(T));
     close(fd);
-    return wrote == static_cast<ssize_t>(bytes);
+    return ok;
 }
 
 template bool write_array<uint32_t>(const std::string&, const std::vector<uint32_t>&);
 template bool write_array<uint16_t>(const std::string&, const std::vector<uint16_t>&);
+template bool write_array<uint64_t>(const std::string&, const std::vector<uint64_t>&);
 
 bool map_triples(const std::string& path, MMapArray<Triple>& out) {
     if (!map_array(path, out)) return false;
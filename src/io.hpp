@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -9,8 +10,36 @@ struct MMapArrayBase {
     void* data = nullptr;
     size_t bytes = 0;
     int fd = -1;
+    size_t anon_bytes = 0; // length of an anonymous copy (rounded to huge pages), 0 if file-backed
 };
 
+enum class MapAdvice {
+    Normal,
+    Random,
+    Sequential,
+    WillNeed,
+};
+
+// How map_readonly sets up a mapping. The default is a bare shared mapping.
+struct MapPolicy {
+    bool populate = false;        // MAP_POPULATE: fault everything in during mmap
+    size_t prefault_threads = 0;  // touch every page from this many threads after mapping
+    MapAdvice advice = MapAdvice::Normal;
+    bool huge_pages = false;      // MADV_HUGEPAGE (file-backed THP needs kernel support)
+    bool anonymous_copy = false;  // read into anonymous memory: MAP_HUGETLB if available, else THP-advised
+};
+
+// Parses a comma-separated list: populate, prefault[=T], random, sequential,
+// willneed, hugepages, anon. Empty (or "default") means the default policy.
+bool parse_map_policy(const std::string& spec, MapPolicy& out);
+
+struct PageFaults {
+    long minor = 0;
+    long major = 0;
+};
+// Process-wide fault counters (getrusage); diff two readings around a phase.
+PageFaults page_faults();
+
 template <typename T>
 struct MMapArray {
     const T* data = nullptr;
@@ -21,14 +50,31 @@ struct MMapArray {
     bool empty() const { return size == 0; }
 };
 
-bool map_readonly(const std::string& path, MMapArrayBase& out);
+bool map_readonly(const std::string& path, MMapArrayBase& out, const MapPolicy& policy = {});
+// Creates (or truncates) path, sizes it to `bytes` and maps it shared and
+// writable. With truncate=false an existing file keeps its contents and is
+// resized to `bytes`.
+bool map_writable(const std::string& path, size_t bytes, MMapArrayBase& out, bool truncate = true);
+bool sync_mapping(const MMapArrayBase& arr);
 void unmap(MMapArrayBase& arr);
 size_t file_size(const std::string& path);
+bool write_all(int fd, const void* data, size_t bytes);
 bool file_exists(const std::string& path);
 
+// What stat() says about a file's contents: size, modification time and
+// inode. Rewriting or replacing the file changes it, short of a same-size
+// rewrite within one timestamp tick. All zero when the file is missing.
+struct FileStamp {
+    uint64_t size;
+    uint64_t mtime_ns;
+    uint64_t inode;
+    bool operator==(const FileStamp&) const = default;
+};
+FileStamp file_stamp(const std::string& path);
+
 template <typename T>
-bool map_array(const std::string& path, MMapArray<T>& out) {
-    if (!map_readonly(path, out.base)) return false;
+bool map_array(const std::string& path, MMapArray<T>& out, const MapPolicy& policy = {}) {
+    if (!map_readonly(path, out.base, policy)) return false;
     if (out.base.bytes % sizeof(T) != 0) {
         unmap(out.base);
         return false;
@@ -50,3 +96,51 @@ struct Triple {
 bool map_triples(const std::string& path, MMapArray<Triple>& out);
 std::vector<std::string> split_paths(const std::string& paths, char sep = ',');
 
+// 64-bit multiply-xorshift hash over little-endian words, fed incrementally.
+class Checksum64 {
+public:
+    void update(const void* data, size_t n) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        while (n > 0 && pending_ > 0) {
+            buf_[pending_++] = *p++;
+            --n;
+            if (pending_ == 8) {
+                mix(load(buf_));
+                pending_ = 0;
+            }
+        }
+        for (; n >= 8; n -= 8, p += 8) mix(load(p));
+        if (n > 0) {
+            std::memcpy(buf_, p, n);
+            pending_ = n;
+        }
+    }
+    uint64_t finish() {
+        if (pending_ > 0) {
+            std::memset(buf_ + pending_, 0, 8 - pending_);
+            mix(load(buf_));
+        }
+        uint64_t h = h_ ^ (len_ * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    static uint64_t load(const uint8_t* p) {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        return w;
+    }
+    void mix(uint64_t w) {
+        h_ ^= w * 0x87c37b91114253d5ULL;
+        h_ = ((h_ << 31) | (h_ >> 33)) * 0x4cf5ad432745937fULL;
+        ++len_;
+    }
+
+    uint64_t h_ = 0x6a09e667f3bcc908ULL;
+    uint64_t len_ = 0;
+    uint8_t buf_[8] = {};
+    size_t pending_ = 0;
+};
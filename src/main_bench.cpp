@@ -0,0 +1,785 @@
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "inference.hpp"
+#include "io.hpp"
+#include "metrics.hpp"
+#include "optim.hpp"
+#include "perf_counters.hpp"
+#include "rng.hpp"
+#include "sampler.hpp"
+#include "subgraph.hpp"
+#include "synth.hpp"
+#include "threadpool.hpp"
+#include "trainer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_set>
+#include <string>
+#include <vector>
+
+struct BenchOptions {
+    std::string data_dir = "data";
+    std::string mode = "overlay";
+    std::string reordered_dir;
+    std::vector<std::string> map_policies = {"default", "random", "populate", "prefault", "hugepages", "anon"};
+    size_t dim = 64;
+    size_t batches = 200;
+    size_t batch_size = 512;
+    size_t fanout1 = 20;
+    size_t fanout2 = 10;
+    uint64_t seed = 1;
+    // suite mode
+    SynthConfig synth;
+    bool data_given = false;    // otherwise suite mode generates its graph
+    std::string synth_dir;      // keep the generated graph here instead of a temp dir
+    size_t warmup = 3;
+    size_t reps = 20;
+    size_t negatives = 5;
+    size_t threads = default_threads();
+    std::vector<std::string> cases;
+    std::string json;
+    bool perf = false; // hardware counters per case
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_bench --mode overlay|compressed|reorder|mmap|sampler|suite [--data data_dir] [--batches N] [--batch B] "
+                 "[--fanout1 F1] [--fanout2 F2] [--seed S] [--reordered dir] [--dim D] [--map_policies P1;P2;...]\n"
+                 "       suite: [--nodes N] [--edges M] [--relations R] [--skew A] [--rel_skew A] [--synth_dir dir] "
+                 "[--warmup W] [--reps K] [--negatives K] [--threads T] [--cases c1,c2,...] [--json out.json] [--perf]\n"
+                 "  overlay:    two-layer sampling on the base CSR vs. the base merged with delta.bin\n"
+                 "  compressed: bytes/edge, sampling and full-scan decode of csr.bin vs. csr.cbin\n"
+                 "  reorder:    sampling and embedding-row gathers on data_dir vs. its kg_reorder output\n"
+                 "  mmap:       load time, sampling time and page faults per mapping policy\n"
+                 "  sampler:    edges/sec of per-target sampling in hash order vs. the sorted, prefetching layer sampler\n"
+                 "  suite:      median/p99 time and throughput of each hot path on --data, or on a generated\n"
+                 "              skewed graph when --data is not given\n";
+}
+
+static bool parse_args(int argc, char** argv, BenchOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--data" || a == "-d") && need(1)) {
+            opt.data_dir = argv[++i];
+            opt.data_given = true;
+        } else if (a == "--mode" && need(1)) {
+            opt.mode = argv[++i];
+        } else if (a == "--batches" && need(1)) {
+            opt.batches = std::stoul(argv[++i]);
+        } else if (a == "--batch" && need(1)) {
+            opt.batch_size = std::stoul(argv[++i]);
+        } else if (a == "--fanout1" && need(1)) {
+            opt.fanout1 = std::stoul(argv[++i]);
+        } else if (a == "--fanout2" && need(1)) {
+            opt.fanout2 = std::stoul(argv[++i]);
+        } else if (a == "--seed" && need(1)) {
+            opt.seed = std::stoull(argv[++i]);
+        } else if (a == "--reordered" && need(1)) {
+            opt.reordered_dir = argv[++i];
+        } else if (a == "--dim" && need(1)) {
+            opt.dim = std::stoul(argv[++i]);
+        } else if (a == "--map_policies" && need(1)) {
+            opt.map_policies = split_paths(argv[++i], ';');
+        } else if (a == "--nodes" && need(1)) {
+            opt.synth.nodes = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (a == "--edges" && need(1)) {
+            opt.synth.edges = std::stoull(argv[++i]);
+        } else if (a == "--relations" && need(1)) {
+            opt.synth.relations = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (a == "--skew" && need(1)) {
+            opt.synth.out_skew = opt.synth.in_skew = std::stod(argv[++i]);
+        } else if (a == "--rel_skew" && need(1)) {
+            opt.synth.rel_skew = std::stod(argv[++i]);
+        } else if (a == "--synth_dir" && need(1)) {
+            opt.synth_dir = argv[++i];
+        } else if (a == "--warmup" && need(1)) {
+            opt.warmup = std::stoul(argv[++i]);
+        } else if (a == "--reps" && need(1)) {
+            opt.reps = std::stoul(argv[++i]);
+        } else if (a == "--negatives" && need(1)) {
+            opt.negatives = std::stoul(argv[++i]);
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::stoul(argv[++i]);
+        } else if (a == "--cases" && need(1)) {
+            opt.cases = split_paths(argv[++i]);
+        } else if (a == "--json" && need(1)) {
+            opt.json = argv[++i];
+        } else if (a == "--perf") {
+            opt.perf = true;
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Seconds per batch of build_subgraph over `batches` random seed sets drawn
+// from [1, num_seeds]. The same seed gives the same seed sets on any graph.
+static double time_sampling(const CsrGraph& g, uint32_t num_seeds, const BenchOptions& opt,
+                            size_t& sampled) {
+    XorShift128Plus rng(opt.seed);
+    std::vector<size_t> fanouts = {opt.fanout1, opt.fanout2};
+    std::vector<uint32_t> seeds(opt.batch_size);
+    sampled = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < opt.batches; ++b) {
+        for (auto& s : seeds) s = rng.next_u32(num_seeds) + 1;
+        BatchSubgraph sg = build_subgraph(g, seeds, fanouts, rng);
+        sampled += sg.nodes_per_layer[0].size();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count() / static_cast<double>(opt.batches);
+}
+
+static int bench_overlay(const BenchOptions& opt) {
+    CsrGraph base, merged;
+    if (!base.load_custom(opt.data_dir, "offsets.bin", "csr.bin", "rels.bin", "entities.bin",
+                          "props.bin", "") ||
+        !merged.load(opt.data_dir)) {
+        std::cerr << "Failed to load graph from " << opt.data_dir << "\n";
+        return 1;
+    }
+    if (merged.delta_records() == 0) {
+        std::cerr << "Warning: " << opt.data_dir << " has no delta.bin; both runs use the base CSR.\n";
+    }
+    size_t sampled_base = 0, sampled_merged = 0;
+    time_sampling(base, base.num_nodes(), opt, sampled_base); // warm the page cache
+    double t_base = time_sampling(base, base.num_nodes(), opt, sampled_base);
+    double t_merged = time_sampling(merged, base.num_nodes(), opt, sampled_merged);
+    std::cout << "delta records=" << merged.delta_records() << " edges " << base.num_edges()
+              << " -> " << merged.num_edges() << "\n"
+              << "base:    " << t_base * 1e3 << " ms/batch (" << sampled_base / opt.batches
+              << " layer-0 nodes)\n"
+              << "overlay: " << t_merged * 1e3 << " ms/batch (" << sampled_merged / opt.batches
+              << " layer-0 nodes)\n"
+              << "overhead: " << (t_base > 0.0 ? (t_merged / t_base - 1.0) * 100.0 : 0.0) << "%\n";
+    return 0;
+}
+
+// Edges per second over a full scan that reads every neighbour.
+static double time_scan(const CsrGraph& g, uint64_t& checksum) {
+    std::vector<uint32_t> dst_scratch;
+    std::vector<uint16_t> rel_scratch;
+    checksum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t v = 1; v <= g.num_nodes(); ++v) {
+        AdjView adj = g.neighbors(v).unpacked(dst_scratch, rel_scratch);
+        for (uint32_t i = 0; i < adj.size; ++i) checksum += adj.dst[i] + adj.rel[i];
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return static_cast<double>(g.num_edges()) / std::chrono::duration<double>(t1 - t0).count();
+}
+
+static int bench_compressed(const BenchOptions& opt) {
+    CsrGraph raw, packed;
+    raw.set_adjacency_format(AdjFormat::Raw);
+    packed.set_adjacency_format(AdjFormat::Compressed);
+    if (!raw.load(opt.data_dir) || !packed.load(opt.data_dir)) {
+        std::cerr << "Failed to load raw and compressed adjacency from " << opt.data_dir
+                  << " (run kg_compress first)\n";
+        return 1;
+    }
+    const double m = static_cast<double>(raw.num_edges());
+    const double raw_bytes = static_cast<double>(file_size(opt.data_dir + "/csr.bin") +
+                                                 file_size(opt.data_dir + "/rels.bin"));
+    const double packed_bytes = static_cast<double>(file_size(opt.data_dir + "/csr.cbin") +
+                                                    file_size(opt.data_dir + "/csr.cidx"));
+    size_t sampled = 0;
+    uint64_t sum_raw = 0, sum_packed = 0;
+    time_sampling(raw, raw.num_nodes(), opt, sampled); // warm the page cache
+    time_sampling(packed, raw.num_nodes(), opt, sampled);
+    double t_raw = time_sampling(raw, raw.num_nodes(), opt, sampled);
+    double t_packed = time_sampling(packed, raw.num_nodes(), opt, sampled);
+    double scan_raw = time_scan(raw, sum_raw);
+    double scan_packed = time_scan(packed, sum_packed);
+    std::cout << "edges=" << raw.num_edges() << "\n"
+              << "raw:        " << raw_bytes / m << " B/edge, " << t_raw * 1e3 << " ms/batch, scan "
+              << scan_raw / 1e6 << " Medges/s\n"
+              << "compressed: " << packed_bytes / m << " B/edge, " << t_packed * 1e3 << " ms/batch, scan "
+              << scan_packed / 1e6 << " Medges/s\n";
+    if (sum_raw != sum_packed) {
+        std::cerr << "Warning: compressed adjacency does not hold the same edges as csr.bin/rels.bin\n";
+    }
+    return 0;
+}
+
+struct ReorderTiming {
+    double sample = 0.0; // seconds per batch
+    double gather = 0.0; // seconds per batch
+    double checksum = 0.0;
+};
+
+// Samples the same logical seed batches on either numbering (seed IDs are
+// mapped through perm) and gathers one embedding row per sampled node, which
+// is what scoring and cache lookups do.
+static ReorderTiming time_reorder(const CsrGraph& g, const std::vector<uint32_t>* perm,
+                                  const std::vector<float>& table, const BenchOptions& opt) {
+    XorShift128Plus seed_rng(opt.seed);
+    XorShift128Plus rng(opt.seed + 1);
+    std::vector<size_t> fanouts = {opt.fanout1, opt.fanout2};
+    std::vector<uint32_t> seeds(opt.batch_size);
+    std::vector<float> acc(opt.dim, 0.0f);
+    ReorderTiming t;
+    for (size_t b = 0; b < opt.batches; ++b) {
+        for (auto& s : seeds) {
+            s = seed_rng.next_u32(g.num_nodes()) + 1;
+            if (perm) s = (*perm)[s];
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        BatchSubgraph sg = build_subgraph(g, seeds, fanouts, rng);
+        auto t1 = std::chrono::steady_clock::now();
+        for (const auto& ls : sg.samples) {
+            for (uint32_t v : ls.neighbors) {
+                const float* row = table.data() + static_cast<size_t>(v) * opt.dim;
+                for (size_t k = 0; k < opt.dim; ++k) acc[k] += row[k];
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        t.sample += std::chrono::duration<double>(t1 - t0).count();
+        t.gather += std::chrono::duration<double>(t2 - t1).count();
+    }
+    t.sample /= static_cast<double>(opt.batches);
+    t.gather /= static_cast<double>(opt.batches);
+    for (float x : acc) t.checksum += x;
+    return t;
+}
+
+static int bench_reorder(const BenchOptions& opt) {
+    CsrGraph before, after;
+    MMapArray<uint32_t> perm_file;
+    if (opt.reordered_dir.empty() || !before.load(opt.data_dir) || !after.load(opt.reordered_dir) ||
+        !map_array(opt.reordered_dir + "/perm.bin", perm_file) || perm_file.size != before.num_nodes() + 1u) {
+        std::cerr << "reorder mode needs --data and a --reordered directory written by kg_reorder\n";
+        return 1;
+    }
+    std::vector<uint32_t> perm(perm_file.data, perm_file.data + perm_file.size);
+    unmap(perm_file.base);
+    std::vector<float> table((static_cast<size_t>(before.num_nodes()) + 1) * opt.dim);
+    for (size_t i = 0; i < table.size(); ++i) table[i] = static_cast<float>(i % 7);
+
+    time_reorder(before, nullptr, table, opt); // warm the page cache
+    time_reorder(after, &perm, table, opt);
+    ReorderTiming a = time_reorder(before, nullptr, table, opt);
+    ReorderTiming b = time_reorder(after, &perm, table, opt);
+    std::cout << "original:  sample " << a.sample * 1e3 << " ms/batch, gather " << a.gather * 1e3
+              << " ms/batch\n"
+              << "reordered: sample " << b.sample * 1e3 << " ms/batch, gather " << b.gather * 1e3
+              << " ms/batch\n"
+              << "speedup:   sample " << a.sample / b.sample << "x, gather " << a.gather / b.gather << "x\n";
+    return 0;
+}
+
+// The targets are the two-hop frontier of each seed batch (the nodes the
+// first layer samples for); both runs draw fanout1 neighbours per target.
+static int bench_sampler(const BenchOptions& opt) {
+    CsrGraph g;
+    if (!g.load(opt.data_dir)) {
+        std::cerr << "Failed to load graph from " << opt.data_dir << "\n";
+        return 1;
+    }
+    XorShift128Plus rng(opt.seed);
+    std::vector<size_t> fanouts = {opt.fanout1, opt.fanout2};
+    std::vector<uint32_t> seeds(opt.batch_size);
+    std::vector<std::vector<uint32_t>> hashed(opt.batches), sorted(opt.batches);
+    for (size_t b = 0; b < opt.batches; ++b) {
+        for (auto& s : seeds) s = rng.next_u32(g.num_nodes()) + 1;
+        BatchSubgraph sg = build_subgraph(g, seeds, fanouts, rng);
+        sorted[b] = sg.nodes_per_layer[1];
+        std::unordered_set<uint32_t> set(sorted[b].begin(), sorted[b].end());
+        hashed[b].assign(set.begin(), set.end());
+    }
+
+    auto run = [&](bool batched, size_t& edges) {
+        XorShift128Plus r(opt.seed);
+        LayerSamples ls;
+        edges = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < opt.batches; ++b) {
+            if (batched) {
+                sample_layer(g, sorted[b], opt.fanout1, ls, r);
+            } else {
+                ls.neighbors.clear();
+                ls.rels.clear();
+                for (uint32_t v : hashed[b]) sample_neighbors(g, v, opt.fanout1, ls.neighbors, ls.rels, r);
+            }
+            edges += ls.neighbors.size();
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(t1 - t0).count();
+    };
+    size_t e_hash = 0, e_batched = 0;
+    run(false, e_hash); // warm the page cache
+    double t_hash = run(false, e_hash);
+    double t_batched = run(true, e_batched);
+    std::cout << "targets/batch=" << e_hash / opt.batches / std::max<size_t>(opt.fanout1, 1)
+              << " fanout=" << opt.fanout1 << " (" << (g.compressed() ? "compressed" : "raw") << ")\n"
+              << "per-target, hash order:   " << e_hash / t_hash / 1e6 << " M edges/s\n"
+              << "layer, sorted + prefetch: " << e_batched / t_batched / 1e6 << " M edges/s\n"
+              << "speedup: " << (t_batched > 0.0 ? t_hash / t_batched : 0.0) << "x\n";
+    return 0;
+}
+
+// Page-cache residency is shared across runs, so later policies may start
+// warm; drop caches between runs (or run one policy per process) for cold numbers.
+static int bench_mmap(const BenchOptions& opt) {
+    for (const std::string& spec : opt.map_policies) {
+        MapPolicy p;
+        if (!parse_map_policy(spec, p)) return 1;
+        GraphMapPolicy gp;
+        gp.offsets = gp.adjacency = gp.dictionaries = p;
+        PageFaults f0 = page_faults();
+        auto t0 = std::chrono::steady_clock::now();
+        CsrGraph g;
+        g.set_map_policy(gp);
+        if (!g.load(opt.data_dir)) {
+            std::cerr << "Failed to load graph from " << opt.data_dir << "\n";
+            return 1;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        PageFaults f1 = page_faults();
+        size_t sampled = 0;
+        double t_sample = time_sampling(g, g.num_nodes(), opt, sampled);
+        PageFaults f2 = page_faults();
+        std::cout << spec << ": load "
+                  << std::chrono::duration<double>(t1 - t0).count() * 1e3 << " ms faults "
+                  << (f1.minor - f0.minor) << "/" << (f1.major - f0.major) << ", sample " << t_sample * 1e3
+                  << " ms/batch faults " << (f2.minor - f1.minor) << "/" << (f2.major - f1.major)
+                  << " (minor/major)\n";
+    }
+    return 0;
+}
+
+// Timed region of one suite repetition; setup outside start()/stop() is not
+// counted, by the clock or by the counters when perf is set.
+struct RepTimer {
+    const PerfCounters* perf = nullptr;
+    std::chrono::steady_clock::time_point t0;
+    CounterValues c0;
+    double seconds = 0.0;
+    CounterValues counters;
+    void start() {
+        if (perf) c0 = perf->read();
+        t0 = std::chrono::steady_clock::now();
+    }
+    void stop() {
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (perf) counters += perf->read() - c0;
+    }
+};
+
+struct CaseResult {
+    std::string name;
+    std::string unit;            // what the throughput counts
+    double items = 0.0;          // mean per repetition
+    std::vector<double> seconds; // per repetition, sorted
+    CounterValues counters;      // mean per repetition
+};
+
+// Nearest-rank percentile of sorted samples.
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Runs `rep` opt.warmup times untimed, then opt.reps times. Each call does
+// one repetition, timing its region with the RepTimer, and returns the items
+// (edges, nodes, triples, ...) it processed. `perf` may be null.
+template <typename Rep>
+static CaseResult run_case(const std::string& name, const std::string& unit, const BenchOptions& opt,
+                           const PerfCounters* perf, Rep rep) {
+    CaseResult r;
+    r.name = name;
+    r.unit = unit;
+    for (size_t i = 0; i < opt.warmup; ++i) {
+        RepTimer t;
+        rep(t);
+    }
+    for (size_t i = 0; i < opt.reps; ++i) {
+        RepTimer t;
+        t.perf = perf;
+        r.items += static_cast<double>(rep(t));
+        r.seconds.push_back(t.seconds);
+        r.counters += t.counters;
+    }
+    if (opt.reps > 0) {
+        r.items /= static_cast<double>(opt.reps);
+        for (uint64_t& c : r.counters.v) c /= opt.reps;
+    }
+    std::sort(r.seconds.begin(), r.seconds.end());
+    return r;
+}
+
+static std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// One training batch drawn like the trainer's: triples are random edges of
+// the graph, negatives are uniform, and `nodes` are the unique seeds.
+struct SuiteBatch {
+    std::vector<uint32_t> heads, rels, tails, negs, nodes;
+};
+
+static Triple random_edge(const CsrGraph& g, XorShift128Plus& rng) {
+    for (int tries = 0; tries < 64; ++tries) {
+        uint32_t h = rng.next_u32(g.num_nodes()) + 1;
+        AdjView adj = g.neighbors(h);
+        if (adj.size == 0) continue;
+        uint32_t i = rng.next_u32(adj.size);
+        return Triple{h, adj.rel_at(i), adj.dst_at(i)};
+    }
+    return Triple{1, 1, 1};
+}
+
+static SuiteBatch suite_batch(const CsrGraph& g, size_t batch, size_t negatives, XorShift128Plus& rng) {
+    SuiteBatch b;
+    for (size_t i = 0; i < batch; ++i) {
+        Triple t = random_edge(g, rng);
+        b.heads.push_back(t.h);
+        b.rels.push_back(t.r);
+        b.tails.push_back(t.t);
+    }
+    for (size_t i = 0; i < batch * negatives; ++i) b.negs.push_back(sample_negative(g.num_nodes(), rng));
+    std::unordered_set<uint32_t> set(b.heads.begin(), b.heads.end());
+    set.insert(b.tails.begin(), b.tails.end());
+    set.insert(b.negs.begin(), b.negs.end());
+    b.nodes.assign(set.begin(), set.end());
+    return b;
+}
+
+static bool run_suite(const BenchOptions& opt, const std::string& dir, const CsrGraph& g, const CsrGraph* rev) {
+    auto want = [&](const std::string& name) {
+        return opt.cases.empty() || std::find(opt.cases.begin(), opt.cases.end(), name) != opt.cases.end();
+    };
+    // Each case draws from its own stream, so --cases does not change the
+    // inputs of the cases that remain.
+    auto stream = [&](uint64_t k) { return XorShift128Plus(opt.seed, 100 + k); };
+    const std::vector<size_t> fanouts = {opt.fanout1, opt.fanout2};
+    const size_t L = fanouts.size();
+
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = opt.dim;
+    ecfg.layers = static_cast<int>(L);
+    ecfg.fanouts = fanouts;
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = rev != nullptr;
+    XorShift128Plus init(opt.seed);
+    Encoder enc(feature_dim(fcfg, rev != nullptr), g.num_relations(), ecfg, fcfg, init);
+    Decoder dec(g.num_relations(), opt.dim, enc.relation_embeddings(), init);
+    std::vector<Parameter*> params = enc.parameters();
+    std::vector<Parameter*> dparams = dec.parameters();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    size_t param_count = 0;
+    for (const Parameter* p : params) param_count += p->size();
+    Optimizer optim(OptimConfig(), params);
+
+    std::vector<uint32_t> seeds(opt.batch_size);
+    auto draw_seeds = [&](XorShift128Plus& rng) {
+        for (auto& v : seeds) v = rng.next_u32(g.num_nodes()) + 1;
+    };
+    auto output_grads = [&](const EncoderState& st) {
+        std::vector<std::vector<float>> grads(L + 1);
+        grads[L].assign(st.sg.nodes_per_layer[L].size() * opt.dim, 1e-3f);
+        return grads;
+    };
+    auto rows = [](const EncoderState& st) {
+        size_t n = 0;
+        for (const auto& nodes : st.sg.nodes_per_layer) n += nodes.size();
+        return n;
+    };
+
+    PerfCounters perf;
+    const PerfCounters* perf_ptr = nullptr;
+    if (opt.perf) {
+        perf.open();
+        std::cout << "Perf " << perf.status() << "\n";
+        perf_ptr = &perf;
+    }
+
+    std::vector<CaseResult> results;
+    for (int sampler = 0; sampler < 2; ++sampler) {
+        const std::string name = sampler ? "sample_layer" : "sample_neighbors";
+        if (!want(name)) continue;
+        // Targets are the two-hop frontier of a seed batch, sorted, as
+        // build_subgraph passes them to the first layer.
+        XorShift128Plus rng = stream(sampler);
+        LayerSamples ls;
+        results.push_back(run_case(name, "edges", opt, perf_ptr, [&](RepTimer& t) {
+            draw_seeds(rng);
+            std::vector<uint32_t> targets = build_subgraph(g, seeds, fanouts, rng).nodes_per_layer[1];
+            t.start();
+            if (sampler) {
+                sample_layer(g, targets, opt.fanout1, ls, rng);
+            } else {
+                ls.neighbors.clear();
+                ls.rels.clear();
+                for (uint32_t v : targets) sample_neighbors(g, v, opt.fanout1, ls.neighbors, ls.rels, rng);
+            }
+            t.stop();
+            return ls.neighbors.size();
+        }));
+    }
+    if (want("build_subgraph")) {
+        XorShift128Plus rng = stream(2);
+        results.push_back(run_case("build_subgraph", "edges", opt, perf_ptr, [&](RepTimer& t) {
+            draw_seeds(rng);
+            t.start();
+            BatchSubgraph sg = build_subgraph(g, seeds, fanouts, rng);
+            t.stop();
+            size_t edges = 0;
+            for (const auto& ls : sg.samples) edges += ls.neighbors.size();
+            return edges;
+        }));
+    }
+    if (want("compute_base_features")) {
+        XorShift128Plus rng = stream(3);
+        std::vector<float> features;
+        results.push_back(run_case("compute_base_features", "nodes", opt, perf_ptr, [&](RepTimer& t) {
+            draw_seeds(rng);
+            BatchSubgraph sg = build_subgraph(g, seeds, fanouts, rng);
+            t.start();
+            compute_base_features(g, rev, sg.nodes_per_layer[0], fcfg, features);
+            t.stop();
+            return sg.nodes_per_layer[0].size();
+        }));
+    }
+    if (want("encoder_forward")) {
+        XorShift128Plus rng = stream(4);
+        results.push_back(run_case("encoder_forward", "nodes", opt, perf_ptr, [&](RepTimer& t) {
+            SuiteBatch b = suite_batch(g, opt.batch_size, opt.negatives, rng);
+            t.start();
+            EncoderState st = enc.forward(g, rev, b.nodes, rng);
+            t.stop();
+            return rows(st);
+        }));
+    }
+    if (want("encoder_backward")) {
+        XorShift128Plus rng = stream(5);
+        results.push_back(run_case("encoder_backward", "nodes", opt, perf_ptr, [&](RepTimer& t) {
+            SuiteBatch b = suite_batch(g, opt.batch_size, opt.negatives, rng);
+            EncoderState st = enc.forward(g, rev, b.nodes, rng);
+            std::vector<std::vector<float>> grads = output_grads(st);
+            optim.zero_grad();
+            t.start();
+            enc.backward(st, grads);
+            t.stop();
+            return rows(st);
+        }));
+    }
+    for (int loss = 0; loss < 2; ++loss) {
+        const std::string name = loss ? "relation_loss" : "distmult_loss";
+        if (!want(name)) continue;
+        XorShift128Plus rng = stream(6 + loss);
+        results.push_back(run_case(name, "triples", opt, perf_ptr, [&](RepTimer& t) {
+            SuiteBatch b = suite_batch(g, opt.batch_size, opt.negatives, rng);
+            EncoderState st = enc.forward(g, rev, b.nodes, rng);
+            std::vector<std::vector<float>> grads = output_grads(st);
+            optim.zero_grad();
+            t.start();
+            if (loss) {
+                dec.relation_loss(b.heads, b.tails, b.rels, st.index_per_layer[L], st.h_layers[L], grads[L]);
+            } else {
+                dec.distmult_loss(b.heads, b.rels, b.tails, b.negs, opt.negatives, st.index_per_layer[L],
+                                  st.h_layers[L], grads[L]);
+            }
+            t.stop();
+            return b.heads.size();
+        }));
+    }
+    if (want("optimizer_step")) {
+        results.push_back(run_case("optimizer_step", "params", opt, perf_ptr, [&](RepTimer& t) {
+            t.start();
+            optim.step();
+            t.stop();
+            return param_count;
+        }));
+    }
+    if (want("train_step")) {
+        XorShift128Plus rng = stream(8);
+        std::vector<Triple> triples(opt.batch_size * 16);
+        for (auto& tr : triples) tr = random_edge(g, rng);
+        TrainConfig tcfg;
+        tcfg.batch_size = opt.batch_size;
+        tcfg.negatives = opt.negatives;
+        tcfg.shuffle_seed = opt.seed;
+        Trainer trainer(enc, dec, optim, g, rev, triples.data(), triples.size(), tcfg, rng);
+        results.push_back(run_case("train_step", "triples", opt, perf_ptr, [&](RepTimer& t) {
+            BatchResult br;
+            t.start();
+            while (!trainer.step(br)) trainer.next_epoch();
+            t.stop();
+            return br.triples;
+        }));
+    }
+    EmbeddingTable table;
+    const bool need_table = want("build_cache") || want("tail_rank");
+    if (need_table && !table.create(g.num_nodes(), opt.dim)) return false;
+    InferenceConfig icfg;
+    icfg.threads = opt.threads;
+    if (want("build_cache")) {
+        results.push_back(run_case("build_cache", "nodes", opt, perf_ptr, [&](RepTimer& t) {
+            t.start();
+            layerwise_embeddings(enc, g, rev, icfg, table);
+            t.stop();
+            return g.num_nodes();
+        }));
+    } else if (need_table && !layerwise_embeddings(enc, g, rev, icfg, table)) {
+        return false;
+    }
+    if (want("tail_rank")) {
+        // Unfiltered ranking against every node, kRankQueries queries per repetition.
+        constexpr size_t kRankQueries = 16;
+        XorShift128Plus rng = stream(9);
+        const float* rel_emb = enc.relation_embeddings()->data.data();
+        results.push_back(run_case("tail_rank", "triples", opt, perf_ptr, [&](RepTimer& t) {
+            std::vector<Triple> queries(kRankQueries);
+            for (auto& q : queries) q = random_edge(g, rng);
+            t.start();
+            for (const Triple& q : queries) {
+                tail_rank(table.row(1), g.num_nodes(), opt.dim, table.row(q.h),
+                                  rel_emb + static_cast<size_t>(q.r) * opt.dim, q.t, nullptr);
+            }
+            t.stop();
+            return queries.size();
+        }));
+    }
+
+    std::cout << "graph " << dir << ": " << g.num_nodes() << " nodes, " << g.num_edges() << " edges, "
+              << g.num_relations() << " relations" << (rev ? ", reverse" : "") << "\n"
+              << "warmup " << opt.warmup << ", reps " << opt.reps << ", batch " << opt.batch_size << ", fanouts "
+              << opt.fanout1 << "," << opt.fanout2 << ", dim " << opt.dim << ", threads " << opt.threads << "\n"
+              << std::left << std::setw(24) << "case" << std::right << std::setw(12) << "median ms"
+              << std::setw(12) << "p99 ms" << "  throughput\n";
+    for (const CaseResult& r : results) {
+        const double median = percentile(r.seconds, 50.0);
+        std::cout << std::left << std::setw(24) << r.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << median * 1e3 << std::setw(12) << percentile(r.seconds, 99.0) * 1e3
+                  << std::defaultfloat << std::setprecision(4) << "  "
+                  << (median > 0.0 ? r.items / median : 0.0) << " " << r.unit << "/s";
+        if (opt.perf) {
+            std::string unit = r.unit.substr(0, r.unit.size() - 1); // "edges" -> "edge"
+            std::cout << "  " << format_counters(perf, r.counters, r.items, unit);
+        }
+        std::cout << "\n";
+    }
+    if (opt.json.empty()) return true;
+
+    std::ofstream out(opt.json);
+    out << std::setprecision(9) << "{\n  \"schema\": 1,\n  \"graph\": {\"source\": "
+        << json_string(opt.data_given ? dir : "synthetic") << ", \"nodes\": " << g.num_nodes()
+        << ", \"edges\": " << g.num_edges() << ", \"relations\": " << g.num_relations()
+        << ", \"reverse\": " << (rev ? "true" : "false");
+    if (!opt.data_given) {
+        out << ", \"skew\": " << opt.synth.out_skew << ", \"rel_skew\": " << opt.synth.rel_skew
+            << ", \"seed\": " << opt.seed;
+    }
+    out << "},\n  \"config\": {\"warmup\": " << opt.warmup << ", \"reps\": " << opt.reps
+        << ", \"batch\": " << opt.batch_size << ", \"fanouts\": [" << opt.fanout1 << ", " << opt.fanout2
+        << "], \"dim\": " << opt.dim << ", \"negatives\": " << opt.negatives << ", \"threads\": " << opt.threads
+        << ", \"seed\": " << opt.seed << "},\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const CaseResult& r = results[i];
+        double mean = 0.0;
+        for (double x : r.seconds) mean += x;
+        if (!r.seconds.empty()) mean /= static_cast<double>(r.seconds.size());
+        const double median = percentile(r.seconds, 50.0);
+        out << (i ? "," : "") << "\n    {\"name\": " << json_string(r.name) << ", \"unit\": "
+            << json_string(r.unit) << ", \"items\": " << r.items << ", \"median_s\": " << median
+            << ", \"p99_s\": " << percentile(r.seconds, 99.0) << ", \"mean_s\": " << mean
+            << ", \"min_s\": " << (r.seconds.empty() ? 0.0 : r.seconds.front())
+            << ", \"max_s\": " << (r.seconds.empty() ? 0.0 : r.seconds.back())
+            << ", \"per_s\": " << (median > 0.0 ? r.items / median : 0.0);
+        if (perf.any()) {
+            out << ", \"counters\": {";
+            const char* sep = "";
+            for (size_t c = 0; c < kCounterCount; ++c) {
+                if (!perf.available(static_cast<Counter>(c))) continue;
+                out << sep << json_string(counter_name(static_cast<Counter>(c))) << ": " << r.counters.v[c];
+                sep = ", ";
+            }
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    if (!out) {
+        std::cerr << "Failed to write " << opt.json << "\n";
+        return false;
+    }
+    return true;
+}
+
+static int bench_suite(const BenchOptions& opt) {
+    std::string dir = opt.data_dir;
+    bool temp_dir = false;
+    if (!opt.data_given) {
+        if (!opt.synth_dir.empty()) {
+            dir = opt.synth_dir;
+            std::filesystem::create_directories(dir);
+        } else {
+            char templ[] = "/tmp/kg_benchXXXXXX";
+            if (!mkdtemp(templ)) {
+                std::cerr << "Failed to create a temporary graph directory\n";
+                return 1;
+            }
+            dir = templ;
+            temp_dir = true;
+        }
+        SynthConfig sc = opt.synth;
+        sc.seed = opt.seed;
+        sc.threads = opt.threads;
+        auto t0 = std::chrono::steady_clock::now();
+        if (!write_synthetic_graph(dir, sc)) return 1;
+        std::cout << "Generated " << sc.nodes << " nodes, " << sc.edges << " edges, " << sc.relations
+                  << " relations (skew " << sc.out_skew << ", rel_skew " << sc.rel_skew << ") in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() << " s\n";
+    }
+    int rc = 1;
+    {
+        CsrGraph g, rev;
+        const bool has_rev = file_exists(dir + "/offsets_rev.bin");
+        if (!g.load(dir) ||
+            (has_rev && !rev.load_custom(dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin", "entities.bin",
+                                         "props.bin", "delta_rev.bin"))) {
+            std::cerr << "Failed to load graph from " << dir << "\n";
+        } else {
+            rc = run_suite(opt, dir, g, has_rev ? &rev : nullptr) ? 0 : 1;
+        }
+    }
+    if (temp_dir) std::filesystem::remove_all(dir);
+    return rc;
+}
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+    if (opt.mode == "overlay") return bench_overlay(opt);
+    if (opt.mode == "compressed") return bench_compressed(opt);
+    if (opt.mode == "reorder") return bench_reorder(opt);
+    if (opt.mode == "mmap") return bench_mmap(opt);
+    if (opt.mode == "sampler") return bench_sampler(opt);
+    if (opt.mode == "suite") return bench_suite(opt);
+    print_usage();
+    return 1;
+}
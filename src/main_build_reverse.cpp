@@ -1,67 +1,75 @@
 #include "csr.hpp"
-#include "io.hpp"
+#include "reverse.hpp"
+#include "threadpool.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <vector>
 
-int main(int argc, char** argv) {
+struct ReverseOptions {
     std::string in_dir = "data";
     std::string out_dir = "data";
+    size_t threads = default_threads();
+    size_t mem_budget_mb = 1024;
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_build_reverse [--input data_dir] [--output rev_dir] [--threads T] "
+                 "[--mem_budget_mb MB]\n";
+}
+
+static bool parse_args(int argc, char** argv, ReverseOptions& opt) {
     for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
-        if ((arg == "--input" || arg == "-i") && i + 1 < argc) {
-            in_dir = argv[++i];
-        } else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
-            out_dir = argv[++i];
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--input" || a == "-i") && need(1)) {
+            opt.in_dir = argv[++i];
+        } else if ((a == "--output" || a == "-o") && need(1)) {
+            opt.out_dir = argv[++i];
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--mem_budget_mb" && need(1)) {
+            opt.mem_budget_mb = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else {
+            print_usage();
+            return false;
         }
     }
+    return true;
+}
 
-    CsrGraph g(in_dir);
-    if (!g.valid()) {
-        std::cerr << "Failed to load graph from " << in_dir << "\n";
-        return 1;
-    }
-    uint32_t n = g.num_nodes();
-    uint32_t m = g.num_edges();
-    std::vector<uint32_t> indeg(n + 1, 0);
-    for (uint32_t u = 1; u <= n; ++u) {
-        AdjView adj = g.neighbors(u);
-        for (uint32_t i = 0; i < adj.size; ++i) {
-            uint32_t v = adj.dst[i];
-            if (v <= n) ++indeg[v];
-        }
-    }
+int main(int argc, char** argv) {
+    ReverseOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
 
-    std::vector<uint32_t> offsets(n + 2, 0);
-    uint64_t cur = 0;
-    for (uint32_t v = 1; v <= n; ++v) {
-        offsets[v] = static_cast<uint32_t>(cur);
-        cur += indeg[v];
+    // The reverse of the base files; a forward delta log is mirrored by delta_rev.bin.
+    CsrGraph g;
+    if (!g.load_custom(opt.in_dir, "offsets.bin", "csr.bin", "rels.bin", "entities.bin", "props.bin", "")) {
+        std::cerr << "Failed to load graph from " << opt.in_dir << "\n";
+        return 1;
     }
-    offsets[n + 1] = static_cast<uint32_t>(cur);
-
-    std::vector<uint32_t> csr(m, 0);
-    std::vector<uint16_t> rels(m, 0);
-    std::vector<uint32_t> cursor(n + 1, 0);
-    for (uint32_t v = 1; v <= n; ++v) cursor[v] = offsets[v];
+    size_t passes = 0;
+    if (!write_reverse_csr(g, opt.out_dir, opt.threads, opt.mem_budget_mb << 20, &passes)) return 1;
 
-    for (uint32_t u = 1; u <= n; ++u) {
-        AdjView adj = g.neighbors(u);
-        for (uint32_t i = 0; i < adj.size; ++i) {
-            uint32_t v = adj.dst[i];
-            uint16_t r = adj.rel[i];
-            uint32_t pos = cursor[v]++;
-            csr[pos] = u;
-            rels[pos] = r;
+    // load_custom needs the dictionaries next to the reverse files.
+    namespace fs = std::filesystem;
+    if (!fs::equivalent(opt.in_dir, opt.out_dir)) {
+        std::error_code ec;
+        for (const char* name : {"entities.bin", "props.bin"}) {
+            fs::copy_file(opt.in_dir + "/" + name, opt.out_dir + "/" + name,
+                          fs::copy_options::overwrite_existing, ec);
+            if (ec) {
+                std::cerr << "Failed to copy " << name << " to " << opt.out_dir << ": " << ec.message() << "\n";
+                return 1;
+            }
         }
     }
 
-    if (!write_array(out_dir + "/offsets_rev.bin", offsets)) return 1;
-    if (!write_array(out_dir + "/csr_rev.bin", csr)) return 1;
-    if (!write_array(out_dir + "/rels_rev.bin", rels)) return 1;
-
-    std::cout << "Reverse CSR written to " << out_dir << " (nodes=" << n << " edges=" << m << ")\n";
+    std::cout << "Reverse CSR written to " << opt.out_dir << " (nodes=" << g.num_nodes() << " edges=" << g.num_edges()
+              << " passes=" << passes << ")\n";
     return 0;
 }
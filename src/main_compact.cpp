@@ -0,0 +1,348 @@
+#include "csr.hpp"
+#include "delta.hpp"
+#include "io.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/file.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct CompactOptions {
+    std::string data_dir = "data";
+    std::string reverse_dir;
+    std::string apply;
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_compact [--data data_dir] [--reverse rev_dir] [--apply edits.txt]\n"
+                 "  --apply appends the edits (lines \"+ Q42 P31 Q5\" / \"- Q42 P31 Q5\") to the delta log.\n"
+                 "  Without --apply, folds the delta log into new base files.\n";
+}
+
+static bool parse_args(int argc, char** argv, CompactOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--data" || a == "-d") && need(1)) {
+            opt.data_dir = argv[++i];
+        } else if (a == "--reverse" && need(1)) {
+            opt.reverse_dir = argv[++i];
+        } else if (a == "--apply" && need(1)) {
+            opt.apply = argv[++i];
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Exclusive flock on "<data_dir>/delta.lock". --apply holds it for its whole
+// run and a fold from its final size check until the logs are retired, so no
+// edit is appended to a log that is being folded. The lock is a separate file
+// because the logs themselves are unlinked when they are retired.
+class DeltaLock {
+public:
+    explicit DeltaLock(const std::string& data_dir) {
+        const std::string path = data_dir + "/delta.lock";
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ >= 0 && flock(fd_, LOCK_EX) != 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        if (fd_ < 0) std::cerr << "Failed to lock " << path << ": " << strerror(errno) << "\n";
+    }
+    ~DeltaLock() {
+        if (fd_ >= 0) close(fd_);
+    }
+    DeltaLock(const DeltaLock&) = delete;
+    DeltaLock& operator=(const DeltaLock&) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+
+private:
+    int fd_ = -1;
+};
+
+static void sync_dir(const std::string& dir) {
+    int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+}
+
+// A directory a fold rewrites: its delta log and the base files staged for it.
+struct FoldDir {
+    std::string dir;
+    std::string log;
+    std::string packed; // kg_compress output stem, "<packed>.cbin/.cidx"
+    std::vector<std::string> files;
+};
+
+static std::vector<FoldDir> fold_dirs(const CompactOptions& opt) {
+    std::vector<FoldDir> dirs = {
+        {opt.data_dir, "delta.bin", "csr", {"offsets.bin", "csr.bin", "rels.bin", "entities.bin", "props.bin"}}};
+    if (!opt.reverse_dir.empty()) {
+        FoldDir rev{opt.reverse_dir, "delta_rev.bin", "csr_rev", {"offsets_rev.bin", "csr_rev.bin", "rels_rev.bin"}};
+        if (opt.reverse_dir != opt.data_dir) {
+            rev.files.push_back("entities.bin");
+            rev.files.push_back("props.bin");
+        }
+        dirs.push_back(rev);
+    }
+    return dirs;
+}
+
+// Second half of a fold, once "<log>.folding" marks every log as contained in
+// the complete staged "<file>.compact" files: drops compressed adjacency
+// encoded from the old base, installs the staged files, then retires the logs
+// and their dictionaries, then the marks. CsrGraph skips a
+// marked log whose staged files are all installed, so a crash at any point
+// leaves a graph that loads as either the old base plus its log or the new
+// base, and kg_compact runs this again to finish.
+static bool finish_fold(const std::vector<FoldDir>& dirs) {
+    for (const FoldDir& d : dirs) {
+        remove_packed(d.dir, d.packed);
+        for (const std::string& f : d.files) {
+            const std::string path = d.dir + "/" + f;
+            if (file_exists(path + ".compact") && std::rename((path + ".compact").c_str(), path.c_str()) != 0) {
+                std::cerr << "Failed to install " << path << ": " << strerror(errno) << "\n";
+                return false;
+            }
+        }
+        sync_dir(d.dir);
+    }
+    for (const FoldDir& d : dirs) unlink((d.dir + "/" + d.log).c_str());
+    for (const FoldDir& d : dirs) {
+        unlink((d.dir + "/delta_entities.bin").c_str());
+        unlink((d.dir + "/delta_props.bin").c_str());
+        unlink((d.dir + "/" + d.log + ".folding").c_str());
+        sync_dir(d.dir);
+    }
+    return true;
+}
+
+// Finishes a fold that stopped after marking its logs. Call with the lock held.
+static bool recover_fold(const CompactOptions& opt) {
+    const std::vector<FoldDir> dirs = fold_dirs(opt);
+    bool marked = false;
+    for (const FoldDir& d : dirs) marked = marked || file_exists(d.dir + "/" + d.log + ".folding");
+    if (!marked) return true;
+    std::cout << "Finishing an interrupted fold\n";
+    return finish_fold(dirs);
+}
+
+static bool load_graphs(const CompactOptions& opt, CsrGraph& fwd, CsrGraph& rev) {
+    if (!fwd.load(opt.data_dir)) {
+        std::cerr << "Failed to load graph from " << opt.data_dir << "\n";
+        return false;
+    }
+    if (!opt.reverse_dir.empty() &&
+        !rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                         "entities.bin", "props.bin", "delta_rev.bin")) {
+        std::cerr << "Failed to load reverse graph from " << opt.reverse_dir << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Accepts "Q42", "P31" or bare numbers.
+static bool parse_id(const std::string& tok, char prefix, uint32_t& out) {
+    size_t start = (!tok.empty() && (tok[0] == prefix || tok[0] == prefix + 32)) ? 1 : 0;
+    if (start >= tok.size()) return false;
+    uint64_t v = 0;
+    for (size_t i = start; i < tok.size(); ++i) {
+        if (tok[i] < '0' || tok[i] > '9') return false;
+        v = v * 10 + static_cast<uint64_t>(tok[i] - '0');
+        if (v > 0xffffffffull) return false;
+    }
+    out = static_cast<uint32_t>(v);
+    return true;
+}
+
+struct Edit {
+    bool add;
+    uint32_t s, p, o;
+};
+
+static int apply_edits(const CompactOptions& opt) {
+    std::ifstream in(opt.apply);
+    if (!in) {
+        std::cerr << "Failed to open " << opt.apply << "\n";
+        return 1;
+    }
+    std::vector<Edit> edits;
+    std::unordered_map<uint32_t, uint32_t> qids, pids; // original -> internal (0 = unknown)
+    std::string line;
+    size_t bad = 0;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string op, s, p, o;
+        Edit e;
+        if (!(ls >> op >> s >> p >> o) || (op != "+" && op != "-") || !parse_id(s, 'Q', e.s) ||
+            !parse_id(p, 'P', e.p) || !parse_id(o, 'Q', e.o) || e.p > 0xffff) {
+            if (!line.empty() && line[0] != '#') ++bad;
+            continue;
+        }
+        e.add = op == "+";
+        qids.emplace(e.s, 0);
+        qids.emplace(e.o, 0);
+        pids.emplace(e.p, 0);
+        edits.push_back(e);
+    }
+
+    DeltaLock lock(opt.data_dir);
+    if (!lock.ok()) return 1;
+    CsrGraph fwd, rev;
+    if (!load_graphs(opt, fwd, rev)) return 1;
+
+    // One pass over the dictionaries resolves only the IDs the edits mention.
+    for (uint32_t v = 1; v <= fwd.num_nodes(); ++v) {
+        auto it = qids.find(fwd.entity_of(v));
+        if (it != qids.end() && it->second == 0) it->second = v;
+    }
+    for (uint32_t r = 1; r <= fwd.num_relations(); ++r) {
+        auto it = pids.find(fwd.prop_of(r));
+        if (it != pids.end() && it->second == 0) it->second = r;
+    }
+
+    std::vector<uint32_t> new_entities;
+    std::vector<uint16_t> new_props;
+    std::vector<DeltaRecord> recs, recs_rev;
+    size_t skipped = 0;
+    for (const Edit& e : edits) {
+        uint32_t& s = qids[e.s];
+        uint32_t& o = qids[e.o];
+        uint32_t& p = pids[e.p];
+        if (!e.add && (!s || !o || !p)) {
+            ++skipped;
+            continue;
+        }
+        if (!s) {
+            s = fwd.num_nodes() + static_cast<uint32_t>(new_entities.size()) + 1;
+            new_entities.push_back(e.s);
+        }
+        if (!o) {
+            o = fwd.num_nodes() + static_cast<uint32_t>(new_entities.size()) + 1;
+            new_entities.push_back(e.o);
+        }
+        if (!p) {
+            if (fwd.num_relations() + new_props.size() >= 0xffff) {
+                std::cerr << "Relation ID space exhausted\n";
+                return 1;
+            }
+            p = fwd.num_relations() + static_cast<uint32_t>(new_props.size()) + 1;
+            new_props.push_back(static_cast<uint16_t>(e.p));
+        }
+        uint16_t op = static_cast<uint16_t>(e.add ? DeltaOp::Add : DeltaOp::Remove);
+        recs.push_back({s, o, static_cast<uint16_t>(p), op});
+        recs_rev.push_back({o, s, static_cast<uint16_t>(p), op});
+    }
+
+    // Dictionaries first, so no record ever refers to an entity that is not on disk.
+    std::vector<std::string> dirs = {opt.data_dir};
+    if (!opt.reverse_dir.empty() && opt.reverse_dir != opt.data_dir) dirs.push_back(opt.reverse_dir);
+    for (const std::string& dir : dirs) {
+        if (!append_array(dir + "/delta_entities.bin", new_entities) ||
+            !append_array(dir + "/delta_props.bin", new_props)) {
+            return 1;
+        }
+    }
+    if (!append_delta(opt.data_dir + "/delta.bin", recs)) return 1;
+    if (!opt.reverse_dir.empty() && !append_delta(opt.reverse_dir + "/delta_rev.bin", recs_rev)) return 1;
+
+    std::cout << "Applied " << recs.size() << " edits (" << new_entities.size() << " new entities, "
+              << new_props.size() << " new properties, " << skipped << " removals of unknown edges, "
+              << bad << " unparsable lines)\n";
+    return 0;
+}
+
+// Folds the delta into new base files. Everything is written under
+// "<name>.compact" first; processes that already mapped the old files keep
+// reading them, since renaming over a mapped file does not affect the mapping.
+static int fold(const CompactOptions& opt) {
+    CsrGraph fwd, rev;
+    if (!load_graphs(opt, fwd, rev)) return 1;
+    const bool has_rev = !opt.reverse_dir.empty();
+    const std::string fwd_delta = opt.data_dir + "/delta.bin";
+    const std::string rev_delta = has_rev ? opt.reverse_dir + "/delta_rev.bin" : std::string();
+    if (fwd.delta_records() == 0 && (!has_rev || rev.delta_records() == 0)) {
+        std::cout << "No delta to fold\n";
+        return 0;
+    }
+    const size_t fwd_bytes = file_size(fwd_delta);
+    const size_t rev_bytes = has_rev ? file_size(rev_delta) : 0;
+
+    std::vector<std::pair<std::string, std::string>> staged;
+    auto stage = [&](const std::string& dir, const std::string& name) {
+        std::string path = dir + "/" + name;
+        staged.emplace_back(path + ".compact", path);
+        return path + ".compact";
+    };
+    bool ok = write_merged_csr(fwd, stage(opt.data_dir, "offsets.bin"), stage(opt.data_dir, "csr.bin"),
+                               stage(opt.data_dir, "rels.bin")) &&
+              write_merged_dictionaries(fwd, stage(opt.data_dir, "entities.bin"),
+                                        stage(opt.data_dir, "props.bin"));
+    if (ok && has_rev) {
+        ok = write_merged_csr(rev, stage(opt.reverse_dir, "offsets_rev.bin"),
+                              stage(opt.reverse_dir, "csr_rev.bin"), stage(opt.reverse_dir, "rels_rev.bin"));
+        if (ok && opt.reverse_dir != opt.data_dir) {
+            ok = write_merged_dictionaries(rev, stage(opt.reverse_dir, "entities.bin"),
+                                           stage(opt.reverse_dir, "props.bin"));
+        }
+    }
+    if (!ok) {
+        for (const auto& [tmp, final_path] : staged) unlink(tmp.c_str());
+        return 1;
+    }
+
+    DeltaLock lock(opt.data_dir);
+    // Edits appended while we were writing are not in the staged files; with
+    // the lock held no more can arrive.
+    if (!lock.ok() || file_size(fwd_delta) != fwd_bytes || (has_rev && file_size(rev_delta) != rev_bytes)) {
+        if (lock.ok()) std::cerr << "Delta log grew during compaction; rerun kg_compact\n";
+        for (const auto& [tmp, final_path] : staged) unlink(tmp.c_str());
+        return 1;
+    }
+    // Mark each log as folded into the staged files before anything is
+    // installed, so that a crash from here on is finished rather than lost.
+    const std::vector<FoldDir> dirs = fold_dirs(opt);
+    for (const FoldDir& d : dirs) {
+        const std::string log = d.dir + "/" + d.log;
+        const std::string mark = log + ".folding";
+        const bool marked = file_exists(log) ? link(log.c_str(), mark.c_str()) == 0
+                                             : write_array(mark, std::vector<uint32_t>());
+        if (!marked) {
+            std::cerr << "Failed to mark " << log << " as folding: " << strerror(errno) << "\n";
+            for (const FoldDir& m : dirs) unlink((m.dir + "/" + m.log + ".folding").c_str());
+            for (const auto& [tmp, final_path] : staged) unlink(tmp.c_str());
+            return 1;
+        }
+        sync_dir(d.dir);
+    }
+    if (!finish_fold(dirs)) return 1;
+
+    std::cout << "Folded " << fwd.delta_records() << " delta records: nodes=" << fwd.num_nodes()
+              << " edges=" << fwd.num_edges() << " rels=" << fwd.num_relations() << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    CompactOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+    {
+        DeltaLock lock(opt.data_dir);
+        if (!lock.ok() || !recover_fold(opt)) return 1;
+    }
+    return opt.apply.empty() ? fold(opt) : apply_edits(opt);
+}
@@ -0,0 +1,166 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "packed_adj.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct CompressOptions {
+    std::string data_dir = "data";
+    std::string reverse_dir;
+    bool verify = false;
+    size_t threads = default_threads();
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_compress [--data data_dir] [--reverse rev_dir] [--verify] [--threads T]\n"
+                 "Writes csr.cbin/csr.cidx (and csr_rev.cbin/csr_rev.cidx) next to the raw files.\n"
+                 "--verify checks existing ones against the raw contents instead.\n";
+}
+
+static bool parse_args(int argc, char** argv, CompressOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--data" || a == "-d") && need(1)) {
+            opt.data_dir = argv[++i];
+        } else if (a == "--reverse" && need(1)) {
+            opt.reverse_dir = argv[++i];
+        } else if (a == "--verify") {
+            opt.verify = true;
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Encodes node ranges of ~kBatchEdges edges, split across threads, and appends
+// them in node order so memory stays bounded by the batch.
+static bool compress(const std::string& dir, const std::string& offsets_file, const std::string& csr_file,
+                     const std::string& rels_file, const std::string& stem, size_t threads) {
+    constexpr uint64_t kBatchEdges = uint64_t(1) << 24;
+    CsrGraph g;
+    g.set_adjacency_format(AdjFormat::Raw);
+    if (!g.load_custom(dir, offsets_file, csr_file, rels_file, "entities.bin", "props.bin", "")) {
+        std::cerr << "Failed to load " << dir << "/" << csr_file << "\n";
+        return false;
+    }
+    const uint32_t n = g.num_nodes();
+
+    // The index header ties the blob to the raw files it was encoded from.
+    PackedIndexHeader header{kPackedIndexMagic, g.num_edges(), 0, 0, file_stamp(dir + "/" + offsets_file),
+                             file_stamp(dir + "/" + csr_file), file_stamp(dir + "/" + rels_file)};
+    if (g.num_edges() > 0) {
+        MMapArray<uint32_t> offsets, csr;
+        MMapArray<uint16_t> rels;
+        const bool mapped = map_array(dir + "/" + offsets_file, offsets) && map_array(dir + "/" + csr_file, csr) &&
+                            map_array(dir + "/" + rels_file, rels);
+        if (mapped) header.raw_checksum = raw_csr_checksum(offsets.data, offsets.size, csr.data, rels.data, csr.size);
+        unmap(offsets.base);
+        unmap(csr.base);
+        unmap(rels.base);
+        if (!mapped) return false;
+    }
+    const std::string cbin = dir + "/" + stem + ".cbin";
+    const std::string cidx = dir + "/" + stem + ".cidx";
+    int fd = ::open((cbin + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << cbin << ".tmp\n";
+        return false;
+    }
+
+    std::vector<uint64_t> index(kPackedIndexHeaderWords + static_cast<size_t>(n) + 2, 0);
+    std::memcpy(index.data(), &header, sizeof(header));
+    uint64_t* node_index = index.data() + kPackedIndexHeaderWords;
+    std::vector<std::vector<uint8_t>> parts(threads);
+    std::vector<std::vector<uint64_t>> local(threads);
+    uint64_t written = 0;
+    bool ok = true;
+    for (uint32_t lo = 1; lo <= n && ok;) {
+        uint32_t hi = lo;
+        uint64_t edges = 0;
+        while (hi <= n && (edges < kBatchEdges || hi == lo)) edges += g.out_degree(hi++);
+        parallel_for(0, threads, threads, [&](size_t t) {
+            uint32_t b = lo + static_cast<uint32_t>(uint64_t(hi - lo) * t / threads);
+            uint32_t e = lo + static_cast<uint32_t>(uint64_t(hi - lo) * (t + 1) / threads);
+            parts[t].clear();
+            local[t].clear();
+            for (uint32_t u = b; u < e; ++u) {
+                local[t].push_back(parts[t].size());
+                AdjView adj = g.neighbors(u);
+                packed_encode(adj.dst, adj.rel, adj.size, parts[t]);
+            }
+        });
+        uint32_t u = lo;
+        for (size_t t = 0; t < threads && ok; ++t) {
+            for (uint64_t off : local[t]) node_index[u++] = written + off;
+            ok = write_all(fd, parts[t].data(), parts[t].size());
+            written += parts[t].size();
+        }
+        lo = hi;
+    }
+    node_index[n + 1] = written;
+    std::vector<uint8_t> pad(kPackedPadding, 0);
+    ok = ok && write_all(fd, pad.data(), pad.size()) && fsync(fd) == 0;
+    close(fd);
+    ok = ok && write_array(cidx + ".tmp", index) && std::rename((cbin + ".tmp").c_str(), cbin.c_str()) == 0 &&
+         std::rename((cidx + ".tmp").c_str(), cidx.c_str()) == 0;
+    if (!ok) {
+        std::cerr << "Failed to write " << cbin << "\n";
+        return false;
+    }
+    const uint64_t raw = static_cast<uint64_t>(g.num_edges()) * (sizeof(uint32_t) + sizeof(uint16_t));
+    const uint64_t packed = written + kPackedPadding + index.size() * sizeof(uint64_t);
+    std::cout << cbin << ": edges=" << g.num_edges() << " raw=" << raw << "B packed=" << packed << "B ("
+              << (g.num_edges() ? static_cast<double>(packed) / g.num_edges() : 0.0) << " B/edge incl. index)\n";
+    return true;
+}
+
+// Recomputes the checksum of the raw files and compares it with the one the
+// index header recorded, which loading does not do.
+static bool verify(const std::string& dir, const std::string& offsets_file, const std::string& csr_file,
+                   const std::string& rels_file, const std::string& stem) {
+    const std::string cidx = dir + "/" + stem + ".cidx";
+    MMapArray<uint64_t> index;
+    MMapArray<uint32_t> offsets, csr;
+    MMapArray<uint16_t> rels;
+    PackedIndexHeader header{};
+    bool ok = map_array(cidx, index) && index.size >= kPackedIndexHeaderWords;
+    if (ok) std::memcpy(&header, index.data, sizeof(header));
+    ok = ok && header.magic == kPackedIndexMagic && map_array(dir + "/" + offsets_file, offsets) &&
+         map_array(dir + "/" + csr_file, csr) && map_array(dir + "/" + rels_file, rels) && csr.size == rels.size &&
+         header.edges == csr.size &&
+         raw_csr_checksum(offsets.data, offsets.size, csr.data, rels.data, csr.size) == header.raw_checksum;
+    for (MMapArrayBase* base : {&index.base, &offsets.base, &csr.base, &rels.base}) unmap(*base);
+    std::cout << cidx << (ok ? ": matches " : ": does not match ") << dir << "/" << csr_file << "\n";
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    CompressOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+    if (opt.verify) {
+        bool ok = verify(opt.data_dir, "offsets.bin", "csr.bin", "rels.bin", "csr");
+        if (!opt.reverse_dir.empty()) {
+            ok = verify(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin", "csr_rev") && ok;
+        }
+        return ok ? 0 : 1;
+    }
+    if (!compress(opt.data_dir, "offsets.bin", "csr.bin", "rels.bin", "csr", opt.threads)) return 1;
+    if (!opt.reverse_dir.empty() &&
+        !compress(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin", "csr_rev", opt.threads)) {
+        return 1;
+    }
+    return 0;
+}
@@ -1,10 +1,14 @@
 #include "checkpoint.hpp"
+#include "config_file.hpp"
 #include "csr.hpp"
 #include "decoder.hpp"
 #include "encoder.hpp"
 #include "io.hpp"
+#include "memory.hpp"
 #include "metrics.hpp"
 #include "features.hpp"
+#include "inference.hpp"
+#include "perf_counters.hpp"
 #include "rng.hpp"
 
 #include <cmath>
@@ -19,9 +23,18 @@ struct EvalOptions {
     std::string data_dir = "data";
     std::string reverse_dir;
     std::string checkpoint;
+    std::string features; // default: <data>/features.bin when the checkpoint uses stored features
     std::string eval_file;
     std::string train_file;
     size_t batch_nodes = 1024;
+    InferenceMode inference = InferenceMode::Full;
+    std::string cache;
+    std::string spill_dir;
+    size_t mem_budget_mb = 0;
+    size_t threads = default_threads();
+    size_t chunk_nodes = 1024;
+    bool verify_checkpoint = false;
+    bool perf = false; // hardware counters around the cache build and scoring
     uint64_t seed = 99;
 };
 
@@ -41,6 +54,24 @@ static bool parse_args(int argc, char** argv, EvalOptions& opt) {
             opt.train_file = argv[++i];
         } else if (a == "--batch_nodes" && need(1)) {
             opt.batch_nodes = std::stoul(argv[++i]);
+        } else if (a == "--inference" && need(1)) {
+            if (!parse_inference_mode(argv[++i], opt.inference)) return false;
+        } else if (a == "--cache" && need(1)) {
+            opt.cache = argv[++i];
+        } else if (a == "--spill_dir" && need(1)) {
+            opt.spill_dir = argv[++i];
+        } else if (a == "--mem_budget_mb" && need(1)) {
+            opt.mem_budget_mb = std::stoul(argv[++i]);
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--chunk_nodes" && need(1)) {
+            opt.chunk_nodes = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--features" && need(1)) {
+            opt.features = argv[++i];
+        } else if (a == "--verify_checkpoint") {
+            opt.verify_checkpoint = true;
+        } else if (a == "--perf") {
+            opt.perf = true;
         } else if (a == "--seed" && need(1)) {
             opt.seed = std::stoull(argv[++i]);
         } else {
@@ -50,29 +81,6 @@ static bool parse_args(int argc, char** argv, EvalOptions& opt) {
     return !opt.checkpoint.empty() && !opt.eval_file.empty();
 }
 
-static std::vector<float> build_cache(Encoder& enc, const CsrGraph& g, const CsrGraph* rev,
-                                      size_t dim, size_t batch_nodes, XorShift128Plus& rng) {
-    std::vector<float> cache(static_cast<size_t>(g.num_nodes()) * dim, 0.0f);
-    for (uint32_t start = 1; start <= g.num_nodes(); start += batch_nodes) {
-        uint32_t end = std::min<uint32_t>(g.num_nodes(), start + batch_nodes - 1);
-        std::vector<uint32_t> seeds;
-        seeds.reserve(end - start + 1);
-        for (uint32_t v = start; v <= end; ++v) seeds.push_back(v);
-        EncoderState st = enc.forward(g, rev, seeds, rng);
-        const auto& map = st.index_per_layer.back();
-        const auto& emb = st.h_layers.back();
-        for (uint32_t v : seeds) {
-            auto it = map.find(v);
-            if (it == map.end()) continue;
-            size_t idx = it->second;
-            std::memcpy(&cache[(static_cast<size_t>(v - 1)) * dim],
-                        &emb[idx * dim],
-                        sizeof(float) * dim);
-        }
-    }
-    return cache;
-}
-
 static void add_truths(const MMapArray<Triple>& triples,
                        std::unordered_map<uint64_t, std::unordered_set<uint32_t>>& truth) {
     for (size_t i = 0; i < triples.size; ++i) {
@@ -83,9 +91,14 @@ static void add_truths(const MMapArray<Triple>& triples,
 }
 
 int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    if (!expand_config_args(argc, argv, "inference", args)) return 1;
+    std::vector<char*> arg_ptrs = arg_pointers(args);
+    argc = static_cast<int>(args.size());
+    argv = arg_ptrs.data();
     EvalOptions opt;
     if (!parse_args(argc, argv, opt)) {
-        std::cerr << "Usage: kg_eval --checkpoint ckpt --eval eval.bin [--train train.bin] [--data dir] [--reverse dir]\n";
+        std::cerr << "Usage: kg_eval --checkpoint ckpt --eval eval.bin [--train train.bin] [--data dir] [--reverse dir] [--features features.bin] [--verify_checkpoint] [--inference full|fanout|batched] [--cache emb.bin] [--spill_dir dir] [--mem_budget_mb MB] [--threads T] [--chunk_nodes N] [--perf] [--config tuned.conf]\n";
         return 1;
     }
 
@@ -97,7 +110,8 @@ int main(int argc, char** argv) {
     CsrGraph* rev_ptr = nullptr;
     CsrGraph rev;
     if (!opt.reverse_dir.empty()) {
-        if (rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin")) {
+        if (rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                            "entities.bin", "props.bin", "delta_rev.bin")) {
             rev_ptr = &rev;
         }
     }
@@ -112,26 +126,58 @@ int main(int argc, char** argv) {
         map_triples(opt.train_file, train_q);
     }
 
-    CheckpointMeta meta;
-    std::vector<std::vector<float>> params, m, v;
-    if (!load_checkpoint(opt.checkpoint, meta, params, m, v)) {
+    CheckpointView ckpt;
+    if (!ckpt.open(opt.checkpoint)) {
         std::cerr << "Failed to load checkpoint\n";
         return 1;
     }
+    if (opt.verify_checkpoint && !ckpt.verify()) {
+        std::cerr << "Checkpoint checksum mismatch\n";
+        return 1;
+    }
+    CheckpointMeta meta = ckpt.meta();
     FeatureConfig fcfg = meta.feat_cfg;
     if (meta.enc_cfg.fanouts.empty()) meta.enc_cfg.fanouts.resize(meta.enc_cfg.layers, 10);
 
-    XorShift128Plus rng(opt.seed);
     Encoder encoder(meta.feature_dim ? meta.feature_dim : feature_dim(fcfg, rev_ptr != nullptr),
-                    g.num_relations(), meta.enc_cfg, fcfg, rng);
-    Decoder decoder(g.num_relations(), meta.enc_cfg.hidden_dim, encoder.relation_embeddings(), rng);
-    auto enc_params = encoder.parameters();
-    auto dec_params = decoder.parameters();
-    std::vector<Parameter*> all_params = enc_params;
-    all_params.insert(all_params.end(), dec_params.begin(), dec_params.end());
-    assign_parameters(params, all_params);
+                    g.num_relations(), meta.enc_cfg, fcfg);
+    Decoder decoder(g.num_relations(), meta.enc_cfg.hidden_dim, encoder.relation_embeddings());
+    if (!bind_checkpoint(ckpt, encoder, decoder)) {
+        std::cerr << "Checkpoint does not match the graph\n";
+        return 1;
+    }
+    FeatureStore store;
+    if (!fcfg.columns.empty()) {
+        if (!open_feature_store(opt.features.empty() ? opt.data_dir + "/features.bin" : opt.features, fcfg,
+                                store)) {
+            return 1;
+        }
+        encoder.set_feature_store(&store);
+    }
 
-    std::vector<float> cache = build_cache(encoder, g, rev_ptr, encoder.output_dim(), opt.batch_nodes, rng);
+    InferenceConfig icfg;
+    icfg.mode = opt.inference;
+    icfg.batch_nodes = opt.batch_nodes;
+    icfg.seed = opt.seed;
+    icfg.threads = opt.threads;
+    icfg.chunk_nodes = opt.chunk_nodes;
+    icfg.cache = opt.cache;
+    icfg.spill_dir = opt.spill_dir;
+    icfg.mem_budget = opt.mem_budget_mb << 20;
+    MemoryAccount memory;
+    icfg.memory = &memory;
+    PerfCounters perf;
+    if (opt.perf) {
+        perf.open();
+        std::cout << "Perf " << perf.status() << "\n";
+    }
+    CounterValues c0 = perf.read();
+    EmbeddingTable cache;
+    if (!node_embeddings(encoder, g, rev_ptr, icfg, ckpt.checksum(), cache)) return 1;
+    CounterValues c1 = perf.read();
+    std::cout << "Memory: ";
+    print_memory_report(std::cout, memory);
+    std::cout << "\n";
     const float* rel_emb = encoder.relation_embeddings()->data.data();
 
     std::unordered_map<uint64_t, std::unordered_set<uint32_t>> truth;
@@ -143,26 +189,20 @@ int main(int argc, char** argv) {
     for (size_t i = 0; i < eval_q.size; ++i) {
         const Triple& q = eval_q[i];
         if (q.h == 0 || q.r == 0 || q.t == 0) continue;
-        const float* h = &cache[(static_cast<size_t>(q.h - 1)) * dim];
-        const float* t_true = &cache[(static_cast<size_t>(q.t - 1)) * dim];
-        const float* rvec = &rel_emb[static_cast<size_t>(q.r) * dim];
-        float true_score = 0.0f;
-        for (size_t d = 0; d < dim; ++d) true_score += h[d] * rvec[d] * t_true[d];
-
-        size_t rank = 1;
-        for (uint32_t cand = 1; cand <= g.num_nodes(); ++cand) {
-            if (cand == q.t) continue;
-            uint64_t key = (static_cast<uint64_t>(q.h) << 32) | q.r;
-            auto it = truth.find(key);
-            if (it != truth.end() && it->second.count(cand)) continue;
-            const float* t = &cache[(cand - 1) * dim];
-            float score = 0.0f;
-            for (size_t d = 0; d < dim; ++d) score += h[d] * rvec[d] * t[d];
-            if (score > true_score) ++rank;
-        }
+        auto it = truth.find((static_cast<uint64_t>(q.h) << 32) | q.r);
+        const std::unordered_set<uint32_t>* known = it != truth.end() ? &it->second : nullptr;
+        size_t rank = tail_rank(cache.row(1), g.num_nodes(), dim, cache.row(q.h),
+                                &rel_emb[static_cast<size_t>(q.r) * dim], q.t, known);
         accumulate_rank(metrics, rank);
     }
     finalize_metrics(metrics);
+    if (opt.perf) {
+        CounterValues c2 = perf.read();
+        std::cout << "  cache: " << format_counters(perf, c1 - c0, g.num_nodes(), "node") << "\n"
+                  << "  scoring: "
+                  << format_counters(perf, c2 - c1, static_cast<double>(metrics.count) * g.num_nodes(), "candidate")
+                  << "\n";
+    }
 
     std::cout << "MRR=" << metrics.mrr << " Hits@1=" << metrics.hits1
               << " Hits@3=" << metrics.hits3 << " Hits@10=" << metrics.hits10
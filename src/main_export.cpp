@@ -0,0 +1,71 @@
+#include "checkpoint.hpp"
+#include "io.hpp"
+
+#include <iostream>
+#include <string>
+
+struct ExportOptions {
+    std::string checkpoint;
+    std::string output;
+    ExportPrecision precision = ExportPrecision::F32;
+    bool verify_checkpoint = false;
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_export --checkpoint ckpt.bin --output serving.bin "
+                 "[--quantize none|fp16|bf16|int8] [--verify_checkpoint]\n";
+}
+
+static bool parse_args(int argc, char** argv, ExportOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--checkpoint" || a == "-c") && need(1)) {
+            opt.checkpoint = argv[++i];
+        } else if ((a == "--output" || a == "-o") && need(1)) {
+            opt.output = argv[++i];
+        } else if (a == "--quantize" && need(1)) {
+            std::string v = argv[++i];
+            if (v == "none") opt.precision = ExportPrecision::F32;
+            else if (v == "fp16") opt.precision = ExportPrecision::F16;
+            else if (v == "bf16") opt.precision = ExportPrecision::BF16;
+            else if (v == "int8") opt.precision = ExportPrecision::I8;
+            else {
+                print_usage();
+                return false;
+            }
+        } else if (a == "--verify_checkpoint") {
+            opt.verify_checkpoint = true;
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    if (opt.checkpoint.empty() || opt.output.empty()) {
+        print_usage();
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ExportOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+
+    CheckpointView ckpt;
+    if (!ckpt.open(opt.checkpoint)) {
+        std::cerr << "Failed to load checkpoint\n";
+        return 1;
+    }
+    if (opt.verify_checkpoint && !ckpt.verify()) {
+        std::cerr << "Checkpoint checksum mismatch\n";
+        return 1;
+    }
+    if (!export_checkpoint(ckpt, opt.output, opt.precision)) {
+        std::cerr << "Failed to write serving checkpoint\n";
+        return 1;
+    }
+    std::cout << "Serving checkpoint written to " << opt.output << " (" << file_size(opt.checkpoint)
+              << " -> " << file_size(opt.output) << " bytes)\n";
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "csr.hpp"
+#include "features.hpp"
+#include "io.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+struct FeaturesOptions {
+    std::string data_dir = "data";
+    std::string reverse_dir;
+    std::string output; // default: <data>/features.bin
+    std::string columns = "out_degree,in_degree,rel_out=16,rel_in=16,class=16";
+    FeatureDtype dtype = FeatureDtype::F32;
+    size_t threads = default_threads();
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_features [--data data_dir] [--reverse rev_dir] [--output features.bin] "
+                 "[--columns SPEC] [--dtype f32|f16] [--threads T]\n"
+                 "  SPEC: comma list of out_degree, in_degree, rel_out=K, rel_in=K, class=K\n"
+                 "        (in_degree and rel_in need --reverse; default "
+                 "out_degree,in_degree,rel_out=16,rel_in=16,class=16)\n";
+}
+
+static bool parse_args(int argc, char** argv, FeaturesOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--data" || a == "-d") && need(1)) {
+            opt.data_dir = argv[++i];
+        } else if (a == "--reverse" && need(1)) {
+            opt.reverse_dir = argv[++i];
+        } else if ((a == "--output" || a == "-o") && need(1)) {
+            opt.output = argv[++i];
+        } else if (a == "--columns" && need(1)) {
+            opt.columns = argv[++i];
+        } else if (a == "--dtype" && need(1)) {
+            std::string v = argv[++i];
+            if (v != "f32" && v != "f16") {
+                print_usage();
+                return false;
+            }
+            opt.dtype = v == "f16" ? FeatureDtype::F16 : FeatureDtype::F32;
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    if (opt.output.empty()) opt.output = opt.data_dir + "/features.bin";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    FeaturesOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+
+    auto t0 = std::chrono::steady_clock::now();
+    CsrGraph g(opt.data_dir);
+    if (!g.valid()) {
+        std::cerr << "Failed to load CSR graph from " << opt.data_dir << "\n";
+        return 1;
+    }
+    CsrGraph rev;
+    const CsrGraph* rev_ptr = nullptr;
+    if (!opt.reverse_dir.empty()) {
+        if (!rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                             "entities.bin", "props.bin", "delta_rev.bin")) {
+            std::cerr << "Failed to load reverse CSR from " << opt.reverse_dir << "\n";
+            return 1;
+        }
+        rev_ptr = &rev;
+    }
+
+    FeaturePlan plan;
+    if (!plan_features(g, rev_ptr, opt.columns, opt.threads, plan)) return 1;
+    const uint64_t rows = static_cast<uint64_t>(g.num_nodes()) + 1;
+    auto fill = [&](uint32_t v, float* row) { fill_feature_row(plan, g, rev_ptr, v, row); };
+    if (!write_feature_store(opt.output, plan.names, rows, opt.dtype, opt.threads, fill)) return 1;
+    auto t1 = std::chrono::steady_clock::now();
+
+    std::cout << "Wrote " << opt.output << ": " << g.num_nodes() << " nodes x " << plan.names.size()
+              << " columns (" << (opt.dtype == FeatureDtype::F16 ? "f16" : "f32") << ") in "
+              << std::chrono::duration<double>(t1 - t0).count() << "s\n";
+    for (const std::string& c : plan.names) std::cout << "  " << c << "\n";
+    return 0;
+}
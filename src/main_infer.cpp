@@ -1,9 +1,12 @@
 #include "checkpoint.hpp"
+#include "config_file.hpp"
 #include "csr.hpp"
 #include "decoder.hpp"
 #include "encoder.hpp"
 #include "features.hpp"
+#include "inference.hpp"
 #include "io.hpp"
+#include "memory.hpp"
 #include "rng.hpp"
 
 #include <algorithm>
@@ -19,10 +22,18 @@ struct InferOptions {
     std::string data_dir = "data";
     std::string reverse_dir;
     std::string checkpoint;
+    std::string features; // default: <data>/features.bin when the checkpoint uses stored features
     std::string relation_queries;
     std::string tail_queries;
     size_t topk = 5;
     size_t batch_nodes = 1024;
+    InferenceMode inference = InferenceMode::Full;
+    std::string cache;
+    std::string spill_dir;
+    size_t mem_budget_mb = 0;
+    size_t threads = default_threads();
+    size_t chunk_nodes = 1024;
+    bool verify_checkpoint = false;
     uint64_t seed = 123;
 };
 
@@ -44,6 +55,22 @@ static bool parse_args(int argc, char** argv, InferOptions& opt) {
             opt.topk = std::stoul(argv[++i]);
         } else if (a == "--batch_nodes" && need(1)) {
             opt.batch_nodes = std::stoul(argv[++i]);
+        } else if (a == "--inference" && need(1)) {
+            if (!parse_inference_mode(argv[++i], opt.inference)) return false;
+        } else if (a == "--cache" && need(1)) {
+            opt.cache = argv[++i];
+        } else if (a == "--spill_dir" && need(1)) {
+            opt.spill_dir = argv[++i];
+        } else if (a == "--mem_budget_mb" && need(1)) {
+            opt.mem_budget_mb = std::stoul(argv[++i]);
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--chunk_nodes" && need(1)) {
+            opt.chunk_nodes = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--features" && need(1)) {
+            opt.features = argv[++i];
+        } else if (a == "--verify_checkpoint") {
+            opt.verify_checkpoint = true;
         } else if (a == "--seed" && need(1)) {
             opt.seed = std::stoull(argv[++i]);
         } else {
@@ -53,38 +80,15 @@ static bool parse_args(int argc, char** argv, InferOptions& opt) {
     return !opt.checkpoint.empty();
 }
 
-static std::vector<float> build_cache(Encoder& enc, const CsrGraph& g, const CsrGraph* rev,
-                                      size_t dim, size_t batch_nodes, XorShift128Plus& rng) {
-    std::vector<float> cache(static_cast<size_t>(g.num_nodes()) * dim, 0.0f);
-    for (uint32_t start = 1; start <= g.num_nodes(); start += batch_nodes) {
-        uint32_t end = std::min<uint32_t>(g.num_nodes(), start + batch_nodes - 1);
-        std::vector<uint32_t> seeds;
-        seeds.reserve(end - start + 1);
-        for (uint32_t v = start; v <= end; ++v) seeds.push_back(v);
-        EncoderState st = enc.forward(g, rev, seeds, rng);
-        const auto& map = st.index_per_layer.back();
-        const auto& emb = st.h_layers.back();
-        for (uint32_t v : seeds) {
-            auto it = map.find(v);
-            if (it == map.end()) continue;
-            size_t idx = it->second;
-            std::memcpy(&cache[(static_cast<size_t>(v - 1)) * dim],
-                        &emb[idx * dim],
-                        sizeof(float) * dim);
-        }
-    }
-    return cache;
-}
-
 static void run_relation_queries(const InferOptions& opt, Decoder& dec, size_t dim,
-                                 const std::vector<float>& cache, const MMapArray<Triple>& queries) {
+                                 const EmbeddingTable& cache, const MMapArray<Triple>& queries) {
     const size_t phi_dim = 4 * dim;
     std::vector<float> phi(phi_dim, 0.0f);
     for (size_t i = 0; i < queries.size; ++i) {
         const Triple& q = queries[i];
         if (q.h == 0 || q.t == 0) continue;
-        const float* uh = &cache[(static_cast<size_t>(q.h - 1)) * dim];
-        const float* tv = &cache[(static_cast<size_t>(q.t - 1)) * dim];
+        const float* uh = cache.row(q.h);
+        const float* tv = cache.row(q.t);
         for (size_t d = 0; d < dim; ++d) {
             phi[d] = uh[d];
             phi[dim + d] = tv[d];
@@ -125,17 +129,17 @@ static void run_relation_queries(const InferOptions& opt, Decoder& dec, size_t d
 }
 
 static void run_tail_queries(const InferOptions& opt, Encoder& enc, size_t dim,
-                             const std::vector<float>& cache, const MMapArray<Triple>& queries) {
+                             const EmbeddingTable& cache, const MMapArray<Triple>& queries) {
     const float* rel_emb = enc.relation_embeddings()->data.data();
     for (size_t i = 0; i < queries.size; ++i) {
         const Triple& q = queries[i];
         if (q.h == 0 || q.r == 0) continue;
-        const float* h = &cache[(static_cast<size_t>(q.h - 1)) * dim];
+        const float* h = cache.row(q.h);
         const float* rvec = &rel_emb[static_cast<size_t>(q.r) * dim];
-        std::vector<float> scores(cache.size() / dim, 0.0f);
+        std::vector<float> scores(cache.nodes(), 0.0f);
         float true_score = 0.0f;
         for (size_t v = 1; v <= scores.size(); ++v) {
-            const float* t = &cache[(v - 1) * dim];
+            const float* t = cache.row(static_cast<uint32_t>(v));
             float s = 0.0f;
             for (size_t d = 0; d < dim; ++d) s += h[d] * rvec[d] * t[d];
             scores[v - 1] = s;
@@ -157,6 +161,11 @@ static void run_tail_queries(const InferOptions& opt, Encoder& enc, size_t dim,
 }
 
 int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    if (!expand_config_args(argc, argv, "inference", args)) return 1;
+    std::vector<char*> arg_ptrs = arg_pointers(args);
+    argc = static_cast<int>(args.size());
+    argv = arg_ptrs.data();
     InferOptions opt;
     if (!parse_args(argc, argv, opt)) {
         std::cerr << "Invalid arguments\n";
@@ -171,40 +180,60 @@ int main(int argc, char** argv) {
     CsrGraph* rev_ptr = nullptr;
     CsrGraph rev;
     if (!opt.reverse_dir.empty()) {
-        if (rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin")) {
+        if (rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                            "entities.bin", "props.bin", "delta_rev.bin")) {
             rev_ptr = &rev;
         }
     }
 
-    CheckpointMeta meta;
-    std::vector<std::vector<float>> params, m, v;
-    if (!load_checkpoint(opt.checkpoint, meta, params, m, v)) {
+    CheckpointView ckpt;
+    if (!ckpt.open(opt.checkpoint)) {
         std::cerr << "Failed to load checkpoint\n";
         return 1;
     }
+    if (opt.verify_checkpoint && !ckpt.verify()) {
+        std::cerr << "Checkpoint checksum mismatch\n";
+        return 1;
+    }
+    CheckpointMeta meta = ckpt.meta();
 
     FeatureConfig fcfg = meta.feat_cfg;
     if (meta.enc_cfg.fanouts.empty()) {
         meta.enc_cfg.fanouts.resize(meta.enc_cfg.layers, 10);
     }
 
-    XorShift128Plus rng(opt.seed);
     Encoder encoder(meta.feature_dim ? meta.feature_dim : feature_dim(fcfg, rev_ptr != nullptr),
-                    g.num_relations(), meta.enc_cfg, fcfg, rng);
-    Decoder decoder(g.num_relations(), meta.enc_cfg.hidden_dim, encoder.relation_embeddings(), rng);
-    auto enc_params = encoder.parameters();
-    auto dec_params = decoder.parameters();
-    std::vector<Parameter*> all_params = enc_params;
-    all_params.insert(all_params.end(), dec_params.begin(), dec_params.end());
-    assign_parameters(params, all_params);
-    if (!m.empty() && !v.empty()) {
-        OptimConfig oc;
-        oc.use_adam = meta.use_adam;
-        Optimizer opttmp(oc, all_params);
-        opttmp.set_state(m, v, meta.step);
+                    g.num_relations(), meta.enc_cfg, fcfg);
+    Decoder decoder(g.num_relations(), meta.enc_cfg.hidden_dim, encoder.relation_embeddings());
+    if (!bind_checkpoint(ckpt, encoder, decoder)) {
+        std::cerr << "Checkpoint does not match the graph\n";
+        return 1;
+    }
+    FeatureStore store;
+    if (!fcfg.columns.empty()) {
+        if (!open_feature_store(opt.features.empty() ? opt.data_dir + "/features.bin" : opt.features, fcfg,
+                                store)) {
+            return 1;
+        }
+        encoder.set_feature_store(&store);
     }
 
-    std::vector<float> cache = build_cache(encoder, g, rev_ptr, encoder.output_dim(), opt.batch_nodes, rng);
+    InferenceConfig icfg;
+    icfg.mode = opt.inference;
+    icfg.batch_nodes = opt.batch_nodes;
+    icfg.seed = opt.seed;
+    icfg.threads = opt.threads;
+    icfg.chunk_nodes = opt.chunk_nodes;
+    icfg.cache = opt.cache;
+    icfg.spill_dir = opt.spill_dir;
+    icfg.mem_budget = opt.mem_budget_mb << 20;
+    MemoryAccount memory;
+    icfg.memory = &memory;
+    EmbeddingTable cache;
+    if (!node_embeddings(encoder, g, rev_ptr, icfg, ckpt.checksum(), cache)) return 1;
+    std::cout << "Memory: ";
+    print_memory_report(std::cout, memory);
+    std::cout << "\n";
 
     if (!opt.relation_queries.empty()) {
         MMapArray<Triple> q;
@@ -0,0 +1,222 @@
+#include "checkpoint.hpp"
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "delta.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "inference.hpp"
+#include "io.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct RefreshOptions {
+    std::string data_dir = "data";
+    std::string reverse_dir;
+    std::string checkpoint;
+    std::string cache;
+    std::string features;
+    std::string changed;  // u32 node IDs whose edges changed
+    std::string queried;  // u32 node IDs to recompute without expanding
+    bool use_delta = false;
+    size_t delta_since = SIZE_MAX; // default: the records the cache already includes
+    InferenceMode inference = InferenceMode::Full;
+    uint64_t seed = 123;
+    size_t threads = default_threads();
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_refresh --checkpoint ckpt.bin --cache emb.bin [--data data_dir] [--reverse rev_dir] "
+                 "[--changed nodes.bin] [--delta [--delta_since N]] [--queried nodes.bin] "
+                 "[--inference full|fanout] [--seed S] [--features features.bin] [--threads T]\n"
+                 "Recomputes the cache rows of every node within L hops of the changed nodes (needs --reverse)\n"
+                 "and of the queried nodes, in place.\n";
+}
+
+static bool parse_args(int argc, char** argv, RefreshOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--data" || a == "-d") && need(1)) {
+            opt.data_dir = argv[++i];
+        } else if (a == "--reverse" && need(1)) {
+            opt.reverse_dir = argv[++i];
+        } else if ((a == "--checkpoint" || a == "-c") && need(1)) {
+            opt.checkpoint = argv[++i];
+        } else if (a == "--cache" && need(1)) {
+            opt.cache = argv[++i];
+        } else if (a == "--features" && need(1)) {
+            opt.features = argv[++i];
+        } else if (a == "--changed" && need(1)) {
+            opt.changed = argv[++i];
+        } else if (a == "--queried" && need(1)) {
+            opt.queried = argv[++i];
+        } else if (a == "--delta") {
+            opt.use_delta = true;
+        } else if (a == "--delta_since" && need(1)) {
+            opt.delta_since = std::stoul(argv[++i]);
+        } else if (a == "--inference" && need(1)) {
+            if (!parse_inference_mode(argv[++i], opt.inference)) return false;
+        } else if (a == "--seed" && need(1)) {
+            opt.seed = std::stoull(argv[++i]);
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    bool expands = opt.use_delta || !opt.changed.empty();
+    if (opt.checkpoint.empty() || opt.cache.empty() || (!expands && opt.queried.empty()) ||
+        (expands && opt.reverse_dir.empty())) {
+        print_usage();
+        return false;
+    }
+    return true;
+}
+
+static bool read_nodes(const std::string& path, std::vector<uint32_t>& out) {
+    MMapArray<uint32_t> ids;
+    if (!map_array(path, ids)) {
+        std::cerr << "Failed to read node IDs from " << path << "\n";
+        return false;
+    }
+    out.insert(out.end(), ids.data, ids.data + ids.size);
+    unmap(ids.base);
+    return true;
+}
+
+// Only the target rows are recomputed, so the others must already be this
+// model's rows for the graph before the change: the cache tag has to match the
+// checkpoint, input features, mode and seed, its base checksum the graph's
+// base, and its delta record count --delta_since (the graph's own without
+// --delta). The base is only hashed when its files lost the stamp recorded
+// in the cache. With --changed the graph before the change is not known, and
+// the caller vouches for it. Sets `why` on a mismatch.
+static bool cache_matches(const RefreshOptions& opt, const EmbeddingTable& cache, uint64_t model_tag,
+                          uint64_t inputs, const CsrGraph& g, const InferenceConfig& icfg, std::string& why) {
+    if (cache.tag() != cache_tag(model_tag, cache.graph(), inputs, icfg)) {
+        why = "was built with another checkpoint, features, mode or seed";
+        return false;
+    }
+    if (!opt.changed.empty()) return true;
+    if (graph_identity(g, &cache.graph(), icfg.threads).base != cache.graph().base) {
+        why = "does not match the base graph";
+        return false;
+    }
+    const size_t before = opt.use_delta ? opt.delta_since : g.delta_records();
+    if (cache.graph().delta != before) {
+        why = "includes " + std::to_string(cache.graph().delta) + " delta records, not " + std::to_string(before);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    RefreshOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+
+    CsrGraph g(opt.data_dir);
+    if (!g.valid()) {
+        std::cerr << "Failed to load CSR graph\n";
+        return 1;
+    }
+    CsrGraph rev;
+    const CsrGraph* rev_ptr = nullptr;
+    if (!opt.reverse_dir.empty()) {
+        if (!rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                             "entities.bin", "props.bin", "delta_rev.bin")) {
+            std::cerr << "Failed to load reverse CSR from " << opt.reverse_dir << "\n";
+            return 1;
+        }
+        rev_ptr = &rev;
+    }
+
+    CheckpointView ckpt;
+    if (!ckpt.open(opt.checkpoint)) {
+        std::cerr << "Failed to load checkpoint\n";
+        return 1;
+    }
+    CheckpointMeta meta = ckpt.meta();
+    FeatureConfig fcfg = meta.feat_cfg;
+    if (fcfg.use_in_degree && !rev_ptr) {
+        std::cerr << "The checkpoint uses in-degree features; pass --reverse\n";
+        return 1;
+    }
+    if (meta.enc_cfg.fanouts.empty()) meta.enc_cfg.fanouts.resize(meta.enc_cfg.layers, 10);
+    Encoder encoder(meta.feature_dim ? meta.feature_dim : feature_dim(fcfg, rev_ptr != nullptr),
+                    g.num_relations(), meta.enc_cfg, fcfg);
+    Decoder decoder(g.num_relations(), meta.enc_cfg.hidden_dim, encoder.relation_embeddings());
+    if (!bind_checkpoint(ckpt, encoder, decoder)) {
+        std::cerr << "Checkpoint does not match the graph\n";
+        return 1;
+    }
+    FeatureStore store;
+    if (!fcfg.columns.empty()) {
+        if (!open_feature_store(opt.features.empty() ? opt.data_dir + "/features.bin" : opt.features, fcfg,
+                                store)) {
+            return 1;
+        }
+        encoder.set_feature_store(&store);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    EmbeddingTable cached;
+    const bool readable = cached.open(opt.cache);
+    if (opt.delta_since == SIZE_MAX) opt.delta_since = readable ? cached.graph().delta : 0;
+    std::vector<uint32_t> changed, targets;
+    if (!opt.changed.empty() && !read_nodes(opt.changed, changed)) return 1;
+    size_t delta_records = 0;
+    if (opt.use_delta && file_exists(opt.data_dir + "/delta.bin")) {
+        MMapArray<DeltaRecord> log;
+        if (file_size(opt.data_dir + "/delta.bin") > 0 && !map_array(opt.data_dir + "/delta.bin", log)) {
+            std::cerr << "Failed to map " << opt.data_dir << "/delta.bin\n";
+            return 1;
+        }
+        delta_records = log.size;
+        for (size_t i = opt.delta_since; i < log.size; ++i) {
+            changed.push_back(log[i].src);
+            changed.push_back(log[i].dst);
+        }
+        unmap(log.base);
+    }
+    if (!changed.empty()) targets = affected_nodes(rev, changed, meta.enc_cfg.fanouts.size());
+    if (!opt.queried.empty() && !read_nodes(opt.queried, targets)) return 1;
+
+    InferenceConfig icfg;
+    icfg.mode = opt.inference;
+    icfg.seed = opt.seed;
+    icfg.threads = opt.threads;
+    const uint64_t inputs = input_tag(encoder, rev_ptr);
+    std::string stale = "cannot be read";
+    if (!readable || !cache_matches(opt, cached, ckpt.checksum(), inputs, g, icfg, stale)) {
+        std::cout << "Embedding cache " << opt.cache << " " << stale << "; rebuilding it in full\n";
+        icfg.cache = opt.cache;
+        EmbeddingTable rebuilt;
+        return node_embeddings(encoder, g, rev_ptr, icfg, ckpt.checksum(), rebuilt) ? 0 : 1;
+    }
+    EmbeddingTable cache;
+    if (!cache.open_writable(opt.cache, g.num_nodes())) return 1;
+    if (cache.dim() != encoder.output_dim()) {
+        std::cerr << "Embedding cache " << opt.cache << " has dim " << cache.dim() << ", the checkpoint "
+                  << encoder.output_dim() << "\n";
+        return 1;
+    }
+    if (!refresh_embeddings(encoder, g, rev_ptr, icfg, targets, cache)) return 1;
+    // The rows now hold every record of the log.
+    const GraphIdentity graph = graph_identity(g, &cache.graph(), icfg.threads);
+    if (!cache.commit(cache_tag(ckpt.checksum(), graph, inputs, icfg), graph)) return 1;
+    auto t1 = std::chrono::steady_clock::now();
+
+    std::cout << "Refreshed " << targets.size() << " of " << g.num_nodes() << " rows (" << changed.size()
+              << " changed endpoints) in " << std::chrono::duration<double>(t1 - t0).count() << "s\n";
+    if (opt.use_delta) {
+        std::cout << "delta.bin has " << delta_records << " records; next run: --delta_since " << delta_records
+                  << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,288 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+struct ReorderOptions {
+    std::string data_dir = "data";
+    std::string reverse_dir;
+    std::string out_dir;
+    std::string order = "degree";
+    std::vector<std::string> remap_triples; // "in.bin:out.bin"
+    size_t threads = default_threads();
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_reorder --output out_dir [--data data_dir] [--reverse rev_dir] "
+                 "[--order degree|rcm|bfs] [--remap_triples in.bin:out.bin[,...]] [--threads T]\n"
+                 "Writes the renumbered graph and perm.bin (u32 new ID per old ID, n+1 entries) to out_dir.\n";
+}
+
+static bool parse_args(int argc, char** argv, ReorderOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--data" || a == "-d") && need(1)) {
+            opt.data_dir = argv[++i];
+        } else if (a == "--reverse" && need(1)) {
+            opt.reverse_dir = argv[++i];
+        } else if ((a == "--output" || a == "-o") && need(1)) {
+            opt.out_dir = argv[++i];
+        } else if (a == "--order" && need(1)) {
+            opt.order = argv[++i];
+        } else if (a == "--remap_triples" && need(1)) {
+            opt.remap_triples = split_paths(argv[++i]);
+        } else if (a == "--threads" && need(1)) {
+            opt.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    if (opt.out_dir.empty() || (opt.order != "degree" && opt.order != "rcm" && opt.order != "bfs")) {
+        print_usage();
+        return false;
+    }
+    return true;
+}
+
+// In-neighbours, from the reverse CSR when given, otherwise built in memory.
+struct InEdges {
+    const CsrGraph* rev = nullptr;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> src;
+
+    void build(const CsrGraph& g) {
+        const uint32_t n = g.num_nodes();
+        offsets.assign(static_cast<size_t>(n) + 2, 0);
+        std::vector<uint32_t> ds;
+        std::vector<uint16_t> rs;
+        for (uint32_t u = 1; u <= n; ++u) {
+            AdjView adj = g.neighbors(u).unpacked(ds, rs);
+            for (uint32_t i = 0; i < adj.size; ++i) ++offsets[adj.dst[i] + 1];
+        }
+        for (size_t v = 1; v < offsets.size(); ++v) offsets[v] += offsets[v - 1];
+        src.resize(g.num_edges());
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (uint32_t u = 1; u <= n; ++u) {
+            AdjView adj = g.neighbors(u).unpacked(ds, rs);
+            for (uint32_t i = 0; i < adj.size; ++i) src[cursor[adj.dst[i]]++] = u;
+        }
+    }
+
+    uint32_t degree(uint32_t v) const { return rev ? rev->out_degree(v) : offsets[v + 1] - offsets[v]; }
+
+    template <typename Fn>
+    void for_each(uint32_t v, std::vector<uint32_t>& ds, std::vector<uint16_t>& rs, Fn fn) const {
+        if (rev) {
+            AdjView adj = rev->neighbors(v).unpacked(ds, rs);
+            for (uint32_t i = 0; i < adj.size; ++i) fn(adj.dst[i]);
+        } else {
+            for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i) fn(src[i]);
+        }
+    }
+};
+
+// Returns order[k] = old ID placed at new ID k + 1.
+static std::vector<uint32_t> compute_order(const CsrGraph& g, const InEdges& in, const std::string& kind) {
+    const uint32_t n = g.num_nodes();
+    std::vector<uint32_t> deg(static_cast<size_t>(n) + 1, 0);
+    for (uint32_t v = 1; v <= n; ++v) deg[v] = g.out_degree(v) + in.degree(v);
+
+    // Hub-first: by total degree, descending; ties keep the old order.
+    std::vector<uint32_t> by_degree(n);
+    for (uint32_t v = 1; v <= n; ++v) by_degree[v - 1] = v;
+    std::stable_sort(by_degree.begin(), by_degree.end(),
+                     [&](uint32_t a, uint32_t b) { return deg[a] > deg[b]; });
+    if (kind == "degree") return by_degree;
+
+    // BFS over the undirected view, one component at a time. "bfs" roots each
+    // component at its highest-degree node and visits neighbours in adjacency
+    // order; "rcm" (reverse Cuthill-McKee) roots at the lowest-degree node,
+    // visits neighbours by increasing degree and reverses the final order.
+    const bool rcm = kind == "rcm";
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    std::vector<uint8_t> seen(static_cast<size_t>(n) + 1, 0);
+    std::vector<uint32_t> ds, nbrs;
+    std::vector<uint16_t> rs;
+    for (size_t k = 0; k < n; ++k) {
+        uint32_t root = rcm ? by_degree[n - 1 - k] : by_degree[k];
+        if (seen[root]) continue;
+        seen[root] = 1;
+        size_t head = order.size();
+        order.push_back(root);
+        while (head < order.size()) {
+            uint32_t u = order[head++];
+            nbrs.clear();
+            auto visit = [&](uint32_t v) {
+                if (!seen[v]) {
+                    seen[v] = 1;
+                    nbrs.push_back(v);
+                }
+            };
+            AdjView adj = g.neighbors(u).unpacked(ds, rs);
+            for (uint32_t i = 0; i < adj.size; ++i) visit(adj.dst[i]);
+            in.for_each(u, ds, rs, visit);
+            if (rcm) {
+                std::stable_sort(nbrs.begin(), nbrs.end(), [&](uint32_t a, uint32_t b) { return deg[a] < deg[b]; });
+            }
+            order.insert(order.end(), nbrs.begin(), nbrs.end());
+        }
+    }
+    if (rcm) std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// Writes the renumbered CSR (offsets/csr/rels) with each list sorted by (dst, rel).
+static bool write_permuted(const CsrGraph& g, const std::vector<uint32_t>& order,
+                           const std::vector<uint32_t>& perm, const std::string& dir,
+                           const std::string& offsets_file, const std::string& csr_file,
+                           const std::string& rels_file, size_t threads) {
+    const uint32_t n = g.num_nodes();
+    const uint32_t m = g.num_edges();
+    std::vector<uint32_t> offsets(static_cast<size_t>(n) + 2, 0);
+    for (uint32_t k = 0; k < n; ++k) offsets[k + 2] = offsets[k + 1] + g.out_degree(order[k]);
+
+    MMapArrayBase csr_map, rels_map;
+    if (!map_writable(dir + "/" + csr_file, static_cast<size_t>(m) * sizeof(uint32_t), csr_map) ||
+        !map_writable(dir + "/" + rels_file, static_cast<size_t>(m) * sizeof(uint16_t), rels_map)) {
+        return false;
+    }
+    uint32_t* csr = static_cast<uint32_t*>(csr_map.data);
+    uint16_t* rels = static_cast<uint16_t*>(rels_map.data);
+    parallel_for(0, threads, threads, [&](size_t t) {
+        std::vector<uint32_t> ds;
+        std::vector<uint16_t> rs;
+        std::vector<uint64_t> keys;
+        for (uint32_t k = static_cast<uint32_t>(uint64_t(n) * t / threads);
+             k < static_cast<uint32_t>(uint64_t(n) * (t + 1) / threads); ++k) {
+            AdjView adj = g.neighbors(order[k]).unpacked(ds, rs);
+            keys.resize(adj.size);
+            for (uint32_t i = 0; i < adj.size; ++i) keys[i] = (uint64_t(perm[adj.dst[i]]) << 16) | adj.rel[i];
+            std::sort(keys.begin(), keys.end());
+            uint32_t base = offsets[k + 1];
+            for (uint32_t i = 0; i < adj.size; ++i) {
+                csr[base + i] = static_cast<uint32_t>(keys[i] >> 16);
+                rels[base + i] = static_cast<uint16_t>(keys[i] & 0xffff);
+            }
+        }
+    });
+    bool ok = sync_mapping(csr_map) && sync_mapping(rels_map);
+    unmap(csr_map);
+    unmap(rels_map);
+    return ok && write_array(dir + "/" + offsets_file, offsets);
+}
+
+static bool remap_triple_file(const std::string& spec, const std::vector<uint32_t>& perm) {
+    size_t colon = spec.find(':');
+    if (colon == std::string::npos) {
+        std::cerr << "--remap_triples expects in.bin:out.bin, got " << spec << "\n";
+        return false;
+    }
+    MMapArray<Triple> in;
+    if (!map_triples(spec.substr(0, colon), in)) return false;
+    std::vector<uint32_t> words;
+    words.reserve(in.size * 3);
+    size_t dropped = 0;
+    for (size_t i = 0; i < in.size; ++i) {
+        const Triple& t = in[i];
+        if (t.h >= perm.size() || t.t >= perm.size()) {
+            ++dropped;
+            continue;
+        }
+        words.push_back(perm[t.h]);
+        words.push_back(t.r);
+        words.push_back(perm[t.t]);
+    }
+    unmap(in.base);
+    if (dropped) std::cerr << "Warning: dropped " << dropped << " triples with unknown nodes from " << spec << "\n";
+    return write_array(spec.substr(colon + 1), words);
+}
+
+int main(int argc, char** argv) {
+    ReorderOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+
+    // The output is written while the input graphs are still mapped.
+    for (const std::string& in_dir : {opt.data_dir, opt.reverse_dir}) {
+        std::error_code ec;
+        if (!in_dir.empty() && std::filesystem::equivalent(in_dir, opt.out_dir, ec)) {
+            std::cerr << "--output must be a different directory than " << in_dir << "\n";
+            return 1;
+        }
+    }
+
+    CsrGraph g, rev;
+    if (!g.load(opt.data_dir)) {
+        std::cerr << "Failed to load graph from " << opt.data_dir << "\n";
+        return 1;
+    }
+    if (g.delta_records() > 0) {
+        std::cerr << opt.data_dir << " has a delta log; fold it with kg_compact first\n";
+        return 1;
+    }
+    InEdges in;
+    if (!opt.reverse_dir.empty()) {
+        if (!rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin", "entities.bin",
+                             "props.bin", "delta_rev.bin")) {
+            std::cerr << "Failed to load reverse graph from " << opt.reverse_dir << "\n";
+            return 1;
+        }
+        if (rev.delta_records() > 0 || rev.num_nodes() != g.num_nodes() || rev.num_edges() != g.num_edges()) {
+            std::cerr << "Reverse graph in " << opt.reverse_dir << " does not match " << opt.data_dir << "\n";
+            return 1;
+        }
+        in.rev = &rev;
+    } else {
+        in.build(g);
+    }
+
+    const uint32_t n = g.num_nodes();
+    std::vector<uint32_t> order = compute_order(g, in, opt.order);
+    std::vector<uint32_t> perm(static_cast<size_t>(n) + 1, 0);
+    for (uint32_t k = 0; k < n; ++k) perm[order[k]] = k + 1;
+
+    std::filesystem::create_directories(opt.out_dir);
+    remove_packed(opt.out_dir, "csr");
+    if (in.rev) remove_packed(opt.out_dir, "csr_rev");
+    std::vector<uint32_t> entities(n);
+    for (uint32_t k = 0; k < n; ++k) entities[k] = g.entity_of(order[k]);
+    std::vector<uint16_t> props(g.num_relations());
+    for (uint32_t r = 1; r <= g.num_relations(); ++r) props[r - 1] = g.prop_of(r);
+    bool ok = write_permuted(g, order, perm, opt.out_dir, "offsets.bin", "csr.bin", "rels.bin", opt.threads) &&
+              write_array(opt.out_dir + "/entities.bin", entities) &&
+              write_array(opt.out_dir + "/props.bin", props) && write_array(opt.out_dir + "/perm.bin", perm);
+    if (ok && in.rev) {
+        ok = write_permuted(rev, order, perm, opt.out_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                            opt.threads);
+    }
+    for (const std::string& spec : opt.remap_triples) ok = ok && remap_triple_file(spec, perm);
+    if (!ok) {
+        std::cerr << "Failed to write reordered graph to " << opt.out_dir << "\n";
+        return 1;
+    }
+
+    // Mean |new(u) - new(v)| over edges: how far apart neighbours sit in csr.bin.
+    double before = 0.0, after = 0.0;
+    std::vector<uint32_t> ds;
+    std::vector<uint16_t> rs;
+    for (uint32_t u = 1; u <= n; ++u) {
+        AdjView adj = g.neighbors(u).unpacked(ds, rs);
+        for (uint32_t i = 0; i < adj.size; ++i) {
+            before += std::abs(static_cast<double>(u) - adj.dst[i]);
+            after += std::abs(static_cast<double>(perm[u]) - perm[adj.dst[i]]);
+        }
+    }
+    const double m = g.num_edges() ? static_cast<double>(g.num_edges()) : 1.0;
+    std::cout << "Reordered " << n << " nodes (" << opt.order << ") into " << opt.out_dir
+              << "; mean edge ID gap " << before / m << " -> " << after / m << "\n";
+    return 0;
+}
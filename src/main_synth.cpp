@@ -0,0 +1,97 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "synth.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+struct SynthOptions {
+    std::string out_dir = "synth";
+    SynthConfig cfg;
+    TripleSplit split;
+    bool triples = true;
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_synth [--output dir] [--nodes N] [--edges M] [--relations R] [--skew A] "
+                 "[--out_skew A] [--in_skew A] [--rel_skew A] [--seed S] [--threads T] [--no_reverse] "
+                 "[--eval_fraction F] [--train_fraction F] [--no_triples]\n"
+                 "Writes a skewed random graph in the kg_gencsr format, plus train.bin/eval.bin drawn from its edges.\n";
+}
+
+static bool parse_args(int argc, char** argv, SynthOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--output" || a == "-o") && need(1)) {
+            opt.out_dir = argv[++i];
+        } else if (a == "--nodes" && need(1)) {
+            opt.cfg.nodes = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (a == "--edges" && need(1)) {
+            opt.cfg.edges = std::stoull(argv[++i]);
+        } else if (a == "--relations" && need(1)) {
+            opt.cfg.relations = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (a == "--skew" && need(1)) {
+            opt.cfg.out_skew = opt.cfg.in_skew = std::stod(argv[++i]);
+        } else if (a == "--out_skew" && need(1)) {
+            opt.cfg.out_skew = std::stod(argv[++i]);
+        } else if (a == "--in_skew" && need(1)) {
+            opt.cfg.in_skew = std::stod(argv[++i]);
+        } else if (a == "--rel_skew" && need(1)) {
+            opt.cfg.rel_skew = std::stod(argv[++i]);
+        } else if (a == "--seed" && need(1)) {
+            opt.cfg.seed = std::stoull(argv[++i]);
+        } else if (a == "--threads" && need(1)) {
+            opt.cfg.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--no_reverse") {
+            opt.cfg.reverse = false;
+        } else if (a == "--eval_fraction" && need(1)) {
+            opt.split.eval_fraction = std::stod(argv[++i]);
+        } else if (a == "--train_fraction" && need(1)) {
+            opt.split.train_fraction = std::stod(argv[++i]);
+        } else if (a == "--no_triples") {
+            opt.triples = false;
+        } else {
+            print_usage();
+            return false;
+        }
+    }
+    opt.split.seed = opt.cfg.seed;
+    opt.split.threads = opt.cfg.threads;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    SynthOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+    std::filesystem::create_directories(opt.out_dir);
+
+    auto t0 = std::chrono::steady_clock::now();
+    if (!write_synthetic_graph(opt.out_dir, opt.cfg)) return 1;
+    auto t1 = std::chrono::steady_clock::now();
+    CsrGraph g;
+    if (!g.load(opt.out_dir)) {
+        std::cerr << "Failed to load generated graph from " << opt.out_dir << "\n";
+        return 1;
+    }
+    uint32_t max_out = 0;
+    for (uint32_t v = 1; v <= g.num_nodes(); ++v) max_out = std::max(max_out, g.out_degree(v));
+    std::cout << "Graph: nodes=" << g.num_nodes() << " edges=" << g.num_edges() << " relations="
+              << g.num_relations() << " max out-degree=" << max_out << " ("
+              << std::chrono::duration<double>(t1 - t0).count() << " s"
+              << (opt.cfg.reverse ? ", with reverse" : "") << ")\n";
+
+    if (!opt.triples) return 0;
+    uint64_t train = 0, eval = 0;
+    if (!write_edge_triples(g, opt.out_dir + "/train.bin", opt.out_dir + "/eval.bin", opt.split, train, eval)) {
+        return 1;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    std::cout << "Triples: train=" << train << " eval=" << eval << " ("
+              << std::chrono::duration<double>(t2 - t1).count() << " s)\n";
+    return 0;
+}
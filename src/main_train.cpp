@@ -1,15 +1,24 @@
+#include "async_checkpoint.hpp"
 #include "checkpoint.hpp"
+#include "config_file.hpp"
 #include "csr.hpp"
 #include "decoder.hpp"
 #include "encoder.hpp"
 #include "io.hpp"
+#include "memory.hpp"
 #include "optim.hpp"
+#include "partition.hpp"
+#include "perf_counters.hpp"
 #include "rng.hpp"
+#include "trainer.hpp"
 
 #include <chrono>
+#include <csignal>
 #include <iostream>
+#include <memory>
 #include <string>
-#include <unordered_set>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
 struct TrainOptions {
@@ -17,6 +26,9 @@ struct TrainOptions {
     std::string reverse_dir;
     std::string train_file;
     std::string checkpoint = "checkpoint.bin";
+    std::string resume;
+    std::string features;
+    GraphMapPolicy map_policy;
     size_t epochs = 1;
     size_t batch_size = 256;
     size_t dim = 64;
@@ -29,13 +41,32 @@ struct TrainOptions {
     bool use_adam = true;
     bool use_in_degree = true;
     bool add_noise = false;
+    bool bf16_activations = false;
+    size_t history_staleness = 0; // 0: no historical embeddings
+    bool cluster_batches = false;
+    size_t clusters_per_batch = 4;
+    uint32_t partition_parts = 0; // 0: about batch / clusters_per_batch triples per part
+    std::string partition_file;   // kg_partition output; computed in-process when empty
+    uint32_t world_size = 1;
+    int rank = -1;                // -1 with world_size > 1: launch world_size workers
+    std::string shm;              // all-reduce segment name; default /kg_train.<launcher pid>
+    size_t checkpoint_every_steps = 0;
+    double checkpoint_every_seconds = 0.0;
+    size_t keep_checkpoints = 3;
+    std::string metrics_file;     // JSON lines of per-phase metrics
+    size_t metrics_every = 100;   // batches per metrics line
+    bool perf = false;            // hardware counters per phase
+    size_t mem_budget_mb = 0;     // activation memory per forward/backward pass; 0: no limit
     uint64_t seed = 1;
 };
 
 static void print_usage() {
-    std::cout << "Usage: kg_train --train train.bin [--data data_dir] [--reverse rev_dir] "
+    std::cout << "Usage: kg_train --train train.bin [--config tuned.conf] [--data data_dir] [--reverse rev_dir] "
                  "[--epochs E] [--batch B] [--dim D] [--layers L] [--negatives K] "
-                 "[--lambda_rel X] [--lr LR] [--optimizer adam|sgd] [--checkpoint path]\n";
+                 "[--lambda_rel X] [--lr LR] [--optimizer adam|sgd] [--checkpoint path] "
+                 "[--bf16_activations] [--mem_budget_mb MB] [--history_staleness S] [--batch_order random|cluster] [--clusters_per_batch Q] [--partition_parts K] [--partition partition.bin] [--world_size N [--rank R --shm NAME]] [--checkpoint_every STEPS|SECONDSs] [--keep_checkpoints K] "
+                 "[--metrics metrics.jsonl] [--metrics_every N] [--perf] [--resume ckpt.bin] [--features features.bin] [--map_policy P] [--map_offsets P] [--map_adjacency P]\n"
+                 "  P: comma list of populate, prefault[=T], random, sequential, willneed, hugepages, anon\n";
 }
 
 static bool parse_args(int argc, char** argv, TrainOptions& opt) {
@@ -75,6 +106,58 @@ static bool parse_args(int argc, char** argv, TrainOptions& opt) {
             opt.use_in_degree = false;
         } else if (a == "--noise") {
             opt.add_noise = true;
+        } else if (a == "--bf16_activations") {
+            opt.bf16_activations = true;
+        } else if (a == "--checkpoint_every" && need(1)) {
+            std::string v = argv[++i];
+            if (!v.empty() && v.back() == 's') {
+                opt.checkpoint_every_seconds = std::stod(v.substr(0, v.size() - 1));
+            } else {
+                opt.checkpoint_every_steps = std::stoul(v);
+            }
+        } else if (a == "--metrics" && need(1)) {
+            opt.metrics_file = argv[++i];
+        } else if (a == "--metrics_every" && need(1)) {
+            opt.metrics_every = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--perf") {
+            opt.perf = true;
+        } else if (a == "--mem_budget_mb" && need(1)) {
+            opt.mem_budget_mb = std::stoul(argv[++i]);
+        } else if (a == "--history_staleness" && need(1)) {
+            opt.history_staleness = std::stoul(argv[++i]);
+        } else if (a == "--batch_order" && need(1)) {
+            std::string v = argv[++i];
+            if (v != "random" && v != "cluster") {
+                print_usage();
+                return false;
+            }
+            opt.cluster_batches = v == "cluster";
+        } else if (a == "--clusters_per_batch" && need(1)) {
+            opt.clusters_per_batch = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--world_size" && need(1)) {
+            opt.world_size = static_cast<uint32_t>(std::max<unsigned long>(1, std::stoul(argv[++i])));
+        } else if (a == "--rank" && need(1)) {
+            opt.rank = std::stoi(argv[++i]);
+        } else if (a == "--shm" && need(1)) {
+            opt.shm = argv[++i];
+        } else if (a == "--partition" && need(1)) {
+            opt.partition_file = argv[++i];
+        } else if (a == "--partition_parts" && need(1)) {
+            opt.partition_parts = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (a == "--keep_checkpoints" && need(1)) {
+            opt.keep_checkpoints = std::stoul(argv[++i]);
+        } else if (a == "--map_policy" && need(1)) {
+            MapPolicy p;
+            if (!parse_map_policy(argv[++i], p)) return false;
+            opt.map_policy.offsets = opt.map_policy.adjacency = opt.map_policy.dictionaries = p;
+        } else if (a == "--map_offsets" && need(1)) {
+            if (!parse_map_policy(argv[++i], opt.map_policy.offsets)) return false;
+        } else if (a == "--map_adjacency" && need(1)) {
+            if (!parse_map_policy(argv[++i], opt.map_policy.adjacency)) return false;
+        } else if (a == "--features" && need(1)) {
+            opt.features = argv[++i];
+        } else if (a == "--resume" && need(1)) {
+            opt.resume = argv[++i];
         } else if (a == "--seed" && need(1)) {
             opt.seed = std::stoull(argv[++i]);
         } else {
@@ -82,39 +165,93 @@ static bool parse_args(int argc, char** argv, TrainOptions& opt) {
             return false;
         }
     }
-    if (opt.train_file.empty()) {
+    if (opt.train_file.empty() || (opt.rank >= 0 && static_cast<uint32_t>(opt.rank) >= opt.world_size) ||
+        (opt.rank >= 0 && opt.world_size > 1 && opt.shm.empty())) {
         print_usage();
         return false;
     }
     return true;
 }
 
-static void shuffle_indices(std::vector<size_t>& idx, XorShift128Plus& rng) {
-    for (size_t i = idx.size(); i > 1; --i) {
-        size_t j = rng.next_u32(static_cast<uint32_t>(i));
-        std::swap(idx[i - 1], idx[j]);
+// Starts world_size copies of this binary with --rank r --shm NAME appended
+// and waits for them. If one fails, the others (which would block in the
+// all-reduce) are terminated.
+static int launch_workers(int argc, char** argv, const TrainOptions& opt) {
+    const std::string shm = opt.shm.empty() ? "/kg_train." + std::to_string(getpid()) : opt.shm;
+    remove_shm(shm);
+    std::vector<pid_t> workers;
+    for (uint32_t r = 0; r < opt.world_size; ++r) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "fork failed\n";
+            for (pid_t w : workers) kill(w, SIGTERM);
+            break;
+        }
+        if (pid == 0) {
+            std::vector<std::string> args(argv, argv + argc);
+            args.insert(args.end(), {"--rank", std::to_string(r), "--shm", shm});
+            std::vector<char*> cargs;
+            for (std::string& a : args) cargs.push_back(a.data());
+            cargs.push_back(nullptr);
+            execv("/proc/self/exe", cargs.data());
+            std::cerr << "exec failed\n";
+            _exit(127);
+        }
+        workers.push_back(pid);
+    }
+    int rc = workers.size() == opt.world_size ? 0 : 1;
+    for (size_t left = workers.size(); left > 0; --left) {
+        int status = 0;
+        pid_t done = wait(&status);
+        if (done < 0) break;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (rc == 0) std::cerr << "Worker " << done << " failed; stopping the others\n";
+            rc = 1;
+            for (pid_t w : workers) if (w != done) kill(w, SIGTERM);
+        }
     }
+    remove_shm(shm);
+    return rc;
 }
 
 int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    if (!expand_config_args(argc, argv, "train", args)) return 1;
+    std::vector<char*> arg_ptrs = arg_pointers(args);
+    argc = static_cast<int>(args.size());
+    argv = arg_ptrs.data();
     TrainOptions opt;
     if (!parse_args(argc, argv, opt)) return 1;
+    if (opt.world_size > 1 && opt.rank < 0) return launch_workers(argc, argv, opt);
+    const uint32_t rank = opt.rank < 0 ? 0 : static_cast<uint32_t>(opt.rank);
+    // Only rank 0 reports and writes checkpoints.
+    if (rank > 0) std::cout.setstate(std::ios::failbit);
 
-    CsrGraph g(opt.data_dir);
+    const PageFaults faults_start = page_faults();
+    CsrGraph g;
+    g.set_map_policy(opt.map_policy);
+    g.load(opt.data_dir);
     if (!g.valid()) {
         std::cerr << "Failed to load CSR from " << opt.data_dir << "\n";
         return 1;
     }
     CsrGraph* rev_ptr = nullptr;
     CsrGraph rev;
+    rev.set_map_policy(opt.map_policy);
     if (!opt.reverse_dir.empty()) {
-        if (rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin")) {
+        if (rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                            "entities.bin", "props.bin", "delta_rev.bin")) {
             rev_ptr = &rev;
         } else {
             std::cerr << "Warning: reverse CSR could not be loaded; continuing without it.\n";
         }
     }
 
+    const PageFaults faults_loaded = page_faults();
+    std::cout << "Graph mapped: nodes=" << g.num_nodes() << " edges=" << g.num_edges()
+              << " faults=" << (faults_loaded.minor - faults_start.minor) << "/"
+              << (faults_loaded.major - faults_start.major) << " (minor/major)\n";
+
     MMapArray<Triple> train;
     if (!map_triples(opt.train_file, train)) {
         std::cerr << "Failed to map training triples.\n";
@@ -124,12 +261,22 @@ int main(int argc, char** argv) {
     FeatureConfig fcfg;
     fcfg.use_in_degree = opt.use_in_degree && rev_ptr;
     fcfg.add_noise = opt.add_noise;
+    FeatureStore store;
+    if (!opt.features.empty()) {
+        if (!store.open(opt.features)) return 1;
+        if (store.rows() <= g.base_nodes()) {
+            std::cerr << "Feature store " << opt.features << " has fewer rows than the graph has nodes\n";
+            return 1;
+        }
+        fcfg.columns = store.columns();
+    }
     size_t feat_dim = feature_dim(fcfg, rev_ptr != nullptr);
 
     EncoderConfig ecfg;
     ecfg.hidden_dim = opt.dim;
     ecfg.layers = opt.layers;
     ecfg.use_relu = true;
+    ecfg.bf16_activations = opt.bf16_activations;
     ecfg.fanouts.clear();
     for (int l = 0; l < ecfg.layers; ++l) {
         if (l == 0)
@@ -138,9 +285,42 @@ int main(int argc, char** argv) {
             ecfg.fanouts.push_back(opt.fanout2);
     }
 
+    // A resumed run keeps the checkpoint's model shape; the flags only apply to fresh runs.
+    CheckpointView resume_view;
+    if (!opt.resume.empty()) {
+        if (!resume_view.open(opt.resume) || !resume_view.verify()) {
+            std::cerr << "Failed to open checkpoint " << opt.resume << " for resuming\n";
+            return 1;
+        }
+        const CheckpointMeta& rm = resume_view.meta();
+        if (rm.num_rel != g.num_relations() || rm.feature_dim != feat_dim || rm.feat_cfg.columns != fcfg.columns) {
+            std::cerr << "Checkpoint " << opt.resume << " does not match this graph\n";
+            return 1;
+        }
+        ecfg.hidden_dim = rm.enc_cfg.hidden_dim;
+        ecfg.layers = rm.enc_cfg.layers;
+        ecfg.use_relu = rm.enc_cfg.use_relu;
+        ecfg.fanouts = rm.enc_cfg.fanouts;
+        fcfg.add_noise = rm.feat_cfg.add_noise;
+    }
+
     XorShift128Plus rng(opt.seed);
     Encoder encoder(feat_dim, g.num_relations(), ecfg, fcfg, rng);
     Decoder decoder(g.num_relations(), ecfg.hidden_dim, encoder.relation_embeddings(), rng);
+    if (!fcfg.columns.empty()) encoder.set_feature_store(&store);
+    MemoryAccount memory;
+    HistoryStore history;
+    if (opt.history_staleness > 0 && ecfg.fanouts.size() > 1) {
+        history.init(g.num_nodes(), ecfg.fanouts.size(), ecfg.hidden_dim, static_cast<uint32_t>(opt.history_staleness));
+        encoder.set_history(&history);
+        std::cout << "Historical embeddings: " << (history.bytes() >> 20) << " MB, staleness <= "
+                  << opt.history_staleness << " steps\n";
+        memory.set(MemKind::History, history.bytes());
+    }
+
+    // Every rank initialises the same weights from --seed, then samples from
+    // its own stream.
+    if (rank > 0) rng = XorShift128Plus(opt.seed, (uint64_t{1} << 32) + rank);
 
     std::vector<Parameter*> params = encoder.parameters();
     auto dparams = decoder.parameters();
@@ -150,71 +330,165 @@ int main(int argc, char** argv) {
     ocfg.use_adam = opt.use_adam;
     Optimizer optim(ocfg, params);
 
-    size_t total = train.size;
-    std::vector<size_t> order(total);
-    for (size_t i = 0; i < total; ++i) order[i] = i;
+    TrainConfig tcfg;
+    tcfg.batch_size = opt.batch_size;
+    tcfg.negatives = opt.negatives;
+    tcfg.lambda_rel = opt.lambda_rel;
+    tcfg.shuffle_seed = opt.seed;
+    TrainMetrics metrics;
+    tcfg.phase_times = metrics.phases();
+    tcfg.mem_budget = opt.mem_budget_mb << 20;
+    tcfg.memory = &memory;
+    std::vector<uint32_t> partition;
+    if (opt.cluster_batches && !opt.partition_file.empty()) {
+        MMapArray<uint32_t> stored;
+        if (!map_array(opt.partition_file, stored) || stored.size != static_cast<size_t>(g.num_nodes()) + 1) {
+            std::cerr << "Partition " << opt.partition_file << " does not match the graph (" << g.num_nodes()
+                      << " nodes)\n";
+            return 1;
+        }
+        partition.assign(stored.data, stored.data + stored.size);
+        unmap(stored.base);
+        std::cout << "Loaded partition " << opt.partition_file << "; " << opt.clusters_per_batch
+                  << " parts per batch group\n";
+    } else if (opt.cluster_batches) {
+        PartitionConfig pcfg;
+        pcfg.parts = opt.partition_parts;
+        if (pcfg.parts == 0) {
+            pcfg.parts = static_cast<uint32_t>(std::max<size_t>(1, train.size * opt.clusters_per_batch / opt.batch_size));
+        }
+        // Single-threaded label propagation is deterministic, so a resumed run
+        // and every rank of a multi-process run compute the same partition.
+        pcfg.threads = 1;
+        auto p0 = std::chrono::steady_clock::now();
+        label_propagation(g, rev_ptr, pcfg, partition);
+        auto p1 = std::chrono::steady_clock::now();
+        std::cout << "Partitioned into " << pcfg.parts << " parts in " << std::chrono::duration<double>(p1 - p0).count()
+                  << "s; " << opt.clusters_per_batch << " parts per batch group\n";
+    }
+    if (opt.cluster_batches) {
+        tcfg.partition = &partition;
+        tcfg.clusters_per_batch = opt.clusters_per_batch;
+    }
+    ShmAllReduce allreduce;
+    if (opt.world_size > 1) {
+        if (!allreduce.open(opt.shm, opt.world_size, rank, allreduce_floats(encoder, decoder))) return 1;
+        tcfg.allreduce = &allreduce;
+        std::cout << "Rank " << rank << " of " << opt.world_size << ": " << opt.batch_size << " triples per rank, "
+                  << opt.batch_size * opt.world_size << " per step\n";
+    }
+    Trainer trainer(encoder, decoder, optim, g, rev_ptr, train.data, train.size, tcfg, rng);
+
+    if (!opt.resume.empty()) {
+        if (!restore_model(resume_view, encoder, decoder, optim)) return 1;
+        const TrainProgress& p = resume_view.meta().progress;
+        if (p.valid) {
+            trainer.restore(p);
+            if (rank > 0) rng = XorShift128Plus(p.rng_s0 ^ mix_seed(rank), (uint64_t{1} << 32) + rank);
+        } else {
+            std::cerr << "Warning: checkpoint has no training progress; restarting at epoch 1.\n";
+        }
+        std::cout << "Resumed from " << opt.resume << " at step " << optim.step_count()
+                  << ", epoch " << (trainer.epoch() + 1) << "\n";
+    }
 
-    size_t neg_per = opt.negatives;
-    size_t layer_L = ecfg.fanouts.size();
+    std::unique_ptr<AsyncCheckpointer> periodic;
+    if (rank == 0 && (opt.checkpoint_every_steps > 0 || opt.checkpoint_every_seconds > 0.0)) {
+        periodic = std::make_unique<AsyncCheckpointer>(opt.checkpoint, opt.keep_checkpoints);
+    }
+    auto last_snapshot = std::chrono::steady_clock::now();
+    // Each rank writes its own metrics file; rank r > 0 appends ".rank<r>".
+    std::string metrics_path = opt.metrics_file;
+    if (!metrics_path.empty() && rank > 0) metrics_path += ".rank" + std::to_string(rank);
+    if (!metrics.open(metrics_path, opt.metrics_every)) return 1;
+    // Opened after the checkpointer thread so only training work is counted.
+    PerfCounters perf;
+    if (opt.perf) {
+        perf.open();
+        std::cout << "Perf " << perf.status() << "\n";
+        metrics.set_perf(&perf);
+    }
 
-    for (size_t epoch = 0; epoch < opt.epochs; ++epoch) {
-        shuffle_indices(order, rng);
+    for (; trainer.epoch() < opt.epochs; trainer.next_epoch()) {
         double epoch_loss = 0.0;
         size_t batches = 0;
+        size_t rows = 0, nodes = 0, triples = 0, history_reads = 0, micro_batches = 0;
+        const PhaseTimes phases_before = metrics.totals().phases;
         auto t0 = std::chrono::steady_clock::now();
+        PageFaults f0 = page_faults();
 
-        for (size_t start = 0; start < total; start += opt.batch_size) {
-            size_t end = std::min(total, start + opt.batch_size);
-            size_t bs = end - start;
-            std::vector<uint32_t> heads(bs), rels(bs), tails(bs);
-            for (size_t i = 0; i < bs; ++i) {
-                const Triple& tr = train[order[start + i]];
-                heads[i] = tr.h;
-                rels[i] = tr.r;
-                tails[i] = tr.t;
-            }
-
-            std::vector<uint32_t> neg_tails(bs * neg_per);
-            for (size_t i = 0; i < bs * neg_per; ++i) {
-                neg_tails[i] = sample_negative(g.num_nodes(), rng);
+        BatchResult br;
+        while (trainer.step(br)) {
+            if (periodic) {
+                auto now = std::chrono::steady_clock::now();
+                bool due = opt.checkpoint_every_steps > 0
+                               ? optim.step_count() % opt.checkpoint_every_steps == 0
+                               : std::chrono::duration<double>(now - last_snapshot).count() >= opt.checkpoint_every_seconds;
+                if (due) {
+                    TrainProgress progress = trainer.progress();
+                    take_snapshot(encoder, decoder, fcfg, &optim, periodic->acquire(), &progress);
+                    periodic->submit(optim.step_count());
+                    last_snapshot = now;
+                }
             }
 
-            std::unordered_set<uint32_t> seed_set;
-            seed_set.reserve(bs * (2 + neg_per) + 1);
-            for (uint32_t v : heads) seed_set.insert(v);
-            for (uint32_t v : tails) seed_set.insert(v);
-            for (uint32_t v : neg_tails) seed_set.insert(v);
-            std::vector<uint32_t> batch_nodes(seed_set.begin(), seed_set.end());
-
-            optim.zero_grad();
-            EncoderState st = encoder.forward(g, rev_ptr, batch_nodes, rng);
-            std::vector<std::vector<float>> grad_layers(layer_L + 1);
-            grad_layers[layer_L].assign(st.sg.nodes_per_layer[layer_L].size() * ecfg.hidden_dim, 0.0f);
-
-            const auto& index_map = st.index_per_layer[layer_L];
-            const auto& embeds = st.h_layers[layer_L];
-
-            float loss_tail = decoder.distmult_loss(heads, rels, tails, neg_tails, neg_per,
-                                                    index_map, embeds, grad_layers[layer_L]);
-            float loss_rel = decoder.relation_loss(heads, tails, rels, index_map, embeds,
-                                                   grad_layers[layer_L], opt.lambda_rel);
-
-            encoder.backward(st, grad_layers);
-            optim.step();
-
-            epoch_loss += (loss_tail + loss_rel);
+            epoch_loss += (br.loss_tail + br.loss_rel);
+            rows += br.rows;
+            nodes += br.nodes;
+            triples += br.triples;
+            history_reads += br.history_reads;
+            micro_batches += br.micro_batches;
             ++batches;
+            metrics.add(br, trainer.epoch());
         }
+        metrics.flush(trainer.epoch());
 
         auto t1 = std::chrono::steady_clock::now();
         double dt = std::chrono::duration<double>(t1 - t0).count();
         double avg = batches ? (epoch_loss / batches) : 0.0;
-        std::cout << "Epoch " << (epoch + 1) << "/" << opt.epochs
+        PageFaults f1 = page_faults();
+        std::cout << "Epoch " << (trainer.epoch() + 1) << "/" << opt.epochs
                   << " batches=" << batches << " loss=" << avg
-                  << " time=" << dt << "s\n";
+                  << " time=" << dt << "s faults=" << (f1.minor - f0.minor) << "/" << (f1.major - f0.major)
+                  << " triples/s=" << (dt > 0 ? triples / dt : 0.0)
+                  << " nodes/batch=" << (batches ? nodes / batches : 0) << " rows/batch=" << (batches ? rows / batches : 0);
+        if (history.enabled()) std::cout << " history_reads/batch=" << history_reads / std::max<size_t>(1, batches);
+        if (tcfg.mem_budget > 0) {
+            std::cout << " passes/batch=" << static_cast<double>(micro_batches) / std::max<size_t>(1, batches);
+        }
+        PhaseTimes epoch_phases = metrics.totals().phases;
+        for (size_t i = 0; i < kPhaseCount; ++i) epoch_phases.seconds[i] -= phases_before.seconds[i];
+        std::cout << "\n  phases:";
+        print_phase_breakdown(std::cout, epoch_phases);
+        std::cout << "\n";
+    }
+    const MetricsWindow& total = metrics.totals();
+    if (total.wall > 0.0) {
+        std::cout << "Throughput: " << total.triples / total.wall << " triples/s, " << total.edges / total.wall
+                  << " sampled edges/s over " << total.wall << " s\n";
+    }
+    if (opt.perf) {
+        std::cout << "Counters per phase:\n";
+        print_phase_counters(std::cout, perf, total.phases, static_cast<double>(total.edges));
     }
+    std::cout << "Memory: ";
+    print_memory_report(std::cout, memory);
+    std::cout << "\n";
+    if (tcfg.mem_budget > 0) {
+        const AdaptiveBatch& sizer = trainer.batch_sizer();
+        std::cout << "Memory budget " << opt.mem_budget_mb << " MB: " << sizer.retries()
+                  << " micro-batches resampled smaller, " << sizer.over_budget() << " single triples over budget\n";
+    }
+    if (!metrics.finish()) return 1;
 
-    if (!save_checkpoint(opt.checkpoint, encoder, decoder, fcfg, &optim)) {
+    if (periodic) {
+        periodic->drain();
+        std::cout << "Periodic checkpoints written: " << periodic->written()
+                  << " failed: " << periodic->failed() << "\n";
+    }
+    if (rank > 0) return 0;
+    TrainProgress progress = trainer.progress();
+    if (!save_checkpoint(opt.checkpoint, encoder, decoder, fcfg, &optim, &progress)) {
         std::cerr << "Failed to write checkpoint\n";
         return 1;
     }
@@ -0,0 +1,422 @@
+#include "config_file.hpp"
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "inference.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "optim.hpp"
+#include "rng.hpp"
+#include "threadpool.hpp"
+#include "trainer.hpp"
+#include "tune.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct TuneOptions {
+    std::string data_dir = "data";
+    std::string reverse_dir;
+    std::string train_file;
+    std::string output = "tuned.conf";
+    std::string only;                  // "train" or "inference": tune just that section
+    size_t dim = 64;
+    int layers = 2;
+    size_t fanout1 = 20;
+    size_t fanout2 = 10;
+    size_t negatives = 5;
+    bool bf16_activations = false;
+    std::vector<size_t> batches = {128, 256, 512, 1024, 2048};
+    std::vector<std::pair<size_t, size_t>> fanouts; // empty: only --fanout1/--fanout2
+    InferenceMode inference = InferenceMode::Full;
+    std::vector<size_t> threads;       // empty: powers of two up to the core count, and the core count
+    std::vector<size_t> chunk_nodes = {256, 1024, 4096};
+    std::vector<size_t> batch_nodes = {256, 1024, 4096};
+    bool halving = true;
+    size_t eta = 3;
+    size_t train_steps = 8;            // timed steps per training trial in the first round
+    size_t cache_builds = 1;           // cache builds per inference trial in the first round
+    size_t mem_ceiling_mb = 0;
+    uint64_t seed = 1;
+};
+
+static void print_usage() {
+    std::cout << "Usage: kg_tune --train train.bin [--data data_dir] [--reverse rev_dir] [--output tuned.conf] "
+                 "[--only train|inference] [--dim D] [--layers L] [--fanout1 F] [--fanout2 F] [--negatives K] "
+                 "[--bf16_activations] [--batches B,B,...] [--fanouts F1,F2;F1,F2;...] "
+                 "[--inference full|fanout|batched] [--threads T,T,...] [--chunk_nodes C,C,...] "
+                 "[--batch_nodes N,N,...] [--search halving|grid] [--eta E] [--train_steps S] [--cache_builds R] "
+                 "[--mem_ceiling_mb MB] [--seed S]\n";
+}
+
+static bool parse_size_list(const std::string& spec, std::vector<size_t>& out) {
+    out.clear();
+    for (const std::string& tok : split_paths(spec)) {
+        const size_t v = std::stoul(tok);
+        if (v == 0) {
+            std::cerr << "List values must be positive: " << spec << "\n";
+            return false;
+        }
+        out.push_back(v);
+    }
+    if (out.empty()) std::cerr << "Empty list: " << spec << "\n";
+    return !out.empty();
+}
+
+static bool parse_args(int argc, char** argv, TuneOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto need = [&](int more) { return i + more < argc; };
+        if ((a == "--data" || a == "-d") && need(1)) {
+            opt.data_dir = argv[++i];
+        } else if (a == "--reverse" && need(1)) {
+            opt.reverse_dir = argv[++i];
+        } else if (a == "--train" && need(1)) {
+            opt.train_file = argv[++i];
+        } else if ((a == "--output" || a == "-o") && need(1)) {
+            opt.output = argv[++i];
+        } else if (a == "--only" && need(1)) {
+            opt.only = argv[++i];
+            if (opt.only != "train" && opt.only != "inference") {
+                std::cerr << "--only takes train or inference\n";
+                return false;
+            }
+        } else if (a == "--dim" && need(1)) {
+            opt.dim = std::stoul(argv[++i]);
+        } else if (a == "--layers" && need(1)) {
+            opt.layers = std::stoi(argv[++i]);
+        } else if (a == "--fanout1" && need(1)) {
+            opt.fanout1 = std::stoul(argv[++i]);
+        } else if (a == "--fanout2" && need(1)) {
+            opt.fanout2 = std::stoul(argv[++i]);
+        } else if (a == "--negatives" && need(1)) {
+            opt.negatives = std::stoul(argv[++i]);
+        } else if (a == "--bf16_activations") {
+            opt.bf16_activations = true;
+        } else if (a == "--batches" && need(1)) {
+            if (!parse_size_list(argv[++i], opt.batches)) return false;
+        } else if (a == "--fanouts" && need(1)) {
+            opt.fanouts.clear();
+            for (const std::string& pair : split_paths(argv[++i], ';')) {
+                std::vector<size_t> f;
+                if (!parse_size_list(pair, f) || f.size() != 2) {
+                    std::cerr << "--fanouts takes F1,F2 pairs separated by ';'\n";
+                    return false;
+                }
+                opt.fanouts.emplace_back(f[0], f[1]);
+            }
+        } else if (a == "--inference" && need(1)) {
+            if (!parse_inference_mode(argv[++i], opt.inference)) return false;
+        } else if (a == "--threads" && need(1)) {
+            if (!parse_size_list(argv[++i], opt.threads)) return false;
+        } else if (a == "--chunk_nodes" && need(1)) {
+            if (!parse_size_list(argv[++i], opt.chunk_nodes)) return false;
+        } else if (a == "--batch_nodes" && need(1)) {
+            if (!parse_size_list(argv[++i], opt.batch_nodes)) return false;
+        } else if (a == "--search" && need(1)) {
+            std::string s = argv[++i];
+            if (s != "halving" && s != "grid") {
+                std::cerr << "--search takes halving or grid\n";
+                return false;
+            }
+            opt.halving = s == "halving";
+        } else if (a == "--eta" && need(1)) {
+            opt.eta = std::max<size_t>(2, std::stoul(argv[++i]));
+        } else if (a == "--train_steps" && need(1)) {
+            opt.train_steps = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--cache_builds" && need(1)) {
+            opt.cache_builds = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (a == "--mem_ceiling_mb" && need(1)) {
+            opt.mem_ceiling_mb = std::stoul(argv[++i]);
+        } else if (a == "--seed" && need(1)) {
+            opt.seed = std::stoull(argv[++i]);
+        } else if (a == "--help" || a == "-h") {
+            print_usage();
+            return false;
+        } else {
+            std::cerr << "Unknown or incomplete argument: " << a << "\n";
+            print_usage();
+            return false;
+        }
+    }
+    if (opt.train_file.empty() && opt.only != "inference") {
+        std::cerr << "--train is required unless --only inference\n";
+        print_usage();
+        return false;
+    }
+    return true;
+}
+
+static EncoderConfig encoder_config(const TuneOptions& opt, size_t fanout1, size_t fanout2) {
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = opt.dim;
+    ecfg.layers = opt.layers;
+    ecfg.use_relu = true;
+    ecfg.bf16_activations = opt.bf16_activations;
+    ecfg.fanouts.clear();
+    for (int l = 0; l < ecfg.layers; ++l) ecfg.fanouts.push_back(l == 0 ? fanout1 : fanout2);
+    return ecfg;
+}
+
+static size_t to_mb(size_t bytes) {
+    return std::max<size_t>(1, bytes >> 20);
+}
+
+// Graph and model inputs shared by every trial.
+struct TuneSetup {
+    const TuneOptions& opt;
+    const CsrGraph& g;
+    const CsrGraph* rev;
+    FeatureConfig fcfg;
+    size_t feat_dim = 0;
+    const Triple* triples = nullptr;
+    size_t count = 0;
+};
+
+// Bytes that stay resident through training regardless of the batch size:
+// parameters, their gradients and the optimizer moments.
+static size_t model_bytes(const std::vector<Parameter*>& params, const Optimizer& optim) {
+    size_t bytes = 0;
+    for (const Parameter* p : params) bytes += (p->data.size() + p->grad.size()) * sizeof(float);
+    for (const auto& m : optim.m()) bytes += m.size() * sizeof(float);
+    for (const auto& v : optim.v()) bytes += v.size() * sizeof(float);
+    return bytes;
+}
+
+struct TrainCandidate {
+    size_t batch = 0;
+    size_t fanout1 = 0;
+    size_t fanout2 = 0;
+    size_t model_bytes = 0; // set by train_trial
+};
+
+// A fresh model trained for one warm-up step and then `steps` timed steps of
+// `batch` triples. Under a ceiling the activation budget is whatever the model
+// leaves, so oversized batches run as several passes and are timed that way.
+static void train_trial(const TuneSetup& s, TrainCandidate& c, size_t steps, TuneTrial& trial) {
+    const TuneOptions& opt = s.opt;
+    XorShift128Plus rng(opt.seed);
+    Encoder enc(s.feat_dim, s.g.num_relations(), encoder_config(opt, c.fanout1, c.fanout2), s.fcfg, rng);
+    Decoder dec(s.g.num_relations(), opt.dim, enc.relation_embeddings(), rng);
+    std::vector<Parameter*> params = enc.parameters();
+    auto dparams = dec.parameters();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    Optimizer optim(OptimConfig(), params);
+    const size_t ceiling = opt.mem_ceiling_mb << 20;
+    const size_t fixed = model_bytes(params, optim);
+    c.model_bytes = fixed;
+    if (ceiling > 0 && fixed >= ceiling) {
+        trial.fits = false;
+        return;
+    }
+    MemoryAccount mem;
+    TrainConfig tcfg;
+    tcfg.batch_size = c.batch;
+    tcfg.negatives = opt.negatives;
+    tcfg.shuffle_seed = opt.seed;
+    tcfg.mem_budget = ceiling > 0 ? ceiling - fixed : 0;
+    tcfg.memory = &mem;
+    Trainer trainer(enc, dec, optim, s.g, s.rev, s.triples, s.count, tcfg, rng);
+    BatchResult br;
+    while (!trainer.step(br)) trainer.next_epoch();
+    size_t triples = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < steps; ++i) {
+        while (!trainer.step(br)) trainer.next_epoch();
+        triples += br.triples;
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    trial.rate = secs > 0.0 ? static_cast<double>(triples) / secs : 0.0;
+    trial.peak_bytes = mem.peak_total();
+}
+
+// `builds` full embedding-cache builds under `icfg`, with the output table
+// and in-flight layers counted against the ceiling.
+static void cache_trial(const TuneSetup& s, Encoder& enc, InferenceConfig icfg, size_t builds, TuneTrial& trial) {
+    const size_t ceiling = s.opt.mem_ceiling_mb << 20;
+    const size_t table = static_cast<size_t>(s.g.num_nodes()) * enc.output_dim() * sizeof(float);
+    if (ceiling > 0) {
+        // Layer-wise holds two layers besides the table; batched gets what
+        // the table leaves.
+        const size_t need = icfg.mode == InferenceMode::Batched ? table : 3 * table;
+        if (need >= ceiling) {
+            trial.fits = false;
+            return;
+        }
+        if (icfg.mode == InferenceMode::Batched) icfg.mem_budget = ceiling - table;
+    }
+    MemoryAccount mem;
+    icfg.memory = &mem;
+    // node_embeddings reports each build; keep the trial log readable.
+    std::cout.setstate(std::ios::failbit);
+    bool ok = true;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < builds && ok; ++i) {
+        EmbeddingTable out;
+        ok = node_embeddings(enc, s.g, s.rev, icfg, 0, out);
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout.clear();
+    trial.rate = ok && secs > 0.0 ? static_cast<double>(s.g.num_nodes()) * builds / secs : 0.0;
+    trial.peak_bytes = mem.peak_total();
+    if (!ok) trial.fits = false;
+}
+
+static std::string fanout_label(size_t f1, size_t f2) {
+    return std::to_string(f1) + "," + std::to_string(f2);
+}
+
+int main(int argc, char** argv) {
+    TuneOptions opt;
+    if (!parse_args(argc, argv, opt)) return 1;
+
+    CsrGraph g(opt.data_dir);
+    if (!g.valid()) {
+        std::cerr << "Failed to load CSR from " << opt.data_dir << "\n";
+        return 1;
+    }
+    CsrGraph* rev_ptr = nullptr;
+    CsrGraph rev;
+    if (!opt.reverse_dir.empty()) {
+        if (rev.load_custom(opt.reverse_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin",
+                            "entities.bin", "props.bin", "delta_rev.bin")) {
+            rev_ptr = &rev;
+        } else {
+            std::cerr << "Warning: reverse CSR could not be loaded; continuing without it.\n";
+        }
+    }
+    MMapArray<Triple> train;
+    if (!opt.train_file.empty() && !map_triples(opt.train_file, train)) {
+        std::cerr << "Failed to map training triples.\n";
+        return 1;
+    }
+
+    TuneSetup setup{opt, g, rev_ptr, FeatureConfig(), 0, nullptr, 0};
+    setup.fcfg.use_in_degree = rev_ptr != nullptr;
+    setup.feat_dim = feature_dim(setup.fcfg, rev_ptr != nullptr);
+    setup.triples = train.data;
+    setup.count = train.size;
+    const size_t ceiling = opt.mem_ceiling_mb << 20;
+    std::cout << "Tuning on nodes=" << g.num_nodes() << " edges=" << g.num_edges() << " with "
+              << (opt.halving ? "successive halving (eta=" + std::to_string(opt.eta) + ")" : std::string("a grid"))
+              << (ceiling ? ", memory ceiling " + std::to_string(opt.mem_ceiling_mb) + "MB" : std::string()) << "\n";
+
+    std::ostringstream header;
+    header << "kg_tune on " << opt.data_dir << " (" << g.num_nodes() << " nodes, " << g.num_edges() << " edges), "
+           << default_threads() << " cores";
+    if (ceiling) header << ", memory ceiling " << opt.mem_ceiling_mb << "MB";
+    header << "\ndim=" << opt.dim << " layers=" << opt.layers << " negatives=" << opt.negatives;
+    std::vector<std::pair<std::string, ConfigEntries>> sections;
+
+    if (opt.only != "inference") {
+        if (setup.count == 0) {
+            std::cerr << "No training triples in " << opt.train_file << "\n";
+            return 1;
+        }
+        std::vector<std::pair<size_t, size_t>> fanouts = opt.fanouts;
+        if (fanouts.empty()) fanouts.emplace_back(opt.fanout1, opt.fanout2);
+        std::vector<TuneTrial> trials;
+        std::vector<TrainCandidate> cands;
+        for (const auto& [f1, f2] : fanouts) {
+            for (size_t b : opt.batches) {
+                cands.push_back({b, f1, f2});
+                TuneTrial t;
+                t.label = "batch=" + std::to_string(b) + " fanouts=" + fanout_label(f1, f2);
+                t.flags = {{"batch", std::to_string(b)}, {"fanout1", std::to_string(f1)},
+                           {"fanout2", std::to_string(f2)}};
+                trials.push_back(std::move(t));
+            }
+        }
+        TuneSearch search;
+        search.halving = opt.halving;
+        search.eta = opt.eta;
+        search.units = opt.train_steps;
+        search.mem_ceiling = ceiling;
+        search.unit = "triples";
+        std::cout << "Training step (" << trials.size() << " candidates):\n";
+        const int best = run_search(trials, search, [&](TuneTrial& t, size_t units) {
+            train_trial(setup, cands[&t - trials.data()], units, t);
+        }, std::cout);
+        if (best < 0) {
+            std::cerr << "No training configuration fits under the memory ceiling\n";
+            return 1;
+        }
+        TuneTrial& win = trials[best];
+        std::cout << "Best training: " << win.label << " (" << std::llround(win.rate) << " triples/s)\n";
+        // The model shape the trials ran with, so that kg_train matches them.
+        ConfigEntries entries = {{"dim", std::to_string(opt.dim)}, {"layers", std::to_string(opt.layers)},
+                                 {"negatives", std::to_string(opt.negatives)}};
+        if (opt.bf16_activations) entries.emplace_back("bf16_activations", "");
+        entries.insert(entries.end(), win.flags.begin(), win.flags.end());
+        // The activation budget the winner ran under.
+        if (ceiling) entries.emplace_back("mem_budget_mb", std::to_string(to_mb(ceiling - cands[best].model_bytes)));
+        header << "\ntrain: " << win.label << ", " << std::llround(win.rate) << " triples/s";
+        sections.emplace_back("train", std::move(entries));
+    }
+
+    if (opt.only != "train") {
+        std::vector<size_t> threads = opt.threads;
+        if (threads.empty()) {
+            const size_t cores = default_threads();
+            for (size_t t = 1; t < cores; t *= 2) threads.push_back(t);
+            threads.push_back(cores);
+        }
+        const bool batched = opt.inference == InferenceMode::Batched;
+        const std::vector<size_t>& sizes = batched ? opt.batch_nodes : opt.chunk_nodes;
+        const char* size_flag = batched ? "batch_nodes" : "chunk_nodes";
+        const char* mode_name = batched ? "batched" : opt.inference == InferenceMode::Fanout ? "fanout" : "full";
+        std::vector<TuneTrial> trials;
+        std::vector<InferenceConfig> cands;
+        for (size_t t : threads) {
+            for (size_t n : sizes) {
+                InferenceConfig icfg;
+                icfg.mode = opt.inference;
+                icfg.seed = opt.seed;
+                icfg.threads = t;
+                (batched ? icfg.batch_nodes : icfg.chunk_nodes) = n;
+                cands.push_back(icfg);
+                TuneTrial trial;
+                trial.label = "threads=" + std::to_string(t) + " " + size_flag + "=" + std::to_string(n);
+                trial.flags = {{"inference", mode_name}, {"threads", std::to_string(t)}, {size_flag, std::to_string(n)}};
+                trials.push_back(std::move(trial));
+            }
+        }
+        // Throughput does not depend on the weights, so a freshly initialised
+        // encoder of the configured shape stands in for the trained one.
+        XorShift128Plus rng(opt.seed);
+        Encoder enc(setup.feat_dim, g.num_relations(), encoder_config(opt, opt.fanout1, opt.fanout2), setup.fcfg, rng);
+        TuneSearch search;
+        search.halving = opt.halving;
+        search.eta = opt.eta;
+        search.units = opt.cache_builds;
+        search.mem_ceiling = ceiling;
+        search.unit = "nodes";
+        std::cout << "Cache build, " << mode_name << " (" << trials.size() << " candidates):\n";
+        const int best = run_search(trials, search, [&](TuneTrial& t, size_t units) {
+            cache_trial(setup, enc, cands[&t - trials.data()], units, t);
+        }, std::cout);
+        if (best < 0) {
+            std::cerr << "No inference configuration fits under the memory ceiling\n";
+            return 1;
+        }
+        TuneTrial& win = trials[best];
+        std::cout << "Best cache build: " << win.label << " (" << std::llround(win.rate) << " nodes/s)\n";
+        ConfigEntries entries = win.flags;
+        if (ceiling && batched) {
+            const size_t table = static_cast<size_t>(g.num_nodes()) * enc.output_dim() * sizeof(float);
+            entries.emplace_back("mem_budget_mb", std::to_string(to_mb(ceiling - table)));
+        }
+        header << "\ninference: " << win.label << ", " << std::llround(win.rate) << " nodes/s";
+        sections.emplace_back("inference", std::move(entries));
+    }
+
+    if (!write_config_file(opt.output, header.str(), sections)) return 1;
+    std::cout << "Wrote " << opt.output << "\n";
+    return 0;
+}
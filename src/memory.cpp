@@ -0,0 +1,103 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+const char* mem_kind_name(MemKind k) {
+    switch (k) {
+    case MemKind::Parameters: return "parameters";
+    case MemKind::Gradients: return "gradients";
+    case MemKind::Optimizer: return "optimizer";
+    case MemKind::Activations: return "activations";
+    case MemKind::Cache: return "cache";
+    case MemKind::History: return "history";
+    case MemKind::Count: break;
+    }
+    return "?";
+}
+
+void MemoryAccount::set(MemKind k, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mu_);
+    const size_t i = static_cast<size_t>(k);
+    total_ = total_ - current_[i] + bytes;
+    current_[i] = bytes;
+    peak_[i] = std::max(peak_[i], bytes);
+    peak_total_ = std::max(peak_total_, total_);
+}
+
+size_t MemoryAccount::current(MemKind k) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return current_[static_cast<size_t>(k)];
+}
+
+size_t MemoryAccount::peak(MemKind k) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return peak_[static_cast<size_t>(k)];
+}
+
+size_t MemoryAccount::total() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return total_;
+}
+
+size_t MemoryAccount::peak_total() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return peak_total_;
+}
+
+size_t current_rss_bytes() {
+    std::FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long size = 0, resident = 0;
+    const int got = std::fscanf(f, "%lu %lu", &size, &resident);
+    std::fclose(f);
+    if (got != 2) return 0;
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t peak_rss_bytes() {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return static_cast<size_t>(ru.ru_maxrss) * 1024; // kilobytes on Linux
+}
+
+void print_memory_report(std::ostream& os, const MemoryAccount& mem) {
+    auto mb = [](size_t bytes) { return static_cast<double>(bytes) / (1 << 20); };
+    os << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < kMemKindCount; ++i) {
+        const size_t peak = mem.peak(static_cast<MemKind>(i));
+        if (peak > 0) os << mem_kind_name(static_cast<MemKind>(i)) << "=" << mb(peak) << "MB ";
+    }
+    os << "tracked peak=" << mb(mem.peak_total()) << "MB rss=" << mb(current_rss_bytes()) << "MB peak rss="
+       << mb(peak_rss_bytes()) << "MB" << std::defaultfloat << std::setprecision(6);
+}
+
+// Offers aim this far under the budget, so that batches a little denser than
+// the estimate still fit.
+static constexpr double kBudgetHeadroom = 0.9;
+
+size_t AdaptiveBatch::next(size_t remaining) const {
+    size_t n = max_items_;
+    if (budget_ > 0 && per_item_ > 0.0) {
+        n = std::min(n, static_cast<size_t>(kBudgetHeadroom * static_cast<double>(budget_) / per_item_));
+    }
+    return std::max<size_t>(1, std::min(n, remaining));
+}
+
+bool AdaptiveBatch::accept(size_t items, size_t bytes) {
+    const double per_item = static_cast<double>(bytes) / static_cast<double>(std::max<size_t>(1, items));
+    if (budget_ > 0 && bytes > budget_ && items > 1) {
+        // Smaller batches share fewer neighbours, so the per-item cost only
+        // rises as the count shrinks: never retry below the observed rate.
+        per_item_ = std::max(per_item_, per_item);
+        ++retries_;
+        return false;
+    }
+    if (budget_ > 0 && bytes > budget_) ++over_budget_;
+    per_item_ = per_item_ == 0.0 ? per_item : 0.8 * per_item_ + 0.2 * per_item;
+    return true;
+}
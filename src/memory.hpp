@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+
+enum class MemKind : size_t {
+    Parameters,  // model weights
+    Gradients,   // parameter gradients plus the activation gradients of backward
+    Optimizer,   // Adam moments
+    Activations, // EncoderState of the batch in flight; in-RAM layers of layer-wise inference
+    Cache,       // the node embedding table
+    History,     // HistoryStore rows and stamps
+    Count,
+};
+
+constexpr size_t kMemKindCount = static_cast<size_t>(MemKind::Count);
+const char* mem_kind_name(MemKind k);
+
+// Bytes held by the large training and inference buffers, per kind, with the
+// high-water mark of each kind and of their sum. Owners report a buffer's
+// size with set() when they (re)size or release it; thread-safe.
+class MemoryAccount {
+public:
+    void set(MemKind k, size_t bytes);
+    size_t current(MemKind k) const;
+    size_t peak(MemKind k) const;
+    size_t total() const;
+    size_t peak_total() const;
+
+private:
+    mutable std::mutex mu_;
+    size_t current_[kMemKindCount] = {};
+    size_t peak_[kMemKindCount] = {};
+    size_t total_ = 0;
+    size_t peak_total_ = 0;
+};
+
+// Resident set size of the process now (/proc/self/statm) and its high-water
+// mark (getrusage); 0 where unavailable.
+size_t current_rss_bytes();
+size_t peak_rss_bytes();
+
+// "parameters=1.2MB ... tracked peak=40.1MB rss=55.0MB peak rss=61.3MB",
+// listing the peak of every kind that was used.
+void print_memory_report(std::ostream& os, const MemoryAccount& mem);
+
+// Chooses how many items (seeds, or triples) go into each batch so that its
+// predicted bytes stay under `budget`. It offers the largest count that the
+// running bytes-per-item estimate allows. A batch that comes out over budget
+// once sampled is rejected, and the next offer is scaled down by the
+// overshoot, so only the rare hub-heavy batch is sampled twice. A single item
+// is always accepted, over budget or not. With budget 0 every offer is
+// max_items.
+class AdaptiveBatch {
+public:
+    AdaptiveBatch(size_t budget, size_t max_items) : budget_(budget), max_items_(max_items) {}
+
+    size_t budget() const { return budget_; }
+    // Items for the next batch, at least 1 and at most `remaining`.
+    size_t next(size_t remaining) const;
+    // Reports the predicted bytes of a sampled batch of `items`; false when
+    // it must be retried with fewer.
+    bool accept(size_t items, size_t bytes);
+    size_t retries() const { return retries_; }
+    size_t over_budget() const { return over_budget_; }
+    // The bytes-per-item estimate; training progress carries it so that a
+    // resumed run offers the same counts as an uninterrupted one.
+    double estimate() const { return per_item_; }
+    void set_estimate(double per_item) { per_item_ = per_item; }
+
+private:
+    size_t budget_;
+    size_t max_items_;
+    double per_item_ = 0.0; // moving estimate of bytes per item
+    size_t retries_ = 0;
+    size_t over_budget_ = 0;
+};
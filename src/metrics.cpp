@@ -1,5 +1,7 @@
 #include "metrics.hpp"
 
+#include <vector>
+
 void accumulate_rank(Metrics& m, size_t rank) {
     ++m.count;
     m.mrr += 1.0 / static_cast<double>(rank);
@@ -18,3 +20,25 @@ void finalize_metrics(Metrics& m) {
     m.hits10 *= inv;
     m.hits100 *= inv;
 }
+
+size_t tail_rank(const float* rows, uint32_t nodes, size_t dim, const float* h, const float* rvec, uint32_t t,
+                 const std::unordered_set<uint32_t>* known) {
+    // h[d] * r[d] is hoisted; the products are formed in the same order as
+    // h[d] * r[d] * t[d], so the scores are unchanged.
+    std::vector<float> q(dim);
+    for (size_t d = 0; d < dim; ++d) q[d] = h[d] * rvec[d];
+    const float* t_row = rows + static_cast<size_t>(t - 1) * dim;
+    float true_score = 0.0f;
+    for (size_t d = 0; d < dim; ++d) true_score += q[d] * t_row[d];
+
+    size_t rank = 1;
+    for (uint32_t cand = 1; cand <= nodes; ++cand) {
+        if (cand == t) continue;
+        if (known && known->count(cand)) continue;
+        const float* row = rows + static_cast<size_t>(cand - 1) * dim;
+        float score = 0.0f;
+        for (size_t d = 0; d < dim; ++d) score += q[d] * row[d];
+        if (score > true_score) ++rank;
+    }
+    return rank;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <unordered_set>
 
 struct Metrics {
     double mrr = 0.0;
@@ -13,3 +15,9 @@ struct Metrics {
 
 void accumulate_rank(Metrics& m, size_t rank);
 void finalize_metrics(Metrics& m);
+
+// Filtered rank of tail t for the query (h, r): one plus the number of nodes
+// other than t, and not in `known` (may be null), whose DistMult score beats
+// t's. `rows` holds nodes x dim floats, row v-1 for node v.
+size_t tail_rank(const float* rows, uint32_t nodes, size_t dim, const float* h, const float* rvec, uint32_t t,
+                 const std::unordered_set<uint32_t>* known);
@@ -1,9 +1,50 @@
 #include "optim.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <utility>
 
-Parameter::Parameter(size_t n, float init) {
-    data.assign(n, init);
+ParamStorage& ParamStorage::operator=(const ParamStorage& other) {
+    if (this == &other) return *this;
+    if (other.borrowed_) {
+        owned_.clear();
+        ptr_ = other.ptr_;
+    } else {
+        owned_ = other.owned_;
+        ptr_ = owned_.data();
+    }
+    size_ = other.size_;
+    borrowed_ = other.borrowed_;
+    return *this;
+}
+
+ParamStorage& ParamStorage::operator=(ParamStorage&& other) noexcept {
+    if (this == &other) return *this;
+    owned_ = std::move(other.owned_);
+    ptr_ = other.borrowed_ ? other.ptr_ : owned_.data();
+    size_ = other.size_;
+    borrowed_ = other.borrowed_;
+    other.ptr_ = nullptr;
+    other.size_ = 0;
+    other.borrowed_ = false;
+    return *this;
+}
+
+void ParamStorage::assign(const float* src, size_t n) {
+    owned_.assign(src, src + n);
+    ptr_ = owned_.data();
+    size_ = n;
+    borrowed_ = false;
+}
+
+void ParamStorage::borrow(const float* src, size_t n) {
+    std::vector<float>().swap(owned_);
+    ptr_ = const_cast<float*>(src);
+    size_ = n;
+    borrowed_ = true;
+}
+
+Parameter::Parameter(size_t n, float init) : data(n, init) {
     grad.assign(n, 0.0f);
 }
 
@@ -57,10 +98,10 @@ void Optimizer::step() {
 void Optimizer::set_state(const std::vector<std::vector<float>>& m,
                           const std::vector<std::vector<float>>& v,
                           size_t t) {
+    t_ = t;
     if (!cfg_.use_adam) return;
     if (m.size() == params_.size() && v.size() == params_.size()) {
         m_ = m;
         v_ = v;
-        t_ = t;
     }
 }
@@ -1,10 +1,44 @@
 #pragma once
 
 #include <cstddef>
+#include <string>
 #include <vector>
 
+// Element storage of a Parameter. It normally owns its floats; inference tools
+// instead borrow weights that live inside a mapped checkpoint. Borrowed storage
+// is read-only and must not outlive the mapping.
+class ParamStorage {
+public:
+    ParamStorage() = default;
+    ParamStorage(size_t n, float init) : owned_(n, init), ptr_(owned_.data()), size_(n) {}
+    ParamStorage(const ParamStorage& other) { *this = other; }
+    ParamStorage(ParamStorage&& other) noexcept { *this = std::move(other); }
+    ParamStorage& operator=(const ParamStorage& other);
+    ParamStorage& operator=(ParamStorage&& other) noexcept;
+
+    void assign(const float* src, size_t n);
+    void borrow(const float* src, size_t n);
+    bool borrowed() const { return borrowed_; }
+
+    float* data() { return ptr_; }
+    const float* data() const { return ptr_; }
+    size_t size() const { return size_; }
+    float& operator[](size_t i) { return ptr_[i]; }
+    const float& operator[](size_t i) const { return ptr_[i]; }
+    float* begin() { return ptr_; }
+    float* end() { return ptr_ + size_; }
+    const float* begin() const { return ptr_; }
+    const float* end() const { return ptr_ + size_; }
+
+private:
+    std::vector<float> owned_;
+    float* ptr_ = nullptr;
+    size_t size_ = 0;
+    bool borrowed_ = false;
+};
+
 struct Parameter {
-    std::vector<float> data;
+    ParamStorage data;
     std::vector<float> grad;
 
     Parameter() = default;
@@ -13,6 +47,13 @@ struct Parameter {
     size_t size() const { return data.size(); }
 };
 
+// Name and element count of a parameter, in parameters() order. Names key the
+// tensors of a v2 checkpoint.
+struct ParamSpec {
+    std::string name;
+    size_t size = 0;
+};
+
 struct OptimConfig {
     float lr = 0.001f;
     bool use_adam = true;
@@ -0,0 +1,173 @@
+#include "packed_adj.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+static inline uint32_t num_blocks(uint32_t degree) { return (degree + kPackedBlock - 1) / kPackedBlock; }
+
+static inline size_t rel_bytes(uint32_t degree, uint32_t width) {
+    return (static_cast<size_t>(degree) * width + 7) / 8;
+}
+
+static inline uint32_t load_u32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t value_len(uint32_t v) {
+    return v < (1u << 8) ? 1 : v < (1u << 16) ? 2 : v < (1u << 24) ? 3 : 4;
+}
+
+void packed_encode(const uint32_t* dst, const uint16_t* rel, uint32_t degree, std::vector<uint8_t>& out) {
+    if (degree == 0) return;
+    std::vector<uint64_t> keys(degree);
+    uint16_t max_rel = 0;
+    for (uint32_t i = 0; i < degree; ++i) {
+        keys[i] = (static_cast<uint64_t>(dst[i]) << 16) | rel[i];
+        max_rel = std::max(max_rel, rel[i]);
+    }
+    std::sort(keys.begin(), keys.end());
+    uint32_t width = 0;
+    while (width < 16 && (max_rel >> width) != 0) ++width;
+
+    const size_t start = out.size();
+    const uint32_t nb = num_blocks(degree);
+    out.push_back(static_cast<uint8_t>(width));
+    const size_t skip_at = out.size();
+    out.resize(skip_at + 8 * static_cast<size_t>(nb - 1));
+    const size_t rel_at = out.size();
+    out.resize(rel_at + rel_bytes(degree, width), 0);
+    for (uint32_t i = 0; i < degree; ++i) {
+        uint32_t r = static_cast<uint32_t>(keys[i] & 0xffff);
+        size_t bit = static_cast<size_t>(i) * width;
+        for (uint32_t b = 0; b < width; ++b, ++bit) {
+            if ((r >> b) & 1) out[rel_at + bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+        }
+    }
+
+    uint32_t prev = 0;
+    for (uint32_t k = 0; k < nb; ++k) {
+        const uint32_t first = k * kPackedBlock;
+        const uint32_t count = std::min(kPackedBlock, degree - first);
+        if (k > 0) {
+            uint32_t entry[2] = {static_cast<uint32_t>(out.size() - start), prev};
+            std::memcpy(out.data() + skip_at + 8 * (k - 1), entry, sizeof(entry));
+        }
+        const size_t ctrl_at = out.size();
+        out.resize(ctrl_at + (count + 3) / 4, 0);
+        for (uint32_t j = 0; j < count; ++j) {
+            uint32_t v = static_cast<uint32_t>(keys[first + j] >> 16);
+            uint32_t delta = v - prev;
+            prev = v;
+            uint32_t len = value_len(delta);
+            out[ctrl_at + j / 4] |= static_cast<uint8_t>((len - 1) << (2 * (j % 4)));
+            for (uint32_t b = 0; b < len; ++b) out.push_back(static_cast<uint8_t>(delta >> (8 * b)));
+        }
+    }
+}
+
+// Locates block k of a node: its control bytes and the value preceding it.
+static inline const uint8_t* block_start(const uint8_t* node, uint32_t degree, uint32_t k, uint32_t& base) {
+    const uint32_t nb = num_blocks(degree);
+    if (k == 0) {
+        base = 0;
+        return node + 1 + 8 * static_cast<size_t>(nb - 1) + rel_bytes(degree, node[0]);
+    }
+    const uint8_t* entry = node + 1 + 8 * static_cast<size_t>(k - 1);
+    base = load_u32(entry + 4);
+    return node + load_u32(entry);
+}
+
+uint32_t packed_dst_at(const uint8_t* node, uint32_t degree, uint32_t i) {
+    uint32_t v;
+    const uint32_t k = i / kPackedBlock;
+    const uint32_t j = i % kPackedBlock;
+    const uint8_t* ctrl = block_start(node, degree, k, v);
+    const uint32_t count = std::min(kPackedBlock, degree - k * kPackedBlock);
+    const uint8_t* data = ctrl + (count + 3) / 4;
+    for (uint32_t x = 0; x <= j; ++x) {
+        uint32_t len = ((ctrl[x / 4] >> (2 * (x % 4))) & 3) + 1;
+        v += load_u32(data) & (len == 4 ? 0xffffffffu : ((1u << (8 * len)) - 1));
+        data += len;
+    }
+    return v;
+}
+
+uint16_t packed_rel_at(const uint8_t* node, uint32_t degree, uint32_t i) {
+    const uint32_t width = node[0];
+    const uint8_t* rels = node + 1 + 8 * static_cast<size_t>(num_blocks(degree) - 1);
+    const size_t bit = static_cast<size_t>(i) * width;
+    return static_cast<uint16_t>((load_u32(rels + bit / 8) >> (bit % 8)) & ((1u << width) - 1));
+}
+
+#if defined(__SSSE3__)
+struct GroupTables {
+    std::array<std::array<uint8_t, 16>, 256> shuffle;
+    std::array<uint8_t, 256> length;
+};
+
+static const GroupTables& group_tables() {
+    static const GroupTables tables = [] {
+        GroupTables t;
+        for (uint32_t c = 0; c < 256; ++c) {
+            uint8_t pos = 0;
+            for (uint32_t lane = 0; lane < 4; ++lane) {
+                uint32_t len = ((c >> (2 * lane)) & 3) + 1;
+                for (uint32_t b = 0; b < 4; ++b) t.shuffle[c][4 * lane + b] = b < len ? pos++ : 0x80;
+            }
+            t.length[c] = pos;
+        }
+        return t;
+    }();
+    return tables;
+}
+#endif
+
+void packed_decode(const uint8_t* node, uint32_t degree, uint32_t* dst, uint16_t* rel) {
+    if (degree == 0) return;
+    const uint32_t nb = num_blocks(degree);
+    for (uint32_t k = 0; k < nb; ++k) {
+        uint32_t prev;
+        const uint8_t* ctrl = block_start(node, degree, k, prev);
+        const uint32_t count = std::min(kPackedBlock, degree - k * kPackedBlock);
+        const uint8_t* data = ctrl + (count + 3) / 4;
+        uint32_t* out = dst + k * kPackedBlock;
+        uint32_t j = 0;
+#if defined(__SSSE3__)
+        const GroupTables& t = group_tables();
+        __m128i run = _mm_set1_epi32(static_cast<int>(prev));
+        for (; j + 4 <= count; j += 4) {
+            const uint8_t c = ctrl[j / 4];
+            __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.shuffle[c].data()));
+            __m128i x = _mm_shuffle_epi8(raw, mask);
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, run);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), x);
+            run = _mm_shuffle_epi32(x, 0xff);
+            data += t.length[c];
+        }
+        prev = static_cast<uint32_t>(_mm_cvtsi128_si32(run));
+#endif
+        for (; j < count; ++j) {
+            uint32_t len = ((ctrl[j / 4] >> (2 * (j % 4))) & 3) + 1;
+            prev += load_u32(data) & (len == 4 ? 0xffffffffu : ((1u << (8 * len)) - 1));
+            data += len;
+            out[j] = prev;
+        }
+    }
+    const uint32_t width = node[0];
+    const uint8_t* rels = node + 1 + 8 * static_cast<size_t>(nb - 1);
+    const uint32_t mask = (1u << width) - 1;
+    size_t bit = 0;
+    for (uint32_t i = 0; i < degree; ++i, bit += width) {
+        rel[i] = static_cast<uint16_t>((load_u32(rels + bit / 8) >> (bit % 8)) & mask);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "io.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed adjacency ("<csr>.cbin" + "<csr>.cidx"). Each node's neighbours
+// are sorted by (dst, rel). Destinations are delta-coded in StreamVByte groups
+// of four (one control byte, 1-4 data bytes per value) within blocks of
+// kPackedBlock values; relations are bit-packed at the node's maximum width.
+// Per-node layout, `degree` taken from offsets.bin:
+//
+//   u8   relation bit width w
+//   skip table: for blocks 1..nb-1 {u32 byte offset from node start, u32 last dst of previous block}
+//   ceil(degree * w / 8) bytes of relations
+//   blocks: ceil(count / 4) control bytes, then the data bytes
+//
+// The i-th neighbour is found by jumping to block i / kPackedBlock and decoding
+// at most one block. The .cidx file holds a PackedIndexHeader and then n + 2
+// u64 byte offsets (1-based node IDs, like offsets.bin); the blob ends with
+// kPackedPadding zero bytes so decoders may load past the last value.
+constexpr uint32_t kPackedBlock = 64;
+constexpr size_t kPackedPadding = 16;
+
+// Identifies the raw files a compressed adjacency was encoded from, so that it
+// is not used after they are rewritten. Loading compares the stamps, which
+// costs three stat() calls; kg_compress --verify recomputes raw_checksum (see
+// raw_csr_checksum in csr.hpp).
+struct PackedIndexHeader {
+    uint64_t magic;
+    uint64_t edges;
+    uint64_t raw_checksum;
+    uint64_t reserved;
+    FileStamp offsets;
+    FileStamp csr;
+    FileStamp rels;
+};
+constexpr size_t kPackedIndexHeaderWords = sizeof(PackedIndexHeader) / sizeof(uint64_t);
+constexpr uint64_t kPackedIndexMagic = 0x3258444943474b; // "KGCIDX2"
+
+// Appends the encoding of one node to out.
+void packed_encode(const uint32_t* dst, const uint16_t* rel, uint32_t degree, std::vector<uint8_t>& out);
+
+uint32_t packed_dst_at(const uint8_t* node, uint32_t degree, uint32_t i);
+uint16_t packed_rel_at(const uint8_t* node, uint32_t degree, uint32_t i);
+// Decodes the whole list (SSSE3 when available).
+void packed_decode(const uint8_t* node, uint32_t degree, uint32_t* dst, uint16_t* rel);
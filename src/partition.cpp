@@ -0,0 +1,189 @@
+#include "partition.hpp"
+
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <queue>
+
+// Labels are read and written from several threads during a pass; relaxed
+// atomic accesses keep that well-defined without ordering cost.
+static uint32_t load_label(uint32_t* label, uint32_t v) {
+    return std::atomic_ref<uint32_t>(label[v]).load(std::memory_order_relaxed);
+}
+
+// Compressed lists are decoded once into ds/rs rather than per neighbour.
+static void gather_labels(const AdjView& packed, uint32_t* label, uint32_t n, std::vector<uint32_t>& ds,
+                          std::vector<uint16_t>& rs, std::vector<uint32_t>& out) {
+    AdjView adj = packed.unpacked(ds, rs);
+    for (uint32_t i = 0; i < adj.size; ++i) {
+        uint32_t u = adj.dst[i];
+        if (u != 0 && u <= n) out.push_back(load_label(label, u));
+    }
+}
+
+// One pass of size-constrained label propagation: every node moves to the
+// label most of its neighbours carry if that label has fewer than `cap`
+// members and its own keeps more than `floor`. Nodes are split into
+// `threads` contiguous ranges that stream the CSR in order. Returns the
+// number of moves.
+static uint64_t propagate(const CsrGraph& g, const CsrGraph* rev, uint32_t* label,
+                          std::vector<std::atomic<uint32_t>>& size, uint32_t cap, uint32_t floor, size_t threads) {
+    const uint32_t n = g.num_nodes();
+    std::atomic<uint64_t> moved{0};
+    parallel_for(0, threads, threads, [&](size_t t) {
+        const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(n) * t / threads) + 1;
+        const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(n) * (t + 1) / threads) + 1;
+        std::vector<uint32_t> labels, ds;
+        std::vector<uint16_t> rs;
+        uint64_t local_moved = 0;
+        for (uint32_t v = begin; v < end; ++v) {
+            labels.clear();
+            gather_labels(g.neighbors(v), label, n, ds, rs, labels);
+            if (rev && v <= rev->num_nodes()) gather_labels(rev->neighbors(v), label, n, ds, rs, labels);
+            if (labels.empty()) continue;
+            std::sort(labels.begin(), labels.end());
+            const uint32_t cur = load_label(label, v);
+            size_t cur_count = 0, best_count = 0;
+            uint32_t best = cur;
+            for (size_t i = 0; i < labels.size();) {
+                size_t j = i;
+                while (j < labels.size() && labels[j] == labels[i]) ++j;
+                if (labels[i] == cur) {
+                    cur_count = j - i;
+                } else if (j - i > best_count && size[labels[i]].load(std::memory_order_relaxed) < cap) {
+                    best = labels[i];
+                    best_count = j - i;
+                }
+                i = j;
+            }
+            if (best == cur || best_count <= cur_count) continue;
+            // Another thread may have filled `best` or drained `cur` since the check.
+            if (size[best].fetch_add(1, std::memory_order_relaxed) >= cap) {
+                size[best].fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (size[cur].fetch_sub(1, std::memory_order_relaxed) <= floor) {
+                size[cur].fetch_add(1, std::memory_order_relaxed);
+                size[best].fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            std::atomic_ref<uint32_t>(label[v]).store(best, std::memory_order_relaxed);
+            ++local_moved;
+        }
+        moved.fetch_add(local_moved, std::memory_order_relaxed);
+    });
+    return moved.load();
+}
+
+void label_propagation(const CsrGraph& g, const CsrGraph* rev, const PartitionConfig& cfg, uint32_t* part) {
+    const uint32_t n = g.num_nodes();
+    const uint32_t parts = std::max<uint32_t>(1, std::min(cfg.parts, std::max<uint32_t>(1, n)));
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(cfg.threads, n));
+    const double mean = static_cast<double>(n) / parts;
+    const uint32_t cap = static_cast<uint32_t>((1.0 + cfg.imbalance) * mean) + 1;
+    const uint32_t floor = static_cast<uint32_t>(std::max(0.0, (1.0 - cfg.imbalance) * mean));
+    part[0] = 0;
+
+    // 1. Clusters: every node starts alone; no cluster grows past one part.
+    std::vector<std::atomic<uint32_t>> size(static_cast<size_t>(n) + 1);
+    for (uint32_t v = 1; v <= n; ++v) {
+        part[v] = v;
+        size[v].store(1, std::memory_order_relaxed);
+    }
+    const uint32_t cluster_cap = std::max<uint32_t>(1, static_cast<uint32_t>(mean));
+    for (size_t it = 0; it < cfg.iterations; ++it) {
+        if (propagate(g, rev, part, size, cluster_cap, 0, threads) * 1000 < n) break;
+    }
+
+    // 2. Pack clusters, largest first, into the lightest part. A cluster that
+    // would push even the lightest part past `cap` is spread node by node.
+    std::vector<std::pair<uint32_t, uint32_t>> clusters; // (size, label)
+    for (uint32_t c = 1; c <= n; ++c) {
+        uint32_t s = size[c].load(std::memory_order_relaxed);
+        if (s > 0) clusters.emplace_back(s, c);
+    }
+    std::sort(clusters.begin(), clusters.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    using Load = std::pair<uint64_t, uint32_t>; // (nodes, part)
+    std::priority_queue<Load, std::vector<Load>, std::greater<Load>> lightest;
+    for (uint32_t p = 0; p < parts; ++p) lightest.push({0, p});
+    // size[] is reused as the cluster -> part map; kSpread marks a cluster
+    // whose nodes are placed one by one.
+    const uint32_t kSpread = parts;
+    for (const auto& [csize, c] : clusters) {
+        Load l = lightest.top();
+        if (l.first + csize > cap) {
+            size[c].store(kSpread, std::memory_order_relaxed);
+            continue;
+        }
+        lightest.pop();
+        size[c].store(l.second, std::memory_order_relaxed);
+        lightest.push({l.first + csize, l.second});
+    }
+    std::vector<std::pair<uint32_t, uint32_t>>().swap(clusters);
+    for (uint32_t v = 1; v <= n; ++v) {
+        uint32_t p = size[part[v]].load(std::memory_order_relaxed);
+        if (p == kSpread) {
+            Load l = lightest.top();
+            lightest.pop();
+            p = l.second;
+            lightest.push({l.first + 1, p});
+        }
+        part[v] = p;
+    }
+    std::vector<std::atomic<uint32_t>>().swap(size);
+
+    // 3. Refine the parts, keeping each within [floor, cap].
+    std::vector<std::atomic<uint32_t>> part_size(parts);
+    for (uint32_t v = 1; v <= n; ++v) part_size[part[v]].fetch_add(1, std::memory_order_relaxed);
+    for (size_t it = 0; it < cfg.iterations; ++it) {
+        if (propagate(g, rev, part, part_size, cap, floor, threads) * 1000 < n) break;
+    }
+}
+
+void label_propagation(const CsrGraph& g, const CsrGraph* rev, const PartitionConfig& cfg,
+                       std::vector<uint32_t>& part) {
+    part.assign(static_cast<size_t>(g.num_nodes()) + 1, 0);
+    label_propagation(g, rev, cfg, part.data());
+}
+
+void partition_stats(const CsrGraph& g, const uint32_t* part, uint32_t parts, size_t threads, PartitionStats& out) {
+    const uint32_t n = g.num_nodes();
+    out.nodes.assign(parts, 0);
+    out.edges.assign(parts, 0);
+    out.cut.assign(parts, 0);
+    threads = std::max<size_t>(1, std::min<size_t>(threads, n));
+    std::mutex mu;
+    parallel_for(0, threads, threads, [&](size_t t) {
+        const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(n) * t / threads) + 1;
+        const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(n) * (t + 1) / threads) + 1;
+        std::vector<uint64_t> nodes(parts, 0), edges(parts, 0), cut(parts, 0);
+        std::vector<uint32_t> ds;
+        std::vector<uint16_t> rs;
+        for (uint32_t v = begin; v < end; ++v) {
+            const uint32_t p = part[v];
+            if (p >= parts) continue;
+            ++nodes[p];
+            AdjView adj = g.neighbors(v).unpacked(ds, rs);
+            edges[p] += adj.size;
+            for (uint32_t i = 0; i < adj.size; ++i) {
+                uint32_t u = adj.dst[i];
+                if (u != 0 && u <= n && part[u] != p) ++cut[p];
+            }
+        }
+        std::lock_guard<std::mutex> lock(mu);
+        for (uint32_t p = 0; p < parts; ++p) {
+            out.nodes[p] += nodes[p];
+            out.edges[p] += edges[p];
+            out.cut[p] += cut[p];
+        }
+    });
+    out.total_edges = out.total_cut = 0;
+    for (uint32_t p = 0; p < parts; ++p) {
+        out.total_edges += out.edges[p];
+        out.total_cut += out.cut[p];
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "csr.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct PartitionConfig {
+    uint32_t parts = 64;
+    double imbalance = 0.05;  // a part holds at most (1 + imbalance) * N / parts nodes
+    size_t iterations = 10;
+    size_t threads = 1;
+};
+
+// Balanced partition by label propagation over the forward (and, if given,
+// reverse) adjacency, treated as undirected:
+//  1. size-capped label propagation clusters the nodes (each starts alone,
+//     no cluster grows past N / parts);
+//  2. clusters are packed, largest first, into the lightest part; one that
+//     would overfill it is spread node by node;
+//  3. label propagation refines the parts within (1 +- imbalance) * N / parts.
+// Each phase stops after `iterations` passes or once fewer than 0.1% of the
+// nodes move. part[v] is v's part in [0, parts) for v in 1..num_nodes;
+// part[0] is unused.
+//
+// Each pass streams the CSR in node order, split into `threads` contiguous
+// ranges that update the labels in place. `part` doubles as the label array,
+// so it can be a mapped output file; the other resident state is at most
+// 12 bytes per node. With threads > 1 the result depends on thread timing;
+// one thread is deterministic.
+void label_propagation(const CsrGraph& g, const CsrGraph* rev, const PartitionConfig& cfg, uint32_t* part);
+void label_propagation(const CsrGraph& g, const CsrGraph* rev, const PartitionConfig& cfg,
+                       std::vector<uint32_t>& part);
+
+// Per-part node counts, out-edges, and out-edges whose target is in another
+// part (the edge cut, counted once per directed edge).
+struct PartitionStats {
+    std::vector<uint64_t> nodes;
+    std::vector<uint64_t> edges;
+    std::vector<uint64_t> cut;
+    uint64_t total_edges = 0;
+    uint64_t total_cut = 0;
+};
+
+void partition_stats(const CsrGraph& g, const uint32_t* part, uint32_t parts, size_t threads, PartitionStats& out);
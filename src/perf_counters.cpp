@@ -0,0 +1,130 @@
+#include "perf_counters.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char* counter_name(Counter c) {
+    switch (c) {
+    case Counter::Cycles: return "cycles";
+    case Counter::Instructions: return "instructions";
+    case Counter::LlcMisses: return "llc_misses";
+    case Counter::DtlbMisses: return "dtlb_misses";
+    case Counter::PageFaults: return "page_faults";
+    case Counter::Count: break;
+    }
+    return "?";
+}
+
+PerfCounters::~PerfCounters() {
+    for (int& fd : fd_) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+}
+
+bool PerfCounters::open() {
+    struct Event {
+        uint32_t type;
+        uint64_t config;
+    };
+    const Event events[kCounterCount] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    };
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        if (fd_[i] >= 0) continue;
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        fd_[i] = fd >= 0 ? static_cast<int>(fd) : -1;
+        err_[i] = fd >= 0 ? 0 : errno;
+    }
+    return any();
+}
+
+bool PerfCounters::any() const {
+    for (int fd : fd_) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+CounterValues PerfCounters::read() const {
+    CounterValues out;
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        if (fd_[i] < 0) continue;
+        uint64_t buf[3] = {0, 0, 0}; // value, time enabled, time running
+        if (::read(fd_[i], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))) continue;
+        if (buf[2] == 0) continue;
+        out.v[i] = buf[2] >= buf[1] ? buf[0]
+                                    : static_cast<uint64_t>(static_cast<long double>(buf[0]) * buf[1] / buf[2]);
+    }
+    return out;
+}
+
+std::string PerfCounters::status() const {
+    std::ostringstream os;
+    std::ostringstream missing;
+    os << "counters:";
+    for (size_t i = 0; i < kCounterCount; ++i) {
+        if (fd_[i] >= 0) {
+            os << " " << counter_name(static_cast<Counter>(i));
+        } else {
+            missing << " " << counter_name(static_cast<Counter>(i)) << " (" << std::strerror(err_[i]) << ")";
+        }
+    }
+    if (!any()) os << " none";
+    if (!missing.str().empty()) {
+        os << "; unavailable:" << missing.str();
+        std::ifstream paranoid("/proc/sys/kernel/perf_event_paranoid");
+        int level = 0;
+        if (paranoid >> level) os << "; perf_event_paranoid=" << level;
+    }
+    return os.str();
+}
+
+std::string format_counters(const PerfCounters& perf, const CounterValues& d, double items, const std::string& unit) {
+    std::ostringstream os;
+    os.precision(3);
+    const char* sep = "";
+    if (perf.available(Counter::Cycles) && perf.available(Counter::Instructions) && d[Counter::Cycles] > 0) {
+        os << sep << "IPC=" << static_cast<double>(d[Counter::Instructions]) / d[Counter::Cycles];
+        sep = " ";
+    }
+    auto per_item = [&](Counter c, const char* label) {
+        if (!perf.available(c)) return;
+        os << sep << label;
+        if (items > 0.0) {
+            os << "/" << unit << "=" << static_cast<double>(d[c]) / items;
+        } else {
+            os << "=" << d[c];
+        }
+        sep = " ";
+    };
+    per_item(Counter::LlcMisses, "LLC-miss");
+    per_item(Counter::DtlbMisses, "dTLB-miss");
+    if (perf.available(Counter::PageFaults)) {
+        os << sep << "faults=" << d[Counter::PageFaults];
+        sep = " ";
+    }
+    if (!perf.any()) os << "counters n/a";
+    return os.str();
+}
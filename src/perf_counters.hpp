@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class Counter : size_t {
+    Cycles,
+    Instructions,
+    LlcMisses,  // last-level cache misses
+    DtlbMisses, // dTLB load misses
+    PageFaults,
+    Count,
+};
+
+constexpr size_t kCounterCount = static_cast<size_t>(Counter::Count);
+const char* counter_name(Counter c);
+
+struct CounterValues {
+    uint64_t v[kCounterCount] = {};
+
+    uint64_t operator[](Counter c) const { return v[static_cast<size_t>(c)]; }
+    CounterValues& operator+=(const CounterValues& o) {
+        for (size_t i = 0; i < kCounterCount; ++i) v[i] += o.v[i];
+        return *this;
+    }
+    CounterValues operator-(const CounterValues& o) const {
+        CounterValues d;
+        for (size_t i = 0; i < kCounterCount; ++i) d.v[i] = v[i] >= o.v[i] ? v[i] - o.v[i] : 0;
+        return d;
+    }
+};
+
+// User-space hardware counters from perf_event_open, one event per counter,
+// counting the opening thread and every thread it creates afterwards
+// (inherit). A worker thread's counts reach the totals when it exits, so
+// open() before starting any threads and read around phases that join their
+// workers, as parallel_for does. Counters the kernel refuses (no PMU in a
+// VM, perf_event_paranoid, seccomp) stay closed and read as 0; callers check
+// available() and print them as n/a. Each read() is one syscall per counter.
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters();
+
+    // Opens every counter the kernel allows; false if none could be opened.
+    bool open();
+    bool available(Counter c) const { return fd_[static_cast<size_t>(c)] >= 0; }
+    bool any() const;
+    // Running totals, scaled up when the kernel multiplexed a counter.
+    CounterValues read() const;
+    // "counters: cycles instructions ..." or why some are missing.
+    std::string status() const;
+
+private:
+    int fd_[kCounterCount] = {-1, -1, -1, -1, -1};
+    int err_[kCounterCount] = {};
+};
+
+// "IPC=1.52 LLC-miss/edge=0.031 dTLB-miss/edge=0.004 faults=12" from a
+// counter delta; `items` of `unit` are the per-item denominator (skipped when
+// 0). Unavailable counters are left out, or shown as n/a if none is available.
+std::string format_counters(const PerfCounters& perf, const CounterValues& d, double items, const std::string& unit);
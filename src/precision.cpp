@@ -0,0 +1,40 @@
+#include "precision.hpp"
+
+#include <algorithm>
+
+void pack_bf16(const float* src, uint16_t* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = float_to_bf16(src[i]);
+}
+
+void unpack_bf16(const uint16_t* src, float* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = bf16_to_float(src[i]);
+}
+
+void pack_fp16(const float* src, uint16_t* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = float_to_fp16(src[i]);
+}
+
+void unpack_fp16(const uint16_t* src, float* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = fp16_to_float(src[i]);
+}
+
+void quantize_rows_i8(const float* src, size_t rows, size_t cols, int8_t* dst, float* scales) {
+    for (size_t r = 0; r < rows; ++r) {
+        const float* row = src + r * cols;
+        float max_abs = 0.0f;
+        for (size_t c = 0; c < cols; ++c) max_abs = std::max(max_abs, std::abs(row[c]));
+        float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        float inv = 1.0f / scale;
+        for (size_t c = 0; c < cols; ++c) {
+            long q = std::lrint(row[c] * inv);
+            dst[r * cols + c] = static_cast<int8_t>(std::clamp(q, -127L, 127L));
+        }
+        scales[r] = scale;
+    }
+}
+
+void dequantize_rows_i8(const int8_t* src, const float* scales, size_t rows, size_t cols, float* dst) {
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) dst[r * cols + c] = static_cast<float>(src[r * cols + c]) * scales[r];
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// bfloat16: the upper 16 bits of an IEEE float32. Conversion rounds to
+// nearest-even and keeps NaNs quiet.
+inline uint16_t float_to_bf16(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) return static_cast<uint16_t>((bits >> 16) | 0x0040u);
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+inline float bf16_to_float(uint16_t h) {
+    uint32_t bits = static_cast<uint32_t>(h) << 16;
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// IEEE binary16, round-to-nearest-even; out-of-range values become infinity.
+inline uint16_t float_to_fp16(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    uint32_t abs = bits & 0x7fffffffu;
+    if (abs > 0x7f800000u) return sign | 0x7e00u;
+    if (abs >= 0x477ff000u) return sign | 0x7c00u;
+    if (abs < 0x38800000u) {
+        float mag;
+        std::memcpy(&mag, &abs, sizeof(mag));
+        return sign | static_cast<uint16_t>(std::lrint(mag * 16777216.0f));
+    }
+    abs += 0xfffu + ((abs >> 13) & 1u);
+    return sign | static_cast<uint16_t>((abs - 0x38000000u) >> 13);
+}
+
+inline float fp16_to_float(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1fu;
+    uint32_t man = h & 0x3ffu;
+    if (exp == 0) {
+        float mag = static_cast<float>(man) * (1.0f / 16777216.0f);
+        return sign ? -mag : mag;
+    }
+    uint32_t bits = sign | (exp == 31 ? 0x7f800000u : (exp + 112) << 23) | (man << 13);
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+void pack_bf16(const float* src, uint16_t* dst, size_t n);
+void unpack_bf16(const uint16_t* src, float* dst, size_t n);
+void pack_fp16(const float* src, uint16_t* dst, size_t n);
+void unpack_fp16(const uint16_t* src, float* dst, size_t n);
+
+// Symmetric int8 quantisation with one scale per row of cols elements.
+void quantize_rows_i8(const float* src, size_t rows, size_t cols, int8_t* dst, float* scales);
+void dequantize_rows_i8(const int8_t* src, const float* scales, size_t rows, size_t cols, float* dst);
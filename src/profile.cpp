@@ -0,0 +1,175 @@
+#include "profile.hpp"
+
+#include "memory.hpp"
+#include "trainer.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+const char* phase_name(Phase p) {
+    switch (p) {
+    case Phase::Negatives: return "negatives";
+    case Phase::Dedup: return "dedup";
+    case Phase::Subgraph: return "subgraph";
+    case Phase::Features: return "features";
+    case Phase::Forward: return "forward";
+    case Phase::DistMult: return "distmult_loss";
+    case Phase::RelLoss: return "relation_loss";
+    case Phase::Backward: return "backward";
+    case Phase::AllReduce: return "allreduce";
+    case Phase::Optimizer: return "optimizer";
+    case Phase::Count: break;
+    }
+    return "?";
+}
+
+void PhaseTimes::add(const PhaseTimes& other) {
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        seconds[i] += other.seconds[i];
+        counters[i] += other.counters[i];
+    }
+}
+
+double PhaseTimes::total() const {
+    double t = 0.0;
+    for (double s : seconds) t += s;
+    return t;
+}
+
+void MetricsWindow::add(const BatchResult& b) {
+    ++batches;
+    micro_batches += b.micro_batches;
+    triples += b.triples;
+    rows += b.rows;
+    edges += b.edges;
+    history_reads += b.history_reads;
+    activation_bytes += b.activation_bytes;
+    max_activation_bytes = std::max(max_activation_bytes, b.activation_bytes);
+    if (layer_nodes.size() < b.layer_nodes.size()) layer_nodes.resize(b.layer_nodes.size(), 0);
+    for (size_t l = 0; l < b.layer_nodes.size(); ++l) layer_nodes[l] += b.layer_nodes[l];
+    loss += b.loss_tail + b.loss_rel;
+}
+
+void MetricsWindow::merge(const MetricsWindow& other) {
+    batches += other.batches;
+    micro_batches += other.micro_batches;
+    triples += other.triples;
+    rows += other.rows;
+    edges += other.edges;
+    history_reads += other.history_reads;
+    activation_bytes += other.activation_bytes;
+    max_activation_bytes = std::max(max_activation_bytes, other.max_activation_bytes);
+    if (layer_nodes.size() < other.layer_nodes.size()) layer_nodes.resize(other.layer_nodes.size(), 0);
+    for (size_t l = 0; l < other.layer_nodes.size(); ++l) layer_nodes[l] += other.layer_nodes[l];
+    loss += other.loss;
+    wall += other.wall;
+    phases.add(other.phases);
+}
+
+bool TrainMetrics::open(const std::string& path, size_t every) {
+    every_ = every;
+    window_start_ = std::chrono::steady_clock::now();
+    if (path.empty()) return true;
+    out_.open(path, std::ios::out | std::ios::trunc);
+    if (!out_) {
+        std::cerr << "Failed to open metrics file " << path << "\n";
+        return false;
+    }
+    out_ << std::setprecision(6);
+    return true;
+}
+
+void TrainMetrics::set_perf(const PerfCounters* perf) {
+    perf_ = perf;
+    window_.phases.perf = perf;
+}
+
+void TrainMetrics::add(const BatchResult& b, uint64_t epoch) {
+    window_.add(b);
+    ++step_;
+    if (every_ > 0 && window_.batches >= every_) flush(epoch);
+}
+
+void TrainMetrics::flush(uint64_t epoch) {
+    auto now = std::chrono::steady_clock::now();
+    window_.wall = std::chrono::duration<double>(now - window_start_).count();
+    window_start_ = now;
+    if (window_.batches > 0) {
+        write_line(window_, "window", epoch);
+        total_.merge(window_);
+    }
+    // Reset in place: the Trainer holds a pointer to window_.phases.
+    window_ = MetricsWindow();
+    window_.phases.perf = perf_;
+}
+
+bool TrainMetrics::finish() {
+    if (!out_.is_open()) return true;
+    write_line(total_, "summary", 0);
+    out_.flush();
+    if (!out_) {
+        std::cerr << "Failed to write the metrics file\n";
+        return false;
+    }
+    return true;
+}
+
+void TrainMetrics::write_line(const MetricsWindow& w, const char* kind, uint64_t epoch) {
+    if (!out_.is_open()) return;
+    const double n = static_cast<double>(std::max<size_t>(1, w.batches));
+    const double wall = w.wall > 0.0 ? w.wall : 1e-12;
+    out_ << "{\"type\": \"" << kind << "\"";
+    if (std::string(kind) == "window") out_ << ", \"epoch\": " << epoch + 1 << ", \"step\": " << step_;
+    out_ << ", \"batches\": " << w.batches << ", \"wall_s\": " << w.wall << ", \"triples\": " << w.triples
+         << ", \"triples_per_s\": " << w.triples / wall << ", \"edges_per_s\": " << w.edges / wall
+         << ", \"loss\": " << w.loss / n << ", \"edges_per_batch\": " << w.edges / n
+         << ", \"micro_batches_per_batch\": " << w.micro_batches / n << ", \"rows_per_batch\": " << w.rows / n
+         << ", \"history_reads_per_batch\": " << w.history_reads / n
+         << ", \"nodes_per_layer\": [";
+    for (size_t l = 0; l < w.layer_nodes.size(); ++l) out_ << (l ? ", " : "") << w.layer_nodes[l] / n;
+    out_ << "], \"activation_bytes\": {\"mean\": " << w.activation_bytes / n
+         << ", \"max\": " << w.max_activation_bytes << "}, \"phase_s\": {";
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        out_ << (i ? ", " : "") << "\"" << phase_name(static_cast<Phase>(i)) << "\": " << w.phases.seconds[i];
+    }
+    out_ << "}, \"other_s\": " << std::max(0.0, w.wall - w.phases.total()) << ", \"rss_bytes\": " << current_rss_bytes()
+         << ", \"peak_rss_bytes\": " << peak_rss_bytes();
+    if (perf_ && perf_->any()) {
+        out_ << ", \"phase_counters\": {";
+        for (size_t i = 0; i < kPhaseCount; ++i) {
+            out_ << (i ? ", " : "") << "\"" << phase_name(static_cast<Phase>(i)) << "\": {";
+            const char* sep = "";
+            for (size_t c = 0; c < kCounterCount; ++c) {
+                if (!perf_->available(static_cast<Counter>(c))) continue;
+                out_ << sep << "\"" << counter_name(static_cast<Counter>(c)) << "\": " << w.phases.counters[i].v[c];
+                sep = ", ";
+            }
+            out_ << "}";
+        }
+        out_ << "}";
+    }
+    out_ << "}\n";
+}
+
+void print_phase_breakdown(std::ostream& os, const PhaseTimes& times) {
+    std::vector<size_t> order(kPhaseCount);
+    for (size_t i = 0; i < kPhaseCount; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return times.seconds[a] > times.seconds[b]; });
+    const double total = times.total();
+    os << std::fixed << std::setprecision(1);
+    for (size_t i : order) {
+        if (times.seconds[i] <= 0.0) continue;
+        os << " " << phase_name(static_cast<Phase>(i)) << "=" << 100.0 * times.seconds[i] / total << "%";
+    }
+    os << std::defaultfloat << std::setprecision(6);
+}
+
+void print_phase_counters(std::ostream& os, const PerfCounters& perf, const PhaseTimes& times, double edges) {
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        if (times.seconds[i] <= 0.0) continue;
+        os << "  " << phase_name(static_cast<Phase>(i)) << ": "
+           << format_counters(perf, times.counters[i], edges, "edge") << "\n";
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "perf_counters.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Phases of one training step, in execution order.
+enum class Phase : size_t {
+    Negatives, // sample_negative for the batch
+    Dedup,     // unique seed set
+    Subgraph,  // build_subgraph
+    Features,  // compute_base_features
+    Forward,   // index maps, input projection and aggregation layers
+    DistMult,  // Decoder::distmult_loss
+    RelLoss,   // Decoder::relation_loss
+    Backward,  // Encoder::backward
+    AllReduce, // gradient all-reduce across ranks
+    Optimizer, // zero_grad and Optimizer::step
+    Count,
+};
+
+constexpr size_t kPhaseCount = static_cast<size_t>(Phase::Count);
+const char* phase_name(Phase p);
+
+// Wall seconds spent in each phase and, when `perf` is set, the counter
+// deltas over the same scopes.
+struct PhaseTimes {
+    double seconds[kPhaseCount] = {};
+    CounterValues counters[kPhaseCount];
+    const PerfCounters* perf = nullptr;
+
+    void add(const PhaseTimes& other);
+    double total() const;
+};
+
+// Adds the wall time of its scope to `times`; a no-op when times is null.
+// Costs two steady_clock reads (vDSO, tens of ns) per scope, plus two
+// PerfCounters::read() calls (a few us) when times->perf is set.
+class ScopedPhase {
+public:
+    ScopedPhase(PhaseTimes* times, Phase phase) : times_(times), phase_(phase) {
+        if (!times_) return;
+        if (times_->perf) c0_ = times_->perf->read();
+        t0_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedPhase() {
+        if (!times_) return;
+        const size_t p = static_cast<size_t>(phase_);
+        times_->seconds[p] += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0_).count();
+        if (times_->perf) times_->counters[p] += times_->perf->read() - c0_;
+    }
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    PhaseTimes* times_;
+    Phase phase_;
+    std::chrono::steady_clock::time_point t0_;
+    CounterValues c0_;
+};
+
+struct BatchResult;
+
+// Sums of BatchResults and phase times over a run of batches.
+struct MetricsWindow {
+    size_t batches = 0;
+    size_t micro_batches = 0;
+    size_t triples = 0;
+    size_t rows = 0;
+    size_t edges = 0;
+    size_t history_reads = 0;
+    size_t activation_bytes = 0;     // sum over batches
+    size_t max_activation_bytes = 0;
+    std::vector<size_t> layer_nodes; // sum over batches, input layer first
+    double loss = 0.0;               // sum of per-batch mean losses
+    double wall = 0.0;               // seconds
+    PhaseTimes phases;
+
+    void add(const BatchResult& b);
+    void merge(const MetricsWindow& other);
+};
+
+// Per-phase training metrics. The Trainer adds phase times to phases() and
+// the caller adds each BatchResult. Every `every` batches, and at flush(), the
+// pending window is written as one JSON line to the metrics file (if any) and
+// folded into the run totals.
+class TrainMetrics {
+public:
+    // An empty path only aggregates.
+    bool open(const std::string& path, size_t every);
+    // Collect counters per phase from `perf` (opened by the caller) from now on.
+    void set_perf(const PerfCounters* perf);
+    PhaseTimes* phases() { return &window_.phases; }
+    void add(const BatchResult& b, uint64_t epoch);
+    void flush(uint64_t epoch);
+    const MetricsWindow& totals() const { return total_; }
+    // Writes the run totals as a final {"summary": true, ...} line.
+    bool finish();
+
+private:
+    void write_line(const MetricsWindow& w, const char* kind, uint64_t epoch);
+
+    std::ofstream out_;
+    size_t every_ = 0;
+    size_t step_ = 0;
+    const PerfCounters* perf_ = nullptr;
+    MetricsWindow window_;
+    MetricsWindow total_;
+    std::chrono::steady_clock::time_point window_start_ = std::chrono::steady_clock::now();
+};
+
+// "phase=12.3% ..." breakdown of `times`, largest first.
+void print_phase_breakdown(std::ostream& os, const PhaseTimes& times);
+// One "  phase: IPC=... LLC-miss/edge=..." line per timed phase, normalized
+// by `edges` sampled edges.
+void print_phase_counters(std::ostream& os, const PerfCounters& perf, const PhaseTimes& times, double edges);
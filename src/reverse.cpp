@@ -0,0 +1,117 @@
+#include "reverse.hpp"
+
+#include "io.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+// Splits source nodes [1, n] into `parts` contiguous ranges of about equal edge count.
+static std::vector<uint32_t> split_by_edges(const CsrGraph& g, size_t parts) {
+    const uint32_t n = g.num_nodes();
+    const uint64_t m = g.num_edges();
+    std::vector<uint32_t> cut(parts + 1, n + 1);
+    cut[0] = 1;
+    uint64_t seen = 0;
+    size_t p = 1;
+    for (uint32_t u = 1; u <= n && p < parts; ++u) {
+        seen += g.out_degree(u);
+        while (p < parts && seen >= m * p / parts) cut[p++] = u + 1;
+    }
+    return cut;
+}
+
+bool write_reverse_csr(const CsrGraph& g, const std::string& out_dir, size_t threads, size_t mem_budget,
+                       size_t* passes_out) {
+    const uint32_t n = g.num_nodes();
+    const uint32_t m = g.num_edges();
+    const size_t T = std::max<size_t>(1, threads);
+    std::filesystem::create_directories(out_dir);
+    remove_packed(out_dir, "csr_rev");
+
+    const std::string offsets_path = out_dir + "/offsets_rev.bin";
+    const std::string csr_path = out_dir + "/csr_rev.bin";
+    const std::string rels_path = out_dir + "/rels_rev.bin";
+    MMapArrayBase off_map, csr_map, rels_map;
+    if (!map_writable(offsets_path + ".tmp", (static_cast<size_t>(n) + 2) * sizeof(uint32_t), off_map) ||
+        !map_writable(csr_path + ".tmp", static_cast<size_t>(m) * sizeof(uint32_t), csr_map) ||
+        !map_writable(rels_path + ".tmp", static_cast<size_t>(m) * sizeof(uint16_t), rels_map)) {
+        return false;
+    }
+    uint32_t* offsets = static_cast<uint32_t*>(off_map.data);
+    uint32_t* csr = static_cast<uint32_t*>(csr_map.data);
+    uint16_t* rels = static_cast<uint16_t*>(rels_map.data);
+
+    const size_t range = std::max<size_t>(1, mem_budget / (T * sizeof(uint32_t)));
+    const std::vector<uint32_t> src_cut = split_by_edges(g, T);
+    std::vector<std::vector<uint32_t>> hist(T);
+    offsets[0] = 0;
+    uint64_t pos = 0;
+    size_t passes = 0;
+
+    for (uint64_t lo = 1; lo <= n; lo += range, ++passes) {
+        const uint32_t lo32 = static_cast<uint32_t>(lo);
+        const uint32_t hi = static_cast<uint32_t>(std::min<uint64_t>(n + 1, lo + range));
+        const size_t width = hi - lo32;
+
+        parallel_for(0, T, T, [&](size_t t) {
+            auto& h = hist[t];
+            h.assign(width, 0);
+            std::vector<uint32_t> dst_scratch;
+            std::vector<uint16_t> rel_scratch;
+            for (uint32_t u = src_cut[t]; u < src_cut[t + 1]; ++u) {
+                AdjView adj = g.neighbors(u).unpacked(dst_scratch, rel_scratch);
+                for (uint32_t i = 0; i < adj.size; ++i) {
+                    uint32_t v = adj.dst[i];
+                    if (v >= lo32 && v < hi) ++h[v - lo32];
+                }
+            }
+        });
+
+        // Prefix over (node, thread): thread t writes node v's in-edges after threads < t.
+        for (size_t k = 0; k < width; ++k) {
+            offsets[lo32 + k] = static_cast<uint32_t>(pos);
+            for (size_t t = 0; t < T; ++t) {
+                uint32_t c = hist[t][k];
+                hist[t][k] = static_cast<uint32_t>(pos);
+                pos += c;
+            }
+        }
+
+        parallel_for(0, T, T, [&](size_t t) {
+            auto& cursor = hist[t];
+            std::vector<uint32_t> dst_scratch;
+            std::vector<uint16_t> rel_scratch;
+            for (uint32_t u = src_cut[t]; u < src_cut[t + 1]; ++u) {
+                AdjView adj = g.neighbors(u).unpacked(dst_scratch, rel_scratch);
+                for (uint32_t i = 0; i < adj.size; ++i) {
+                    uint32_t v = adj.dst[i];
+                    if (v < lo32 || v >= hi) continue;
+                    uint32_t p = cursor[v - lo32]++;
+                    csr[p] = u;
+                    rels[p] = adj.rel[i];
+                }
+            }
+        });
+    }
+    offsets[n + 1] = static_cast<uint32_t>(pos);
+    for (auto& h : hist) std::vector<uint32_t>().swap(h);
+
+    bool ok = sync_mapping(off_map) && sync_mapping(csr_map) && sync_mapping(rels_map);
+    unmap(off_map);
+    unmap(csr_map);
+    unmap(rels_map);
+    ok = ok && std::rename((offsets_path + ".tmp").c_str(), offsets_path.c_str()) == 0 &&
+         std::rename((csr_path + ".tmp").c_str(), csr_path.c_str()) == 0 &&
+         std::rename((rels_path + ".tmp").c_str(), rels_path.c_str()) == 0;
+    if (!ok) {
+        std::cerr << "Failed to write reverse CSR to " << out_dir << "\n";
+        return false;
+    }
+    if (passes_out) *passes_out = passes;
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "csr.hpp"
+
+#include <cstddef>
+#include <string>
+
+// Writes offsets_rev.bin, csr_rev.bin and rels_rev.bin for the base files of
+// `g` into out_dir. The builder never holds the graph in RAM: the outputs are
+// mapped, and destination nodes are handled in ranges sized so that one
+// in-degree histogram per thread fits `mem_budget` bytes; each range reads the
+// forward graph twice (count, then scatter). Each thread owns a contiguous
+// range of sources and its histogram doubles as its write cursor, so
+// in-neighbours come out in ascending source order exactly as a serial build
+// would write them. `passes` (optional) receives the number of ranges.
+bool write_reverse_csr(const CsrGraph& g, const std::string& out_dir, size_t threads, size_t mem_budget,
+                       size_t* passes = nullptr);
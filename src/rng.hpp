@@ -8,6 +8,8 @@ public:
     uint64_t next_u64();
     uint32_t next_u32(uint32_t bound);
     float uniform();
+    void get_state(uint64_t& s0, uint64_t& s1) const { s0 = s0_; s1 = s1_; }
+    void set_state(uint64_t s0, uint64_t s1) { s0_ = s0; s1_ = s1; }
 
 private:
     uint64_t s0_;
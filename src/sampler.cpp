@@ -1,17 +1,89 @@
 #include "sampler.hpp"
 
+#include <algorithm>
+
 void sample_neighbors(const CsrGraph& g, uint32_t node, size_t fanout,
                       std::vector<uint32_t>& out_nodes, std::vector<uint16_t>& out_rels,
                       XorShift128Plus& rng) {
     AdjView adj = g.neighbors(node);
     if (adj.size == 0 || fanout == 0) return;
-    out_nodes.reserve(out_nodes.size() + fanout);
-    out_rels.reserve(out_rels.size() + fanout);
+    // Compressed lists: one block decode per sample on long lists, one full
+    // decode on short ones.
+    if (adj.packed && adj.size <= fanout * kPackedBlock / 4) {
+        thread_local std::vector<uint32_t> dst_scratch;
+        thread_local std::vector<uint16_t> rel_scratch;
+        adj = adj.unpacked(dst_scratch, rel_scratch);
+    }
     for (size_t i = 0; i < fanout; ++i) {
         uint32_t idx = rng.next_u32(adj.size);
-        out_nodes.push_back(adj.dst[idx]);
-        out_rels.push_back(adj.rel[idx]);
+        out_nodes.push_back(adj.dst_at(idx));
+        out_rels.push_back(adj.rel_at(idx));
+    }
+}
+
+static constexpr size_t kSampleAhead = 8;
+
+void sample_layer(const CsrGraph& g, const std::vector<uint32_t>& targets, size_t fanout,
+                  LayerSamples& out, XorShift128Plus& rng) {
+    const size_t n = targets.size();
+    out.offsets.assign(n + 1, 0);
+    out.neighbors.resize(n * fanout);
+    out.rels.resize(n * fanout);
+    size_t pos = 0;
+    if (fanout == 0) return;
+
+    // Targets in flight between drawing their indices and emitting samples.
+    AdjView views[kSampleAhead];
+    thread_local std::vector<uint32_t> picks;
+    thread_local std::vector<uint32_t> dst_scratch;
+    thread_local std::vector<uint16_t> rel_scratch;
+    picks.resize(kSampleAhead * fanout);
+
+    auto draw = [&](size_t i) {
+        AdjView& adj = views[i % kSampleAhead];
+        adj = g.neighbors(targets[i]);
+        if (adj.size == 0) return;
+        uint32_t* p = &picks[(i % kSampleAhead) * fanout];
+        for (size_t k = 0; k < fanout; ++k) {
+            p[k] = rng.next_u32(adj.size);
+            if (!adj.packed) {
+                __builtin_prefetch(adj.dst + p[k]);
+                __builtin_prefetch(adj.rel + p[k]);
+            }
+        }
+        if (adj.packed) __builtin_prefetch(adj.packed);
+    };
+    auto emit = [&](size_t i) {
+        AdjView adj = views[i % kSampleAhead];
+        if (adj.size == 0) return;
+        const uint32_t* p = &picks[(i % kSampleAhead) * fanout];
+        uint32_t* dst = out.neighbors.data() + pos;
+        uint16_t* rel = out.rels.data() + pos;
+        pos += fanout;
+        if (adj.packed && adj.size <= fanout * kPackedBlock / 4) adj = adj.unpacked(dst_scratch, rel_scratch);
+        if (!adj.packed) {
+            for (size_t k = 0; k < fanout; ++k) {
+                dst[k] = adj.dst[p[k]];
+                rel[k] = adj.rel[p[k]];
+            }
+            return;
+        }
+        for (size_t k = 0; k < fanout; ++k) {
+            dst[k] = adj.dst_at(p[k]);
+            rel[k] = adj.rel_at(p[k]);
+        }
+    };
+
+    for (size_t i = 0; i < std::min(n, 2 * kSampleAhead); ++i) g.prefetch(targets[i]);
+    for (size_t i = 0; i < std::min(n, kSampleAhead); ++i) draw(i);
+    for (size_t i = 0; i < n; ++i) {
+        if (i + 2 * kSampleAhead < n) g.prefetch(targets[i + 2 * kSampleAhead]);
+        emit(i);
+        out.offsets[i + 1] = static_cast<uint32_t>(pos);
+        if (i + kSampleAhead < n) draw(i + kSampleAhead);
     }
+    out.neighbors.resize(pos);
+    out.rels.resize(pos);
 }
 
 uint32_t sample_negative(uint32_t num_nodes, XorShift128Plus& rng) {
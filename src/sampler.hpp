@@ -7,8 +7,24 @@
 #include <cstdint>
 #include <vector>
 
+// Sampled neighbours of a list of targets: target i owns
+// neighbors/rels[offsets[i], offsets[i+1]).
+struct LayerSamples {
+    std::vector<uint32_t> offsets;  // len = targets+1
+    std::vector<uint32_t> neighbors;
+    std::vector<uint16_t> rels;
+};
+
 void sample_neighbors(const CsrGraph& g, uint32_t node, size_t fanout,
                       std::vector<uint32_t>& out_nodes, std::vector<uint16_t>& out_rels,
                       XorShift128Plus& rng);
 
+// Samples `fanout` neighbours (with replacement) of every target into `out`.
+// Draws the same random numbers in the same order as calling sample_neighbors
+// per target, but software-pipelines the loads: offsets are prefetched
+// 2 * kSampleAhead targets ahead and the sampled adjacency slots kSampleAhead
+// ahead. Pass targets sorted by node ID so consecutive lookups share pages.
+void sample_layer(const CsrGraph& g, const std::vector<uint32_t>& targets, size_t fanout,
+                  LayerSamples& out, XorShift128Plus& rng);
+
 uint32_t sample_negative(uint32_t num_nodes, XorShift128Plus& rng);
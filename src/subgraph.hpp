@@ -1,6 +1,7 @@
 #pragma once
 
 #include "csr.hpp"
+#include "history.hpp"
 #include "rng.hpp"
 #include "sampler.hpp"
 
@@ -8,16 +9,14 @@
 #include <cstdint>
 #include <vector>
 
-struct LayerSamples {
-    std::vector<uint32_t> offsets;  // len = targets+1
-    std::vector<uint32_t> neighbors;
-    std::vector<uint16_t> rels;
-};
-
 struct BatchSubgraph {
-    std::vector<std::vector<uint32_t>> nodes_per_layer; // 0 is farthest
+    std::vector<std::vector<uint32_t>> nodes_per_layer; // 0 is farthest; each sorted by ID
     std::vector<LayerSamples> samples;                  // size = L
 };
 
+// With `history`, sampled layer-l neighbours whose historical row is fresh
+// are left out of layer l (and so not expanded below it); the encoder reads
+// their rows from the store. Every layer still contains the one above it.
 BatchSubgraph build_subgraph(const CsrGraph& g, const std::vector<uint32_t>& seeds,
-                             const std::vector<size_t>& fanouts, XorShift128Plus& rng);
+                             const std::vector<size_t>& fanouts, XorShift128Plus& rng,
+                             const HistoryStore* history = nullptr);
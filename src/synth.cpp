@@ -0,0 +1,326 @@
+#include "synth.hpp"
+
+#include "csr.hpp"
+#include "io.hpp"
+#include "reverse.hpp"
+#include "rng.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+static constexpr uint32_t kSynthChunk = 4096; // nodes per generation stream
+
+static double uniform01(XorShift128Plus& rng) {
+    return static_cast<double>(rng.next_u64() >> 11) * 0x1.0p-53;
+}
+
+// Zipf(s) over 1..n by rejection-inversion (Hoermann and Derflinger 1996):
+// O(1) per draw with no tables. h_integral is also the continuous CDF used
+// for the rounded expected degrees.
+class ZipfSampler {
+public:
+    ZipfSampler(uint64_t n, double s) : n_(static_cast<double>(n)), s_(s) {
+        h_x1_ = h_integral(1.5) - 1.0;
+        h_n_ = h_integral(n_ + 0.5);
+        s_const_ = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    uint64_t operator()(XorShift128Plus& rng) const {
+        for (;;) {
+            double u = h_n_ + uniform01(rng) * (h_x1_ - h_n_);
+            double x = h_integral_inverse(u);
+            double k = std::clamp(std::floor(x + 0.5), 1.0, n_);
+            if (k - x <= s_const_ || u >= h_integral(k + 0.5) - h(k)) return static_cast<uint64_t>(k);
+        }
+    }
+
+    // Integral of x^-s from 1 to x.
+    double h_integral(double x) const {
+        double lx = std::log(x);
+        return helper2((1.0 - s_) * lx) * lx;
+    }
+
+private:
+    double h(double x) const { return std::exp(-s_ * std::log(x)); }
+    double h_integral_inverse(double x) const {
+        double t = std::max(-1.0, x * (1.0 - s_));
+        return std::exp(helper1(t) * x);
+    }
+    // log1p(x) / x and expm1(x) / x, accurate near 0.
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    double n_;
+    double s_;
+    double h_x1_;
+    double h_n_;
+    double s_const_;
+};
+
+// Pseudo-random bijection of [0, n): a 4-round Feistel network on the
+// smallest even bit width that covers n, cycle-walked back into range.
+class IndexPermutation {
+public:
+    IndexPermutation(uint64_t n, uint64_t seed) : n_(n) {
+        int bits = 2;
+        while (bits < 64 && (1ULL << bits) < n) bits += 2;
+        half_ = bits / 2;
+        mask_ = (1ULL << half_) - 1;
+        for (int k = 0; k < 4; ++k) keys_[k] = mix_seed(seed + static_cast<uint64_t>(k));
+    }
+
+    uint64_t operator()(uint64_t x) const {
+        do {
+            uint64_t l = x >> half_;
+            uint64_t r = x & mask_;
+            for (uint64_t key : keys_) {
+                uint64_t t = l ^ (mix_seed(r ^ key) & mask_);
+                l = r;
+                r = t;
+            }
+            x = (l << half_) | r;
+        } while (x >= n_);
+        return x;
+    }
+
+private:
+    uint64_t n_;
+    int half_;
+    uint64_t mask_;
+    uint64_t keys_[4];
+};
+
+// Out-degree of the node of out-rank `rank`: the Zipf expected-degree shares
+// rounded down cumulatively, so the degrees of all ranks sum to `edges`.
+class DegreeSequence {
+public:
+    DegreeSequence(const SynthConfig& cfg) : zipf_(cfg.nodes, cfg.out_skew), n_(cfg.nodes), edges_(cfg.edges) {
+        base_ = zipf_.h_integral(0.5);
+        total_ = zipf_.h_integral(static_cast<double>(n_) + 0.5) - base_;
+    }
+
+    uint32_t operator()(uint64_t rank) const {
+        uint64_t lo = cumulative(rank);
+        uint64_t hi = cumulative(rank + 1);
+        return hi > lo ? static_cast<uint32_t>(hi - lo) : 0;
+    }
+
+private:
+    uint64_t cumulative(uint64_t k) const {
+        if (k == 0) return 0;
+        if (k >= n_) return edges_;
+        double share = (zipf_.h_integral(static_cast<double>(k) + 0.5) - base_) / total_;
+        return std::min(edges_, static_cast<uint64_t>(static_cast<double>(edges_) * share));
+    }
+
+    ZipfSampler zipf_;
+    uint64_t n_;
+    uint64_t edges_;
+    double base_;
+    double total_;
+};
+
+// Runs fn(chunk) for every chunk in [0, chunks) from `threads` workers
+// pulling chunks in order, so skewed chunks do not stall one thread.
+template <typename Fn>
+static void for_each_chunk(size_t chunks, size_t threads, Fn fn) {
+    std::atomic<size_t> next{0};
+    parallel_for(0, std::max<size_t>(1, threads), std::max<size_t>(1, threads), [&](size_t) {
+        for (size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) fn(c);
+    });
+}
+
+// Node IDs [lo, hi) of chunk c.
+static void chunk_nodes(uint32_t n, size_t c, uint32_t& lo, uint32_t& hi) {
+    lo = static_cast<uint32_t>(c * kSynthChunk + 1);
+    hi = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(n) + 1, (c + 1) * kSynthChunk + 1));
+}
+
+static bool finish_files(const std::vector<std::string>& paths, std::vector<MMapArrayBase>& maps) {
+    bool ok = true;
+    for (auto& m : maps) {
+        ok = sync_mapping(m) && ok;
+        unmap(m);
+    }
+    for (const std::string& p : paths) ok = ok && std::rename((p + ".tmp").c_str(), p.c_str()) == 0;
+    return ok;
+}
+
+bool write_synthetic_graph(const std::string& dir, const SynthConfig& cfg) {
+    if (cfg.nodes == 0 || cfg.relations == 0 || cfg.relations > std::numeric_limits<uint16_t>::max() ||
+        cfg.edges >= std::numeric_limits<uint32_t>::max() || cfg.nodes == std::numeric_limits<uint32_t>::max() ||
+        cfg.out_skew < 0.0 || cfg.in_skew < 0.0 || cfg.rel_skew < 0.0) {
+        std::cerr << "Invalid synthetic graph size (nodes and relations > 0, relations < 65536, "
+                     "nodes and edges < 2^32 - 1, skews >= 0)\n";
+        return false;
+    }
+    const uint32_t n = cfg.nodes;
+    const size_t chunks = (static_cast<size_t>(n) + kSynthChunk - 1) / kSynthChunk;
+    const IndexPermutation out_rank(n, mix_seed(cfg.seed ^ 0x6f7574ULL));
+    const IndexPermutation in_node(n, mix_seed(cfg.seed ^ 0x696eULL));
+    const DegreeSequence degree(cfg);
+    const ZipfSampler dst_rank(n, cfg.in_skew);
+    const ZipfSampler rel_rank(cfg.relations, cfg.rel_skew);
+
+    // Edges per chunk, then each chunk's first slot.
+    std::vector<uint64_t> start(chunks + 1, 0);
+    for_each_chunk(chunks, cfg.threads, [&](size_t c) {
+        uint32_t lo, hi;
+        chunk_nodes(n, c, lo, hi);
+        uint64_t sum = 0;
+        for (uint32_t v = lo; v < hi; ++v) sum += degree(out_rank(v - 1));
+        start[c + 1] = sum;
+    });
+    for (size_t c = 0; c < chunks; ++c) start[c + 1] += start[c];
+    const uint64_t m = start[chunks];
+    if (m >= std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Synthetic graph has too many edges for 32-bit offsets\n";
+        return false;
+    }
+
+    remove_packed(dir, "csr");
+    const std::vector<std::string> paths = {dir + "/offsets.bin", dir + "/csr.bin", dir + "/rels.bin",
+                                            dir + "/entities.bin"};
+    const size_t bytes[] = {(static_cast<size_t>(n) + 2) * sizeof(uint32_t), m * sizeof(uint32_t),
+                            m * sizeof(uint16_t), static_cast<size_t>(n) * sizeof(uint32_t)};
+    std::vector<MMapArrayBase> maps(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!map_writable(paths[i] + ".tmp", bytes[i], maps[i])) {
+            for (auto& mm : maps) unmap(mm);
+            return false;
+        }
+    }
+    uint32_t* offsets = static_cast<uint32_t*>(maps[0].data);
+    uint32_t* csr = static_cast<uint32_t*>(maps[1].data);
+    uint16_t* rels = static_cast<uint16_t*>(maps[2].data);
+    uint32_t* entities = static_cast<uint32_t*>(maps[3].data);
+    offsets[0] = 0;
+    offsets[1] = 0;
+
+    for_each_chunk(chunks, cfg.threads, [&](size_t c) {
+        uint32_t lo, hi;
+        chunk_nodes(n, c, lo, hi);
+        XorShift128Plus rng(cfg.seed, c + 1);
+        std::vector<uint64_t> adj; // (dst << 16) | rel, sorted
+        uint64_t pos = start[c];
+        for (uint32_t v = lo; v < hi; ++v) {
+            const uint32_t d = degree(out_rank(v - 1));
+            adj.resize(d);
+            for (uint32_t i = 0; i < d; ++i) {
+                uint64_t dst = in_node(dst_rank(rng) - 1) + 1;
+                adj[i] = (dst << 16) | rel_rank(rng);
+            }
+            std::sort(adj.begin(), adj.end());
+            for (uint64_t e : adj) {
+                csr[pos] = static_cast<uint32_t>(e >> 16);
+                rels[pos] = static_cast<uint16_t>(e & 0xffff);
+                ++pos;
+            }
+            offsets[v + 1] = static_cast<uint32_t>(pos);
+            entities[v - 1] = v;
+        }
+    });
+
+    std::vector<uint16_t> props(cfg.relations);
+    for (uint32_t r = 0; r < cfg.relations; ++r) props[r] = static_cast<uint16_t>(r + 1);
+    if (!finish_files(paths, maps) || !write_array(dir + "/props.bin", props)) {
+        std::cerr << "Failed to write synthetic graph to " << dir << "\n";
+        return false;
+    }
+    if (cfg.reverse) {
+        CsrGraph g;
+        if (!g.load_custom(dir, "offsets.bin", "csr.bin", "rels.bin", "entities.bin", "props.bin", "") ||
+            !write_reverse_csr(g, dir, cfg.threads, size_t(1) << 30)) {
+            std::cerr << "Failed to write reverse CSR to " << dir << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool write_edge_triples(const CsrGraph& g, const std::string& train_path, const std::string& eval_path,
+                        const TripleSplit& split, uint64_t& train_count, uint64_t& eval_count) {
+    const uint32_t n = g.num_nodes();
+    const size_t chunks = (static_cast<size_t>(n) + kSynthChunk - 1) / kSynthChunk;
+    const double eval_cut = split.eval_fraction;
+    const double train_cut = eval_cut + split.train_fraction * (1.0 - eval_cut);
+    // 0 = eval, 1 = train, 2 = neither, from a hash of the edge's position.
+    auto kind = [&](uint64_t e) {
+        double u = static_cast<double>(mix_seed(split.seed ^ mix_seed(e)) >> 11) * 0x1.0p-53;
+        return u < eval_cut ? 0 : u < train_cut ? 1 : 2;
+    };
+    // Global position of each chunk's first edge, for the hash.
+    std::vector<uint64_t> first(chunks + 1, 0);
+    for_each_chunk(chunks, split.threads, [&](size_t c) {
+        uint32_t lo, hi;
+        chunk_nodes(n, c, lo, hi);
+        uint64_t sum = 0;
+        for (uint32_t v = lo; v < hi; ++v) sum += g.out_degree(v);
+        first[c + 1] = sum;
+    });
+    for (size_t c = 0; c < chunks; ++c) first[c + 1] += first[c];
+
+    std::vector<uint64_t> train_at(chunks + 1, 0), eval_at(chunks + 1, 0);
+    for_each_chunk(chunks, split.threads, [&](size_t c) {
+        for (uint64_t e = first[c]; e < first[c + 1]; ++e) {
+            int k = kind(e);
+            if (k == 0) ++eval_at[c + 1];
+            if (k == 1) ++train_at[c + 1];
+        }
+    });
+    for (size_t c = 0; c < chunks; ++c) {
+        train_at[c + 1] += train_at[c];
+        eval_at[c + 1] += eval_at[c];
+    }
+    train_count = train_path.empty() ? 0 : train_at[chunks];
+    eval_count = eval_path.empty() ? 0 : eval_at[chunks];
+
+    std::vector<std::string> paths;
+    std::vector<MMapArrayBase> maps;
+    Triple* out[2] = {nullptr, nullptr}; // eval, train
+    const std::string* want[2] = {&eval_path, &train_path};
+    const uint64_t counts[2] = {eval_count, train_count};
+    for (int k = 0; k < 2; ++k) {
+        if (want[k]->empty()) continue;
+        MMapArrayBase map;
+        if (!map_writable(*want[k] + ".tmp", counts[k] * sizeof(Triple), map)) {
+            for (auto& mm : maps) unmap(mm);
+            return false;
+        }
+        out[k] = static_cast<Triple*>(map.data);
+        paths.push_back(*want[k]);
+        maps.push_back(map);
+    }
+
+    for_each_chunk(chunks, split.threads, [&](size_t c) {
+        uint64_t at[2] = {eval_at[c], train_at[c]};
+        uint64_t e = first[c];
+        std::vector<uint32_t> dst_scratch;
+        std::vector<uint16_t> rel_scratch;
+        uint32_t lo, hi;
+        chunk_nodes(n, c, lo, hi);
+        for (uint32_t v = lo; v < hi; ++v) {
+            AdjView adj = g.neighbors(v).unpacked(dst_scratch, rel_scratch);
+            for (uint32_t i = 0; i < adj.size; ++i, ++e) {
+                int k = kind(e);
+                if (k == 2) continue;
+                uint64_t p = at[k]++;
+                if (out[k]) out[k][p] = Triple{v, adj.rel[i], adj.dst[i]};
+            }
+        }
+    });
+    if (!finish_files(paths, maps)) {
+        std::cerr << "Failed to write triple files\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "csr.hpp"
+#include "threadpool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Skewed random directed multigraph in the Chung-Lu style. Nodes get an
+// out-rank and an in-rank from two independent pseudo-random permutations.
+// The node of out-rank k gets the expected out-degree of a Zipf(out_skew)
+// distribution over `edges` draws, rounded so the degrees sum to `edges`.
+// Every edge draws its destination's in-rank from Zipf(in_skew) and its
+// relation from Zipf(rel_skew). Skew 0 is uniform. Out-hubs and in-hubs are
+// therefore different nodes, and the relations are dominated by a few
+// frequent ones, as in Wikidata.
+//
+// Generation is parallel and streams into mapped output files. Nodes are cut
+// into fixed chunks and each chunk draws from its own stream, so the output
+// depends only on the config, not on `threads`.
+struct SynthConfig {
+    uint32_t nodes = 100000;
+    uint64_t edges = 1000000;
+    uint32_t relations = 100;
+    double out_skew = 0.8;
+    double in_skew = 0.8;
+    double rel_skew = 1.0;
+    uint64_t seed = 1;
+    size_t threads = default_threads();
+    bool reverse = true; // also write the *_rev.bin files
+};
+
+// Writes offsets.bin, csr.bin, rels.bin (each adjacency list sorted by
+// (dst, rel) like kg_gencsr), entities.bin (Q ID = node ID), props.bin
+// (P ID = relation ID) and, with cfg.reverse, the reverse files into `dir`.
+bool write_synthetic_graph(const std::string& dir, const SynthConfig& cfg);
+
+struct TripleSplit {
+    double eval_fraction = 0.001; // of all edges
+    double train_fraction = 1.0;  // of the edges not held out for eval
+    uint64_t seed = 1;
+    size_t threads = default_threads();
+};
+
+// Writes the edges of `g` as Triple files in edge order. Each edge is hashed
+// with the seed into eval (a fraction eval_fraction), train (train_fraction of
+// the rest), or neither, so the two files are disjoint and deterministic.
+// An empty path skips that file. `train_count`/`eval_count` receive the sizes.
+bool write_edge_triples(const CsrGraph& g, const std::string& train_path, const std::string& eval_path,
+                        const TripleSplit& split, uint64_t& train_count, uint64_t& eval_count);
@@ -0,0 +1,292 @@
+#include "trainer.hpp"
+
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+void epoch_order(size_t total, uint64_t seed, uint64_t epoch, std::vector<size_t>& order) {
+    order.resize(total);
+    for (size_t i = 0; i < total; ++i) order[i] = i;
+    XorShift128Plus rng(seed, epoch + 1);
+    for (size_t i = total; i > 1; --i) {
+        size_t j = rng.next_u32(static_cast<uint32_t>(i));
+        std::swap(order[i - 1], order[j]);
+    }
+}
+
+void cluster_epoch_order(const Triple* triples, size_t total, const std::vector<uint32_t>& part,
+                         size_t per_group, uint64_t seed, uint64_t epoch, std::vector<size_t>& order) {
+    auto part_of = [&](size_t i) { return triples[i].h < part.size() ? part[triples[i].h] : 0u; };
+    uint32_t parts = 1;
+    for (size_t v = 1; v < part.size(); ++v) parts = std::max(parts, part[v] + 1);
+    std::vector<size_t> start(static_cast<size_t>(parts) + 1, 0);
+    for (size_t i = 0; i < total; ++i) ++start[part_of(i) + 1];
+    for (uint32_t p = 0; p < parts; ++p) start[p + 1] += start[p];
+    std::vector<size_t> bucketed(total), fill(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < total; ++i) bucketed[fill[part_of(i)]++] = i;
+
+    XorShift128Plus rng(seed, epoch + 1);
+    std::vector<uint32_t> cluster(parts);
+    for (uint32_t p = 0; p < parts; ++p) cluster[p] = p;
+    for (uint32_t i = parts; i > 1; --i) std::swap(cluster[i - 1], cluster[rng.next_u32(i)]);
+
+    order.clear();
+    order.reserve(total);
+    per_group = std::max<size_t>(1, per_group);
+    for (size_t c = 0; c < parts; c += per_group) {
+        size_t group_begin = order.size();
+        for (size_t k = c; k < std::min<size_t>(parts, c + per_group); ++k) {
+            order.insert(order.end(), bucketed.begin() + start[cluster[k]], bucketed.begin() + start[cluster[k] + 1]);
+        }
+        for (size_t i = order.size() - group_begin; i > 1; --i) {
+            std::swap(order[group_begin + i - 1], order[group_begin + rng.next_u32(static_cast<uint32_t>(i))]);
+        }
+    }
+}
+
+Trainer::Trainer(Encoder& enc, Decoder& dec, Optimizer& optim, const CsrGraph& g, const CsrGraph* rev,
+                 const Triple* triples, size_t count, const TrainConfig& cfg, XorShift128Plus& rng)
+    : enc_(enc), dec_(dec), optim_(optim), g_(g), rev_(rev), triples_(triples), count_(count),
+      cfg_(cfg), rng_(rng), sizer_(cfg.mem_budget, cfg.batch_size) {
+    enc_.set_phase_times(cfg_.phase_times);
+    auto params = enc_.parameters();
+    auto dparams = dec_.parameters();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    size_t param_bytes = 0;
+    for (const Parameter* p : params) {
+        param_bytes += p->data.size() * sizeof(float);
+        grad_bytes_ += p->grad.size() * sizeof(float);
+    }
+    if (cfg_.memory) {
+        size_t moment_bytes = 0;
+        for (const auto& m : optim_.m()) moment_bytes += m.size() * sizeof(float);
+        for (const auto& v : optim_.v()) moment_bytes += v.size() * sizeof(float);
+        cfg_.memory->set(MemKind::Parameters, param_bytes);
+        cfg_.memory->set(MemKind::Gradients, grad_bytes_);
+        cfg_.memory->set(MemKind::Optimizer, moment_bytes);
+    }
+    build_order();
+}
+
+void Trainer::build_order() {
+    if (cfg_.partition) {
+        cluster_epoch_order(triples_, count_, *cfg_.partition, cfg_.clusters_per_batch, cfg_.shuffle_seed, epoch_,
+                            order_);
+    } else {
+        epoch_order(count_, cfg_.shuffle_seed, epoch_, order_);
+    }
+}
+
+bool Trainer::step(BatchResult& out) {
+    if (next_ >= count_) return false;
+    const uint32_t world = cfg_.allreduce ? cfg_.allreduce->world() : 1;
+    const uint32_t rank = cfg_.allreduce ? cfg_.allreduce->rank() : 0;
+    const size_t global_end = std::min(count_, next_ + cfg_.batch_size * world);
+    const size_t begin = std::min(global_end, next_ + cfg_.batch_size * rank);
+    const size_t end = std::min(global_end, begin + cfg_.batch_size);
+    size_t bs = end - begin;
+    std::vector<uint32_t> heads(bs), rels(bs), tails(bs);
+    for (size_t i = 0; i < bs; ++i) {
+        const Triple& tr = triples_[order_[begin + i]];
+        heads[i] = tr.h;
+        rels[i] = tr.r;
+        tails[i] = tr.t;
+    }
+    const size_t global_bs = global_end - next_;
+    next_ = global_end;
+
+    PhaseTimes* times = cfg_.phase_times;
+    {
+        ScopedPhase phase(times, Phase::Optimizer);
+        optim_.zero_grad();
+    }
+    out = BatchResult();
+    if (bs > 0) {
+        const size_t neg_per = cfg_.negatives;
+        std::vector<uint32_t> neg_tails(bs * neg_per);
+        {
+            ScopedPhase phase(times, Phase::Negatives);
+            for (size_t i = 0; i < bs * neg_per; ++i) {
+                neg_tails[i] = sample_negative(g_.num_nodes(), rng_);
+            }
+        }
+
+        // One pass over the whole batch unless the memory budget splits it.
+        const size_t layer_L = enc_.config().fanouts.size();
+        std::vector<uint32_t> mb_heads, mb_rels, mb_tails, mb_negs, batch_nodes;
+        size_t done = 0;
+        while (done < bs) {
+            const size_t take = sizer_.next(bs - done);
+            // An unsplit batch works on the step's own vectors.
+            const bool whole = take == bs;
+            if (!whole) {
+                mb_heads.assign(heads.begin() + done, heads.begin() + done + take);
+                mb_rels.assign(rels.begin() + done, rels.begin() + done + take);
+                mb_tails.assign(tails.begin() + done, tails.begin() + done + take);
+                mb_negs.assign(neg_tails.begin() + done * neg_per, neg_tails.begin() + (done + take) * neg_per);
+            }
+            const std::vector<uint32_t>& b_heads = whole ? heads : mb_heads;
+            const std::vector<uint32_t>& b_rels = whole ? rels : mb_rels;
+            const std::vector<uint32_t>& b_tails = whole ? tails : mb_tails;
+            const std::vector<uint32_t>& b_negs = whole ? neg_tails : mb_negs;
+            {
+                ScopedPhase phase(times, Phase::Dedup);
+                std::unordered_set<uint32_t> seed_set;
+                seed_set.reserve(take * (2 + neg_per) + 1);
+                for (uint32_t v : b_heads) seed_set.insert(v);
+                for (uint32_t v : b_tails) seed_set.insert(v);
+                for (uint32_t v : b_negs) seed_set.insert(v);
+                batch_nodes.assign(seed_set.begin(), seed_set.end());
+            }
+            BatchSubgraph sg = enc_.sample(g_, batch_nodes, rng_);
+            const size_t step_bytes = enc_.predict_bytes(sg, true);
+            if (!sizer_.accept(take, step_bytes)) continue;
+
+            EncoderState st = enc_.forward(g_, rev_, std::move(sg));
+            std::vector<std::vector<float>> grad_layers(layer_L + 1);
+            grad_layers[layer_L].assign(st.sg.nodes_per_layer[layer_L].size() * enc_.output_dim(), 0.0f);
+
+            const auto& index_map = st.index_per_layer[layer_L];
+            const auto& embeds = st.h_layers[layer_L];
+            // Losses are means over the micro-batch; weight them into the
+            // batch mean (exactly 1 for an unsplit batch).
+            const float weight = static_cast<float>(take) / static_cast<float>(bs);
+            {
+                ScopedPhase phase(times, Phase::DistMult);
+                out.loss_tail += weight * dec_.distmult_loss(b_heads, b_rels, b_tails, b_negs, neg_per,
+                                                             index_map, embeds, grad_layers[layer_L]);
+            }
+            {
+                ScopedPhase phase(times, Phase::RelLoss);
+                out.loss_rel += weight * dec_.relation_loss(b_heads, b_tails, b_rels, index_map, embeds,
+                                                            grad_layers[layer_L], cfg_.lambda_rel);
+            }
+            out.layer_nodes.resize(st.sg.nodes_per_layer.size(), 0);
+            for (size_t l = 0; l < st.sg.nodes_per_layer.size(); ++l) {
+                out.rows += st.sg.nodes_per_layer[l].size();
+                out.layer_nodes[l] += st.sg.nodes_per_layer[l].size();
+            }
+            for (const auto& ls : st.sg.samples) out.edges += ls.neighbors.size();
+            out.nodes += st.sg.nodes_per_layer[0].size();
+            out.history_reads += st.history_reads;
+            out.activation_bytes = std::max(out.activation_bytes, st.activation_bytes());
+            ++out.micro_batches;
+            if (cfg_.memory) cfg_.memory->set(MemKind::Activations, st.activation_bytes());
+
+            {
+                ScopedPhase phase(times, Phase::Backward);
+                enc_.backward(st, grad_layers);
+            }
+            if (cfg_.memory) {
+                // Record the peak with the activation gradients, then their release.
+                size_t act_grad_bytes = 0;
+                for (const auto& gl : grad_layers) act_grad_bytes += gl.size() * sizeof(float);
+                cfg_.memory->set(MemKind::Gradients, grad_bytes_ + act_grad_bytes);
+                cfg_.memory->set(MemKind::Activations, 0);
+                cfg_.memory->set(MemKind::Gradients, grad_bytes_);
+            }
+            done += take;
+        }
+        out.triples = bs;
+    }
+    if (cfg_.allreduce) {
+        ScopedPhase phase(times, Phase::AllReduce);
+        reduce_gradients(out, global_bs);
+    }
+    ScopedPhase phase(times, Phase::Optimizer);
+    optim_.step();
+    return true;
+}
+
+// Sums every parameter gradient, plus the batch-weighted losses, across the
+// ranks. The losses come back as means over the whole global batch.
+void Trainer::reduce_gradients(BatchResult& out, size_t global_bs) {
+    auto params = enc_.parameters();
+    auto dparams = dec_.parameters();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    reduce_buf_.clear();
+    for (const Parameter* p : params) reduce_buf_.insert(reduce_buf_.end(), p->grad.begin(), p->grad.end());
+    reduce_buf_.push_back(out.loss_tail * static_cast<float>(out.triples));
+    reduce_buf_.push_back(out.loss_rel * static_cast<float>(out.triples));
+    cfg_.allreduce->sum(reduce_buf_.data());
+    size_t pos = 0;
+    for (Parameter* p : params) {
+        std::copy(reduce_buf_.begin() + pos, reduce_buf_.begin() + pos + p->grad.size(), p->grad.begin());
+        pos += p->grad.size();
+    }
+    out.loss_tail = reduce_buf_[pos] / static_cast<float>(global_bs);
+    out.loss_rel = reduce_buf_[pos + 1] / static_cast<float>(global_bs);
+    out.triples = global_bs;
+}
+
+void Trainer::next_epoch() {
+    ++epoch_;
+    next_ = 0;
+    build_order();
+}
+
+TrainProgress Trainer::progress() const {
+    TrainProgress p;
+    p.valid = true;
+    // A finished epoch is reported as the start of the next one.
+    p.epoch = next_ >= count_ ? epoch_ + 1 : epoch_;
+    p.next = next_ >= count_ ? 0 : next_;
+    p.shuffle_seed = cfg_.shuffle_seed;
+    p.batch_estimate = sizer_.estimate();
+    rng_.get_state(p.rng_s0, p.rng_s1);
+    return p;
+}
+
+void Trainer::restore(const TrainProgress& p) {
+    cfg_.shuffle_seed = p.shuffle_seed;
+    epoch_ = p.epoch;
+    next_ = static_cast<size_t>(p.next);
+    rng_.set_state(p.rng_s0, p.rng_s1);
+    sizer_.set_estimate(p.batch_estimate);
+    build_order();
+}
+
+size_t allreduce_floats(const Encoder& enc, const Decoder& dec) {
+    size_t floats = 2;
+    for (const auto& spec : enc.parameter_specs()) floats += spec.size;
+    for (const auto& spec : dec.parameter_specs()) floats += spec.size;
+    return floats;
+}
+
+bool restore_model(const CheckpointView& view, Encoder& enc, Decoder& dec, Optimizer& optim) {
+    auto params = enc.parameters();
+    auto dparams = dec.parameters();
+    params.insert(params.end(), dparams.begin(), dparams.end());
+    auto specs = enc.parameter_specs();
+    auto dspecs = dec.parameter_specs();
+    specs.insert(specs.end(), dspecs.begin(), dspecs.end());
+
+    std::vector<std::vector<float>> m, v;
+    const bool want_adam = !optim.m().empty();
+    for (size_t i = 0; i < specs.size(); ++i) {
+        std::string key = view.version() == 1 ? std::to_string(i) : specs[i].name;
+        const CheckpointTensor* p = view.find("param." + key);
+        const CheckpointTensor* pm = view.find("adam.m." + key);
+        const CheckpointTensor* pv = view.find("adam.v." + key);
+        if (!p || p->count != specs[i].size || p->count != params[i]->size()) {
+            std::cerr << "Checkpoint tensor missing or mis-sized: " << specs[i].name << "\n";
+            return false;
+        }
+        params[i]->data.assign(static_cast<const float*>(p->data), p->count);
+        params[i]->grad.assign(p->count, 0.0f);
+        if (!want_adam) continue;
+        if (!pm || !pv || pm->count != p->count || pv->count != p->count) {
+            std::cerr << "Checkpoint has no Adam state for " << specs[i].name << "\n";
+            return false;
+        }
+        const float* mp = static_cast<const float*>(pm->data);
+        const float* vp = static_cast<const float*>(pv->data);
+        m.emplace_back(mp, mp + pm->count);
+        v.emplace_back(vp, vp + pv->count);
+    }
+    optim.set_state(m, v, view.meta().step);
+    return true;
+}
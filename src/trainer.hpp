@@ -0,0 +1,114 @@
+#pragma once
+
+#include "allreduce.hpp"
+#include "checkpoint.hpp"
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "optim.hpp"
+#include "profile.hpp"
+#include "rng.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TrainConfig {
+    size_t batch_size = 256;
+    size_t negatives = 5;
+    float lambda_rel = 1.0f;
+    uint64_t shuffle_seed = 1;
+    // Cluster batching: with a node partition, triples are grouped by the
+    // part of their head and each run of batches is drawn from
+    // clusters_per_batch randomly chosen parts (see cluster_epoch_order).
+    const std::vector<uint32_t>* partition = nullptr;
+    size_t clusters_per_batch = 4;
+    // Data-parallel training: each step takes world x batch_size triples of
+    // the shared epoch order, this rank trains on slice `rank` of them, and
+    // the gradients (sums over the triples) are summed across ranks before
+    // the optimizer step, so every rank applies the same update.
+    ShmAllReduce* allreduce = nullptr;
+    // Wall time of each step phase is added here when set (see profile.hpp).
+    PhaseTimes* phase_times = nullptr;
+    // Memory budget for one forward/backward pass (saved activations plus
+    // their gradients), in bytes; 0: no limit. A batch whose sampled subgraph
+    // would exceed it is split into micro-batches with fewer triples, chosen
+    // by an AdaptiveBatch, whose gradients are summed before the one
+    // optimizer step, so the update still covers the whole batch.
+    size_t mem_budget = 0;
+    // Parameter, gradient, optimizer and activation bytes are reported here.
+    MemoryAccount* memory = nullptr;
+};
+
+struct BatchResult {
+    float loss_tail = 0.0f;
+    float loss_rel = 0.0f;
+    size_t triples = 0;
+    size_t rows = 0;          // node rows computed over all encoder layers
+    size_t nodes = 0;         // unique nodes in the batch subgraph
+    size_t history_reads = 0; // neighbour messages read from the HistoryStore
+    size_t edges = 0;         // sampled neighbour edges over all layers
+    size_t activation_bytes = 0;     // largest micro-batch
+    size_t micro_batches = 0;        // forward/backward passes the batch was split into
+    std::vector<size_t> layer_nodes; // unique nodes per layer, input layer first
+};
+
+// Permutation of [0, total) used as the training order of `epoch`. It depends
+// only on (seed, epoch), so a resumed run rebuilds the same order.
+void epoch_order(size_t total, uint64_t seed, uint64_t epoch, std::vector<size_t>& order);
+
+// Cluster-GCN style order: buckets the triples by part[h], shuffles the
+// parts, and emits them in groups of `per_group` parts with each group's
+// triples shuffled together. Consecutive batches then share most of their
+// neighbourhood. Depends only on (triples, part, seed, epoch).
+void cluster_epoch_order(const Triple* triples, size_t total, const std::vector<uint32_t>& part,
+                         size_t per_group, uint64_t seed, uint64_t epoch, std::vector<size_t>& order);
+
+// Drives mini-batch training over a triple set: walks the epoch order in
+// batch_size steps, sampling negatives and subgraphs from rng, and applies one
+// optimizer step per batch.
+class Trainer {
+public:
+    Trainer(Encoder& enc, Decoder& dec, Optimizer& optim, const CsrGraph& g, const CsrGraph* rev,
+            const Triple* triples, size_t count, const TrainConfig& cfg, XorShift128Plus& rng);
+
+    // Trains the batch at the cursor. Returns false, without training, once
+    // the current epoch is exhausted.
+    bool step(BatchResult& out);
+    void next_epoch();
+    uint64_t epoch() const { return epoch_; }
+
+    TrainProgress progress() const;
+    void restore(const TrainProgress& p);
+    const AdaptiveBatch& batch_sizer() const { return sizer_; }
+
+private:
+    void build_order();
+    void reduce_gradients(BatchResult& out, size_t global_bs);
+
+    Encoder& enc_;
+    Decoder& dec_;
+    Optimizer& optim_;
+    const CsrGraph& g_;
+    const CsrGraph* rev_;
+    const Triple* triples_;
+    size_t count_;
+    TrainConfig cfg_;
+    XorShift128Plus& rng_;
+    std::vector<size_t> order_;
+    uint64_t epoch_ = 0;
+    size_t next_ = 0;
+    std::vector<float> reduce_buf_;
+    AdaptiveBatch sizer_;
+    size_t grad_bytes_ = 0; // parameter gradients
+};
+
+// Length of the vector Trainer sums per step through TrainConfig::allreduce:
+// every parameter gradient plus the two batch losses.
+size_t allreduce_floats(const Encoder& enc, const Decoder& dec);
+
+// Restores parameters and Adam moments/step from a checkpoint into an
+// already-constructed model with matching shapes.
+bool restore_model(const CheckpointView& view, Encoder& enc, Decoder& dec, Optimizer& optim);
@@ -0,0 +1,54 @@
+#include "tune.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+int run_search(std::vector<TuneTrial>& trials, const TuneSearch& cfg, const TrialMeasure& measure, std::ostream& log) {
+    std::vector<size_t> alive;
+    for (size_t i = 0; i < trials.size(); ++i) if (trials[i].fits) alive.push_back(i);
+    const size_t eta = std::max<size_t>(2, cfg.eta);
+    size_t units = std::max<size_t>(1, cfg.units);
+    // The fastest trial that fit in the latest round any did, with the rate
+    // and peak it fit at, in case every survivor of a later round goes over.
+    int best = -1;
+    double best_rate = 0.0;
+    size_t best_peak = 0;
+    for (size_t round = 1; !alive.empty(); ++round) {
+        for (size_t i : alive) {
+            TuneTrial& t = trials[i];
+            measure(t, units);
+            ++t.rounds;
+            if (cfg.mem_ceiling > 0 && t.peak_bytes > cfg.mem_ceiling) t.fits = false;
+            log << "  round " << round << " (" << units << "): " << t.label << "  ";
+            if (t.rate > 0.0) {
+                log << std::fixed << std::setprecision(0) << t.rate << " " << cfg.unit << "/s, peak "
+                    << std::setprecision(1) << static_cast<double>(t.peak_bytes) / (1 << 20) << "MB"
+                    << std::defaultfloat << std::setprecision(6);
+            }
+            if (!t.fits) log << (t.rate > 0.0 ? " " : "") << "over the memory ceiling";
+            log << "\n";
+        }
+        alive.erase(std::remove_if(alive.begin(), alive.end(), [&](size_t i) { return !trials[i].fits; }),
+                    alive.end());
+        // Stable, so equal rates keep the candidate order.
+        std::stable_sort(alive.begin(), alive.end(),
+                         [&](size_t a, size_t b) { return trials[a].rate > trials[b].rate; });
+        if (alive.empty()) break;
+        best = static_cast<int>(alive.front());
+        best_rate = trials[best].rate;
+        best_peak = trials[best].peak_bytes;
+        if (!cfg.halving || alive.size() <= 1) break;
+        alive.resize((alive.size() + eta - 1) / eta);
+        if (alive.size() == 1) break;
+        units *= eta;
+    }
+    if (alive.empty() && best >= 0) {
+        TuneTrial& t = trials[best];
+        log << "  no survivor fits; keeping " << t.label << " from round " << t.rounds - 1 << "\n";
+        t.rate = best_rate;
+        t.peak_bytes = best_peak;
+        t.fits = true;
+    }
+    return best;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "config_file.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// One candidate configuration in a kg_tune search.
+struct TuneTrial {
+    std::string label;      // for the log, e.g. "batch=512 fanouts=20,10"
+    ConfigEntries flags;    // written to the config file if it wins
+    double rate = 0.0;      // items per second in its latest measurement
+    size_t peak_bytes = 0;  // tracked memory peak of its latest measurement
+    bool fits = true;       // false once it went (or is known to go) over the ceiling
+    size_t rounds = 0;      // measurements taken
+};
+
+// Times `units` units of work (training steps, cache builds) under `trial`,
+// setting its rate and peak_bytes. May clear `fits` without measuring when the
+// trial cannot stay under the ceiling.
+using TrialMeasure = std::function<void(TuneTrial& trial, size_t units)>;
+
+struct TuneSearch {
+    bool halving = true;     // successive halving; false: every trial measured once (grid)
+    size_t units = 4;        // work per trial in the first round
+    size_t eta = 3;          // halving: the best 1/eta survive each round with eta times the units
+    size_t mem_ceiling = 0;  // bytes; trials peaking above it are dropped. 0: no limit
+    std::string unit = "items";
+};
+
+// Measures the trials, dropping those over the ceiling, and with halving
+// re-measures the fastest 1/eta with eta times the work until one is left, so
+// most of the time goes to the likely winners. Logs one line per measurement.
+// Returns the index of the fastest trial that fits, or -1 when none does. When
+// every survivor of a later round goes over the ceiling, that is the fastest
+// of the last round that had one fit, with the rate and peak it fit at.
+int run_search(std::vector<TuneTrial>& trials, const TuneSearch& cfg, const TrialMeasure& measure, std::ostream& log);
@@ -0,0 +1,96 @@
+#include "async_checkpoint.hpp"
+#include "checkpoint.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "optim.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static void random_step(const std::vector<Parameter*>& params, Optimizer& opt, XorShift128Plus& rng) {
+    for (Parameter* p : params) {
+        for (float& g : p->grad) g = rng.uniform() - 0.5f;
+    }
+    opt.step();
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = false;
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 32;
+    ecfg.layers = 2;
+    ecfg.fanouts = {4, 3};
+    const size_t num_rel = 200;
+    XorShift128Plus rng(9);
+    Encoder enc(feature_dim(fcfg, false), num_rel, ecfg, fcfg, rng);
+    Decoder dec(num_rel, ecfg.hidden_dim, enc.relation_embeddings(), rng);
+    std::vector<Parameter*> params = enc.parameters();
+    auto dp = dec.parameters();
+    params.insert(params.end(), dp.begin(), dp.end());
+    OptimConfig oc;
+    Optimizer opt(oc, params);
+    random_step(params, opt, rng);
+
+    // Snapshot, then keep training while the file is written: the file holds
+    // the state at the snapshot, not the one after the step.
+    const std::string base = dir + "/ckpt.bin";
+    AsyncCheckpointer periodic(base, 2);
+    TrainProgress progress;
+    progress.valid = true;
+    progress.epoch = 3;
+    progress.next = 17;
+    progress.rng_s0 = 5;
+    progress.rng_s1 = 6;
+    progress.shuffle_seed = 7;
+    take_snapshot(enc, dec, fcfg, &opt, periodic.acquire(), &progress);
+    std::vector<std::vector<float>> params_then, m_then = opt.m(), v_then = opt.v();
+    for (const Parameter* p : params) params_then.emplace_back(p->data.begin(), p->data.end());
+    periodic.submit(1);
+    random_step(params, opt, rng);
+    CHECK(!std::equal(params_then[0].begin(), params_then[0].end(), params[0]->data.begin()));
+    periodic.drain();
+    CHECK(periodic.written() == 1 && periodic.failed() == 0);
+
+    CheckpointMeta meta;
+    std::vector<std::vector<float>> pv, mv, vv;
+    CHECK(load_checkpoint(base + ".step1", meta, pv, mv, vv));
+    CHECK(pv == params_then && mv == m_then && vv == v_then);
+    CHECK(meta.step == 1 && meta.enc_cfg.fanouts == ecfg.fanouts);
+    CHECK(meta.progress.valid && meta.progress.epoch == 3 && meta.progress.next == 17);
+    CHECK(meta.progress.rng_s0 == 5 && meta.progress.rng_s1 == 6 && meta.progress.shuffle_seed == 7);
+    CheckpointView view;
+    CHECK(view.open(base + ".step1") && view.verify());
+
+    // Only the newest `keep` files stay on disk.
+    for (size_t step = 2; step <= 4; ++step) {
+        random_step(params, opt, rng);
+        take_snapshot(enc, dec, fcfg, &opt, periodic.acquire());
+        periodic.submit(step);
+        periodic.drain();
+    }
+    CHECK(periodic.written() == 4 && periodic.failed() == 0);
+    CHECK(!fs::exists(base + ".step1") && !fs::exists(base + ".step2"));
+    CHECK(fs::exists(base + ".step3") && fs::exists(base + ".step4"));
+    CheckpointMeta last;
+    std::vector<std::vector<float>> lp, lm, lv;
+    CHECK(load_checkpoint(base + ".step4", last, lp, lm, lv));
+    CHECK(last.step == 5 && !last.progress.valid); // optimizer steps, not the file label
+    for (size_t i = 0; i < params.size(); ++i) CHECK(std::equal(lp[i].begin(), lp[i].end(), params[i]->data.begin()));
+
+    fs::remove_all(dir);
+    std::printf("async checkpoint ok\n");
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "io.hpp"
+#include "optim.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct RunResult {
+    std::vector<float> embeddings;
+    std::vector<std::vector<float>> grads;
+    size_t activation_bytes = 0;
+};
+
+// One forward/backward pass; identical seeds give identical weights and samples.
+static RunResult run(const CsrGraph& g, bool bf16) {
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = false;
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 16;
+    ecfg.layers = 2;
+    ecfg.fanouts = {3, 2};
+    ecfg.bf16_activations = bf16;
+
+    XorShift128Plus rng_init(7);
+    Encoder enc(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg, rng_init);
+    Decoder dec(g.num_relations(), ecfg.hidden_dim, enc.relation_embeddings(), rng_init);
+
+    std::vector<uint32_t> heads = {1, 2, 4};
+    std::vector<uint32_t> rels = {1, 2, 1};
+    std::vector<uint32_t> tails = {2, 3, 5};
+    std::vector<uint32_t> negs = {6, 3, 1};
+    std::vector<uint32_t> seeds = {1, 2, 3, 4, 5, 6};
+
+    XorShift128Plus rng(11);
+    EncoderState st = enc.forward(g, nullptr, seeds, rng);
+    std::vector<std::vector<float>> grad(ecfg.fanouts.size() + 1);
+    grad.back().assign(st.sg.nodes_per_layer.back().size() * ecfg.hidden_dim, 0.0f);
+    dec.distmult_loss(heads, rels, tails, negs, 1, st.index_per_layer.back(), st.h_layers.back(),
+                      grad.back());
+    dec.relation_loss(heads, tails, rels, st.index_per_layer.back(), st.h_layers.back(), grad.back());
+
+    RunResult res;
+    res.activation_bytes = st.activation_bytes();
+    enc.backward(st, grad);
+    res.embeddings = st.h_layers.back();
+    for (const Parameter* p : enc.parameters_const()) res.grads.push_back(p->grad);
+    for (const Parameter* p : dec.parameters_const()) res.grads.push_back(p->grad);
+    return res;
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    // 6 nodes, 2 relations, every node has out-edges
+    std::vector<uint32_t> offsets = {0, 0, 2, 4, 5, 7, 8, 10};
+    std::vector<uint32_t> csr = {2, 3, 3, 4, 5, 1, 6, 2, 1, 4};
+    std::vector<uint16_t> rels = {1, 2, 1, 1, 2, 1, 2, 1, 2, 1};
+    std::vector<uint32_t> entities = {10, 20, 30, 40, 50, 60};
+    std::vector<uint16_t> props = {31, 279};
+
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", props));
+
+    CsrGraph g(dir);
+    CHECK(g.valid());
+
+    RunResult f32 = run(g, false);
+    RunResult b16 = run(g, true);
+
+    // Forward compute is fp32 in both modes, so the outputs match exactly.
+    CHECK(f32.embeddings == b16.embeddings);
+
+    // Gradients see bf16-rounded activations; allow bf16-sized relative error.
+    double max_rel = 0.0;
+    CHECK(f32.grads.size() == b16.grads.size());
+    for (size_t p = 0; p < f32.grads.size(); ++p) {
+        double num = 0.0, den = 0.0;
+        for (size_t i = 0; i < f32.grads[p].size(); ++i) {
+            double d = static_cast<double>(f32.grads[p][i]) - b16.grads[p][i];
+            num += d * d;
+            den += static_cast<double>(f32.grads[p][i]) * f32.grads[p][i];
+        }
+        if (den > 0.0) max_rel = std::max(max_rel, std::sqrt(num / den));
+    }
+    CHECK(max_rel < 1e-2);
+    CHECK(b16.activation_bytes < f32.activation_bytes);
+
+    fs::remove_all(dir);
+    std::printf("bf16 activations ok (max grad rel err %.2e, bytes %zu -> %zu)\n",
+                max_rel, f32.activation_bytes, b16.activation_bytes);
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "checkpoint.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "optim.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+template <typename T>
+static void put(std::ofstream& f, T v) {
+    f.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Legacy KGC1 layout, as written before the v2 format existed.
+static void write_kgc1(const std::string& path, const EncoderConfig& ec, size_t num_rel,
+                       size_t feat_dim, const std::vector<const Parameter*>& params) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    put<uint32_t>(f, 0x4b474331);
+    put<uint32_t>(f, 1);
+    put<uint64_t>(f, ec.hidden_dim);
+    put<uint32_t>(f, static_cast<uint32_t>(ec.layers));
+    put<uint64_t>(f, ec.fanouts.size());
+    for (size_t fo : ec.fanouts) put<uint64_t>(f, fo);
+    put<uint8_t>(f, ec.use_relu ? 1 : 0);
+    put<uint8_t>(f, 0);
+    put<uint8_t>(f, 0);
+    put<uint64_t>(f, num_rel);
+    put<uint64_t>(f, feat_dim);
+    put<uint32_t>(f, static_cast<uint32_t>(params.size()));
+    for (const Parameter* p : params) {
+        put<uint64_t>(f, p->size());
+        f.write(reinterpret_cast<const char*>(p->data.data()), sizeof(float) * p->size());
+    }
+    put<uint8_t>(f, 0);
+    put<uint64_t>(f, 0);
+}
+
+static void check_bound(const CheckpointView& view, const std::vector<const Parameter*>& ref,
+                        const EncoderConfig& ecfg, const FeatureConfig& fcfg, size_t num_rel,
+                        size_t feat_dim) {
+    Encoder enc(feat_dim, num_rel, ecfg, fcfg);
+    Decoder dec(num_rel, ecfg.hidden_dim, enc.relation_embeddings());
+    CHECK(bind_checkpoint(view, enc, dec));
+    auto bound = enc.parameters_const();
+    auto dbound = dec.parameters_const();
+    bound.insert(bound.end(), dbound.begin(), dbound.end());
+    CHECK(bound.size() == ref.size());
+    for (size_t i = 0; i < ref.size(); ++i) {
+        CHECK(bound[i]->size() == ref[i]->size());
+        for (size_t k = 0; k < ref[i]->size(); ++k) CHECK(bound[i]->data[k] == ref[i]->data[k]);
+    }
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = false;
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 8;
+    ecfg.layers = 2;
+    ecfg.fanouts = {4, 3};
+    const size_t num_rel = 5;
+    const size_t feat_dim = feature_dim(fcfg, false);
+
+    XorShift128Plus rng(3);
+    Encoder enc(feat_dim, num_rel, ecfg, fcfg, rng);
+    Decoder dec(num_rel, ecfg.hidden_dim, enc.relation_embeddings(), rng);
+    std::vector<Parameter*> params = enc.parameters();
+    auto dp = dec.parameters();
+    params.insert(params.end(), dp.begin(), dp.end());
+    for (Parameter* p : params) {
+        for (float& g : p->grad) g = rng.uniform() - 0.5f;
+    }
+    OptimConfig oc;
+    Optimizer opt(oc, params);
+    opt.step();
+
+    std::vector<const Parameter*> ref = enc.parameters_const();
+    auto dref = dec.parameters_const();
+    ref.insert(ref.end(), dref.begin(), dref.end());
+
+    // v2: mapped, aligned, checksummed; Adam state round-trips through load_checkpoint.
+    std::string v2 = dir + "/ckpt_v2.bin";
+    CHECK(save_checkpoint(v2, enc, dec, fcfg, &opt));
+    {
+        CheckpointView view;
+        CHECK(view.open(v2));
+        CHECK(view.version() == 2);
+        CHECK(view.verify());
+        CHECK(view.meta().enc_cfg.fanouts == ecfg.fanouts);
+        CHECK(view.meta().step == 1);
+        for (const auto& t : view.tensors()) {
+            CHECK(reinterpret_cast<uintptr_t>(t.data) % 64 == 0);
+        }
+        check_bound(view, ref, ecfg, fcfg, num_rel, feat_dim);
+
+        CheckpointMeta meta;
+        std::vector<std::vector<float>> pv, mv, vv;
+        CHECK(load_checkpoint(v2, meta, pv, mv, vv));
+        CHECK(pv.size() == ref.size() && mv.size() == ref.size() && vv.size() == ref.size());
+        for (size_t i = 0; i < ref.size(); ++i) CHECK(mv[i] == opt.m()[i] && vv[i] == opt.v()[i]);
+    }
+
+    // Serving artifacts drop the moments; reduced-precision tensors expand to fp32 on open.
+    for (ExportPrecision prec : {ExportPrecision::F32, ExportPrecision::F16, ExportPrecision::BF16,
+                                 ExportPrecision::I8}) {
+        std::string out = dir + "/serving.bin";
+        {
+            CheckpointView view;
+            CHECK(view.open(v2));
+            CHECK(export_checkpoint(view, out, prec));
+        }
+        CheckpointView served;
+        CHECK(served.open(out));
+        CHECK(served.verify());
+        CHECK(!served.meta().use_adam && !served.find("adam.m.enc.rel_emb"));
+        Encoder e(feat_dim, num_rel, ecfg, fcfg);
+        Decoder d(num_rel, ecfg.hidden_dim, e.relation_embeddings());
+        CHECK(bind_checkpoint(served, e, d));
+        const float tol = prec == ExportPrecision::F32 ? 0.0f : 2e-3f;
+        const Parameter* rel = e.relation_embeddings();
+        const Parameter* ref_rel = enc.relation_embeddings();
+        for (size_t k = 0; k < rel->size(); ++k) CHECK(std::abs(rel->data[k] - ref_rel->data[k]) <= tol);
+        for (size_t k = 0; k < d.rel_cls_w().size(); ++k) {
+            CHECK(std::abs(d.rel_cls_w().data[k] - dec.rel_cls_w().data[k]) <= tol);
+        }
+    }
+
+    // Flipping a payload byte must fail verification but not opening.
+    {
+        std::fstream f(v2, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(-5, std::ios::end);
+        char c = 0;
+        f.read(&c, 1);
+        f.seekp(-5, std::ios::end);
+        c ^= 0x5a;
+        f.write(&c, 1);
+    }
+    {
+        CheckpointView view;
+        CHECK(view.open(v2));
+        CHECK(!view.verify());
+    }
+
+    // Legacy KGC1 files stay readable through the same interface.
+    std::string v1 = dir + "/ckpt_v1.bin";
+    write_kgc1(v1, ecfg, num_rel, feat_dim, ref);
+    {
+        CheckpointView view;
+        CHECK(view.open(v1));
+        CHECK(view.version() == 1);
+        CHECK(view.verify());
+        CHECK(view.meta().enc_cfg.hidden_dim == ecfg.hidden_dim);
+        check_bound(view, ref, ecfg, fcfg, num_rel, feat_dim);
+    }
+
+    // Reopening drops what the previous file set; other versions are refused.
+    {
+        CheckpointView view;
+        CHECK(view.open(v2) && view.checksum() != 0 && view.meta().step == 1);
+        CHECK(view.open(v1));
+        CHECK(view.version() == 1 && view.checksum() == 0 && view.meta().step == 0);
+        std::fstream f(v2, std::ios::binary | std::ios::in | std::ios::out);
+        const uint32_t version = 3;
+        f.seekp(sizeof(uint32_t));
+        f.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    {
+        CheckpointView view;
+        CHECK(!view.open(v2));
+    }
+
+    // A section table past the end of the file or off its alignment is
+    // reported as corrupt, not read.
+    for (const uint64_t table_offset : {uint64_t(1) << 40, uint64_t(65)}) {
+        {
+            std::fstream f(v2, std::ios::binary | std::ios::in | std::ios::out);
+            const uint32_t version = 2;
+            f.seekp(sizeof(uint32_t));
+            f.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            f.seekp(2 * sizeof(uint64_t));
+            f.write(reinterpret_cast<const char*>(&table_offset), sizeof(table_offset));
+        }
+        CheckpointView view;
+        CHECK(!view.open(v2));
+    }
+
+    fs::remove_all(dir);
+    std::printf("checkpoint v2 ok\n");
+    return 0;
+}
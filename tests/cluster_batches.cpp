@@ -0,0 +1,92 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "partition.hpp"
+#include "test_util.hpp"
+#include "trainer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    // Four rings of 50 nodes with interleaved IDs (v belongs to ring v % 4),
+    // so the contiguous starting partition is wrong for every node.
+    const uint32_t n = 200, rings = 4;
+    std::vector<uint32_t> offsets = {0, 0}, csr, entities;
+    std::vector<uint16_t> rels;
+    for (uint32_t v = 1; v <= n; ++v) {
+        uint32_t next = v + rings > n ? v + rings - n : v + rings;
+        uint32_t prev = v > rings ? v - rings : v + n - rings;
+        csr.push_back(next);
+        csr.push_back(prev);
+        rels.push_back(1);
+        rels.push_back(2);
+        offsets.push_back(static_cast<uint32_t>(csr.size()));
+        entities.push_back(v);
+    }
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", std::vector<uint16_t>{1, 2}));
+    CsrGraph g(dir);
+    CHECK(g.valid());
+
+    PartitionConfig pcfg;
+    pcfg.parts = rings;
+    pcfg.imbalance = 0.1;
+    pcfg.iterations = 50;
+    std::vector<uint32_t> part;
+    label_propagation(g, nullptr, pcfg, part);
+    CHECK(part.size() == n + 1);
+    std::vector<size_t> sizes(rings, 0);
+    size_t cut = 0;
+    for (uint32_t v = 1; v <= n; ++v) {
+        CHECK(part[v] < rings);
+        ++sizes[part[v]];
+        AdjView adj = g.neighbors(v);
+        for (uint32_t i = 0; i < adj.size; ++i) cut += part[adj.dst[i]] != part[v];
+    }
+    for (size_t s : sizes) CHECK(s >= 45 && s <= 56);
+    CHECK(cut < csr.size() / 4);
+    PartitionStats stats;
+    partition_stats(g, part.data(), rings, 2, stats);
+    CHECK(stats.total_cut == cut && stats.total_edges == csr.size());
+    for (uint32_t p = 0; p < rings; ++p) CHECK(stats.nodes[p] == sizes[p] && stats.edges[p] == 2 * sizes[p]);
+
+    // Several threads keep the balance constraint.
+    std::vector<uint32_t> threaded;
+    pcfg.threads = 3;
+    label_propagation(g, nullptr, pcfg, threaded);
+    partition_stats(g, threaded.data(), rings, 1, stats);
+    for (uint64_t s : stats.nodes) CHECK(s >= 45 && s <= 56);
+
+    // Triples along ring edges: the cluster order is a permutation, repeats
+    // for the same (seed, epoch), and keeps every group of parts contiguous.
+    std::vector<Triple> triples;
+    for (uint32_t v = 1; v <= n; ++v) triples.push_back({v, 1, csr[2 * (v - 1)]});
+    std::vector<size_t> order, again, other;
+    cluster_epoch_order(triples.data(), triples.size(), part, 2, 9, 0, order);
+    cluster_epoch_order(triples.data(), triples.size(), part, 2, 9, 0, again);
+    cluster_epoch_order(triples.data(), triples.size(), part, 2, 9, 1, other);
+    CHECK(order == again && order != other);
+    std::vector<size_t> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i) CHECK(sorted[i] == i);
+    std::vector<size_t> first(rings, triples.size()), last(rings, 0);
+    for (size_t i = 0; i < order.size(); ++i) {
+        uint32_t p = part[triples[order[i]].h];
+        first[p] = std::min(first[p], i);
+        last[p] = std::max(last[p], i);
+    }
+    std::vector<uint32_t> by_first = {0, 1, 2, 3};
+    std::sort(by_first.begin(), by_first.end(), [&](uint32_t a, uint32_t b) { return first[a] < first[b]; });
+    CHECK(std::max(last[by_first[0]], last[by_first[1]]) < first[by_first[2]]);
+
+    std::cout << "cluster batches ok\n";
+    return 0;
+}
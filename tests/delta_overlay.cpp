@@ -0,0 +1,116 @@
+#include "csr.hpp"
+#include "delta.hpp"
+#include "io.hpp"
+#include "test_util.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::vector<std::pair<uint32_t, uint16_t>> adjacency(const CsrGraph& g, uint32_t v) {
+    AdjView a = g.neighbors(v);
+    std::vector<std::pair<uint32_t, uint16_t>> out;
+    for (uint32_t i = 0; i < a.size; ++i) out.emplace_back(a.dst[i], a.rel[i]);
+    return out;
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    // 3 nodes: 1->2 (r1), 1->3 (r2), 2->3 (r1)
+    std::vector<uint32_t> offsets = {0, 0, 2, 3, 3};
+    std::vector<uint32_t> csr = {2, 3, 3};
+    std::vector<uint16_t> rels = {1, 2, 1};
+    std::vector<uint32_t> entities = {100, 200, 300};
+    std::vector<uint16_t> props = {31, 279};
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", props));
+
+    // New entity 4 (Q400); drop 1->3, add 1->4, 3->1 and 4->2 twice, then drop one 4->2 pair.
+    std::vector<uint32_t> new_entities = {400};
+    std::vector<DeltaRecord> log = {
+        {1, 3, 2, static_cast<uint16_t>(DeltaOp::Remove)},
+        {1, 4, 1, static_cast<uint16_t>(DeltaOp::Add)},
+        {3, 1, 2, static_cast<uint16_t>(DeltaOp::Add)},
+        {4, 2, 1, static_cast<uint16_t>(DeltaOp::Add)},
+        {4, 2, 2, static_cast<uint16_t>(DeltaOp::Add)},
+        {4, 2, 2, static_cast<uint16_t>(DeltaOp::Remove)},
+    };
+    CHECK(append_array(dir + "/delta_entities.bin", new_entities));
+    CHECK(append_delta(dir + "/delta.bin", log));
+
+    CsrGraph g(dir);
+    CHECK(g.valid());
+    CHECK(g.delta_records() == log.size());
+    CHECK(g.num_nodes() == 4 && g.base_nodes() == 3);
+    CHECK(g.num_edges() == 5);
+    CHECK(g.entity_of(4) == 400 && g.entity_of(2) == 200);
+    using Adj = std::vector<std::pair<uint32_t, uint16_t>>;
+    CHECK(adjacency(g, 1) == (Adj{{2, 1}, {4, 1}}));
+    CHECK(adjacency(g, 2) == (Adj{{3, 1}}));
+    CHECK(adjacency(g, 3) == (Adj{{1, 2}}));
+    CHECK(adjacency(g, 4) == (Adj{{2, 1}}));
+    CHECK(g.out_degree(3) == 1 && g.out_degree(4) == 1);
+
+    // Without the log the base is untouched.
+    CsrGraph base;
+    CHECK(base.load_custom(dir, "offsets.bin", "csr.bin", "rels.bin", "entities.bin", "props.bin", ""));
+    CHECK(base.num_nodes() == 3 && base.num_edges() == 3 && base.out_degree(3) == 0);
+
+    // The identity of the graph with its log is the base checksum and the
+    // record count. A known base checksum is reused while the base files keep
+    // their stamp, and the base is hashed again once one of them is rewritten.
+    const GraphIdentity id = graph_identity(g, nullptr, 2);
+    CHECK(id.base == g.base_checksum(1) && id.base == adjacency_checksum(base, 1));
+    CHECK(id.base != adjacency_checksum(g, 1) && id.delta == log.size() && id.stamp == base.base_stamp());
+    GraphIdentity known = id;
+    known.base = 12345;
+    CHECK(graph_identity(g, &known, 2).base == 12345);
+    CHECK(write_array(dir + "/rels.bin", rels));
+    fs::last_write_time(dir + "/rels.bin", fs::last_write_time(dir + "/rels.bin") + std::chrono::seconds(1));
+    CsrGraph restamped(dir);
+    CHECK(restamped.base_stamp() != id.stamp && graph_identity(restamped, &known, 2).base == id.base);
+
+    // Folding yields a plain CSR with the merged contents.
+    std::string out = dir + "/folded";
+    fs::create_directory(out);
+    CHECK(write_merged_csr(g, out + "/offsets.bin", out + "/csr.bin", out + "/rels.bin"));
+    CHECK(write_merged_dictionaries(g, out + "/entities.bin", out + "/props.bin"));
+    CsrGraph folded(out);
+    CHECK(folded.valid() && folded.delta_records() == 0);
+    CHECK(folded.num_nodes() == 4 && folded.num_edges() == 5 && folded.entity_of(4) == 400);
+    for (uint32_t v = 1; v <= 4; ++v) CHECK(adjacency(folded, v) == adjacency(g, v));
+
+    // A fold in progress: the log is marked and the merged base staged. Until
+    // the staged files are installed the log still applies; a partly
+    // installed fold does not load; once installed, the log is skipped.
+    const std::vector<std::string> base_files = {"offsets.bin", "csr.bin", "rels.bin", "entities.bin", "props.bin"};
+    for (const std::string& f : base_files) fs::copy_file(out + "/" + f, dir + "/" + f + ".compact");
+    CHECK(fs::exists(dir + "/delta.bin"));
+    fs::create_hard_link(dir + "/delta.bin", dir + "/delta.bin.folding");
+    CsrGraph staged(dir);
+    CHECK(staged.valid() && staged.delta_records() == log.size() && staged.num_edges() == 5);
+    fs::rename(dir + "/offsets.bin.compact", dir + "/offsets.bin");
+    CsrGraph partial;
+    CHECK(!partial.load(dir));
+    for (const std::string& f : base_files) {
+        if (fs::exists(dir + "/" + f + ".compact")) fs::rename(dir + "/" + f + ".compact", dir + "/" + f);
+    }
+    CsrGraph installed(dir);
+    CHECK(installed.valid() && installed.delta_records() == 0);
+    CHECK(installed.num_nodes() == 4 && installed.num_edges() == 5);
+    for (uint32_t v = 1; v <= 4; ++v) CHECK(adjacency(installed, v) == adjacency(g, v));
+
+    fs::remove_all(dir);
+    std::printf("delta overlay ok\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "checkpoint.hpp"
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "io.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static bool near(float a, float b, float tol) { return std::abs(a - b) <= tol; }
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    // 1 -P17-> 2, 1 -P17-> 3, 1 -P31-> 4, 2 -P31-> 4, 3 -P31-> 5
+    CHECK(write_array(dir + "/offsets.bin", std::vector<uint32_t>{0, 0, 3, 4, 5, 5, 5}));
+    CHECK(write_array(dir + "/csr.bin", std::vector<uint32_t>{2, 3, 4, 4, 5}));
+    CHECK(write_array(dir + "/rels.bin", std::vector<uint16_t>{2, 2, 1, 1, 1}));
+    CHECK(write_array(dir + "/offsets_rev.bin", std::vector<uint32_t>{0, 0, 0, 1, 2, 4, 5}));
+    CHECK(write_array(dir + "/csr_rev.bin", std::vector<uint32_t>{1, 1, 1, 2, 3}));
+    CHECK(write_array(dir + "/rels_rev.bin", std::vector<uint16_t>{2, 2, 1, 1, 1}));
+    CHECK(write_array(dir + "/entities.bin", std::vector<uint32_t>{10, 20, 30, 40, 50}));
+    CHECK(write_array(dir + "/props.bin", std::vector<uint16_t>{31, 17}));
+
+    CsrGraph g(dir);
+    CsrGraph rev;
+    CHECK(g.valid());
+    CHECK(rev.load_custom(dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin"));
+
+    FeaturePlan plan;
+    CHECK(!plan_features(g, nullptr, "in_degree", 1, plan));
+    CHECK(!plan_features(g, &rev, "out_degree,bogus", 1, plan));
+    CHECK(plan_features(g, &rev, "out_degree,in_degree,rel_out=2,rel_in=1,class=1", 2, plan));
+    CHECK((plan.names == std::vector<std::string>{"out_degree", "in_degree", "rel_out.P31", "rel_out.P17",
+                                                   "rel_in.P31", "class.Q40"}));
+    const float expect[6][6] = {
+        {},
+        {std::log1pf(3), 0, std::log1pf(1), std::log1pf(2), 0, 1},
+        {std::log1pf(1), std::log1pf(1), std::log1pf(1), 0, 0, 1},
+        {std::log1pf(1), std::log1pf(1), std::log1pf(1), 0, 0, 0},
+        {0, std::log1pf(2), 0, 0, std::log1pf(2), 0},
+        {0, std::log1pf(1), 0, 0, std::log1pf(1), 0},
+    };
+
+    auto fill = [&](uint32_t v, float* row) { fill_feature_row(plan, g, &rev, v, row); };
+    for (FeatureDtype dtype : {FeatureDtype::F32, FeatureDtype::F16}) {
+        std::string path = dir + "/features.bin";
+        CHECK(write_feature_store(path, plan.names, g.num_nodes() + 1, dtype, 3, fill));
+        FeatureStore store;
+        CHECK(store.open(path));
+        CHECK(store.columns() == plan.names && store.dim() == 6 && store.rows() == 6);
+        std::vector<float> rows;
+        store.gather({4, 1, 9, 2}, rows); // 9 is past the last row
+        const uint32_t want[4] = {4, 1, 0, 2};
+        const float tol = dtype == FeatureDtype::F16 ? 1e-3f : 0.0f;
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t c = 0; c < 6; ++c) CHECK(near(rows[i * 6 + c], expect[want[i]][c], tol));
+        }
+    }
+
+    // A degree-only store reproduces the computed features.
+    CHECK(plan_features(g, &rev, "out_degree,in_degree", 1, plan));
+    std::string degree_path = dir + "/degrees.bin";
+    CHECK(write_feature_store(degree_path, plan.names, g.num_nodes() + 1, FeatureDtype::F32, 1, fill));
+    FeatureStore degrees;
+    CHECK(degrees.open(degree_path));
+    FeatureConfig computed;
+    std::vector<float> a, b;
+    compute_base_features(g, &rev, {1, 2, 3, 4, 5}, computed, a);
+    compute_base_features(g, &rev, {1, 2, 3, 4, 5}, computed, b, &degrees);
+    CHECK(a == b);
+
+    // The column set travels with the checkpoint and its export.
+    FeatureConfig fcfg;
+    fcfg.columns = degrees.columns();
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 4;
+    ecfg.layers = 1;
+    ecfg.fanouts = {2};
+    XorShift128Plus rng(1);
+    Encoder enc(feature_dim(fcfg, true), g.num_relations(), ecfg, fcfg, rng);
+    Decoder dec(g.num_relations(), ecfg.hidden_dim, enc.relation_embeddings(), rng);
+    enc.set_feature_store(&degrees);
+    EncoderState st = enc.forward(g, &rev, {1, 3}, rng);
+    CHECK(st.base_features.size() == st.sg.nodes_per_layer[0].size() * 2);
+    std::string ckpt = dir + "/ckpt.bin";
+    std::string served = dir + "/served.bin";
+    CHECK(save_checkpoint(ckpt, enc, dec, fcfg, nullptr));
+    {
+        CheckpointView view;
+        CHECK(view.open(ckpt));
+        CHECK(view.meta().feat_cfg.columns == fcfg.columns);
+        CHECK(export_checkpoint(view, served, ExportPrecision::F32));
+    }
+    CheckpointView view;
+    CHECK(view.open(served));
+    CHECK(view.meta().feat_cfg.columns == fcfg.columns);
+    FeatureStore reopened;
+    CHECK(open_feature_store(degree_path, view.meta().feat_cfg, reopened));
+    CHECK(!open_feature_store(dir + "/features.bin", view.meta().feat_cfg, reopened));
+
+    fs::remove_all(dir);
+    std::printf("feature store ok\n");
+    return 0;
+}
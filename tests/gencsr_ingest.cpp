@@ -0,0 +1,130 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using Edge = std::tuple<uint32_t, uint16_t, uint32_t>; // (Q ID, P ID, Q ID)
+
+static std::vector<char> slurp(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static std::string q(uint32_t id) { return "<http://www.wikidata.org/entity/Q" + std::to_string(id) + ">"; }
+static std::string p(uint32_t id) { return "<http://www.wikidata.org/prop/direct/P" + std::to_string(id) + ">"; }
+
+// Usage: gencsr_ingest path/to/kg_gencsr
+int main(int argc, char** argv) {
+    CHECK(argc == 2);
+    const std::string tool = argv[1];
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    // A seeded dump of Q P Q lines mixed with lines kg_gencsr must skip:
+    // literals, other predicates, malformed and empty lines. Records the
+    // first-seen order of the IDs and the edges it expects to keep.
+    XorShift128Plus rng(21);
+    std::vector<uint32_t> qids(900), pids(14);
+    for (uint32_t& id : qids) id = rng.next_u32(5000000) + 1;
+    for (uint32_t& id : pids) id = rng.next_u32(9000) + 1;
+    std::vector<uint32_t> entities;
+    std::vector<uint16_t> props;
+    std::unordered_map<uint32_t, uint32_t> seen_q, seen_p;
+    std::vector<Edge> edges;
+    {
+        std::ofstream dump(dir + "/dump.nt", std::ios::binary);
+        for (size_t line = 0; line < 40000; ++line) {
+            // Skewed subjects so adjacency lists get long, with duplicates.
+            const uint32_t s = qids[std::min(rng.next_u32(900), rng.next_u32(900))];
+            const uint32_t r = pids[rng.next_u32(14)];
+            const uint32_t o = qids[rng.next_u32(900)];
+            switch (rng.next_u32(10)) {
+            case 0:
+                dump << q(s) << " " << p(r) << " \"literal " << o << "\"@en .\n";
+                continue;
+            case 1:
+                dump << q(s) << " <http://schema.org/name> " << q(o) << " .\n";
+                continue;
+            case 2:
+                dump << q(s) << " " << p(r) << " " << q(o) << "\n\n";
+                continue;
+            default:
+                dump << q(s) << "\t" << p(r) << " " << q(o) << " .\n";
+            }
+            if (seen_q.emplace(s, 0).second) entities.push_back(s);
+            if (seen_p.emplace(r, 0).second) props.push_back(static_cast<uint16_t>(r));
+            if (seen_q.emplace(o, 0).second) entities.push_back(o);
+            edges.emplace_back(s, static_cast<uint16_t>(r), o);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    // A mapped file in small windows, several threads, and stdin (spilled
+    // edges) all give the same files.
+    const std::vector<std::string> runs = {"--input " + dir + "/dump.nt --threads 1",
+                                           "--input " + dir + "/dump.nt --threads 3 --chunk_mb 1",
+                                           "--threads 2 < " + dir + "/dump.nt"};
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const std::string out = dir + "/out" + std::to_string(i);
+        CHECK(std::system((tool + " " + runs[i] + " --output " + out + " > /dev/null").c_str()) == 0);
+        CHECK(!fs::exists(out + "/edges.tmp"));
+        if (i == 0) continue;
+        for (const char* f : {"offsets.bin", "csr.bin", "rels.bin", "entities.bin", "props.bin"}) {
+            CHECK(slurp(dir + "/out0/" + f) == slurp(out + "/" + f));
+        }
+    }
+
+    // CSR invariants: 1-based offsets covering every edge, in-range IDs, each
+    // list sorted by (dst, rel), dictionaries in first-seen order.
+    const std::string out = dir + "/out0";
+    MMapArray<uint32_t> offsets, csr, ents;
+    MMapArray<uint16_t> rels, prs;
+    CHECK(map_array(out + "/offsets.bin", offsets) && map_array(out + "/csr.bin", csr));
+    CHECK(map_array(out + "/rels.bin", rels) && map_array(out + "/entities.bin", ents));
+    CHECK(map_array(out + "/props.bin", prs));
+    const size_t n = entities.size();
+    CHECK(ents.size == n && std::equal(entities.begin(), entities.end(), ents.data));
+    CHECK(prs.size == props.size() && std::equal(props.begin(), props.end(), prs.data));
+    CHECK(offsets.size == n + 2 && offsets[0] == 0 && offsets[1] == 0);
+    CHECK(offsets[n + 1] == edges.size() && csr.size == edges.size() && rels.size == edges.size());
+    for (size_t v = 1; v <= n; ++v) {
+        CHECK(offsets[v] <= offsets[v + 1]);
+        for (uint32_t e = offsets[v]; e < offsets[v + 1]; ++e) {
+            CHECK(csr[e] >= 1 && csr[e] <= n && rels[e] >= 1 && rels[e] <= props.size());
+            if (e > offsets[v]) {
+                CHECK(csr[e - 1] < csr[e] || (csr[e - 1] == csr[e] && rels[e - 1] <= rels[e]));
+            }
+        }
+    }
+    for (auto* base : {&offsets.base, &csr.base, &ents.base, &rels.base, &prs.base}) unmap(*base);
+
+    // The graph holds exactly the kept edges.
+    CsrGraph g(out);
+    CHECK(g.valid() && g.num_edges() == edges.size());
+    std::vector<Edge> loaded;
+    for (uint32_t u = 1; u <= g.num_nodes(); ++u) {
+        AdjView adj = g.neighbors(u);
+        for (uint32_t i = 0; i < adj.size; ++i) {
+            loaded.emplace_back(g.entity_of(u), g.prop_of(adj.rel[i]), g.entity_of(adj.dst[i]));
+        }
+    }
+    std::sort(loaded.begin(), loaded.end());
+    CHECK(loaded == edges);
+
+    fs::remove_all(dir);
+    std::printf("gencsr ingest ok\n");
+    return 0;
+}
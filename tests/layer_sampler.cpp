@@ -0,0 +1,118 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "packed_adj.hpp"
+#include "rng.hpp"
+#include "sampler.hpp"
+#include "subgraph.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// sample_layer must produce exactly what per-target sample_neighbors calls
+// produce from the same RNG state.
+static void check_layer(const CsrGraph& g, const std::vector<uint32_t>& targets, size_t fanout) {
+    XorShift128Plus a(5), b(5);
+    LayerSamples ls;
+    sample_layer(g, targets, fanout, ls, a);
+    std::vector<uint32_t> nodes;
+    std::vector<uint16_t> rels;
+    CHECK(ls.offsets.size() == targets.size() + 1 && ls.offsets[0] == 0);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        sample_neighbors(g, targets[i], fanout, nodes, rels, b);
+        CHECK(ls.offsets[i + 1] == nodes.size());
+    }
+    CHECK(ls.neighbors == nodes && ls.rels == rels);
+    CHECK(a.next_u32(1000000) == b.next_u32(1000000));
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    // Mixed degrees: empty lists, short lists and lists long enough that the
+    // compressed sampler decodes single blocks.
+    const uint32_t n = 300;
+    XorShift128Plus rng(11);
+    std::vector<uint32_t> offsets(n + 2, 0), csr;
+    std::vector<uint16_t> rels;
+    for (uint32_t v = 1; v <= n; ++v) {
+        uint32_t deg = v % 7 == 0 ? 0 : (v % 50 == 1 ? 900 : rng.next_u32(30) + 1);
+        std::vector<std::pair<uint32_t, uint16_t>> adj;
+        for (uint32_t k = 0; k < deg; ++k) {
+            adj.emplace_back(rng.next_u32(n) + 1, static_cast<uint16_t>(rng.next_u32(4) + 1));
+        }
+        std::sort(adj.begin(), adj.end());
+        for (auto& e : adj) {
+            csr.push_back(e.first);
+            rels.push_back(e.second);
+        }
+        offsets[v + 1] = static_cast<uint32_t>(csr.size());
+    }
+    std::vector<uint32_t> entities(n);
+    for (uint32_t v = 0; v < n; ++v) entities[v] = v + 1;
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", std::vector<uint16_t>{1, 2, 3, 4}));
+
+    std::vector<uint8_t> blob;
+    std::vector<uint64_t> index(kPackedIndexHeaderWords + n + 2, 0);
+    const PackedIndexHeader header{kPackedIndexMagic,
+                                   csr.size(),
+                                   raw_csr_checksum(offsets.data(), offsets.size(), csr.data(), rels.data(), csr.size()),
+                                   0,
+                                   file_stamp(dir + "/offsets.bin"),
+                                   file_stamp(dir + "/csr.bin"),
+                                   file_stamp(dir + "/rels.bin")};
+    std::memcpy(index.data(), &header, sizeof(header));
+    uint64_t* node_index = index.data() + kPackedIndexHeaderWords;
+    for (uint32_t v = 1; v <= n; ++v) {
+        node_index[v] = blob.size();
+        packed_encode(csr.data() + offsets[v], rels.data() + offsets[v], offsets[v + 1] - offsets[v], blob);
+    }
+    node_index[n + 1] = blob.size();
+    blob.resize(blob.size() + kPackedPadding, 0);
+    {
+        FILE* f = std::fopen((dir + "/csr.cbin").c_str(), "wb");
+        CHECK(f && std::fwrite(blob.data(), 1, blob.size(), f) == blob.size());
+        std::fclose(f);
+    }
+    CHECK(write_array(dir + "/csr.cidx", index));
+
+    std::vector<uint32_t> targets;
+    for (uint32_t v = 1; v <= n; v += 2) targets.push_back(v);
+    targets.push_back(n + 5); // out of range: no samples
+
+    for (AdjFormat format : {AdjFormat::Raw, AdjFormat::Compressed}) {
+        CsrGraph g;
+        g.set_adjacency_format(format);
+        CHECK(g.load(dir));
+        CHECK(g.compressed() == (format == AdjFormat::Compressed));
+        for (size_t fanout : {0u, 1u, 5u, 20u}) {
+            check_layer(g, targets, fanout);
+            check_layer(g, std::vector<uint32_t>(targets.begin(), targets.begin() + 3), fanout);
+            check_layer(g, {}, fanout);
+        }
+
+        // Every layer of a subgraph is sorted and unique.
+        XorShift128Plus r(3);
+        BatchSubgraph sg = build_subgraph(g, {9, 2, 9, 150, 51}, {6, 4}, r);
+        for (const auto& nodes : sg.nodes_per_layer) {
+            CHECK(std::is_sorted(nodes.begin(), nodes.end()));
+            CHECK(std::adjacent_find(nodes.begin(), nodes.end()) == nodes.end());
+        }
+        CHECK((sg.nodes_per_layer[2] == std::vector<uint32_t>{2, 9, 51, 150}));
+    }
+
+    fs::remove_all(dir);
+    std::printf("layer sampler ok\n");
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include "csr.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "inference.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "rng.hpp"
+#include "subgraph.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static void write_csr(const std::string& dir, const std::string& suffix,
+                      const std::vector<std::vector<uint32_t>>& adj) {
+    std::vector<uint32_t> offsets = {0, 0}, csr;
+    std::vector<uint16_t> rels;
+    for (size_t v = 1; v < adj.size(); ++v) {
+        for (uint32_t u : adj[v]) {
+            csr.push_back(u);
+            rels.push_back(static_cast<uint16_t>(1 + (v + u) % 3));
+        }
+        offsets.push_back(static_cast<uint32_t>(csr.size()));
+    }
+    CHECK(write_array(dir + "/offsets" + suffix + ".bin", offsets));
+    CHECK(write_array(dir + "/csr" + suffix + ".bin", csr));
+    CHECK(write_array(dir + "/rels" + suffix + ".bin", rels));
+}
+
+// Forward and reverse CSR of `adj` (node IDs 1..adj.size()-1).
+static void write_graph(const std::string& dir, const std::vector<std::vector<uint32_t>>& adj) {
+    std::vector<std::vector<uint32_t>> in(adj.size());
+    std::vector<uint32_t> entities;
+    for (size_t v = 1; v < adj.size(); ++v) {
+        for (uint32_t u : adj[v]) in[u].push_back(static_cast<uint32_t>(v));
+        entities.push_back(static_cast<uint32_t>(v));
+    }
+    write_csr(dir, "", adj);
+    write_csr(dir, "_rev", in);
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", std::vector<uint16_t>{1, 2, 3}));
+}
+
+static bool same_rows(const EmbeddingTable& a, const EmbeddingTable& b) {
+    if (a.nodes() != b.nodes() || a.dim() != b.dim()) return false;
+    return std::memcmp(a.row(1), b.row(1), sizeof(float) * a.nodes() * a.dim()) == 0;
+}
+
+// Every neighbour of every node, in adjacency order, in place of samples: on
+// it Encoder::forward averages what Full layer-wise inference averages.
+static BatchSubgraph full_subgraph(const CsrGraph& g, const std::vector<uint32_t>& seeds, size_t layers) {
+    BatchSubgraph sg;
+    sg.nodes_per_layer.resize(layers + 1);
+    sg.samples.resize(layers);
+    sg.nodes_per_layer[layers] = seeds;
+    for (size_t l = layers; l-- > 0;) {
+        const std::vector<uint32_t>& targets = sg.nodes_per_layer[l + 1];
+        LayerSamples& ls = sg.samples[l];
+        ls.offsets.assign(1, 0);
+        std::vector<uint32_t> nodes = targets;
+        for (uint32_t v : targets) {
+            AdjView adj = g.neighbors(v);
+            ls.neighbors.insert(ls.neighbors.end(), adj.dst, adj.dst + adj.size);
+            ls.rels.insert(ls.rels.end(), adj.rel, adj.rel + adj.size);
+            nodes.insert(nodes.end(), adj.dst, adj.dst + adj.size);
+            ls.offsets.push_back(static_cast<uint32_t>(ls.neighbors.size()));
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        sg.nodes_per_layer[l] = std::move(nodes);
+    }
+    return sg;
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 8;
+    ecfg.layers = 2;
+    ecfg.fanouts = {1, 1};
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = false;
+    XorShift128Plus init(7);
+    Encoder enc(feature_dim(fcfg, false), 3, ecfg, fcfg, init);
+
+    // On a cycle every node has one neighbour, so the sampled subgraph path
+    // sees exactly the full neighbourhoods and both must agree bit for bit.
+    const uint32_t n = 3000;
+    std::vector<std::vector<uint32_t>> cycle(n + 1);
+    for (uint32_t v = 1; v <= n; ++v) cycle[v] = {v % n + 1};
+    std::string cycle_dir = dir + "/cycle";
+    fs::create_directory(cycle_dir);
+    write_graph(cycle_dir, cycle);
+    CsrGraph ring(cycle_dir);
+    CHECK(ring.valid());
+
+    InferenceConfig icfg;
+    icfg.threads = 3;
+    EmbeddingTable full, batched;
+    CHECK(full.create(n, ecfg.hidden_dim));
+    CHECK(layerwise_embeddings(enc, ring, nullptr, icfg, full));
+    icfg.mode = InferenceMode::Batched;
+    icfg.batch_nodes = 700;
+    CHECK(node_embeddings(enc, ring, nullptr, icfg, 0, batched));
+    CHECK(same_rows(full, batched));
+
+    // Irregular graph: spilled layers, thread counts and per-node sampling
+    // do not change the result.
+    std::vector<std::vector<uint32_t>> adj(n + 1);
+    XorShift128Plus rng(5);
+    for (uint32_t v = 1; v <= n; ++v) {
+        uint32_t deg = v % 11 == 0 ? 0 : rng.next_u32(40) + 1;
+        for (uint32_t k = 0; k < deg; ++k) adj[v].push_back(rng.next_u32(n) + 1);
+    }
+    write_graph(dir, adj);
+    CsrGraph g(dir);
+    CHECK(g.valid());
+
+    // Multi-neighbour aggregation, duplicate edges and isolated nodes: Full
+    // layer-wise inference in small chunks matches the encoder's forward pass
+    // on whole neighbourhoods, whose neighbours sit in many other chunks.
+    {
+        InferenceConfig f;
+        f.threads = 3;
+        f.chunk_nodes = 7;
+        EmbeddingTable layerwise;
+        CHECK(layerwise.create(n, ecfg.hidden_dim));
+        CHECK(layerwise_embeddings(enc, g, nullptr, f, layerwise));
+        for (uint32_t lo = 1; lo <= n; lo += 1000) {
+            std::vector<uint32_t> seeds;
+            for (uint32_t v = lo; v < lo + 1000; v += 3) seeds.push_back(v);
+            EncoderState st = enc.forward(g, nullptr, full_subgraph(g, seeds, ecfg.layers));
+            for (size_t i = 0; i < seeds.size(); ++i) {
+                CHECK(std::memcmp(&st.h_layers[ecfg.layers][i * ecfg.hidden_dim], layerwise.row(seeds[i]),
+                                  sizeof(float) * ecfg.hidden_dim) == 0);
+            }
+        }
+    }
+
+    // Without a budget a spill directory is not used: both layers stay in RAM.
+    {
+        MemoryAccount memory;
+        InferenceConfig u;
+        u.spill_dir = dir;
+        u.memory = &memory;
+        EmbeddingTable e;
+        CHECK(e.create(n, ecfg.hidden_dim));
+        CHECK(layerwise_embeddings(enc, g, nullptr, u, e));
+        CHECK(memory.peak(MemKind::Activations) == 2 * sizeof(float) * n * ecfg.hidden_dim);
+    }
+
+    for (InferenceMode mode : {InferenceMode::Full, InferenceMode::Fanout}) {
+        InferenceConfig a;
+        a.mode = mode;
+        a.seed = 11;
+        a.threads = 1;
+        InferenceConfig b = a;
+        b.threads = 4;
+        b.spill_dir = dir;
+        b.mem_budget = 1;
+        EmbeddingTable ea, eb;
+        CHECK(ea.create(n, ecfg.hidden_dim));
+        CHECK(eb.create(n, ecfg.hidden_dim));
+        CHECK(layerwise_embeddings(enc, g, nullptr, a, ea));
+        CHECK(layerwise_embeddings(enc, g, nullptr, b, eb));
+        CHECK(same_rows(ea, eb));
+        CHECK(!fs::exists(dir + "/layer1.emb.tmp"));
+    }
+
+    // After an edit, refreshing the affected rows of the old table gives
+    // exactly the table rebuilt on the edited graph.
+    std::vector<std::vector<uint32_t>> edited = adj;
+    edited[5] = {77, 2999};
+    edited[77].clear();
+    edited[9].push_back(3000);
+    std::vector<uint32_t> changed = {5, 77, 9, 2999, 3000};
+    for (uint32_t u : adj[5]) changed.push_back(u);
+    for (uint32_t u : adj[77]) changed.push_back(u);
+    std::string edited_dir = dir + "/edited";
+    fs::create_directory(edited_dir);
+    write_graph(edited_dir, edited);
+    CsrGraph g2(edited_dir);
+    CsrGraph rev2;
+    CHECK(rev2.load_custom(edited_dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin"));
+    std::vector<uint32_t> targets = affected_nodes(rev2, changed, ecfg.fanouts.size());
+    CHECK(!targets.empty() && targets.size() < n);
+    for (InferenceMode mode : {InferenceMode::Full, InferenceMode::Fanout}) {
+        InferenceConfig r;
+        r.mode = mode;
+        r.threads = 2;
+        EmbeddingTable before, after, rebuilt;
+        CHECK(before.create(n, ecfg.hidden_dim) && after.create(n, ecfg.hidden_dim));
+        CHECK(rebuilt.create(n, ecfg.hidden_dim));
+        CHECK(layerwise_embeddings(enc, g, nullptr, r, before));
+        std::memcpy(after.row(1), before.row(1), sizeof(float) * n * ecfg.hidden_dim);
+        CHECK(refresh_embeddings(enc, g2, &rev2, r, targets, after));
+        CHECK(layerwise_embeddings(enc, g2, &rev2, r, rebuilt));
+        CHECK(same_rows(after, rebuilt));
+        CHECK(!same_rows(before, rebuilt));
+    }
+
+    // The cache is reused for the same tag and rebuilt for another.
+    InferenceConfig c;
+    c.cache = dir + "/emb.bin";
+    EmbeddingTable first, again, other;
+    CHECK(node_embeddings(enc, g, nullptr, c, 42, first));
+    CHECK(again.open(c.cache));
+    uint64_t tag = again.tag();
+    CHECK(same_rows(first, again));
+    CHECK(again.graph().base == g.base_checksum(1) && again.graph().stamp == g.base_stamp());
+    CHECK(node_embeddings(enc, g, nullptr, c, 42, other));
+    CHECK(other.tag() == tag);
+    CHECK(node_embeddings(enc, g, nullptr, c, 43, other));
+    CHECK(other.tag() != tag && same_rows(first, other));
+
+    // The tag follows the adjacency, not just the node and edge counts.
+    std::vector<std::vector<uint32_t>> rewired = adj;
+    rewired[2][0] = rewired[2][0] % n + 1;
+    std::string rewired_dir = dir + "/rewired";
+    fs::create_directory(rewired_dir);
+    write_graph(rewired_dir, rewired);
+    CsrGraph g3(rewired_dir), g_again(dir);
+    CHECK(g3.num_nodes() == g.num_nodes() && g3.num_edges() == g.num_edges());
+    CHECK(cache_tag(42, g3, 0, c) != cache_tag(42, g, 0, c));
+    CHECK(cache_tag(42, g_again, 0, c) == cache_tag(42, g, 0, c));
+
+    // And the inputs: whether a reverse CSR fed the in-degree column, and the
+    // contents of a feature store, which reopening does not change.
+    CsrGraph rev;
+    CHECK(rev.load_custom(dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin"));
+    FeatureConfig in_cfg;
+    Encoder in_enc(feature_dim(in_cfg, true), 3, ecfg, in_cfg, init);
+    CHECK(input_tag(in_enc, &rev) != input_tag(in_enc, nullptr));
+    CHECK(input_tag(enc, &rev) == input_tag(enc, nullptr));
+    EmbeddingTable no_rev, with_rev;
+    CHECK(node_embeddings(in_enc, g, nullptr, c, 42, no_rev));
+    CHECK(node_embeddings(in_enc, g, &rev, c, 42, with_rev));
+    CHECK(with_rev.tag() != no_rev.tag());
+
+    FeatureConfig store_cfg;
+    store_cfg.columns = {"a", "b"};
+    Encoder store_enc(feature_dim(store_cfg, false), 3, ecfg, store_cfg, init);
+    uint64_t store_tags[3];
+    for (int k = 0; k < 3; ++k) {
+        const std::string path = dir + "/features" + std::to_string(k % 2) + ".bin";
+        if (k < 2) {
+            CHECK(write_feature_store(path, store_cfg.columns, n + 1, FeatureDtype::F32, 2, [&](uint32_t v, float* row) {
+                row[0] = static_cast<float>(v % 7);
+                row[1] = static_cast<float>(v == 5 ? k : 0);
+            }));
+        }
+        FeatureStore store;
+        CHECK(open_feature_store(path, store_cfg, store));
+        store_enc.set_feature_store(&store);
+        store_tags[k] = input_tag(store_enc, nullptr);
+        store_enc.set_feature_store(nullptr);
+    }
+    CHECK(store_tags[0] != store_tags[1] && store_tags[2] == store_tags[0]);
+
+    fs::remove_all(dir);
+    std::printf("layerwise inference ok\n");
+    return 0;
+}
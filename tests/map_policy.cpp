@@ -0,0 +1,147 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using Edge = std::tuple<uint32_t, uint32_t, uint16_t>; // (src, dst, rel)
+
+// Every edge by node and relation index, plus both dictionaries.
+struct Snapshot {
+    std::vector<Edge> edges;
+    std::vector<uint32_t> entities;
+    std::vector<uint16_t> props;
+    bool operator==(const Snapshot&) const = default;
+};
+
+static Snapshot snapshot(const CsrGraph& g) {
+    Snapshot s;
+    std::vector<uint32_t> ds;
+    std::vector<uint16_t> rs;
+    for (uint32_t u = 1; u <= g.num_nodes(); ++u) {
+        AdjView adj = g.neighbors(u).unpacked(ds, rs);
+        CHECK(adj.size == g.out_degree(u));
+        for (uint32_t i = 0; i < adj.size; ++i) s.edges.emplace_back(u, adj.dst[i], adj.rel[i]);
+        s.entities.push_back(g.entity_of(u));
+    }
+    for (uint32_t r = 1; r <= g.num_relations(); ++r) s.props.push_back(g.prop_of(r));
+    std::sort(s.edges.begin(), s.edges.end());
+    return s;
+}
+
+// A random graph with skewed out-degrees, each list sorted by (dst, rel).
+static void write_graph(const std::string& dir, uint32_t n, size_t m, uint32_t r, uint64_t seed) {
+    XorShift128Plus rng(seed);
+    std::vector<std::vector<std::pair<uint32_t, uint16_t>>> lists(n + 1);
+    for (size_t e = 0; e < m; ++e) {
+        const uint32_t u = std::min(rng.next_u32(n), rng.next_u32(n)) + 1;
+        lists[u].emplace_back(rng.next_u32(n) + 1, static_cast<uint16_t>(rng.next_u32(r) + 1));
+    }
+    std::vector<uint32_t> offsets = {0, 0}, csr, entities(n);
+    std::vector<uint16_t> rels, props(r);
+    for (uint32_t v = 1; v <= n; ++v) {
+        std::sort(lists[v].begin(), lists[v].end());
+        for (const auto& [dst, rel] : lists[v]) {
+            csr.push_back(dst);
+            rels.push_back(rel);
+        }
+        offsets.push_back(static_cast<uint32_t>(csr.size()));
+        entities[v - 1] = 500 + 3 * v;
+    }
+    for (uint32_t i = 0; i < r; ++i) props[i] = static_cast<uint16_t>(10 + i);
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", props));
+}
+
+// Usage: map_policy path/to/kg_compress
+int main(int argc, char** argv) {
+    CHECK(argc == 2);
+    const std::string tool = argv[1];
+
+    // Spec parsing: every option, combinations, and a rejected token that
+    // leaves the output untouched.
+    MapPolicy p;
+    CHECK(parse_map_policy("", p) && !p.populate && p.prefault_threads == 0 && !p.anonymous_copy);
+    CHECK(parse_map_policy("default", p) && p.advice == MapAdvice::Normal && !p.huge_pages);
+    CHECK(parse_map_policy("populate,random", p) && p.populate && p.advice == MapAdvice::Random);
+    CHECK(parse_map_policy("prefault=3,sequential,hugepages", p));
+    CHECK(p.prefault_threads == 3 && p.advice == MapAdvice::Sequential && p.huge_pages && !p.populate);
+    CHECK(parse_map_policy("prefault", p) && p.prefault_threads >= 1);
+    CHECK(parse_map_policy("anon,willneed", p) && p.anonymous_copy && p.advice == MapAdvice::WillNeed);
+    CHECK(!parse_map_policy("populate,bogus", p) && p.anonymous_copy);
+
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+    const std::string raw = dir + "/raw", packed = dir + "/packed";
+    fs::create_directory(raw);
+    const uint32_t nodes = 2000;
+    const size_t num_edges = 30000;
+    write_graph(raw, nodes, num_edges, 9, 8);
+    fs::copy(raw, packed);
+    CHECK(std::system((tool + " --data " + packed + " > /dev/null").c_str()) == 0);
+
+    Snapshot expect;
+    {
+        CsrGraph g;
+        g.set_adjacency_format(AdjFormat::Raw);
+        CHECK(g.load(raw) && g.num_edges() == num_edges);
+        expect = snapshot(g);
+    }
+
+    // Each policy, applied to every file group or to one group at a time, maps
+    // the same contents from the raw and the compressed files.
+    const char* specs[] = {"default", "populate", "prefault=2", "random", "sequential", "willneed",
+                           "hugepages", "anon", "anon,prefault=3", "populate,prefault=2,hugepages,willneed"};
+    for (const char* spec : specs) {
+        MapPolicy mp;
+        CHECK(parse_map_policy(spec, mp));
+        std::vector<GraphMapPolicy> layouts(4);
+        layouts[0] = {mp, mp, mp};
+        layouts[1].offsets = mp;
+        layouts[2].adjacency = mp;
+        layouts[3].dictionaries = mp;
+        for (const GraphMapPolicy& gp : layouts) {
+            for (bool compressed : {false, true}) {
+                CsrGraph g;
+                g.set_adjacency_format(compressed ? AdjFormat::Compressed : AdjFormat::Raw);
+                g.set_map_policy(gp);
+                CHECK(g.load(compressed ? packed : raw) && g.compressed() == compressed);
+                CHECK(g.num_nodes() == nodes && g.num_edges() == num_edges);
+                CHECK(snapshot(g) == expect);
+            }
+        }
+    }
+
+    // A same-size rewrite that keeps the stamp still loads compressed, but
+    // kg_compress --verify compares the contents and reports it.
+    const std::string verify = tool + " --verify --data " + packed + " > /dev/null";
+    CHECK(std::system(verify.c_str()) == 0);
+    {
+        const std::string csr_path = packed + "/csr.bin";
+        const fs::file_time_type mtime = fs::last_write_time(csr_path);
+        std::fstream f(csr_path, std::ios::binary | std::ios::in | std::ios::out);
+        const uint32_t dst = 1;
+        f.write(reinterpret_cast<const char*>(&dst), sizeof(dst));
+        f.close();
+        fs::last_write_time(csr_path, mtime);
+    }
+    CHECK(std::system(verify.c_str()) != 0);
+
+    fs::remove_all(dir);
+    std::printf("map policy ok\n");
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "inference.hpp"
+#include "memory.hpp"
+#include "optim.hpp"
+#include "rng.hpp"
+#include "synth.hpp"
+#include "test_util.hpp"
+#include "trainer.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Run {
+    std::vector<float> weights;
+    size_t max_activation_bytes = 0; // largest pass
+    size_t micro_batches = 0;
+    size_t batches = 0;
+    size_t triples = 0;
+    size_t peak_activations = 0;
+    size_t over_budget = 0;
+};
+
+// One epoch of training with `budget` bytes per pass (0: unlimited).
+static Run train(const CsrGraph& g, const std::vector<Triple>& triples, size_t budget) {
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = false;
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 16;
+    ecfg.fanouts = {6, 4};
+    XorShift128Plus rng(5);
+    Encoder enc(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg, rng);
+    Decoder dec(g.num_relations(), ecfg.hidden_dim, enc.relation_embeddings(), rng);
+    auto params = enc.parameters();
+    auto dp = dec.parameters();
+    params.insert(params.end(), dp.begin(), dp.end());
+    Optimizer opt(OptimConfig(), params);
+    MemoryAccount mem;
+    TrainConfig tc;
+    tc.batch_size = 64;
+    tc.negatives = 3;
+    tc.mem_budget = budget;
+    tc.memory = &mem;
+    Trainer trainer(enc, dec, opt, g, nullptr, triples.data(), triples.size(), tc, rng);
+    Run run;
+    BatchResult br;
+    while (trainer.step(br)) {
+        CHECK(br.micro_batches >= 1 && std::isfinite(br.loss_tail) && std::isfinite(br.loss_rel));
+        run.max_activation_bytes = std::max(run.max_activation_bytes, br.activation_bytes);
+        run.micro_batches += br.micro_batches;
+        run.triples += br.triples;
+        ++run.batches;
+    }
+    CHECK(mem.peak(MemKind::Parameters) > 0 && mem.peak(MemKind::Optimizer) > 0);
+    CHECK(mem.current(MemKind::Activations) == 0);
+    run.peak_activations = mem.peak(MemKind::Activations);
+    run.over_budget = trainer.batch_sizer().over_budget();
+    for (const Parameter* p : params) run.weights.insert(run.weights.end(), p->data.begin(), p->data.end());
+    return run;
+}
+
+int main() {
+    // The sizer offers what the running estimate allows and backs off on
+    // overshoot; a single item is always taken.
+    AdaptiveBatch sizer(1000, 100);
+    CHECK(sizer.next(50) == 50);
+    CHECK(!sizer.accept(50, 5000) && sizer.retries() == 1);
+    CHECK(sizer.next(50) == 9);
+    CHECK(sizer.accept(9, 900));
+    CHECK(sizer.accept(1, 5000) && sizer.over_budget() == 1);
+    AdaptiveBatch unlimited(0, 100);
+    CHECK(unlimited.accept(100, size_t{1} << 40) && unlimited.next(1000) == 100 && unlimited.next(7) == 7);
+
+    MemoryAccount mem;
+    mem.set(MemKind::Activations, 100);
+    mem.set(MemKind::Gradients, 50);
+    mem.set(MemKind::Activations, 20);
+    CHECK(mem.total() == 70 && mem.peak_total() == 150 && mem.peak(MemKind::Activations) == 100);
+    CHECK(peak_rss_bytes() > 0 && current_rss_bytes() > 0);
+
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+    SynthConfig sc;
+    sc.nodes = 3000;
+    sc.edges = 30000;
+    sc.relations = 12;
+    sc.out_skew = sc.in_skew = 1.0;
+    sc.threads = 2;
+    sc.reverse = false;
+    CHECK(write_synthetic_graph(dir, sc));
+    CsrGraph g(dir);
+    CHECK(g.valid());
+    std::vector<Triple> triples;
+    for (uint32_t v = 1; v <= g.num_nodes() && triples.size() < 2000; v += 3) {
+        AdjView adj = g.neighbors(v);
+        if (adj.size > 0) triples.push_back({v, adj.rel_at(0), adj.dst_at(0)});
+    }
+
+    // predict_bytes is exact, in fp32 and bf16.
+    for (bool bf16 : {false, true}) {
+        FeatureConfig fcfg;
+        fcfg.use_in_degree = false;
+        EncoderConfig ecfg;
+        ecfg.hidden_dim = 16;
+        ecfg.fanouts = {5, 3};
+        ecfg.bf16_activations = bf16;
+        XorShift128Plus rng(9);
+        Encoder enc(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg, rng);
+        std::vector<uint32_t> seeds = {1, 2, 3, 50, 400, 2999};
+        BatchSubgraph sg = enc.sample(g, seeds, rng);
+        const size_t saved = enc.predict_bytes(sg, false);
+        const size_t with_grads = enc.predict_bytes(sg, true);
+        EncoderState st = enc.forward(g, nullptr, std::move(sg));
+        CHECK(st.activation_bytes() == saved);
+        std::vector<std::vector<float>> grads(3);
+        grads[2].assign(st.sg.nodes_per_layer[2].size() * 16, 1e-3f);
+        enc.backward(st, grads);
+        size_t grad_bytes = 0;
+        for (const auto& gl : grads) grad_bytes += gl.size() * sizeof(float);
+        CHECK(with_grads == saved + grad_bytes);
+    }
+
+    // A budget every batch fits under trains exactly like no budget.
+    Run plain = train(g, triples, 0);
+    Run roomy = train(g, triples, size_t{1} << 40);
+    CHECK(plain.weights == roomy.weights);
+    CHECK(plain.micro_batches == plain.batches && roomy.micro_batches == roomy.batches);
+
+    // A tight budget splits batches into passes that all stay under it.
+    const size_t budget = plain.max_activation_bytes / 4;
+    Run tight = train(g, triples, budget);
+    CHECK(tight.triples == triples.size() && tight.batches == plain.batches);
+    CHECK(tight.micro_batches > 2 * tight.batches);
+    CHECK(tight.over_budget == 0 && tight.peak_activations <= budget);
+
+    // Batched inference sizes its seed batches the same way.
+    {
+        FeatureConfig fcfg;
+        fcfg.use_in_degree = false;
+        EncoderConfig ecfg;
+        ecfg.hidden_dim = 16;
+        ecfg.fanouts = {6, 4};
+        XorShift128Plus rng(5);
+        Encoder enc(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg, rng);
+        MemoryAccount imem;
+        InferenceConfig icfg;
+        icfg.mode = InferenceMode::Batched;
+        icfg.batch_nodes = 1024;
+        icfg.memory = &imem;
+        EmbeddingTable full;
+        CHECK(node_embeddings(enc, g, nullptr, icfg, 1, full));
+        const size_t unlimited_peak = imem.peak(MemKind::Activations);
+        CHECK(imem.peak(MemKind::Cache) == static_cast<size_t>(g.num_nodes()) * 16 * sizeof(float));
+
+        MemoryAccount bmem;
+        icfg.memory = &bmem;
+        icfg.mem_budget = unlimited_peak / 5;
+        EmbeddingTable small;
+        CHECK(node_embeddings(enc, g, nullptr, icfg, 1, small));
+        CHECK(bmem.peak(MemKind::Activations) > 0 && bmem.peak(MemKind::Activations) <= icfg.mem_budget);
+        CHECK(bmem.current(MemKind::Activations) == 0);
+    }
+
+    fs::remove_all(dir);
+    std::printf("memory budget ok\n");
+    return 0;
+}
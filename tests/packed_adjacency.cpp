@@ -0,0 +1,119 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "packed_adj.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+int main() {
+    XorShift128Plus rng(17);
+
+    // Codec: block edges, every delta width, duplicates and wide relations.
+    for (uint32_t degree : {1u, 3u, 4u, 63u, 64u, 65u, 130u, 1000u}) {
+        for (uint32_t spread : {1u, 300u, 70000u, 0xfffffffu}) {
+            std::vector<uint32_t> dst(degree);
+            std::vector<uint16_t> rel(degree);
+            for (uint32_t i = 0; i < degree; ++i) {
+                dst[i] = rng.next_u32(spread) + 1;
+                rel[i] = static_cast<uint16_t>(rng.next_u32(spread > 300 ? 60000 : 5) + 1);
+            }
+            if (degree > 3) dst[2] = dst[1]; // duplicate destination
+            std::vector<uint8_t> blob;
+            packed_encode(dst.data(), rel.data(), degree, blob);
+            blob.resize(blob.size() + kPackedPadding, 0);
+
+            std::vector<std::pair<uint32_t, uint16_t>> expect;
+            for (uint32_t i = 0; i < degree; ++i) expect.emplace_back(dst[i], rel[i]);
+            std::sort(expect.begin(), expect.end());
+            std::vector<uint32_t> out_dst(degree);
+            std::vector<uint16_t> out_rel(degree);
+            packed_decode(blob.data(), degree, out_dst.data(), out_rel.data());
+            for (uint32_t i = 0; i < degree; ++i) {
+                CHECK(out_dst[i] == expect[i].first && out_rel[i] == expect[i].second);
+                CHECK(packed_dst_at(blob.data(), degree, i) == expect[i].first);
+                CHECK(packed_rel_at(blob.data(), degree, i) == expect[i].second);
+            }
+        }
+    }
+
+    // CsrGraph serves the same (sorted) lists from .cbin/.cidx through AdjView.
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+    std::vector<uint32_t> offsets = {0, 0, 2, 4, 5, 5};
+    std::vector<uint32_t> csr = {3, 2, 4, 3, 1};
+    std::vector<uint16_t> rels = {1, 2, 1, 1, 2};
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", std::vector<uint32_t>{10, 20, 30, 40}));
+    CHECK(write_array(dir + "/props.bin", std::vector<uint16_t>{31, 279}));
+    std::vector<uint8_t> blob;
+    std::vector<uint64_t> index(kPackedIndexHeaderWords + offsets.size(), 0);
+    const PackedIndexHeader header{kPackedIndexMagic,
+                                   csr.size(),
+                                   raw_csr_checksum(offsets.data(), offsets.size(), csr.data(), rels.data(), csr.size()),
+                                   0,
+                                   file_stamp(dir + "/offsets.bin"),
+                                   file_stamp(dir + "/csr.bin"),
+                                   file_stamp(dir + "/rels.bin")};
+    std::memcpy(index.data(), &header, sizeof(header));
+    uint64_t* node_index = index.data() + kPackedIndexHeaderWords;
+    for (uint32_t v = 1; v <= 4; ++v) {
+        node_index[v] = blob.size();
+        packed_encode(csr.data() + offsets[v], rels.data() + offsets[v], offsets[v + 1] - offsets[v], blob);
+    }
+    node_index[5] = blob.size();
+    blob.resize(blob.size() + kPackedPadding, 0);
+    {
+        FILE* f = std::fopen((dir + "/csr.cbin").c_str(), "wb");
+        CHECK(f && std::fwrite(blob.data(), 1, blob.size(), f) == blob.size());
+        std::fclose(f);
+    }
+    CHECK(write_array(dir + "/csr.cidx", index));
+
+    CsrGraph g(dir);
+    CHECK(g.valid() && g.compressed());
+    CHECK(g.num_edges() == 5 && g.out_degree(2) == 2 && g.out_degree(4) == 0);
+    AdjView a = g.neighbors(1);
+    CHECK(a.packed && a.size == 2);
+    CHECK(a.dst_at(0) == 2 && a.rel_at(0) == 2 && a.dst_at(1) == 3 && a.rel_at(1) == 1);
+    std::vector<uint32_t> ds;
+    std::vector<uint16_t> rs;
+    AdjView u = g.neighbors(2).unpacked(ds, rs);
+    CHECK(!u.packed && u.size == 2 && u.dst[0] == 3 && u.dst[1] == 4);
+
+    CsrGraph raw;
+    raw.set_adjacency_format(AdjFormat::Raw);
+    CHECK(raw.load(dir) && !raw.compressed() && raw.neighbors(1).dst[0] == 3);
+
+    // Once csr.bin is rewritten the blob is stale: Auto falls back to the raw
+    // files and Compressed refuses to load. So does an index without a header.
+    // The rewrite keeps the size and inode, so its mtime is moved past the
+    // timestamp tick the first write may share.
+    csr[4] = 2;
+    CHECK(write_array(dir + "/csr.bin", csr));
+    fs::last_write_time(dir + "/csr.bin", fs::last_write_time(dir + "/csr.bin") + std::chrono::seconds(1));
+    CsrGraph stale(dir);
+    CHECK(stale.valid() && !stale.compressed() && stale.neighbors(3).dst[0] == 2);
+    CsrGraph forced;
+    forced.set_adjacency_format(AdjFormat::Compressed);
+    CHECK(!forced.load(dir));
+    CHECK(write_array(dir + "/csr.cidx", std::vector<uint64_t>(node_index, node_index + offsets.size())));
+    CsrGraph headerless;
+    headerless.set_adjacency_format(AdjFormat::Compressed);
+    CHECK(!headerless.load(dir));
+
+    fs::remove_all(dir);
+    std::printf("packed adjacency ok\n");
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "perf_counters.hpp"
+#include "profile.hpp"
+#include "test_util.hpp"
+
+#include <string>
+#include <thread>
+
+#include <sys/mman.h>
+
+// Touches `pages` fresh anonymous pages, one first-touch fault each.
+static void touch_pages(size_t pages) {
+    const size_t bytes = pages * 4096;
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(p != MAP_FAILED);
+    volatile char* c = static_cast<char*>(p);
+    for (size_t i = 0; i < bytes; i += 4096) c[i] = 1;
+    munmap(p, bytes);
+}
+
+int main() {
+    // Nothing opened: every counter is unavailable and reads as zero.
+    PerfCounters closed;
+    CHECK(!closed.any());
+    for (size_t c = 0; c < kCounterCount; ++c) CHECK(!closed.available(static_cast<Counter>(c)));
+    CounterValues zero = closed.read();
+    for (uint64_t v : zero.v) CHECK(v == 0);
+    CHECK(format_counters(closed, zero, 10.0, "edge") == "counters n/a");
+
+    CounterValues a, b;
+    a.v[0] = 5;
+    b.v[0] = 7;
+    b.v[1] = 3;
+    CounterValues d = b - a;
+    CHECK(d.v[0] == 2 && d.v[1] == 3);
+    d = a - b; // counters never run backwards; clamp instead of wrapping
+    CHECK(d.v[0] == 0 && d.v[1] == 0);
+
+    PerfCounters perf;
+    perf.open();
+    CHECK(!perf.status().empty());
+    if (!perf.available(Counter::PageFaults)) return 0; // perf_event_open not permitted here
+
+    // Faults on this thread and on a joined worker thread both count.
+    CounterValues c0 = perf.read();
+    touch_pages(256);
+    std::thread worker([] { touch_pages(256); });
+    worker.join();
+    CounterValues c1 = perf.read();
+    CHECK((c1 - c0)[Counter::PageFaults] >= 512);
+    const std::string line = format_counters(perf, c1 - c0, 0.0, "edge");
+    CHECK(line.find("faults=") != std::string::npos);
+
+    // ScopedPhase charges the counters to its phase only.
+    PhaseTimes times;
+    times.perf = &perf;
+    {
+        ScopedPhase scope(&times, Phase::Forward);
+        touch_pages(128);
+    }
+    CHECK(times.counters[static_cast<size_t>(Phase::Forward)][Counter::PageFaults] >= 128);
+    CHECK(times.counters[static_cast<size_t>(Phase::Backward)][Counter::PageFaults] == 0);
+    CHECK(times.seconds[static_cast<size_t>(Phase::Forward)] > 0.0);
+    return 0;
+}
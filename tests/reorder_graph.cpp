@@ -0,0 +1,139 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using Edge = std::tuple<uint32_t, uint16_t, uint32_t>; // (Q ID, P ID, Q ID)
+
+// Every edge by its entity and property IDs, which renumbering must keep.
+static std::vector<Edge> edge_multiset(const CsrGraph& g) {
+    std::vector<Edge> edges;
+    std::vector<uint32_t> ds;
+    std::vector<uint16_t> rs;
+    for (uint32_t u = 1; u <= g.num_nodes(); ++u) {
+        AdjView adj = g.neighbors(u).unpacked(ds, rs);
+        for (uint32_t i = 0; i < adj.size; ++i) edges.emplace_back(g.entity_of(u), g.prop_of(adj.rel[i]), g.entity_of(adj.dst[i]));
+    }
+    std::sort(edges.begin(), edges.end());
+    return edges;
+}
+
+static std::vector<Edge> reverse_multiset(const std::string& dir) {
+    CsrGraph rev;
+    CHECK(rev.load_custom(dir, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin", "entities.bin", "props.bin"));
+    std::vector<Edge> edges = edge_multiset(rev);
+    for (Edge& e : edges) std::swap(std::get<0>(e), std::get<2>(e));
+    std::sort(edges.begin(), edges.end());
+    return edges;
+}
+
+static std::vector<uint32_t> read_perm(const std::string& dir) {
+    MMapArray<uint32_t> perm;
+    CHECK(map_array(dir + "/perm.bin", perm));
+    std::vector<uint32_t> out(perm.data, perm.data + perm.size);
+    unmap(perm.base);
+    return out;
+}
+
+// A skewed random graph with its reverse CSR, each list sorted by (dst, rel).
+static void write_graph(const std::string& dir, uint32_t n, size_t m, uint32_t r, uint64_t seed) {
+    XorShift128Plus rng(seed);
+    std::vector<std::vector<std::pair<uint32_t, uint16_t>>> out(n + 1), in(n + 1);
+    for (size_t e = 0; e < m; ++e) {
+        const uint32_t u = std::min(rng.next_u32(n), rng.next_u32(n)) + 1;
+        const uint32_t v = rng.next_u32(n) + 1;
+        const uint16_t rel = static_cast<uint16_t>(rng.next_u32(r) + 1);
+        out[u].emplace_back(v, rel);
+        in[v].emplace_back(u, rel);
+    }
+    auto write_csr = [&](std::vector<std::vector<std::pair<uint32_t, uint16_t>>>& lists, const std::string& suffix) {
+        std::vector<uint32_t> offsets = {0, 0}, csr;
+        std::vector<uint16_t> rels;
+        for (uint32_t v = 1; v <= n; ++v) {
+            std::sort(lists[v].begin(), lists[v].end());
+            for (const auto& [dst, rel] : lists[v]) {
+                csr.push_back(dst);
+                rels.push_back(rel);
+            }
+            offsets.push_back(static_cast<uint32_t>(csr.size()));
+        }
+        CHECK(write_array(dir + "/offsets" + suffix + ".bin", offsets));
+        CHECK(write_array(dir + "/csr" + suffix + ".bin", csr));
+        CHECK(write_array(dir + "/rels" + suffix + ".bin", rels));
+    };
+    write_csr(out, "");
+    write_csr(in, "_rev");
+    std::vector<uint32_t> entities(n);
+    std::vector<uint16_t> props(r);
+    for (uint32_t v = 0; v < n; ++v) entities[v] = 1000 + 7 * v;
+    for (uint32_t i = 0; i < r; ++i) props[i] = static_cast<uint16_t>(31 + i);
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", props));
+}
+
+// Usage: reorder_graph path/to/kg_reorder
+int main(int argc, char** argv) {
+    CHECK(argc == 2);
+    const std::string tool = argv[1];
+    auto run = [&](const std::string& args) { return std::system((tool + " " + args + " > /dev/null").c_str()) == 0; };
+
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+    const std::string in = dir + "/in";
+    fs::create_directory(in);
+    const uint32_t nodes = 3000;
+    const size_t num_edges = 20000;
+    write_graph(in, nodes, num_edges, 12, 5);
+    std::vector<Edge> edges;
+    {
+        CsrGraph g(in);
+        CHECK(g.valid() && g.num_edges() == num_edges);
+        edges = edge_multiset(g);
+    }
+
+    // Each order renumbers the forward and reverse CSR without losing,
+    // duplicating or relabelling an edge, and perm.bin is a permutation.
+    for (const char* order : {"degree", "rcm", "bfs"}) {
+        const std::string out = dir + "/" + order;
+        CHECK(run("--data " + in + " --reverse " + in + " --output " + out + " --order " + order + " --threads 3"));
+        CsrGraph g(out);
+        CHECK(g.valid() && g.num_nodes() == nodes);
+        CHECK(edge_multiset(g) == edges);
+        CHECK(reverse_multiset(out) == edges);
+        std::vector<uint32_t> perm = read_perm(out);
+        CHECK(perm.size() == nodes + 1 && perm[0] == 0);
+        std::sort(perm.begin(), perm.end());
+        for (uint32_t v = 1; v <= nodes; ++v) CHECK(perm[v] == v);
+    }
+
+    // In-edges built in memory give the same order as the reverse CSR.
+    CHECK(run("--data " + in + " --output " + dir + "/no_rev --order rcm"));
+    CHECK(read_perm(dir + "/no_rev") == read_perm(dir + "/rcm"));
+
+    // Writing over an input, under any spelling of its path, is refused and
+    // leaves it intact; so is a --reverse that does not load.
+    CHECK(!run("--data " + in + " --output " + in));
+    CHECK(!run("--data " + in + " --output " + in + "/."));
+    CHECK(!run("--data " + dir + "/rcm --reverse " + in + " --output " + in));
+    CHECK(!run("--data " + in + " --reverse " + dir + "/missing --output " + dir + "/bad"));
+    {
+        CsrGraph g(in);
+        CHECK(g.valid() && edge_multiset(g) == edges);
+        CHECK(reverse_multiset(in) == edges);
+    }
+
+    fs::remove_all(dir);
+    std::printf("reorder graph ok\n");
+    return 0;
+}
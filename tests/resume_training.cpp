@@ -0,0 +1,140 @@
+#include "checkpoint.hpp"
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "io.hpp"
+#include "optim.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+#include "trainer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Model, optimizer and trainer for one run; init_seed only affects the
+// initial weights, which a resumed run overwrites. A nonzero budget splits
+// batches into micro-batches (see AdaptiveBatch).
+struct Run {
+    FeatureConfig fcfg;
+    EncoderConfig ecfg;
+    XorShift128Plus rng;
+    std::unique_ptr<Encoder> enc;
+    std::unique_ptr<Decoder> dec;
+    std::unique_ptr<Optimizer> opt;
+    std::unique_ptr<Trainer> trainer;
+
+    size_t max_activation_bytes = 0;
+    size_t split_batches = 0;
+
+    Run(const CsrGraph& g, const std::vector<Triple>& triples, uint64_t init_seed, size_t budget = 0)
+        : rng(init_seed) {
+        fcfg.use_in_degree = false;
+        ecfg.hidden_dim = 8;
+        ecfg.layers = 2;
+        ecfg.fanouts = {3, 2};
+        enc = std::make_unique<Encoder>(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg, rng);
+        dec = std::make_unique<Decoder>(g.num_relations(), ecfg.hidden_dim, enc->relation_embeddings(), rng);
+        auto params = enc->parameters();
+        auto dp = dec->parameters();
+        params.insert(params.end(), dp.begin(), dp.end());
+        OptimConfig oc;
+        oc.lr = 0.01f;
+        opt = std::make_unique<Optimizer>(oc, params);
+        TrainConfig tc;
+        tc.batch_size = 3;
+        tc.negatives = 2;
+        tc.shuffle_seed = 5;
+        tc.mem_budget = budget;
+        trainer = std::make_unique<Trainer>(*enc, *dec, *opt, g, nullptr, triples.data(), triples.size(), tc, rng);
+    }
+
+    // Trains until `epochs` epochs are done or `max_steps` batches have run.
+    void train(uint64_t epochs, size_t max_steps) {
+        BatchResult br;
+        size_t steps = 0;
+        while (trainer->epoch() < epochs && steps < max_steps) {
+            if (trainer->step(br)) {
+                ++steps;
+                max_activation_bytes = std::max(max_activation_bytes, br.activation_bytes);
+                split_batches += br.micro_batches > 1;
+            } else {
+                trainer->next_epoch();
+            }
+        }
+    }
+
+    std::vector<std::vector<float>> weights() const {
+        std::vector<std::vector<float>> out;
+        for (const Parameter* p : enc->parameters_const()) out.emplace_back(p->data.begin(), p->data.end());
+        for (const Parameter* p : dec->parameters_const()) out.emplace_back(p->data.begin(), p->data.end());
+        return out;
+    }
+};
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    std::vector<uint32_t> offsets = {0, 0, 2, 4, 5, 7, 8, 10};
+    std::vector<uint32_t> csr = {2, 3, 3, 4, 5, 1, 6, 2, 1, 4};
+    std::vector<uint16_t> rels = {1, 2, 1, 1, 2, 1, 2, 1, 2, 1};
+    std::vector<uint32_t> entities = {10, 20, 30, 40, 50, 60};
+    std::vector<uint16_t> props = {31, 279};
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", props));
+    CsrGraph g(dir);
+    CHECK(g.valid());
+
+    std::vector<Triple> triples;
+    for (uint32_t u = 1; u <= 6; ++u) {
+        for (uint32_t i = offsets[u]; i < offsets[u + 1]; ++i) triples.push_back({u, rels[i], csr[i]});
+    }
+
+    // Straight run: 3 epochs of 4 batches each, then under a budget that
+    // splits some of them, which resuming must size the same way.
+    Run plain(g, triples, 1);
+    plain.train(3, ~size_t(0));
+    for (size_t budget : {size_t(0), plain.max_activation_bytes * 3 / 4}) {
+        Run straight(g, triples, 1, budget);
+        straight.train(3, ~size_t(0));
+        CHECK((budget > 0) == (straight.split_batches > 0));
+
+        // Interrupted mid-epoch 2, checkpointed, and resumed into a differently initialised model.
+        std::string ckpt = dir + "/resume.bin";
+        {
+            Run first(g, triples, 1, budget);
+            first.train(3, 6);
+            TrainProgress p = first.trainer->progress();
+            CHECK(p.valid && p.epoch == 1 && p.next == 6);
+            CHECK(save_checkpoint(ckpt, *first.enc, *first.dec, first.fcfg, first.opt.get(), &p));
+        }
+        Run resumed(g, triples, 99, budget);
+        {
+            CheckpointView view;
+            CHECK(view.open(ckpt) && view.verify());
+            CHECK(view.meta().progress.valid && view.meta().step == 6);
+            CHECK(restore_model(view, *resumed.enc, *resumed.dec, *resumed.opt));
+            resumed.trainer->restore(view.meta().progress);
+        }
+        resumed.train(3, ~size_t(0));
+
+        CHECK(resumed.opt->step_count() == straight.opt->step_count());
+        CHECK(resumed.weights() == straight.weights());
+        CHECK(resumed.opt->m() == straight.opt->m());
+        CHECK(resumed.opt->v() == straight.opt->v());
+    }
+
+    fs::remove_all(dir);
+    std::printf("resume training ok (%zu steps)\n", plain.opt->step_count());
+    return 0;
+}
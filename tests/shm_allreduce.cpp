@@ -0,0 +1,163 @@
+#include "allreduce.hpp"
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "io.hpp"
+#include "optim.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+#include "trainer.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Runs fn(rank) in `world` child processes; true if all exit cleanly.
+static bool run_ranks(uint32_t world, const std::function<void(uint32_t)>& fn) {
+    std::vector<pid_t> pids;
+    for (uint32_t r = 0; r < world; ++r) {
+        pid_t pid = fork();
+        CHECK(pid >= 0);
+        if (pid == 0) {
+            fn(r);
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+    bool ok = true;
+    for (pid_t pid : pids) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return ok;
+}
+
+// Every node has one out-edge, so sampling is deterministic and a split
+// batch sees the same embeddings as the whole one.
+static void write_graph(const std::string& dir, uint32_t n) {
+    std::vector<uint32_t> offsets = {0, 0}, csr, entities;
+    std::vector<uint16_t> rels;
+    for (uint32_t v = 1; v <= n; ++v) {
+        csr.push_back((v * 7 + 3) % n + 1);
+        rels.push_back(static_cast<uint16_t>(1 + v % 3));
+        offsets.push_back(static_cast<uint32_t>(csr.size()));
+        entities.push_back(v);
+    }
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", std::vector<uint16_t>{1, 2, 3}));
+}
+
+// Trains `steps` SGD steps of `batch` triples per rank and returns the weights.
+static std::vector<float> train(const std::string& dir, const std::vector<Triple>& triples, size_t batch,
+                                size_t steps, ShmAllReduce* allreduce) {
+    CsrGraph g(dir);
+    CHECK(g.valid());
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 8;
+    ecfg.layers = 2;
+    ecfg.fanouts = {2, 2};
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = false;
+    XorShift128Plus rng(5);
+    Encoder enc(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg, rng);
+    Decoder dec(g.num_relations(), ecfg.hidden_dim, enc.relation_embeddings(), rng);
+    std::vector<Parameter*> params = enc.parameters();
+    for (Parameter* p : dec.parameters()) params.push_back(p);
+    OptimConfig ocfg;
+    ocfg.use_adam = false;
+    ocfg.lr = 0.05f;
+    Optimizer optim(ocfg, params);
+    TrainConfig tcfg;
+    tcfg.batch_size = batch;
+    tcfg.negatives = 0;
+    tcfg.allreduce = allreduce;
+    Trainer trainer(enc, dec, optim, g, nullptr, triples.data(), triples.size(), tcfg, rng);
+    BatchResult br;
+    for (size_t s = 0; s < steps; ++s) {
+        if (!trainer.step(br)) trainer.next_epoch();
+    }
+    std::vector<float> out;
+    for (const Parameter* p : params) out.insert(out.end(), p->data.begin(), p->data.end());
+    return out;
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+    const std::string shm = "/kg_test_allreduce." + std::to_string(getpid());
+
+    // Sums are exact for small integers and identical on every rank.
+    const uint32_t world = 3;
+    const size_t floats = 1000;
+    remove_shm(shm);
+    CHECK(run_ranks(world, [&](uint32_t rank) {
+        ShmAllReduce ar;
+        if (!ar.open(shm, world, rank, floats)) _exit(2);
+        std::vector<float> v(floats);
+        for (uint64_t step = 1; step <= 200; ++step) {
+            for (size_t i = 0; i < floats; ++i) v[i] = static_cast<float>((rank + 1) * step + i % 7);
+            ar.sum(v.data());
+            for (size_t i = 0; i < floats; ++i) {
+                if (v[i] != static_cast<float>(6 * step + 3 * (i % 7))) _exit(3);
+            }
+        }
+    }));
+    // A segment sized for another vector is refused.
+    {
+        ShmAllReduce ar;
+        CHECK(!ar.open(shm, world, 0, floats + 1));
+    }
+    remove_shm(shm);
+
+    // Two ranks of batch 8 follow one process of batch 16 (up to float
+    // summation order), and stay bit-identical to each other.
+    const uint32_t n = 120;
+    write_graph(dir, n);
+    std::vector<Triple> triples;
+    for (uint32_t v = 1; v <= n; v += 3) triples.push_back({v, 1 + v % 3, (v * 7 + 3) % n + 1});
+    const size_t steps = 12;
+    std::vector<float> single = train(dir, triples, 16, steps, nullptr);
+    CHECK(run_ranks(2, [&](uint32_t rank) {
+        CsrGraph g(dir);
+        EncoderConfig ecfg;
+        ecfg.hidden_dim = 8;
+        ecfg.fanouts = {2, 2};
+        FeatureConfig fcfg;
+        fcfg.use_in_degree = false;
+        Encoder enc(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg);
+        Decoder dec(g.num_relations(), ecfg.hidden_dim, enc.relation_embeddings());
+        ShmAllReduce grads;
+        if (!grads.open(shm, 2, rank, allreduce_floats(enc, dec))) _exit(2);
+        std::vector<float> w = train(dir, triples, 8, steps, &grads);
+        std::vector<uint32_t> bits(w.size());
+        std::memcpy(bits.data(), w.data(), w.size() * sizeof(float));
+        if (!write_array(dir + "/rank" + std::to_string(rank) + ".bin", bits)) _exit(4);
+    }));
+    remove_shm(shm);
+    MMapArray<float> r0, r1;
+    CHECK(map_array(dir + "/rank0.bin", r0) && map_array(dir + "/rank1.bin", r1));
+    CHECK(r0.size == single.size() && r1.size == single.size());
+    float max_diff = 0.0f;
+    bool moved = false;
+    std::vector<float> init = train(dir, triples, 16, 0, nullptr);
+    for (size_t i = 0; i < single.size(); ++i) {
+        CHECK(r0[i] == r1[i]);
+        max_diff = std::max(max_diff, std::abs(r0[i] - single[i]));
+        moved = moved || single[i] != init[i];
+    }
+    CHECK(moved);
+    CHECK(max_diff < 1e-5f);
+
+    std::cout << "shm allreduce ok (max diff " << max_diff << ")\n";
+    return 0;
+}
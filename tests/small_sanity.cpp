@@ -5,8 +5,8 @@
 #include "io.hpp"
 #include "optim.hpp"
 #include "rng.hpp"
+#include "test_util.hpp"
 
-#include <cassert>
 #include <cstdlib>
 #include <cstdio>
 #include <filesystem>
@@ -14,17 +14,9 @@
 
 namespace fs = std::filesystem;
 
-static std::string make_temp_dir() {
-    std::string templ = "/tmp/kgtestXXXXXX";
-    std::vector<char> buf(templ.begin(), templ.end());
-    buf.push_back('\0');
-    char* path = mkdtemp(buf.data());
-    return path ? std::string(path) : std::string();
-}
-
 int main() {
     std::string dir = make_temp_dir();
-    assert(!dir.empty());
+    CHECK(!dir.empty());
 
     // Tiny graph: 3 nodes, 3 edges forming a chain
     std::vector<uint32_t> offsets = {0, 1, 2, 3, 3};
@@ -33,16 +25,16 @@ int main() {
     std::vector<uint32_t> entities = {100, 200, 300};
     std::vector<uint16_t> props = {10};
 
-    assert(write_array(dir + "/offsets.bin", offsets));
-    assert(write_array(dir + "/csr.bin", csr));
-    assert(write_array(dir + "/rels.bin", rels));
-    assert(write_array(dir + "/entities.bin", entities));
-    assert(write_array(dir + "/props.bin", props));
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", props));
 
     CsrGraph g(dir);
-    assert(g.valid());
-    assert(g.num_nodes() == 3);
-    assert(g.num_edges() == 3);
+    CHECK(g.valid());
+    CHECK(g.num_nodes() == 3);
+    CHECK(g.num_edges() == 3);
 
     FeatureConfig fcfg;
     fcfg.use_in_degree = false;
@@ -92,7 +84,7 @@ int main() {
                                     st2.index_per_layer.back(), st2.h_layers.back(),
                                     grad2.back());
 
-    assert(loss2 < loss1 + 1e-3f);
+    CHECK(loss2 < loss1 + 1e-3f);
     fs::remove_all(dir);
     std::printf("sanity ok (loss %.4f -> %.4f)\n", loss1, loss2);
     return 0;
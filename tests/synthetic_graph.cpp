@@ -0,0 +1,112 @@
+#include "csr.hpp"
+#include "io.hpp"
+#include "synth.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::vector<char> slurp(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    SynthConfig cfg;
+    cfg.nodes = 20000;
+    cfg.edges = 300000;
+    cfg.relations = 50;
+    cfg.seed = 9;
+    cfg.threads = 1;
+    const std::string a = dir + "/a", b = dir + "/b";
+    fs::create_directory(a);
+    fs::create_directory(b);
+    CHECK(write_synthetic_graph(a, cfg));
+    cfg.threads = 3;
+    CHECK(write_synthetic_graph(b, cfg));
+
+    TripleSplit split;
+    split.eval_fraction = 0.01;
+    split.threads = 1;
+    uint64_t train = 0, eval = 0, train_b = 0, eval_b = 0;
+    CsrGraph g(a);
+    CHECK(g.valid());
+    CHECK(write_edge_triples(g, a + "/train.bin", a + "/eval.bin", split, train, eval));
+    split.threads = 4;
+    CsrGraph gb(b);
+    CHECK(write_edge_triples(gb, b + "/train.bin", b + "/eval.bin", split, train_b, eval_b));
+
+    // The output does not depend on the thread count.
+    for (const char* f : {"offsets.bin", "csr.bin", "rels.bin", "entities.bin", "props.bin", "offsets_rev.bin",
+                          "csr_rev.bin", "rels_rev.bin", "train.bin", "eval.bin"}) {
+        CHECK(slurp(a + "/" + f) == slurp(b + "/" + f));
+    }
+
+    // Exact edge count, sorted adjacency, skewed degrees and relations.
+    CHECK(g.num_nodes() == cfg.nodes && g.num_edges() == cfg.edges && g.num_relations() == cfg.relations);
+    uint32_t max_out = 0;
+    std::vector<uint64_t> rel_count(cfg.relations + 1, 0);
+    for (uint32_t v = 1; v <= g.num_nodes(); ++v) {
+        AdjView adj = g.neighbors(v);
+        max_out = std::max(max_out, adj.size);
+        for (uint32_t i = 0; i < adj.size; ++i) {
+            CHECK(adj.dst[i] >= 1 && adj.dst[i] <= cfg.nodes);
+            CHECK(adj.rel[i] >= 1 && adj.rel[i] <= cfg.relations);
+            if (i > 0) CHECK(adj.dst[i - 1] < adj.dst[i] || (adj.dst[i - 1] == adj.dst[i] && adj.rel[i - 1] <= adj.rel[i]));
+            ++rel_count[adj.rel[i]];
+        }
+    }
+    const double mean = static_cast<double>(cfg.edges) / cfg.nodes;
+    CHECK(max_out > 50 * mean);
+    CHECK(rel_count[1] > 10 * rel_count[cfg.relations]);
+
+    CsrGraph rev;
+    CHECK(rev.load_custom(a, "offsets_rev.bin", "csr_rev.bin", "rels_rev.bin"));
+    CHECK(rev.num_edges() == g.num_edges());
+    uint32_t max_in = 0;
+    for (uint32_t v = 1; v <= rev.num_nodes(); ++v) max_in = std::max(max_in, rev.out_degree(v));
+    CHECK(max_in > 50 * mean);
+
+    // Every edge lands in exactly one triple file, as itself.
+    CHECK(train + eval == cfg.edges && eval > 0 && train_b == train && eval_b == eval);
+    MMapArray<Triple> tr, ev;
+    CHECK(map_triples(a + "/train.bin", tr) && map_triples(a + "/eval.bin", ev));
+    CHECK(tr.size == train && ev.size == eval);
+    for (const MMapArray<Triple>* file : {&tr, &ev}) {
+        for (size_t i = 0; i < file->size; i += 97) {
+            const Triple& t = (*file)[i];
+            AdjView adj = g.neighbors(t.h);
+            bool found = false;
+            for (uint32_t k = 0; k < adj.size && !found; ++k) found = adj.dst[k] == t.t && adj.rel[k] == t.r;
+            CHECK(found);
+        }
+    }
+    unmap(tr.base);
+    unmap(ev.base);
+
+    // Skew 0 spreads the edges evenly.
+    SynthConfig flat = cfg;
+    flat.out_skew = flat.in_skew = 0.0;
+    flat.reverse = false;
+    const std::string c = dir + "/c";
+    fs::create_directory(c);
+    CHECK(write_synthetic_graph(c, flat));
+    CsrGraph uniform(c);
+    CHECK(uniform.num_edges() == cfg.edges);
+    for (uint32_t v = 1; v <= uniform.num_nodes(); ++v) CHECK(uniform.out_degree(v) <= mean + 1);
+
+    fs::remove_all(dir);
+    std::printf("synthetic graph ok\n");
+    return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// assert() that is evaluated in every build. Tests run their setup inside
+// checks (write a file, open a graph), which must not vanish under NDEBUG.
+#define CHECK(cond)                                                                        \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            std::abort();                                                                  \
+        }                                                                                  \
+    } while (0)
+
+// A fresh directory under /tmp; empty if it cannot be created.
+inline std::string make_temp_dir() {
+    std::string templ = "/tmp/kgtestXXXXXX";
+    std::vector<char> buf(templ.begin(), templ.end());
+    buf.push_back('\0');
+    char* path = mkdtemp(buf.data());
+    return path ? std::string(path) : std::string();
+}
@@ -0,0 +1,117 @@
+#include "csr.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "features.hpp"
+#include "io.hpp"
+#include "optim.hpp"
+#include "profile.hpp"
+#include "rng.hpp"
+#include "test_util.hpp"
+#include "trainer.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Trains `epochs` epochs and returns the final weights; with `metrics` the
+// step phases and batch results are recorded.
+static std::vector<float> train(const CsrGraph& g, const std::vector<Triple>& triples, size_t epochs,
+                                TrainMetrics* metrics) {
+    FeatureConfig fcfg;
+    fcfg.use_in_degree = false;
+    EncoderConfig ecfg;
+    ecfg.hidden_dim = 8;
+    ecfg.fanouts = {3, 2};
+    XorShift128Plus rng(3);
+    Encoder enc(feature_dim(fcfg, false), g.num_relations(), ecfg, fcfg, rng);
+    Decoder dec(g.num_relations(), ecfg.hidden_dim, enc.relation_embeddings(), rng);
+    auto params = enc.parameters();
+    auto dp = dec.parameters();
+    params.insert(params.end(), dp.begin(), dp.end());
+    Optimizer opt(OptimConfig(), params);
+    TrainConfig tc;
+    tc.batch_size = 4;
+    tc.negatives = 2;
+    if (metrics) tc.phase_times = metrics->phases();
+    Trainer trainer(enc, dec, opt, g, nullptr, triples.data(), triples.size(), tc, rng);
+    for (; trainer.epoch() < epochs; trainer.next_epoch()) {
+        BatchResult br;
+        while (trainer.step(br)) {
+            CHECK(br.layer_nodes.size() == 3 && br.layer_nodes[0] == br.nodes);
+            CHECK(br.rows == br.layer_nodes[0] + br.layer_nodes[1] + br.layer_nodes[2]);
+            CHECK(br.edges > 0 && br.activation_bytes > 0);
+            if (metrics) metrics->add(br, trainer.epoch());
+        }
+        if (metrics) metrics->flush(trainer.epoch());
+    }
+    std::vector<float> w;
+    for (const Parameter* p : params) w.insert(w.end(), p->data.begin(), p->data.end());
+    return w;
+}
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+
+    const uint32_t n = 40;
+    std::vector<uint32_t> offsets = {0, 0}, csr, entities;
+    std::vector<uint16_t> rels;
+    std::vector<Triple> triples;
+    for (uint32_t v = 1; v <= n; ++v) {
+        for (uint32_t k = 1; k <= 3; ++k) {
+            uint32_t u = (v * k + 7) % n + 1;
+            uint16_t r = static_cast<uint16_t>(k);
+            csr.push_back(u);
+            rels.push_back(r);
+            triples.push_back({v, r, u});
+        }
+        offsets.push_back(static_cast<uint32_t>(csr.size()));
+        entities.push_back(v);
+    }
+    CHECK(write_array(dir + "/offsets.bin", offsets));
+    CHECK(write_array(dir + "/csr.bin", csr));
+    CHECK(write_array(dir + "/rels.bin", rels));
+    CHECK(write_array(dir + "/entities.bin", entities));
+    CHECK(write_array(dir + "/props.bin", std::vector<uint16_t>{31, 279, 17}));
+    CsrGraph g(dir);
+    CHECK(g.valid());
+
+    // Instrumentation does not change training.
+    const std::string path = dir + "/metrics.jsonl";
+    TrainMetrics metrics;
+    CHECK(metrics.open(path, 7));
+    std::vector<float> plain = train(g, triples, 2, nullptr);
+    std::vector<float> timed = train(g, triples, 2, &metrics);
+    CHECK(plain == timed);
+    CHECK(metrics.finish());
+
+    // 30 batches per epoch: windows of 7, 7, 7, 7 and the epoch's last 2.
+    const MetricsWindow& t = metrics.totals();
+    CHECK(t.batches == 60 && t.triples == 2 * triples.size());
+    CHECK(t.layer_nodes.size() == 3 && t.rows == t.layer_nodes[0] + t.layer_nodes[1] + t.layer_nodes[2]);
+    for (Phase p : {Phase::Negatives, Phase::Subgraph, Phase::Features, Phase::Forward, Phase::DistMult,
+                    Phase::RelLoss, Phase::Backward, Phase::Optimizer}) {
+        CHECK(t.phases.seconds[static_cast<size_t>(p)] > 0.0);
+    }
+    CHECK(t.phases.seconds[static_cast<size_t>(Phase::AllReduce)] == 0.0);
+    CHECK(t.phases.total() <= t.wall);
+
+    std::ifstream in(path);
+    std::string line;
+    size_t windows = 0, summaries = 0;
+    while (std::getline(in, line)) {
+        CHECK(line.front() == '{' && line.back() == '}');
+        if (line.find("\"type\": \"window\"") != std::string::npos) ++windows;
+        if (line.find("\"type\": \"summary\", \"batches\": 60,") != std::string::npos) ++summaries;
+    }
+    CHECK(windows == 10 && summaries == 1);
+
+    fs::remove_all(dir);
+    std::printf("train metrics ok\n");
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "config_file.hpp"
+#include "test_util.hpp"
+#include "tune.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+int main() {
+    std::string dir = make_temp_dir();
+    CHECK(!dir.empty());
+    const std::string conf = dir + "/tuned.conf";
+
+    // Round trip: the header becomes comments, sections keep their order.
+    CHECK(write_config_file(conf, "first line\nsecond line",
+                             {{"train", {{"batch", "512"}, {"fanout1", "15"}, {"bf16_activations", ""}}},
+                              {"inference", {{"threads", "4"}}}}));
+    ConfigEntries train, inference, missing;
+    CHECK(read_config_section(conf, "train", train));
+    CHECK(read_config_section(conf, "inference", inference));
+    CHECK(read_config_section(conf, "eval", missing) && missing.empty());
+    CHECK(train.size() == 3 && train[0] == ConfigEntries::value_type("batch", "512"));
+    CHECK(train[2].first == "bf16_activations" && train[2].second.empty());
+    CHECK(inference.size() == 1 && inference[0].second == "4");
+
+    // --config expands in place, so later flags override it and earlier ones
+    // are overridden by it.
+    std::vector<std::string> cmd = {"kg_train", "--batch", "64", "--config", conf, "--fanout1", "20"};
+    std::vector<char*> argv = arg_pointers(cmd);
+    std::vector<std::string> args;
+    CHECK(expand_config_args(static_cast<int>(cmd.size()), argv.data(), "train", args));
+    const std::vector<std::string> want = {"kg_train", "--batch", "64", "--batch", "512", "--fanout1", "15",
+                                           "--bf16_activations", "--fanout1", "20"};
+    CHECK(args == want);
+    CHECK(arg_pointers(args).size() == args.size() + 1 && arg_pointers(args).back() == nullptr);
+
+    // Malformed lines and missing files are errors.
+    {
+        std::ofstream bad(dir + "/bad.conf");
+        bad << "[train]\nbatch 512\n";
+    }
+    ConfigEntries ignored;
+    CHECK(!read_config_section(dir + "/bad.conf", "train", ignored));
+    CHECK(!read_config_section(dir + "/none.conf", "train", ignored));
+
+    // Successive halving: rate grows with the candidate's value and memory
+    // with its square, so the ceiling cuts off the largest ones.
+    std::vector<TuneTrial> trials;
+    for (size_t v = 1; v <= 9; ++v) {
+        TuneTrial t;
+        t.label = "v=" + std::to_string(v);
+        t.flags = {{"v", std::to_string(v)}};
+        trials.push_back(t);
+    }
+    size_t work = 0;
+    auto measure = [&](TuneTrial& t, size_t units) {
+        const double v = std::stod(t.flags[0].second);
+        work += units;
+        t.rate = v * 100.0;
+        t.peak_bytes = static_cast<size_t>(v * v);
+    };
+    TuneSearch search;
+    search.units = 2;
+    search.eta = 3;
+    search.mem_ceiling = 50;
+    std::ostringstream log;
+    int best = run_search(trials, search, measure, log);
+    CHECK(best == 6 && trials[6].fits && !trials[7].fits && !trials[8].fits);
+    // 9 trials at 2 units, then the best 3 of the 7 that fit at 6.
+    CHECK(work == 9 * 2 + 3 * 6);
+    CHECK(trials[6].rounds == 2 && trials[0].rounds == 1);
+    CHECK(log.str().find("over the memory ceiling") != std::string::npos);
+
+    // A grid measures each trial once; nothing fitting gives -1.
+    for (TuneTrial& t : trials) t = TuneTrial{t.label, t.flags};
+    work = 0;
+    search.halving = false;
+    best = run_search(trials, search, measure, log);
+    CHECK(best == 6 && work == 9 * 2);
+    search.mem_ceiling = 0;
+    for (TuneTrial& t : trials) t.fits = true;
+    CHECK(run_search(trials, search, measure, log) == 8);
+    search.mem_ceiling = 1;
+    trials.resize(3);
+    for (TuneTrial& t : trials) t.fits = true;
+    CHECK(run_search(trials, search, [](TuneTrial& t, size_t) { t.peak_bytes = 2; }, log) == -1);
+
+    // Halving keeps the best trial of an earlier round when every survivor
+    // of a later one goes over the ceiling.
+    trials.clear();
+    for (size_t v = 1; v <= 9; ++v) trials.push_back(TuneTrial{"v=" + std::to_string(v), {{"v", std::to_string(v)}}});
+    search.halving = true;
+    search.mem_ceiling = 20;
+    best = run_search(trials, search, [](TuneTrial& t, size_t units) {
+        const double v = std::stod(t.flags[0].second);
+        t.rate = v * 100.0;
+        t.peak_bytes = static_cast<size_t>(v) * units;
+    }, log);
+    CHECK(best == 8 && trials[8].rounds == 2 && trials[8].fits);
+    CHECK(trials[8].rate == 900.0 && trials[8].peak_bytes == 18);
+
+    fs::remove_all(dir);
+    std::printf("tune config ok\n");
+    return 0;
+}